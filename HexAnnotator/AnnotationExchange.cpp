@@ -0,0 +1,944 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "AnnotationExchange.h"
+#include "AnnotationFile.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+std::string FormatData(const std::vector<BYTE>& data, int offset, int length, std::string_view format);
+
+// Annotations encoded by one pool task, and tasks per block written to the
+// file. Only one block of text is held at a time.
+const size_t EXPORT_ANNOTATIONS_PER_TASK = 4096;
+const size_t EXPORT_TASKS_PER_BLOCK = 64;
+
+// Bytes passed to FormatData for an exported value. Numbers need at most 8;
+// hex and text dumps of large annotations are cut short.
+const int EXPORT_VALUE_BYTES = 256;
+
+// Thrown while parsing and turned into a message with the line number
+struct ImportError {
+    std::string message;
+};
+
+//-------------------------------------------------------------------
+// Text encoding
+//-------------------------------------------------------------------
+static bool isAscii(std::string_view text) {
+    for (char c : text) {
+        if (static_cast<unsigned char>(c) >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Between the ANSI code page and UTF-8. ASCII, by far the common case, is
+// the same in both and is not converted.
+static std::string convertCodePage(std::string_view text, UINT from, UINT to) {
+    if (isAscii(text)) {
+        return std::string(text);
+    }
+
+    int wideLength = MultiByteToWideChar(from, 0, text.data(), static_cast<int>(text.size()), NULL, 0);
+    std::wstring wide(wideLength, L'\0');
+    MultiByteToWideChar(from, 0, text.data(), static_cast<int>(text.size()), wide.data(), wideLength);
+
+    int length = WideCharToMultiByte(to, 0, wide.data(), wideLength, NULL, 0, NULL, NULL);
+    std::string converted(length, '\0');
+    WideCharToMultiByte(to, 0, wide.data(), wideLength, converted.data(), length, NULL, NULL);
+    return converted;
+}
+
+template <class Integer>
+static bool parseInteger(std::string_view text, Integer& value, int base = 10) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+    return error == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+
+//-------------------------------------------------------------------
+// Export
+//-------------------------------------------------------------------
+static void appendJsonString(std::string& out, std::string_view text) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    std::string utf8 = convertCodePage(text, CP_ACP, CP_UTF8);
+
+    out += '"';
+    for (char c : utf8) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += HEX_DIGITS[c >> 4];
+                out += HEX_DIGITS[c & 15];
+            }
+            else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+static void appendCsvField(std::string& out, std::string_view text) {
+    std::string utf8 = convertCodePage(text, CP_ACP, CP_UTF8);
+
+    if (utf8.find_first_of(",\"\r\n") == std::string::npos) {
+        out += utf8;
+        return;
+    }
+
+    out += '"';
+    for (char c : utf8) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+// Empty for record arrays, which FormatData has no output for
+static std::string exportedValue(const Annotation& anno, const std::vector<BYTE>& data) {
+    if (anno.displayFormat == RECORD_ARRAY_FORMAT) {
+        return std::string();
+    }
+    int length = std::min(anno.endOffset - anno.startOffset + 1, EXPORT_VALUE_BYTES);
+    return FormatData(data, anno.startOffset, length, anno.displayFormat);
+}
+
+static void appendAnnotationJson(std::string& out, const Annotation& anno, const std::vector<BYTE>* data) {
+    out += "{\"start\": ";
+    out += std::to_string(anno.startOffset);
+    out += ", \"end\": ";
+    out += std::to_string(anno.endOffset);
+    out += ", \"label\": ";
+    appendJsonString(out, anno.label);
+    out += ", \"format\": ";
+    appendJsonString(out, anno.displayFormat);
+    out += ", \"color\": ";
+    out += std::to_string(anno.colorIndex);
+
+    std::string aux = AnnotationAuxText(anno);
+    if (!aux.empty()) {
+        out += ", \"aux\": ";
+        appendJsonString(out, aux);
+    }
+    if (data) {
+        out += ", \"value\": ";
+        appendJsonString(out, exportedValue(anno, *data));
+    }
+    out += '}';
+}
+
+static void appendAnnotationCsv(std::string& out, const Annotation& anno, const std::vector<BYTE>* data) {
+    out += std::to_string(anno.startOffset);
+    out += ',';
+    out += std::to_string(anno.endOffset);
+    out += ',';
+    appendCsvField(out, anno.label);
+    out += ',';
+    appendCsvField(out, anno.displayFormat);
+    out += ',';
+    out += std::to_string(anno.colorIndex);
+    out += ',';
+    appendCsvField(out, AnnotationAuxText(anno));
+    if (data) {
+        out += ',';
+        appendCsvField(out, exportedValue(anno, *data));
+    }
+    out += "\r\n";
+}
+
+ExchangeFormat ExchangeFormatForPath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    if (dot != std::string::npos && path.find_first_of("\\/", dot) == std::string::npos) {
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+        if (extension == "csv") {
+            return ExchangeFormat::Csv;
+        }
+    }
+    return ExchangeFormat::Json;
+}
+
+void ExportAnnotations(const std::string& path, ExchangeFormat format, const DocumentWindowState& state,
+    bool includeValues) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for writing.");
+    }
+
+    bool json = format == ExchangeFormat::Json;
+    const std::vector<BYTE>* data = includeValues ? &state.fileData : nullptr;
+
+    std::string head;
+    if (json) {
+        head = "{\"document\": ";
+        appendJsonString(head, state.fileName);
+        if (state.fingerprint.known()) {
+            char hash[20];
+            sprintf_s(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(state.fingerprint.hash));
+            head += ", \"size\": " + std::to_string(state.fingerprint.size) + ", \"hash\": \"" + hash + "\"";
+        }
+        head += ",\n\"annotations\": [\n";
+    }
+    else {
+        head = includeValues ? "start,end,label,format,color,aux,value\r\n" : "start,end,label,format,color,aux\r\n";
+    }
+    file.write(head.data(), static_cast<std::streamsize>(head.size()));
+
+    // Each block is encoded in parallel and then written in order. The
+    // buffers keep their capacity from block to block.
+    const auto& annotations = state.annotations;
+    const size_t blockSize = EXPORT_ANNOTATIONS_PER_TASK * EXPORT_TASKS_PER_BLOCK;
+    std::vector<std::string> pieces(EXPORT_TASKS_PER_BLOCK);
+
+    for (size_t blockStart = 0; blockStart < annotations.size(); blockStart += blockSize) {
+        size_t blockEnd = std::min(annotations.size(), blockStart + blockSize);
+        size_t taskCount = (blockEnd - blockStart + EXPORT_ANNOTATIONS_PER_TASK - 1) / EXPORT_ANNOTATIONS_PER_TASK;
+
+        WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+            std::string& out = pieces[task];
+            out.clear();
+
+            size_t first = blockStart + task * EXPORT_ANNOTATIONS_PER_TASK;
+            size_t last = std::min(blockEnd, first + EXPORT_ANNOTATIONS_PER_TASK);
+            for (size_t i = first; i < last; ++i) {
+                if (json) {
+                    if (i > 0) {
+                        out += ",\n";
+                    }
+                    appendAnnotationJson(out, annotations[i], data);
+                }
+                else {
+                    appendAnnotationCsv(out, annotations[i], data);
+                }
+            }
+        });
+
+        for (size_t task = 0; task < taskCount; ++task) {
+            file.write(pieces[task].data(), static_cast<std::streamsize>(pieces[task].size()));
+        }
+    }
+
+    if (json) {
+        file.write("\n]}\n", 4);
+    }
+
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write the export file.");
+    }
+}
+
+//-------------------------------------------------------------------
+// Import
+//-------------------------------------------------------------------
+// Turns the fields of one imported annotation into an Annotation, skipping
+// those that do not fit the document
+class AnnotationBuilder {
+public:
+    AnnotationBuilder(ImportedAnnotations& result, size_t documentSize)
+        : result(result), documentSize(documentSize) {
+    }
+
+    void add(long long start, long long end, std::string_view label, std::string_view format, long long color,
+        bool hasColor, std::string_view aux) {
+        if (start < 0 || start > end || end > INT_MAX || static_cast<unsigned long long>(end) >= documentSize) {
+            ++result.skipped;
+            return;
+        }
+
+        Annotation anno;
+        anno.startOffset = static_cast<int>(start);
+        anno.endOffset = static_cast<int>(end);
+        anno.label = convertCodePage(label, CP_UTF8, CP_ACP);
+        anno.displayFormat = format.empty() ? std::string("hex") : std::string(format);
+
+        int colorCount = static_cast<int>(std::size(annotationColors));
+        anno.colorIndex = hasColor && color >= 0 && color < colorCount
+            ? static_cast<int>(color)
+            : static_cast<int>(result.annotations.size() % colorCount);
+
+        if (!aux.empty()) {
+            applyAux(anno, aux);
+            if (!RecordLayoutFits(anno)) {
+                throw ImportError{ "the record layout does not match the annotation's extent" };
+            }
+        }
+
+        result.annotations.push_back(std::move(anno));
+    }
+
+private:
+    // Annotations of one record array or template usually share their aux
+    // text, so they share its decoded layout too, as when loaded from .hva.
+    // The text is UTF-8 like the labels; it is decoded in the ANSI code page.
+    void applyAux(Annotation& anno, std::string_view aux) {
+        std::string key(aux);
+        auto it = auxTemplates.find(key);
+        if (it == auxTemplates.end()) {
+            Annotation decoded;
+            try {
+                ApplyAnnotationAuxText(decoded, convertCodePage(aux, CP_UTF8, CP_ACP));
+            }
+            catch (const std::runtime_error&) {
+                throw ImportError{ "the aux text is not a valid record layout, expression or checksum" };
+            }
+            it = auxTemplates.emplace(std::move(key), std::move(decoded)).first;
+        }
+
+        anno.layout = it->second.layout;
+        anno.computed = it->second.computed;
+        anno.checksum = it->second.checksum;
+        anno.stale = it->second.stale;
+    }
+
+    ImportedAnnotations& result;
+    size_t documentSize;
+    std::unordered_map<std::string, Annotation> auxTemplates;
+};
+
+//-------------------------------------------------------------------
+// JSON
+//-------------------------------------------------------------------
+// Event-driven JSON reader over text in memory. Strings without escapes are
+// passed to the handler in place and the rest are decoded into a reused
+// buffer, so a string is only valid until the next event. Nesting is kept
+// on an explicit stack, so deep input cannot overflow the call stack.
+template <class Handler>
+class JsonReader {
+public:
+    JsonReader(std::string_view text, Handler& handler)
+        : begin(text.data()), p(text.data()), end(text.data() + text.size()), handler(handler) {
+    }
+
+    void parse() {
+        if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+            p += 3;
+        }
+
+        std::vector<char> closers;
+        while (true) {
+            // A value is expected
+            skipSpace();
+            if (p == end) {
+                fail();
+            }
+
+            char c = *p;
+            if (c == '{') {
+                ++p;
+                handler.beginObject();
+                skipSpace();
+                if (p < end && *p == '}') {
+                    ++p;
+                    handler.endObject();
+                }
+                else {
+                    closers.push_back('}');
+                    readKey();
+                    continue;
+                }
+            }
+            else if (c == '[') {
+                ++p;
+                handler.beginArray();
+                skipSpace();
+                if (p < end && *p == ']') {
+                    ++p;
+                    handler.endArray();
+                }
+                else {
+                    closers.push_back(']');
+                    continue;
+                }
+            }
+            else if (c == '"') {
+                handler.string(readString());
+            }
+            else if (c == '-' || (c >= '0' && c <= '9')) {
+                handler.number(readNumber());
+            }
+            else {
+                readLiteral();
+                handler.literal();
+            }
+
+            // After a value: a comma, or the end of one or more containers
+            while (true) {
+                skipSpace();
+                if (closers.empty()) {
+                    if (p != end) {
+                        fail();
+                    }
+                    return;
+                }
+                if (p == end) {
+                    fail();
+                }
+
+                char next = *p++;
+                if (next == ',') {
+                    if (closers.back() == '}') {
+                        readKey();
+                    }
+                    break;
+                }
+                if (next != closers.back()) {
+                    fail();
+                }
+                closers.pop_back();
+                if (next == '}') {
+                    handler.endObject();
+                }
+                else {
+                    handler.endArray();
+                }
+            }
+        }
+    }
+
+    // Line of the current position, for error messages
+    size_t line() const {
+        return 1 + std::count(begin, p, '\n');
+    }
+
+private:
+    [[noreturn]] void fail() const {
+        throw ImportError{ "the text is not valid JSON" };
+    }
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            ++p;
+        }
+    }
+
+    void readKey() {
+        skipSpace();
+        if (p == end || *p != '"') {
+            fail();
+        }
+        handler.key(readString());
+        skipSpace();
+        if (p == end || *p != ':') {
+            fail();
+        }
+        ++p;
+    }
+
+    std::string_view readString() {
+        const char* start = ++p;
+        while (p < end && *p != '"' && *p != '\\') {
+            if (static_cast<unsigned char>(*p) < 0x20) {
+                fail();
+            }
+            ++p;
+        }
+        if (p == end) {
+            fail();
+        }
+        if (*p == '"') {
+            return std::string_view(start, p++ - start);
+        }
+
+        scratch.assign(start, p);
+        while (true) {
+            if (p == end || static_cast<unsigned char>(*p) < 0x20) {
+                fail();
+            }
+            char c = *p++;
+            if (c == '"') {
+                return scratch;
+            }
+            if (c != '\\') {
+                scratch += c;
+                continue;
+            }
+
+            if (p == end) {
+                fail();
+            }
+            switch (*p++) {
+            case '"': scratch += '"'; break;
+            case '\\': scratch += '\\'; break;
+            case '/': scratch += '/'; break;
+            case 'b': scratch += '\b'; break;
+            case 'f': scratch += '\f'; break;
+            case 'n': scratch += '\n'; break;
+            case 'r': scratch += '\r'; break;
+            case 't': scratch += '\t'; break;
+            case 'u': appendCodePoint(readEscapedCodePoint()); break;
+            default: fail();
+            }
+        }
+    }
+
+    unsigned readHex4() {
+        unsigned value;
+        if (end - p < 4 || !parseInteger(std::string_view(p, 4), value, 16)) {
+            fail();
+        }
+        p += 4;
+        return value;
+    }
+
+    // After "\u"; joins surrogate pairs
+    unsigned readEscapedCodePoint() {
+        unsigned unit = readHex4();
+        if (unit >= 0xD800 && unit < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+            p += 2;
+            unsigned low = readHex4();
+            if (low < 0xDC00 || low >= 0xE000) {
+                fail();
+            }
+            return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+        }
+        return unit;
+    }
+
+    void appendCodePoint(unsigned codePoint) {
+        if (codePoint < 0x80) {
+            scratch += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800) {
+            scratch += static_cast<char>(0xC0 | (codePoint >> 6));
+            scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000) {
+            scratch += static_cast<char>(0xE0 | (codePoint >> 12));
+            scratch += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else {
+            scratch += static_cast<char>(0xF0 | (codePoint >> 18));
+            scratch += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            scratch += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            scratch += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    std::string_view readNumber() {
+        const char* start = p;
+        auto digits = [&]() {
+            const char* first = p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                ++p;
+            }
+            if (p == first) {
+                fail();
+            }
+        };
+
+        if (*p == '-') {
+            ++p;
+        }
+        digits();
+        if (p < end && *p == '.') {
+            ++p;
+            digits();
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            ++p;
+            if (p < end && (*p == '+' || *p == '-')) {
+                ++p;
+            }
+            digits();
+        }
+        return std::string_view(start, p - start);
+    }
+
+    void readLiteral() {
+        for (const char* word : { "true", "false", "null" }) {
+            size_t length = strlen(word);
+            if (static_cast<size_t>(end - p) >= length && memcmp(p, word, length) == 0) {
+                p += length;
+                return;
+            }
+        }
+        fail();
+    }
+
+    const char* begin;
+    const char* p;
+    const char* end;
+    Handler& handler;
+    std::string scratch;
+};
+
+// Picks the document header and the annotation objects out of the events;
+// anything else, including unknown keys and their values, is ignored
+class AnnotationJsonHandler {
+public:
+    AnnotationJsonHandler(ImportedAnnotations& result, size_t documentSize)
+        : result(result), builder(result, documentSize) {
+    }
+
+    void beginObject() {
+        if (depth == 0) {
+            sawDocument = true;
+        }
+        else if (inAnnotations && depth == 2) {
+            startAnnotation();
+        }
+        ++depth;
+        field = Field::Other;
+    }
+
+    void endObject() {
+        --depth;
+        if (inAnnotations && depth == 2) {
+            finishAnnotation();
+        }
+    }
+
+    void beginArray() {
+        if (depth == 1 && field == Field::Annotations) {
+            inAnnotations = true;
+            sawAnnotations = true;
+        }
+        ++depth;
+        field = Field::Other;
+    }
+
+    void endArray() {
+        --depth;
+        if (depth == 1) {
+            inAnnotations = false;
+        }
+    }
+
+    void key(std::string_view name) {
+        field = Field::Other;
+        if (depth == 1) {
+            if (name == "document") field = Field::Document;
+            else if (name == "size") field = Field::Size;
+            else if (name == "hash") field = Field::Hash;
+            else if (name == "annotations") field = Field::Annotations;
+        }
+        else if (inAnnotations && depth == 3) {
+            if (name == "start") field = Field::Start;
+            else if (name == "end") field = Field::End;
+            else if (name == "label") field = Field::Label;
+            else if (name == "format") field = Field::Format;
+            else if (name == "color") field = Field::Color;
+            else if (name == "aux") field = Field::Aux;
+        }
+    }
+
+    void string(std::string_view text) {
+        switch (field) {
+        case Field::Document:
+            result.documentName = convertCodePage(text, CP_UTF8, CP_ACP);
+            break;
+        case Field::Hash:
+            if (!parseInteger(text, result.fingerprint.hash, 16)) {
+                throw ImportError{ "the hash is not a hexadecimal number" };
+            }
+            break;
+        case Field::Label:
+            label.assign(text);
+            break;
+        case Field::Format:
+            format.assign(text);
+            break;
+        case Field::Aux:
+            aux.assign(text);
+            break;
+        case Field::Size:
+        case Field::Start:
+        case Field::End:
+        case Field::Color:
+            throw ImportError{ "a number was expected" };
+        default:
+            break;
+        }
+        field = Field::Other;
+    }
+
+    void number(std::string_view text) {
+        switch (field) {
+        case Field::Size:
+            if (!parseInteger(text, result.fingerprint.size)) {
+                throw ImportError{ "the size is not a byte count" };
+            }
+            break;
+        case Field::Start:
+            hasStart = readInteger(text, start);
+            break;
+        case Field::End:
+            hasEnd = readInteger(text, end);
+            break;
+        case Field::Color:
+            hasColor = readInteger(text, color);
+            break;
+        case Field::Document:
+        case Field::Hash:
+        case Field::Label:
+        case Field::Format:
+        case Field::Aux:
+            throw ImportError{ "a string was expected" };
+        default:
+            break;
+        }
+        field = Field::Other;
+    }
+
+    void literal() {
+        field = Field::Other;
+    }
+
+    // After the reader finished
+    void finish() {
+        if (!sawDocument || !sawAnnotations) {
+            throw ImportError{ "there is no \"annotations\" array" };
+        }
+    }
+
+private:
+    enum class Field {
+        None, Other, Document, Size, Hash, Annotations, Start, End, Label, Format, Color, Aux
+    };
+
+    static bool readInteger(std::string_view text, long long& value) {
+        if (!parseInteger(text, value)) {
+            throw ImportError{ "an integer was expected" };
+        }
+        return true;
+    }
+
+    void startAnnotation() {
+        hasStart = hasEnd = hasColor = false;
+        label.clear();
+        format.clear();
+        aux.clear();
+    }
+
+    void finishAnnotation() {
+        if (!hasStart || !hasEnd) {
+            throw ImportError{ "an annotation has no start or end offset" };
+        }
+        builder.add(start, end, label, format, color, hasColor, aux);
+    }
+
+    ImportedAnnotations& result;
+    AnnotationBuilder builder;
+    int depth = 0;
+    bool inAnnotations = false;
+    bool sawDocument = false;
+    bool sawAnnotations = false;
+    Field field = Field::None;
+
+    // The annotation being read; the strings keep their capacity
+    long long start = 0, end = 0, color = 0;
+    bool hasStart = false, hasEnd = false, hasColor = false;
+    std::string label, format, aux;
+};
+
+static std::runtime_error importFailure(size_t line, const ImportError& error) {
+    return std::runtime_error("Error on line " + std::to_string(line) + " of the import file: " + error.message + ".");
+}
+
+ImportedAnnotations ParseAnnotationsJson(std::string_view text, size_t documentSize) {
+    ImportedAnnotations result;
+    AnnotationJsonHandler handler(result, documentSize);
+    JsonReader<AnnotationJsonHandler> reader(text, handler);
+
+    try {
+        reader.parse();
+        handler.finish();
+    }
+    catch (const ImportError& error) {
+        throw importFailure(reader.line(), error);
+    }
+
+    // A hash alone is not a fingerprint
+    if (result.fingerprint.size == 0) {
+        result.fingerprint = ContentFingerprint();
+    }
+    return result;
+}
+
+//-------------------------------------------------------------------
+// CSV
+//-------------------------------------------------------------------
+// RFC 4180 records over text in memory. Unquoted fields and quoted fields
+// without doubled quotes are returned in place; the rest are unescaped into
+// per-column buffers, so fields are valid until the next record.
+class CsvReader {
+public:
+    explicit CsvReader(std::string_view text)
+        : p(text.data()), end(text.data() + text.size()) {
+        if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+            p += 3;
+        }
+    }
+
+    // False at the end of the text
+    bool next(std::vector<std::string_view>& fields) {
+        if (p == end) {
+            return false;
+        }
+
+        fields.clear();
+        recordLine = nextLine;
+
+        while (true) {
+            std::string_view field;
+
+            if (*p == '"') {
+                const char* start = ++p;
+                bool doubled = false;
+                while (true) {
+                    const char* quote = static_cast<const char*>(memchr(p, '"', end - p));
+                    if (!quote) {
+                        throw ImportError{ "a quoted field is not closed" };
+                    }
+                    nextLine += std::count(p, quote, '\n');
+                    p = quote + 1;
+                    if (p < end && *p == '"') {
+                        doubled = true;
+                        ++p;
+                        continue;
+                    }
+                    break;
+                }
+
+                field = std::string_view(start, p - 1 - start);
+                if (doubled) {
+                    if (unquoted.size() <= fields.size()) {
+                        unquoted.resize(fields.size() + 1);
+                    }
+                    std::string& buffer = unquoted[fields.size()];
+                    buffer.clear();
+                    for (size_t i = 0; i < field.size(); ++i) {
+                        buffer += field[i];
+                        if (field[i] == '"') {
+                            ++i;
+                        }
+                    }
+                    field = buffer;
+                }
+
+                if (p < end && *p != ',' && *p != '\r' && *p != '\n') {
+                    throw ImportError{ "a quoted field is followed by more text" };
+                }
+            }
+            else {
+                const char* start = p;
+                while (p < end && *p != ',' && *p != '\r' && *p != '\n') {
+                    ++p;
+                }
+                field = std::string_view(start, p - start);
+            }
+
+            fields.push_back(field);
+
+            if (p == end) {
+                return true;
+            }
+            if (*p == ',') {
+                ++p;
+                continue;
+            }
+
+            if (*p == '\r') {
+                ++p;
+            }
+            if (p < end && *p == '\n') {
+                ++p;
+            }
+            ++nextLine;
+            return true;
+        }
+    }
+
+    // Line the last record started on
+    size_t line() const { return recordLine; }
+
+private:
+    const char* p;
+    const char* end;
+    size_t recordLine = 1;
+    size_t nextLine = 1;
+    std::vector<std::string> unquoted;
+};
+
+ImportedAnnotations ParseAnnotationsCsv(std::string_view text, size_t documentSize) {
+    ImportedAnnotations result;
+    AnnotationBuilder builder(result, documentSize);
+    CsvReader reader(text);
+    std::vector<std::string_view> fields;
+
+    try {
+        // Columns by name; -1 if absent
+        enum { START, END, LABEL, FORMAT, COLOR, AUX, COLUMN_COUNT };
+        const char* const names[COLUMN_COUNT] = { "start", "end", "label", "format", "color", "aux" };
+        int columns[COLUMN_COUNT] = { -1, -1, -1, -1, -1, -1 };
+
+        if (!reader.next(fields)) {
+            throw ImportError{ "the file is empty" };
+        }
+        for (size_t i = 0; i < fields.size(); ++i) {
+            for (int column = 0; column < COLUMN_COUNT; ++column) {
+                if (fields[i] == names[column]) {
+                    columns[column] = static_cast<int>(i);
+                }
+            }
+        }
+        if (columns[START] < 0 || columns[END] < 0) {
+            throw ImportError{ "the header has no start and end columns" };
+        }
+
+        auto column = [&](int index) {
+            return columns[index] >= 0 && columns[index] < static_cast<int>(fields.size())
+                ? fields[columns[index]] : std::string_view();
+        };
+
+        while (reader.next(fields)) {
+            if (fields.size() == 1 && fields[0].empty()) {
+                continue;   // Blank line
+            }
+
+            long long start, end, color = 0;
+            if (!parseInteger(column(START), start) || !parseInteger(column(END), end)) {
+                throw ImportError{ "the start or end offset is not an integer" };
+            }
+            bool hasColor = !column(COLOR).empty();
+            if (hasColor && !parseInteger(column(COLOR), color)) {
+                throw ImportError{ "the color is not an integer" };
+            }
+
+            builder.add(start, end, column(LABEL), column(FORMAT), color, hasColor, column(AUX));
+        }
+    }
+    catch (const ImportError& error) {
+        throw importFailure(reader.line(), error);
+    }
+
+    return result;
+}
+
+ImportedAnnotations ImportAnnotations(const std::string& path, ExchangeFormat format, size_t documentSize) {
+    MappedFile file(path);
+    std::string_view text(reinterpret_cast<const char*>(file.data()), file.length());
+
+    return format == ExchangeFormat::Csv
+        ? ParseAnnotationsCsv(text, documentSize)
+        : ParseAnnotationsJson(text, documentSize);
+}
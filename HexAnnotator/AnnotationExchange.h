@@ -0,0 +1,55 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "includes.h"
+
+// Annotations as JSON or CSV for other tools. Export writes the annotations
+// out a block at a time and import reads a mapped file with an event-driven
+// parser instead of building a document tree, so neither holds more than
+// the annotations themselves in memory.
+//
+// JSON:
+//
+//   {"document": "<name>", "size": <bytes>, "hash": "<hex>",
+//    "annotations": [
+//     {"start": 16, "end": 19, "label": "Size", "format": "int", "color": 2,
+//      "aux": "X\n", "value": "512"},
+//     ...]}
+//
+// CSV, with a header row naming the columns in any order:
+//
+//   start,end,label,format,color,aux,value
+//
+// Offsets are decimal and end is inclusive, as in Annotation. "aux" holds
+// the record layout, expressions and stale mark in the .hva text form and is
+// left out when empty. "value" is FormatData's output, written on request
+// and ignored on import since it derives from the bytes. Text is UTF-8 in
+// the file and the ANSI code page in memory.
+
+enum class ExchangeFormat {
+    Json,
+    Csv
+};
+
+// ".csv" is CSV, anything else JSON
+ExchangeFormat ExchangeFormatForPath(const std::string& path);
+
+// Throws std::runtime_error
+void ExportAnnotations(const std::string& path, ExchangeFormat format, const DocumentWindowState& state,
+    bool includeValues);
+
+struct ImportedAnnotations {
+    std::string documentName;       // JSON only
+    ContentFingerprint fingerprint; // JSON only; unknown if absent
+    std::vector<Annotation> annotations;
+    size_t skipped = 0;             // Annotations that do not fit the document
+};
+
+// Map and parse a file. Throws std::runtime_error naming the line of the
+// first error.
+ImportedAnnotations ImportAnnotations(const std::string& path, ExchangeFormat format, size_t documentSize);
+
+// Parse text that is already in memory
+ImportedAnnotations ParseAnnotationsJson(std::string_view text, size_t documentSize);
+ImportedAnnotations ParseAnnotationsCsv(std::string_view text, size_t documentSize);
@@ -0,0 +1,666 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include "AnnotationFile.h"
+#include "ChecksumFields.h"
+#include "LabelIndex.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+// Version 2 files are read in place, which only works on a little-endian host
+static_assert(std::endian::native == std::endian::little, "annotation files are little-endian");
+
+// Records converted by one pool task when a version 2 file is loaded
+const size_t RECORDS_PER_LOAD_TASK = 65536;
+
+// Loaded texts are copied out of the string table instead of sharing it when
+// they reference less than 1 / STRING_TABLE_SHARE_RATIO of its bytes
+const uint64_t STRING_TABLE_SHARE_RATIO = 4;
+
+static std::runtime_error corruptFile() {
+    return std::runtime_error("The annotation file is damaged or truncated.");
+}
+
+//-------------------------------------------------------------------
+// Auxiliary data
+//-------------------------------------------------------------------
+// Record layouts, computed expressions and checksum declarations are stored
+// as short line-based text in the string table, so identical layouts share
+// one entry:
+//
+//   L <stride> <count>
+//   F <offset> <length> <colorIndex> <format> <name>
+//   S|N|V <start, length or value expression>
+//   C <algorithm> le|be <covered label>
+//   X                         (stale after a rebase)
+static std::string encodeAux(const Annotation& anno) {
+    std::ostringstream aux;
+
+    if (anno.layout) {
+        aux << "L " << anno.layout->stride << ' ' << anno.layout->count << '\n';
+        for (const auto& field : anno.layout->fields) {
+            aux << "F " << field.offset << ' ' << field.length << ' ' << field.colorIndex << ' '
+                << field.displayFormat << ' ' << field.name << '\n';
+        }
+    }
+
+    if (anno.computed) {
+        if (!anno.computed->start.empty()) aux << "S " << anno.computed->start << '\n';
+        if (!anno.computed->length.empty()) aux << "N " << anno.computed->length << '\n';
+        if (!anno.computed->value.empty()) aux << "V " << anno.computed->value << '\n';
+    }
+
+    if (anno.checksum) {
+        aux << "C " << anno.checksum->algorithm << ' ' << (anno.checksum->bigEndian ? "be" : "le") << ' '
+            << anno.checksum->covered << '\n';
+    }
+
+    if (anno.stale) {
+        aux << "X\n";
+    }
+
+    return aux.str();
+}
+
+// References to a shared string table held for texts about to adopt them.
+// Whatever is not handed out, including the creating reference, is released
+// on destruction, so an exception part way through loading leaks nothing.
+struct StringTableReferences {
+    AnnotationText::Block* block;
+    size_t spare;
+
+    // Takes over the reference a newly created block holds
+    explicit StringTableReferences(AnnotationText::Block* created) : block(created), spare(created ? 1 : 0) {}
+
+    // Takes count further references to block
+    StringTableReferences(AnnotationText::Block* shared, size_t count) : block(shared), spare(shared ? count : 0) {
+        if (spare) block->retain(spare);
+    }
+
+    StringTableReferences(const StringTableReferences&) = delete;
+    StringTableReferences& operator=(const StringTableReferences&) = delete;
+
+    ~StringTableReferences() {
+        if (spare) block->release(spare);
+    }
+
+    AnnotationText adopt(uint32_t offset, uint32_t length) {
+        --spare;
+        return AnnotationText::adopt(block, offset, length);
+    }
+};
+
+struct DecodedAux {
+    std::shared_ptr<const RecordLayout> layout;
+    std::shared_ptr<const ComputedFields> computed;
+    std::shared_ptr<const ChecksumField> checksum;
+    bool stale = false;
+};
+
+static DecodedAux decodeAux(std::string_view text) {
+    DecodedAux decoded;
+    std::shared_ptr<RecordLayout> layout;
+    std::shared_ptr<ComputedFields> computed;
+
+    std::istringstream lines{ std::string(text) };
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line == "X") {
+            decoded.stale = true;
+            continue;
+        }
+        if (line.size() < 2 || line[1] != ' ') {
+            throw corruptFile();
+        }
+        std::string rest = line.substr(2);
+
+        switch (line[0]) {
+        case 'L':
+        {
+            layout = std::make_shared<RecordLayout>();
+            std::istringstream values(rest);
+            if (!(values >> layout->stride >> layout->count) || layout->stride <= 0 || layout->count <= 0) {
+                throw corruptFile();
+            }
+            break;
+        }
+
+        case 'F':
+        {
+            RecordField field;
+            std::istringstream values(rest);
+            if (!layout || !(values >> field.offset >> field.length >> field.colorIndex >> field.displayFormat)) {
+                throw corruptFile();
+            }
+            values.get();
+            std::getline(values, field.name);
+
+            // Fields are kept sorted and apart, as ByteMap looks them up by offset
+            int previousEnd = layout->fields.empty() ? 0 : layout->fields.back().offset + layout->fields.back().length;
+            if (field.offset < previousEnd || field.length <= 0 || field.length > layout->stride - field.offset ||
+                field.colorIndex < 0 || field.colorIndex >= static_cast<int>(std::size(annotationColors))) {
+                throw corruptFile();
+            }
+            layout->fields.push_back(std::move(field));
+            break;
+        }
+
+        case 'S':
+        case 'N':
+        case 'V':
+            if (!computed) {
+                computed = std::make_shared<ComputedFields>();
+            }
+            (line[0] == 'S' ? computed->start : line[0] == 'N' ? computed->length : computed->value) = rest;
+            break;
+
+        case 'C':
+        {
+            ChecksumField checksum;
+            std::string order;
+            std::istringstream values(rest);
+            if (!(values >> checksum.algorithm >> order) || (order != "le" && order != "be")) {
+                throw corruptFile();
+            }
+            values.get();
+            std::getline(values, checksum.covered);
+
+            if (checksum.covered.empty() || !IsChecksumAlgorithm(checksum.algorithm)) {
+                throw corruptFile();
+            }
+            checksum.bigEndian = order == "be";
+            decoded.checksum = std::make_shared<const ChecksumField>(std::move(checksum));
+            break;
+        }
+
+        default:
+            throw corruptFile();
+        }
+    }
+
+    decoded.layout = std::move(layout);
+    decoded.computed = std::move(computed);
+    return decoded;
+}
+
+static bool layoutFits(const RecordLayout* layout, int startOffset, int endOffset) {
+    return !layout || static_cast<int64_t>(endOffset) - startOffset + 1 ==
+        static_cast<int64_t>(layout->stride) * layout->count;
+}
+
+bool RecordLayoutFits(const Annotation& anno) {
+    return layoutFits(anno.layout.get(), anno.startOffset, anno.endOffset);
+}
+
+std::string AnnotationAuxText(const Annotation& anno) {
+    return anno.layout || anno.computed || anno.checksum || anno.stale ? encodeAux(anno) : std::string();
+}
+
+void ApplyAnnotationAuxText(Annotation& anno, std::string_view text) {
+    DecodedAux decoded = decodeAux(text);
+    anno.layout = std::move(decoded.layout);
+    anno.computed = std::move(decoded.computed);
+    anno.checksum = std::move(decoded.checksum);
+    anno.stale = decoded.stale;
+}
+
+//-------------------------------------------------------------------
+// WriteAnnotationFile
+//-------------------------------------------------------------------
+// Deduplicating string table. Labels are mostly unique, so lookups go
+// through an open-addressing table of string ids rather than a node-based
+// map that would allocate once per label.
+class StringTableBuilder {
+public:
+    explicit StringTableBuilder(size_t expectedStrings)
+        : slots(std::bit_ceil(std::max<size_t>(expectedStrings * 2, 64)), NO_STRING) {}
+
+    uint32_t add(std::string_view text) {
+        size_t mask = slots.size() - 1;
+        for (size_t slot = std::hash<std::string_view>{}(text) & mask;; slot = (slot + 1) & mask) {
+            uint32_t id = slots[slot];
+            if (id == NO_STRING) {
+                id = append(text);
+                slots[slot] = id;
+                if (entries.size() * 2 > slots.size()) {
+                    grow();
+                }
+                return id;
+            }
+            if (stringAt(id) == text) {
+                return id;
+            }
+        }
+    }
+
+    std::vector<StringEntryV2> entries;
+    std::string data;
+
+private:
+    std::string_view stringAt(uint32_t id) const {
+        return std::string_view(data.data() + entries[id].offset, entries[id].length);
+    }
+
+    uint32_t append(std::string_view text) {
+        if (data.size() + text.size() > UINT32_MAX || entries.size() >= NO_STRING) {
+            throw std::runtime_error("Too many annotation labels to save.");
+        }
+        entries.push_back({ static_cast<uint32_t>(data.size()), static_cast<uint32_t>(text.size()) });
+        data.append(text);
+        return static_cast<uint32_t>(entries.size() - 1);
+    }
+
+    void grow() {
+        slots.assign(slots.size() * 2, NO_STRING);
+        size_t mask = slots.size() - 1;
+        for (uint32_t id = 0; id < entries.size(); ++id) {
+            size_t slot = std::hash<std::string_view>{}(stringAt(id)) & mask;
+            while (slots[slot] != NO_STRING) slot = (slot + 1) & mask;
+            slots[slot] = id;
+        }
+    }
+
+    std::vector<uint32_t> slots;
+};
+
+static uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+void WriteAnnotationFile(const std::string& path, const std::string& documentName, const ContentFingerprint& fingerprint,
+    const std::vector<Annotation>& annotations, uint64_t journalGeneration, const LabelIndex* labelIndex) {
+    StringTableBuilder strings(annotations.size() + 16);
+
+    // Auxiliary data, keyed by the shared objects it was encoded from
+    std::map<std::tuple<const void*, const void*, const void*, bool>, uint32_t> auxIds;
+
+    AnnotationFileHeaderV2 header = {};
+    memcpy(header.signature, "HVA", 4);
+    header.version = ANNOTATION_FILE_VERSION;
+    header.headerSize = sizeof(AnnotationFileHeaderV2);
+    header.recordSize = sizeof(AnnotationRecordV2);
+    header.annotationCount = annotations.size();
+    header.documentName = strings.add(documentName);
+    header.journalGeneration = journalGeneration;
+    if (fingerprint.known()) {
+        header.flags |= ANNOTATION_FLAG_FINGERPRINT;
+        header.documentSize = fingerprint.size;
+        header.documentHash = fingerprint.hash;
+    }
+
+    std::vector<AnnotationRecordV2> records;
+    records.reserve(annotations.size());
+
+    for (const auto& anno : annotations) {
+        AnnotationRecordV2 record;
+        record.startOffset = anno.startOffset;
+        record.endOffset = anno.endOffset;
+        record.colorIndex = anno.colorIndex;
+        record.label = strings.add(anno.label);
+        record.format = strings.add(anno.displayFormat);
+        record.aux = NO_STRING;
+
+        if (anno.layout || anno.computed || anno.checksum || anno.stale) {
+            auto key = std::make_tuple<const void*, const void*, const void*, bool>(
+                anno.layout.get(), anno.computed.get(), anno.checksum.get(), bool(anno.stale));
+            auto it = auxIds.find(key);
+            if (it == auxIds.end()) {
+                it = auxIds.emplace(key, strings.add(encodeAux(anno))).first;
+            }
+            record.aux = it->second;
+        }
+
+        records.push_back(record);
+    }
+
+    header.recordsOffset = alignTo8(sizeof(header));
+    header.stringCount = strings.entries.size();
+    header.stringIndexOffset = alignTo8(header.recordsOffset + records.size() * sizeof(AnnotationRecordV2));
+    header.stringDataOffset = alignTo8(header.stringIndexOffset + strings.entries.size() * sizeof(StringEntryV2));
+    header.stringDataSize = strings.data.size();
+
+    std::string labelIndexBytes;
+    if (labelIndex) {
+        labelIndex->serialize(labelIndexBytes);
+        header.labelIndexOffset = alignTo8(header.stringDataOffset + strings.data.size());
+        header.labelIndexSize = labelIndexBytes.size();
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to open file for writing.");
+    }
+
+    const char padding[8] = {};
+    auto writeAt = [&](uint64_t offset, const void* bytes, size_t length) {
+        uint64_t position = static_cast<uint64_t>(file.tellp());
+        file.write(padding, static_cast<std::streamsize>(offset - position));
+        file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeAt(header.recordsOffset, records.data(), records.size() * sizeof(AnnotationRecordV2));
+    writeAt(header.stringIndexOffset, strings.entries.data(), strings.entries.size() * sizeof(StringEntryV2));
+    writeAt(header.stringDataOffset, strings.data.data(), strings.data.size());
+    if (labelIndex) {
+        writeAt(header.labelIndexOffset, labelIndexBytes.data(), labelIndexBytes.size());
+    }
+
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Failed to write the annotation file.");
+    }
+}
+
+//-------------------------------------------------------------------
+// Version 1
+//-------------------------------------------------------------------
+// Bounds-checked cursor over a file image
+struct ImageReader {
+    const BYTE* data;
+    size_t size;
+    size_t position = 0;
+
+    void read(void* out, size_t length) {
+        if (length > size - position) {
+            throw corruptFile();
+        }
+        memcpy(out, data + position, length);
+        position += length;
+    }
+
+    int readInt() {
+        int value;
+        read(&value, sizeof(value));
+        return value;
+    }
+
+    std::string readString() {
+        int length = readInt();
+        if (length < 0 || static_cast<size_t>(length) > size - position) {
+            throw corruptFile();
+        }
+        std::string text(reinterpret_cast<const char*>(data + position), length);
+        position += length;
+        return text;
+    }
+};
+
+static AnnotationFileContents parseVersion1(const BYTE* data, size_t size, size_t documentSize) {
+    AnnotationFileContents contents;
+    ImageReader reader{ data, size };
+
+    AnnotationFileHeader header;
+    reader.read(&header, sizeof(header));
+    if (header.annotationCount < 0) {
+        throw corruptFile();
+    }
+
+    contents.version = header.version;
+    contents.documentName = reader.readString();
+    contents.annotations.reserve(std::min<size_t>(header.annotationCount, size / 20));
+
+    for (int i = 0; i < header.annotationCount; i++) {
+        Annotation anno;
+        anno.startOffset = reader.readInt();
+        anno.endOffset = reader.readInt();
+        anno.colorIndex = reader.readInt();
+        anno.label = reader.readString();
+        anno.displayFormat = reader.readString();
+
+        // The whole record is read first so a skipped annotation does not
+        // leave the reader in the middle of it
+        if (anno.startOffset < 0 || anno.startOffset > anno.endOffset ||
+            static_cast<size_t>(anno.endOffset) >= documentSize) {
+            ++contents.skipped;
+            continue;
+        }
+        contents.annotations.push_back(std::move(anno));
+    }
+
+    return contents;
+}
+
+//-------------------------------------------------------------------
+// Single annotations
+//-------------------------------------------------------------------
+static void appendInt(std::string& out, int value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void appendString(std::string& out, std::string_view text) {
+    appendInt(out, static_cast<int>(text.size()));
+    out.append(text);
+}
+
+void AppendAnnotationBytes(std::string& out, const Annotation& anno) {
+    appendInt(out, anno.startOffset);
+    appendInt(out, anno.endOffset);
+    appendInt(out, anno.colorIndex);
+    appendString(out, anno.label);
+    appendString(out, anno.displayFormat);
+    appendString(out, AnnotationAuxText(anno));
+}
+
+Annotation ReadAnnotationBytes(const BYTE* data, size_t size, size_t& position) {
+    ImageReader reader{ data, size, position };
+
+    Annotation anno;
+    anno.startOffset = reader.readInt();
+    anno.endOffset = reader.readInt();
+    anno.colorIndex = reader.readInt();
+    anno.label = reader.readString();
+    anno.displayFormat = reader.readString();
+
+    DecodedAux decoded = decodeAux(reader.readString());
+    anno.layout = std::move(decoded.layout);
+    anno.computed = std::move(decoded.computed);
+    anno.checksum = std::move(decoded.checksum);
+    anno.stale = decoded.stale;
+    if (!RecordLayoutFits(anno)) {
+        throw corruptFile();
+    }
+
+    position = reader.position;
+    return anno;
+}
+
+//-------------------------------------------------------------------
+// Version 2
+//-------------------------------------------------------------------
+static bool sectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize) {
+    return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+static AnnotationFileContents parseVersion2(const BYTE* data, size_t size, size_t documentSize) {
+    // Older headers are shorter; the fields they lack stay zero
+    AnnotationFileHeaderV2 header = {};
+    if (size < ANNOTATION_HEADER_V2_MIN_SIZE) {
+        throw corruptFile();
+    }
+    memcpy(&header, data, ANNOTATION_HEADER_V2_MIN_SIZE);
+    if (header.headerSize < ANNOTATION_HEADER_V2_MIN_SIZE || header.headerSize > size) {
+        throw corruptFile();
+    }
+    memcpy(&header, data, std::min<size_t>(header.headerSize, sizeof(header)));
+
+    if (header.recordSize != sizeof(AnnotationRecordV2) ||
+        !sectionFits(header.recordsOffset, header.annotationCount, sizeof(AnnotationRecordV2), size) ||
+        !sectionFits(header.stringIndexOffset, header.stringCount, sizeof(StringEntryV2), size) ||
+        !sectionFits(header.stringDataOffset, header.stringDataSize, 1, size) ||
+        header.documentName >= header.stringCount) {
+        throw corruptFile();
+    }
+
+    const auto* records = reinterpret_cast<const AnnotationRecordV2*>(data + header.recordsOffset);
+    const auto* strings = reinterpret_cast<const StringEntryV2*>(data + header.stringIndexOffset);
+    const char* text = reinterpret_cast<const char*>(data + header.stringDataOffset);
+    const uint64_t recordCount = header.annotationCount;
+    const uint64_t stringCount = header.stringCount;
+    const uint64_t stringDataSize = header.stringDataSize;
+
+    // Validation: one branch-free pass over each array so the compiler can
+    // vectorise it. Bad string references make the file unreadable; ranges
+    // outside the document only drop that annotation.
+    uint32_t corrupt = 0;
+    for (uint64_t i = 0; i < stringCount; ++i) {
+        corrupt |= static_cast<uint64_t>(strings[i].offset) + strings[i].length > stringDataSize;
+    }
+
+    uint64_t fitting = 0;
+    for (uint64_t i = 0; i < recordCount; ++i) {
+        const AnnotationRecordV2& r = records[i];
+        corrupt |= (r.label >= stringCount) | (r.format >= stringCount) |
+            ((r.aux >= stringCount) & (r.aux != NO_STRING));
+        fitting += (r.startOffset >= 0) & (r.startOffset <= r.endOffset) &
+            (static_cast<uint64_t>(static_cast<uint32_t>(r.endOffset)) < documentSize);
+    }
+
+    if (corrupt) {
+        throw corruptFile();
+    }
+
+    auto stringAt = [&](uint32_t index) {
+        return std::string_view(text + strings[index].offset, strings[index].length);
+    };
+
+    // Auxiliary data is decoded once per distinct string and shared
+    std::unordered_map<uint32_t, DecodedAux> aux;
+    for (uint64_t i = 0; i < recordCount; ++i) {
+        uint32_t id = records[i].aux;
+        if (id != NO_STRING && aux.find(id) == aux.end()) {
+            aux.emplace(id, decodeAux(stringAt(id)));
+        }
+    }
+    for (uint64_t i = 0; i < recordCount; ++i) {
+        const AnnotationRecordV2& r = records[i];
+        if (r.aux != NO_STRING && !layoutFits(aux.find(r.aux)->second.layout.get(), r.startOffset, r.endOffset)) {
+            throw corruptFile();
+        }
+    }
+
+    // Records that fit the document, when not all of them do
+    std::vector<uint32_t> selected;
+    if (fitting != recordCount) {
+        selected.reserve(fitting);
+        for (uint64_t i = 0; i < recordCount; ++i) {
+            const AnnotationRecordV2& r = records[i];
+            if (r.startOffset >= 0 && r.startOffset <= r.endOffset && static_cast<uint64_t>(r.endOffset) < documentSize) {
+                selected.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    AnnotationFileContents contents;
+    contents.version = static_cast<int>(header.version);
+    contents.documentName = stringAt(header.documentName);
+    contents.skipped = recordCount - fitting;
+    contents.journalGeneration = header.journalGeneration;
+    if (header.flags & ANNOTATION_FLAG_FINGERPRINT) {
+        contents.fingerprint.size = header.documentSize;
+        contents.fingerprint.hash = header.documentHash;
+    }
+    contents.annotations.resize(fitting);
+
+    // Labels and formats point into one copy of the string table rather than
+    // each holding its own. The file is not kept mapped because saving
+    // rewrites it in place. When records were dropped and the survivors use
+    // little of the table, they get their own copies instead, so the rest of
+    // the table is not kept alive by them.
+    bool shareTable = true;
+    if (!selected.empty()) {
+        uint64_t referenced = 0;
+        for (uint32_t i : selected) {
+            referenced += strings[records[i].label].length + strings[records[i].format].length;
+        }
+        shareTable = referenced * STRING_TABLE_SHARE_RATIO >= stringDataSize;
+    }
+
+    StringTableReferences table(shareTable ? AnnotationText::Block::create(std::string_view(text, stringDataSize)) : nullptr);
+
+    size_t taskCount = (fitting + RECORDS_PER_LOAD_TASK - 1) / RECORDS_PER_LOAD_TASK;
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t first = task * RECORDS_PER_LOAD_TASK;
+        size_t last = std::min<size_t>(first + RECORDS_PER_LOAD_TASK, fitting);
+
+        // The references this task's annotations take are counted at once,
+        // so the loop leaves the shared count alone
+        StringTableReferences references(table.block, 2 * (last - first));
+        auto textAt = [&](uint32_t index) {
+            return references.block
+                ? references.adopt(strings[index].offset, strings[index].length)
+                : AnnotationText(stringAt(index));
+        };
+
+        for (size_t i = first; i < last; ++i) {
+            const AnnotationRecordV2& r = records[selected.empty() ? i : selected[i]];
+            Annotation& anno = contents.annotations[i];
+
+            anno.startOffset = r.startOffset;
+            anno.endOffset = r.endOffset;
+            anno.colorIndex = r.colorIndex;
+            anno.label = textAt(r.label);
+            anno.displayFormat = textAt(r.format);
+
+            if (r.aux != NO_STRING) {
+                const DecodedAux& decoded = aux.find(r.aux)->second;
+                anno.layout = decoded.layout;
+                anno.computed = decoded.computed;
+                anno.checksum = decoded.checksum;
+                anno.stale = decoded.stale;
+            }
+        }
+    });
+
+    // The index refers to annotations by position, so it only applies if
+    // none were skipped. A damaged index is rebuilt when needed instead.
+    if (header.labelIndexOffset != 0 && contents.skipped == 0 &&
+        sectionFits(header.labelIndexOffset, header.labelIndexSize, 1, size)) {
+        try {
+            contents.labelIndex = std::make_shared<LabelIndex>(data + header.labelIndexOffset,
+                header.labelIndexSize, contents.annotations.size());
+        }
+        catch (const std::runtime_error&) {
+        }
+    }
+
+    return contents;
+}
+
+//-------------------------------------------------------------------
+// ParseAnnotationFile / ReadAnnotationFile
+//-------------------------------------------------------------------
+AnnotationFileContents ParseAnnotationFile(const BYTE* data, size_t size, size_t documentSize) {
+    if (size < sizeof(AnnotationFileHeader) || memcmp(data, "HVA", 4) != 0) {
+        throw std::runtime_error("Invalid annotation file format.");
+    }
+
+    int32_t version;
+    memcpy(&version, data + 4, sizeof(version));
+
+    AnnotationFileContents contents = version <= 1
+        ? parseVersion1(data, size, documentSize)
+        : parseVersion2(data, size, documentSize);
+
+    // Colours index a fixed palette
+    for (auto& anno : contents.annotations) {
+        if (anno.colorIndex < 0 || anno.colorIndex >= static_cast<int>(std::size(annotationColors))) {
+            anno.colorIndex = 0;
+        }
+    }
+    return contents;
+}
+
+AnnotationFileContents ReadAnnotationFile(const std::string& path, size_t documentSize) {
+    MappedFile mapped(path);
+    return ParseAnnotationFile(mapped.data(), mapped.length(), documentSize);
+}
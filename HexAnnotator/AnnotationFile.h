@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "includes.h"
+
+// Version written by WriteAnnotationFile. Version 1 files still load.
+const int ANNOTATION_FILE_VERSION = 2;
+
+// Version 1 header: followed by the document name and then one variable
+// length record per annotation, all in host byte order
+struct AnnotationFileHeader {
+    char signature[4];        // "HVA\0" (Hex Viewer Annotations)
+    int version;              // File format version
+    int annotationCount;      // Number of annotations
+    int reserved[4];          // Reserved for future use
+};
+
+//-------------------------------------------------------------------
+// Version 2 layout
+//-------------------------------------------------------------------
+// Little-endian throughout, every section 8-byte aligned:
+//
+//   AnnotationFileHeaderV2
+//   AnnotationRecordV2[annotationCount]
+//   StringEntryV2[stringCount]
+//   string data (not terminated)
+//   label index (optional)
+//
+// Labels, formats and auxiliary data are stored once in the string table
+// and referenced by index, so the record array has a fixed stride and the
+// whole file can be mapped and read in place.
+struct AnnotationFileHeaderV2 {
+    char signature[4];          // "HVA\0", as in version 1
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(AnnotationFileHeaderV2)
+    uint32_t recordSize;        // sizeof(AnnotationRecordV2)
+    uint64_t annotationCount;
+    uint64_t recordsOffset;
+    uint64_t stringCount;
+    uint64_t stringIndexOffset;
+    uint64_t stringDataOffset;
+    uint64_t stringDataSize;
+    uint32_t documentName;      // String index
+    uint32_t flags;             // ANNOTATION_FLAG_*
+    uint64_t journalGeneration; // Autosave snapshots: journal generation they include, else 0
+    uint64_t documentSize;      // Fingerprint of the annotated contents,
+    uint64_t documentHash;      // if ANNOTATION_FLAG_FINGERPRINT is set
+    uint64_t labelIndexOffset;  // LabelIndexHeaderV2, or 0 if there is none
+    uint64_t labelIndexSize;
+};
+
+// Header size of version 2 files written before the label index was added.
+// Fields past headerSize read as zero.
+const uint32_t ANNOTATION_HEADER_V2_MIN_SIZE = 96;
+
+// AnnotationFileHeaderV2::flags
+const uint32_t ANNOTATION_FLAG_FINGERPRINT = 1;
+
+// No string, for AnnotationRecordV2::aux
+const uint32_t NO_STRING = 0xFFFFFFFF;
+
+struct AnnotationRecordV2 {
+    int32_t startOffset;
+    int32_t endOffset;
+    int32_t colorIndex;
+    uint32_t label;             // String index
+    uint32_t format;            // String index
+    uint32_t aux;               // String index of record layout / expressions, or NO_STRING
+};
+
+struct StringEntryV2 {
+    uint32_t offset;            // From stringDataOffset
+    uint32_t length;
+};
+
+// Label index section, see LabelIndex.h:
+//
+//   LabelIndexHeaderV2
+//   uint32_t trigrams[trigramCount]        ascending
+//   uint64_t starts[trigramCount + 1]      8-byte aligned, into postings
+//   uint32_t postings[postingCount]        annotation indices, ascending per trigram
+struct LabelIndexHeaderV2 {
+    uint64_t annotationCount;
+    uint64_t trigramCount;
+    uint64_t postingCount;
+};
+
+static_assert(sizeof(AnnotationFileHeaderV2) == 112, "header layout is part of the file format");
+static_assert(sizeof(AnnotationRecordV2) == 24, "record layout is part of the file format");
+static_assert(sizeof(StringEntryV2) == 8, "string entry layout is part of the file format");
+static_assert(sizeof(LabelIndexHeaderV2) == 24, "label index layout is part of the file format");
+
+// Annotations read from an .hva file
+struct AnnotationFileContents {
+    int version = 0;
+    std::string documentName;
+    ContentFingerprint fingerprint;     // Unknown for files without one
+    std::vector<Annotation> annotations;
+    size_t skipped = 0;         // Annotations that do not fit the document
+    uint64_t journalGeneration = 0;
+    std::shared_ptr<LabelIndex> labelIndex; // Null if the file has none or some annotations were skipped
+};
+
+// Write annotations in the current format, with labelIndex if given; it must
+// be compact and describe annotations. Throws std::runtime_error.
+void WriteAnnotationFile(const std::string& path, const std::string& documentName, const ContentFingerprint& fingerprint,
+    const std::vector<Annotation>& annotations, uint64_t journalGeneration = 0, const LabelIndex* labelIndex = nullptr);
+
+// Map and read a version 1 or 2 file. Annotations that do not fit in a
+// document of documentSize bytes are skipped. The labels and formats read
+// from a version 2 file share one copy of its string table; see
+// AnnotationText. Throws std::runtime_error.
+AnnotationFileContents ReadAnnotationFile(const std::string& path, size_t documentSize);
+
+// Parse a file image that is already in memory
+AnnotationFileContents ParseAnnotationFile(const BYTE* data, size_t size, size_t documentSize);
+
+// Self-contained encoding of one annotation, in the version 1 record layout
+// followed by its auxiliary data. Used by the autosave journal.
+void AppendAnnotationBytes(std::string& out, const Annotation& anno);
+
+// Decode one annotation at data + position and advance position past it.
+// Throws std::runtime_error if the bytes run out or do not decode.
+Annotation ReadAnnotationBytes(const BYTE* data, size_t size, size_t& position);
+
+// Record layout, expressions and stale mark of an annotation as the short
+// text kept in the string table; empty if it has none
+std::string AnnotationAuxText(const Annotation& anno);
+
+// Set them on anno from that text. Throws std::runtime_error if it does not
+// decode.
+void ApplyAnnotationAuxText(Annotation& anno, std::string_view text);
+
+// False if anno's record layout does not cover exactly its extent
+bool RecordLayoutFits(const Annotation& anno);
@@ -1,4 +1,22 @@
+#define NOMINMAX
 #include <Windows.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "includes.h"
+#include "ByteRegex.h"
+#include "ByteSearch.h"
+#include "ChecksumFields.h"
+#include "EmbeddedFiles.h"
+#include "Hashing.h"
+#include "LabelIndex.h"
+#include "StringIndex.h"
+#include "ValueSearch.h"
+#include "ContentFingerprint.h"
 extern HINSTANCE g_hInstance;
 
 // Control IDs
@@ -290,3 +308,1330 @@ INT_PTR CALLBACK InputDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPAR
 
     return FALSE;
 }
+
+// Control IDs for the expression dialog
+#define IDC_EXPR_START  1011
+#define IDC_EXPR_LENGTH 1012
+#define IDC_EXPR_VALUE  1013
+
+INT_PTR CALLBACK ExpressionDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// Appends one control to an in-memory dialog template and returns the next free position
+static LPWORD AppendDialogItem(LPWORD lpw, short x, short y, short cx, short cy, WORD id, DWORD style, WORD classAtom, const char* text)
+{
+    lpw = (LPWORD)((((ULONG_PTR)lpw + 3) & ~3)); // Align DWORD
+    LPDLGITEMTEMPLATE lpdit = (LPDLGITEMTEMPLATE)lpw;
+    lpdit->x = x;
+    lpdit->y = y;
+    lpdit->cx = cx;
+    lpdit->cy = cy;
+    lpdit->id = id;
+    lpdit->style = style;
+
+    lpw = (LPWORD)(lpdit + 1);
+    *lpw++ = 0xFFFF;
+    *lpw++ = classAtom;
+
+    LPWSTR lpwsz = (LPWSTR)lpw;
+    int nchar = MultiByteToWideChar(CP_ACP, 0, text, -1, lpwsz, 100);
+    lpw += nchar;
+    *lpw++ = 0;     // No creation data
+    return lpw;
+}
+
+//-------------------------------------------------------------------
+// Expression Dialog - Edit the expressions of a computed annotation
+//-------------------------------------------------------------------
+// Returns false if the dialog was cancelled
+bool ShowExpressionDialog(HWND hwnd, char* start, char* length, char* value, int bufferSize)
+{
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 9;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 260;
+    lpdt->cy = 120;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Edit Expressions", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    const DWORD labelStyle = WS_CHILD | WS_VISIBLE | SS_LEFT;
+    const DWORD editStyle = WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | WS_TABSTOP;
+
+    lpw = AppendDialogItem(lpw, 10, 8, 240, 10, IDC_STATIC, labelStyle, 0x0082,
+        "Refer to other annotations as {label}, {label}.start, .end or .length");
+    lpw = AppendDialogItem(lpw, 10, 28, 40, 12, IDC_STATIC, labelStyle, 0x0082, "Start:");
+    lpw = AppendDialogItem(lpw, 50, 26, 200, 14, IDC_EXPR_START, editStyle, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 10, 46, 40, 12, IDC_STATIC, labelStyle, 0x0082, "Length:");
+    lpw = AppendDialogItem(lpw, 50, 44, 200, 14, IDC_EXPR_LENGTH, editStyle, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 10, 64, 40, 12, IDC_STATIC, labelStyle, 0x0082, "Value:");
+    lpw = AppendDialogItem(lpw, 50, 62, 200, 14, IDC_EXPR_VALUE, editStyle, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 75, 90, 50, 20, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "OK");
+    lpw = AppendDialogItem(lpw, 135, 90, 50, 20, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Cancel");
+
+    LPARAM dialogParams[4] = { (LPARAM)start, (LPARAM)length, (LPARAM)value, (LPARAM)bufferSize };
+    INT_PTR result = DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)ExpressionDialogProc, (LPARAM)dialogParams);
+
+    GlobalFree(lpdt);
+    return result == IDOK;
+}
+
+INT_PTR CALLBACK ExpressionDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static LPARAM* params = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        params = reinterpret_cast<LPARAM*>(lParam);
+        SetDlgItemText(hwndDlg, IDC_EXPR_START, reinterpret_cast<char*>(params[0]));
+        SetDlgItemText(hwndDlg, IDC_EXPR_LENGTH, reinterpret_cast<char*>(params[1]));
+        SetDlgItemText(hwndDlg, IDC_EXPR_VALUE, reinterpret_cast<char*>(params[2]));
+        SetFocus(GetDlgItem(hwndDlg, IDC_EXPR_START));
+        return FALSE;   // Focus was set explicitly
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDOK:
+        {
+            int bufferSize = static_cast<int>(params[3]);
+            GetDlgItemText(hwndDlg, IDC_EXPR_START, reinterpret_cast<char*>(params[0]), bufferSize);
+            GetDlgItemText(hwndDlg, IDC_EXPR_LENGTH, reinterpret_cast<char*>(params[1]), bufferSize);
+            GetDlgItemText(hwndDlg, IDC_EXPR_VALUE, reinterpret_cast<char*>(params[2]), bufferSize);
+            EndDialog(hwndDlg, IDOK);
+            return TRUE;
+        }
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the find dialog
+#define IDC_FIND_TEXT    1021
+#define IDC_FIND_PREFIX  1022
+#define IDC_FIND_RESULTS 1023
+#define IDC_FIND_COUNT   1024
+
+// Matches listed at once; the count line still reports all of them
+const size_t FIND_MAX_LISTED = 1000;
+
+void GoToAnnotation(HWND hwnd, DocumentWindowState& state, int index);
+INT_PTR CALLBACK FindAnnotationsDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// The document the find dialog searches and the window it navigates
+struct FindDialogContext {
+    HWND viewer;
+    DocumentWindowState* state;
+};
+
+//-------------------------------------------------------------------
+// Find Annotations Dialog - Search labels and jump to the matches
+//-------------------------------------------------------------------
+void ShowFindAnnotationsDialog(HWND hwnd, DocumentWindowState& state)
+{
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 7;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 300;
+    lpdt->cy = 210;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Find Annotations", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    lpw = AppendDialogItem(lpw, 10, 10, 30, 10, IDC_STATIC, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "Label:");
+    lpw = AppendDialogItem(lpw, 45, 8, 245, 14, IDC_FIND_TEXT,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | WS_TABSTOP, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 45, 26, 245, 12, IDC_FIND_PREFIX,
+        WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX | WS_TABSTOP, 0x0080, "Match the start of the label only");
+    lpw = AppendDialogItem(lpw, 10, 42, 280, 135, IDC_FIND_RESULTS,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT | WS_TABSTOP, 0x0083, "");
+    lpw = AppendDialogItem(lpw, 10, 186, 160, 10, IDC_FIND_COUNT, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 180, 184, 50, 16, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "Go To");
+    lpw = AppendDialogItem(lpw, 240, 184, 50, 16, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Close");
+
+    FindDialogContext context = { hwnd, &state };
+    DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)FindAnnotationsDialogProc, (LPARAM)&context);
+
+    GlobalFree(lpdt);
+}
+
+// Run the query in the edit box and list the matches in offset order
+static void RefreshFindResults(HWND hwndDlg, FindDialogContext& context)
+{
+    char text[256] = {};
+    GetDlgItemText(hwndDlg, IDC_FIND_TEXT, text, sizeof(text));
+    LabelMatch match = IsDlgButtonChecked(hwndDlg, IDC_FIND_PREFIX) == BST_CHECKED
+        ? LabelMatch::Prefix : LabelMatch::Substring;
+
+    DocumentWindowState& state = *context.state;
+    std::vector<int> found = LabelIndexFor(state).find(state.annotations, text, match);
+
+    HWND hList = GetDlgItem(hwndDlg, IDC_FIND_RESULTS);
+    SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+    SendMessage(hList, LB_RESETCONTENT, 0, 0);
+
+    size_t listed = std::min(found.size(), FIND_MAX_LISTED);
+    for (size_t i = 0; i < listed; ++i) {
+        const Annotation& anno = state.annotations[found[i]];
+        char line[300];
+        sprintf_s(line, sizeof(line), "%08X  %.*s", anno.startOffset, static_cast<int>(std::min<size_t>(anno.label.size(), 280)), anno.label.data());
+        LRESULT item = SendMessage(hList, LB_ADDSTRING, 0, (LPARAM)line);
+        SendMessage(hList, LB_SETITEMDATA, item, (LPARAM)found[i]);
+    }
+
+    SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(hList, NULL, TRUE);
+
+    std::string count;
+    if (text[0] != '\0') {
+        count = std::to_string(found.size()) + (found.size() == 1 ? " match" : " matches");
+        if (listed < found.size()) {
+            count += ", first " + std::to_string(listed) + " shown";
+        }
+    }
+    SetDlgItemText(hwndDlg, IDC_FIND_COUNT, count.c_str());
+}
+
+// Navigate to the selected match, or the first one if none is selected.
+// Returns false if the list is empty.
+static bool GoToSelectedMatch(HWND hwndDlg, FindDialogContext& context)
+{
+    HWND hList = GetDlgItem(hwndDlg, IDC_FIND_RESULTS);
+    LRESULT item = SendMessage(hList, LB_GETCURSEL, 0, 0);
+    if (item == LB_ERR) {
+        if (SendMessage(hList, LB_GETCOUNT, 0, 0) <= 0) {
+            return false;
+        }
+        item = 0;
+    }
+
+    int index = static_cast<int>(SendMessage(hList, LB_GETITEMDATA, item, 0));
+    GoToAnnotation(context.viewer, *context.state, index);
+    return true;
+}
+
+INT_PTR CALLBACK FindAnnotationsDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static FindDialogContext* context = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        context = reinterpret_cast<FindDialogContext*>(lParam);
+        SetFocus(GetDlgItem(hwndDlg, IDC_FIND_TEXT));
+        return FALSE;   // Focus was set explicitly
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDC_FIND_TEXT:
+            if (HIWORD(wParam) == EN_CHANGE) {
+                RefreshFindResults(hwndDlg, *context);
+            }
+            return TRUE;
+
+        case IDC_FIND_PREFIX:
+            if (HIWORD(wParam) == BN_CLICKED) {
+                RefreshFindResults(hwndDlg, *context);
+            }
+            return TRUE;
+
+        case IDC_FIND_RESULTS:
+            // Browsing the list follows along in the document
+            if (HIWORD(wParam) == LBN_SELCHANGE) {
+                GoToSelectedMatch(hwndDlg, *context);
+            }
+            else if (HIWORD(wParam) == LBN_DBLCLK && GoToSelectedMatch(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDOK:
+            if (GoToSelectedMatch(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the find bytes dialog
+#define IDC_SEARCH_TEXT    1031
+#define IDC_SEARCH_AS_TEXT 1032
+#define IDC_SEARCH_RESULTS 1033
+#define IDC_SEARCH_STATUS  1034
+#define IDC_SEARCH_GOTO    1035
+#define IDC_SEARCH_HEX     1036
+#define IDC_SEARCH_REGEX   1037
+#define IDC_SEARCH_ANNOTATE 1038
+#define IDC_SEARCH_VALUE   1039
+
+// Posted by a running search when it has published matches or finished
+#define WM_SEARCH_PROGRESS (WM_APP + 1)
+
+// Bytes of each match shown after its offset
+const size_t SEARCH_PREVIEW_BYTES = 16;
+
+void GoToByteRange(HWND hwnd, DocumentWindowState& state, int first, int last);
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+void tagAppendedAnnotations(DocumentWindowState& state, size_t firstIndex);
+INT_PTR CALLBACK FindBytesDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// The document searched, the window navigated and the search in progress.
+// Destroying the context cancels the search.
+struct SearchDialogContext {
+    HWND viewer;
+    DocumentWindowState* state;
+    std::unique_ptr<DocumentSearch> search;
+    std::shared_ptr<const ValuePattern> values;     // Set for value searches
+    bool wentToFirst = false;
+};
+
+//-------------------------------------------------------------------
+// Find Bytes Dialog - Search the document for a byte string
+//-------------------------------------------------------------------
+// Hex input may contain wildcards, masks and gaps; see WildcardPattern. Regex
+// and value input are described with RegexPattern and ValuePattern.
+//
+// The results list has no data of its own: it is told how many matches there
+// are and draws each visible one from the search, so listing a million
+// matches costs nothing more than listing ten.
+void ShowFindBytesDialog(HWND hwnd, DocumentWindowState& state)
+{
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 12;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 300;
+    lpdt->cy = 210;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Find Bytes", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    lpw = AppendDialogItem(lpw, 10, 10, 30, 10, IDC_STATIC, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "Find:");
+    lpw = AppendDialogItem(lpw, 45, 8, 185, 14, IDC_SEARCH_TEXT,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | WS_TABSTOP, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 240, 7, 50, 16, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "Find");
+    lpw = AppendDialogItem(lpw, 45, 26, 40, 12, IDC_SEARCH_HEX,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON | WS_GROUP | WS_TABSTOP, 0x0080, "Hex");
+    lpw = AppendDialogItem(lpw, 90, 26, 40, 12, IDC_SEARCH_AS_TEXT,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON, 0x0080, "Text");
+    lpw = AppendDialogItem(lpw, 135, 26, 50, 12, IDC_SEARCH_REGEX,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON, 0x0080, "Regex");
+    lpw = AppendDialogItem(lpw, 190, 26, 50, 12, IDC_SEARCH_VALUE,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON, 0x0080, "Value");
+    lpw = AppendDialogItem(lpw, 10, 42, 280, 135, IDC_SEARCH_RESULTS,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT |
+        LBS_NODATA | LBS_OWNERDRAWFIXED | WS_TABSTOP | WS_GROUP, 0x0083, "");
+    lpw = AppendDialogItem(lpw, 10, 186, 110, 10, IDC_SEARCH_STATUS, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 125, 184, 55, 16, IDC_SEARCH_ANNOTATE, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Annotate All");
+    lpw = AppendDialogItem(lpw, 185, 184, 50, 16, IDC_SEARCH_GOTO, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Go To");
+    lpw = AppendDialogItem(lpw, 240, 184, 50, 16, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Close");
+
+    SearchDialogContext context = { hwnd, &state };
+    DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)FindBytesDialogProc, (LPARAM)&context);
+
+    GlobalFree(lpdt);
+}
+
+static void GoToHit(SearchDialogContext& context, const SearchHit& hit)
+{
+    size_t last = hit.offset + std::max<size_t>(hit.length, 1) - 1;
+    if (last <= INT_MAX) {
+        GoToByteRange(context.viewer, *context.state, static_cast<int>(hit.offset), static_cast<int>(last));
+    }
+}
+
+// Grow the list to the matches published so far, go to the first one, and
+// report how far the search has got
+static void ShowSearchProgress(HWND hwndDlg, SearchDialogContext& context)
+{
+    DocumentSearch& search = *context.search;
+    search.acknowledge();
+    bool finished = search.finished();  // Before the count, so no match is missed
+    size_t count = search.matchCount();
+
+    // Setting the count can drop the selection and the scroll position
+    HWND hList = GetDlgItem(hwndDlg, IDC_SEARCH_RESULTS);
+    if (static_cast<size_t>(SendMessage(hList, LB_GETCOUNT, 0, 0)) != count) {
+        LRESULT selected = SendMessage(hList, LB_GETCURSEL, 0, 0);
+        LRESULT top = SendMessage(hList, LB_GETTOPINDEX, 0, 0);
+        SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+        SendMessage(hList, LB_SETCOUNT, count, 0);
+        SendMessage(hList, LB_SETTOPINDEX, top, 0);
+        if (selected != LB_ERR) {
+            SendMessage(hList, LB_SETCURSEL, selected, 0);
+        }
+        SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(hList, NULL, TRUE);
+    }
+
+    if (!context.wentToFirst && count > 0) {
+        context.wentToFirst = true;
+        SendMessage(hList, LB_SETCURSEL, 0, 0);
+        GoToHit(context, search.matches(0, 1)[0]);
+    }
+
+    std::string status = std::to_string(count) + (count == 1 ? " match" : " matches");
+    if (!finished) {
+        size_t percent = context.state->fileData.empty() ? 100
+            : search.searchedBytes() * 100 / context.state->fileData.size();
+        status = "Searching " + std::to_string(percent) + "%, " + status;
+    }
+    else if (search.truncated()) {
+        status = "Stopped after " + status;
+    }
+    SetDlgItemText(hwndDlg, IDC_SEARCH_STATUS, status.c_str());
+}
+
+// One line of the results list: the offset and the first bytes of the match,
+// and for a value search the value as the data interpreter shows it
+static void DrawSearchHit(const SearchDialogContext& context, const DRAWITEMSTRUCT& item)
+{
+    bool selected = (item.itemState & ODS_SELECTED) != 0;
+    FillRect(item.hDC, &item.rcItem, GetSysColorBrush(selected ? COLOR_HIGHLIGHT : COLOR_WINDOW));
+    if (item.itemID == (UINT)-1 || !context.search) {
+        return;
+    }
+
+    std::vector<SearchHit> hits = context.search->matches(item.itemID, 1);
+    if (!hits.empty()) {
+        const SearchHit& hit = hits[0];
+        const std::vector<BYTE>& data = context.state->fileData;
+
+        char line[160];
+        int used = sprintf_s(line, sizeof(line), "%08zX ", hit.offset);
+        size_t shown = std::min({ hit.length, SEARCH_PREVIEW_BYTES, data.size() - hit.offset });
+        for (size_t i = 0; i < shown; ++i) {
+            used += sprintf_s(line + used, sizeof(line) - used, " %02X", data[hit.offset + i]);
+        }
+        if (context.values) {
+            DataInterpretation interpretation;
+            InterpretData(data.data() + hit.offset, data.size() - hit.offset, interpretation);
+            used += sprintf_s(line + used, sizeof(line) - used, "   %s",
+                interpretation.text[context.values->type()][context.values->byteOrder()]);
+        }
+
+        SetBkMode(item.hDC, TRANSPARENT);
+        SetTextColor(item.hDC, GetSysColor(selected ? COLOR_HIGHLIGHTTEXT : COLOR_WINDOWTEXT));
+        TextOut(item.hDC, item.rcItem.left + 2, item.rcItem.top, line, used);
+    }
+    if (item.itemState & ODS_FOCUS) {
+        DrawFocusRect(item.hDC, &item.rcItem);
+    }
+}
+
+// Start searching for the bytes in the edit box, replacing any search still
+// running
+static void StartByteSearch(HWND hwndDlg, SearchDialogContext& context)
+{
+    char text[512] = {};
+    GetDlgItemText(hwndDlg, IDC_SEARCH_TEXT, text, sizeof(text));
+
+    std::shared_ptr<const SearchPattern> pattern;
+    std::shared_ptr<const ValuePattern> values;
+    try {
+        if (IsDlgButtonChecked(hwndDlg, IDC_SEARCH_AS_TEXT) == BST_CHECKED) {
+            if (text[0] == '\0') {
+                throw std::runtime_error("Enter the text to find.");
+            }
+            pattern = std::make_shared<BytePattern>(std::vector<uint8_t>(text, text + strlen(text)));
+        }
+        else if (IsDlgButtonChecked(hwndDlg, IDC_SEARCH_REGEX) == BST_CHECKED) {
+            pattern = std::make_shared<RegexPattern>(text);
+        }
+        else if (IsDlgButtonChecked(hwndDlg, IDC_SEARCH_VALUE) == BST_CHECKED) {
+            values = std::make_shared<ValuePattern>(text);
+            pattern = values;
+        }
+        else {
+            pattern = ParseSearchPattern(text);
+        }
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwndDlg, e.what(), "Find Bytes", MB_OK | MB_ICONWARNING);
+        return;
+    }
+
+    context.search.reset();
+    context.values = values;
+    context.wentToFirst = false;
+    SendDlgItemMessage(hwndDlg, IDC_SEARCH_RESULTS, LB_RESETCONTENT, 0, 0);
+
+    const std::vector<BYTE>& data = context.state->fileData;
+    context.state->searchCursor = std::make_shared<SearchCursor>(pattern, data.data(), data.size());
+    context.search = std::make_unique<DocumentSearch>(pattern, data.data(), data.size());
+    context.search->start([hwndDlg] { PostMessage(hwndDlg, WM_SEARCH_PROGRESS, 0, 0); });
+    ShowSearchProgress(hwndDlg, context);
+}
+
+// Navigate to the selected match, or the first one if none is selected.
+// Returns false if the list is empty.
+static bool GoToSelectedHit(HWND hwndDlg, SearchDialogContext& context)
+{
+    HWND hList = GetDlgItem(hwndDlg, IDC_SEARCH_RESULTS);
+    LRESULT item = SendMessage(hList, LB_GETCURSEL, 0, 0);
+    if (item == LB_ERR) {
+        if (SendMessage(hList, LB_GETCOUNT, 0, 0) <= 0) {
+            return false;
+        }
+        item = 0;
+    }
+
+    // Items are match indexes
+    std::vector<SearchHit> hits = context.search->matches(static_cast<size_t>(item), 1);
+    if (hits.empty()) {
+        return false;
+    }
+    GoToHit(context, hits[0]);
+    return true;
+}
+
+// Annotate every match of a finished search with one label. Matches that
+// overlap an earlier one are left out.
+static void AnnotateAllHits(HWND hwndDlg, SearchDialogContext& context)
+{
+    if (!context.search || !context.search->finished() || context.search->matchCount() == 0) {
+        MessageBox(hwndDlg, context.search && !context.search->finished()
+            ? "Wait for the search to finish." : "There are no matches to annotate.",
+            "Annotate All", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    char labelBuffer[256] = {};
+    char formatBuffer[32] = "hex";
+    ShowAnnotationInputDialog(hwndDlg, labelBuffer, sizeof(labelBuffer), formatBuffer, sizeof(formatBuffer));
+    if (strlen(labelBuffer) == 0) {
+        return;
+    }
+
+    DocumentWindowState& state = *context.state;
+    std::vector<SearchHit> hits = context.search->matches(0, context.search->matchCount());
+    const int colorIndex = static_cast<int>(state.annotations.size() % std::size(annotationColors));
+
+    std::vector<Annotation> found;
+    found.reserve(hits.size());
+    size_t nextFree = 0;
+    for (const SearchHit& hit : hits) {
+        size_t last = hit.offset + std::max<size_t>(hit.length, 1) - 1;
+        if (hit.offset < nextFree || last > INT_MAX) {
+            continue;
+        }
+        Annotation annotation;
+        annotation.startOffset = static_cast<int>(hit.offset);
+        annotation.endOffset = static_cast<int>(last);
+        annotation.label = labelBuffer;
+        annotation.displayFormat = formatBuffer;
+        annotation.colorIndex = colorIndex;
+        found.push_back(std::move(annotation));
+        nextFree = last + 1;
+    }
+
+    size_t added = found.size();
+    size_t firstIndex = state.annotations.size();
+    AppendAnnotations(state, std::move(found));
+    tagAppendedAnnotations(state, firstIndex);
+    InvalidateRect(context.viewer, NULL, TRUE);
+
+    std::string message = "Added " + std::to_string(added) + (added == 1 ? " annotation." : " annotations.");
+    MessageBox(hwndDlg, message.c_str(), "Annotate All", MB_OK | MB_ICONINFORMATION);
+}
+
+INT_PTR CALLBACK FindBytesDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static SearchDialogContext* context = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        context = reinterpret_cast<SearchDialogContext*>(lParam);
+        CheckDlgButton(hwndDlg, IDC_SEARCH_HEX, BST_CHECKED);
+        {
+            // Owner-drawn items are as tall as a line of the list's font
+            HWND hList = GetDlgItem(hwndDlg, IDC_SEARCH_RESULTS);
+            HDC hdc = GetDC(hList);
+            HGDIOBJ oldFont = SelectObject(hdc, (HFONT)SendMessage(hList, WM_GETFONT, 0, 0));
+            TEXTMETRIC metrics;
+            GetTextMetrics(hdc, &metrics);
+            SelectObject(hdc, oldFont);
+            ReleaseDC(hList, hdc);
+            SendMessage(hList, LB_SETITEMHEIGHT, 0, metrics.tmHeight);
+        }
+        SetFocus(GetDlgItem(hwndDlg, IDC_SEARCH_TEXT));
+        return FALSE;   // Focus was set explicitly
+
+    case WM_SEARCH_PROGRESS:
+        // May arrive from a search that has since been replaced
+        if (context->search) {
+            ShowSearchProgress(hwndDlg, *context);
+        }
+        return TRUE;
+
+    case WM_DRAWITEM:
+        if (wParam == IDC_SEARCH_RESULTS) {
+            DrawSearchHit(*context, *reinterpret_cast<const DRAWITEMSTRUCT*>(lParam));
+            return TRUE;
+        }
+        break;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDOK:
+            StartByteSearch(hwndDlg, *context);
+            return TRUE;
+
+        case IDC_SEARCH_RESULTS:
+            // Browsing the list follows along in the document
+            if (HIWORD(wParam) == LBN_SELCHANGE) {
+                GoToSelectedHit(hwndDlg, *context);
+            }
+            else if (HIWORD(wParam) == LBN_DBLCLK && GoToSelectedHit(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDC_SEARCH_ANNOTATE:
+            AnnotateAllHits(hwndDlg, *context);
+            return TRUE;
+
+        case IDC_SEARCH_GOTO:
+            if (GoToSelectedHit(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the strings dialog
+#define IDC_STRINGS_FILTER     1041
+#define IDC_STRINGS_MIN_LENGTH 1042
+#define IDC_STRINGS_LIST       1043
+#define IDC_STRINGS_STATUS     1044
+#define IDC_STRINGS_ANNOTATE   1045
+
+// Characters of each string shown in the list and used as its label
+const size_t STRINGS_SHOWN_CHARS = 200;
+const size_t STRINGS_LABEL_CHARS = 48;
+
+INT_PTR CALLBACK StringsDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// The document, the window navigated, its strings and those passing the
+// filter, as indices into them
+struct StringsDialogContext {
+    HWND viewer;
+    DocumentWindowState* state;
+    std::shared_ptr<StringIndex> strings;
+    std::vector<uint32_t> listed;
+};
+
+//-------------------------------------------------------------------
+// Strings Dialog - List the strings of the document and jump to them
+//-------------------------------------------------------------------
+// The strings are found once per document contents and kept in the catalog;
+// see DocumentStrings. Like the find bytes results, the list draws each
+// visible string from the index, and the filter is applied as it is typed.
+void ShowStringsDialog(HWND hwnd, DocumentWindowState& state)
+{
+    StringsDialogContext context = { hwnd, &state };
+    {
+        HCURSOR oldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+        context.strings = DocumentStrings(state);
+        SetCursor(oldCursor);
+    }
+
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 10;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 300;
+    lpdt->cy = 210;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Strings", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    lpw = AppendDialogItem(lpw, 10, 10, 30, 10, IDC_STATIC, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "Filter:");
+    lpw = AppendDialogItem(lpw, 45, 8, 150, 14, IDC_STRINGS_FILTER,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | WS_TABSTOP, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 205, 10, 45, 10, IDC_STATIC, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "Min length:");
+    lpw = AppendDialogItem(lpw, 250, 8, 40, 14, IDC_STRINGS_MIN_LENGTH,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_NUMBER | WS_TABSTOP, 0x0081, std::to_string(STRINGS_MIN_LENGTH).c_str());
+    lpw = AppendDialogItem(lpw, 10, 28, 280, 149, IDC_STRINGS_LIST,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT |
+        LBS_NODATA | LBS_OWNERDRAWFIXED | WS_TABSTOP, 0x0083, "");
+    lpw = AppendDialogItem(lpw, 10, 186, 110, 10, IDC_STRINGS_STATUS, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 125, 184, 55, 16, IDC_STRINGS_ANNOTATE, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Annotate All");
+    lpw = AppendDialogItem(lpw, 185, 184, 50, 16, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "Go To");
+    lpw = AppendDialogItem(lpw, 240, 184, 50, 16, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Close");
+
+    DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)StringsDialogProc, (LPARAM)&context);
+
+    GlobalFree(lpdt);
+}
+
+// List the strings passing the filter and the minimum length
+static void RefreshStringsList(HWND hwndDlg, StringsDialogContext& context)
+{
+    char text[256] = {};
+    GetDlgItemText(hwndDlg, IDC_STRINGS_FILTER, text, sizeof(text));
+    BOOL valid = FALSE;
+    UINT minLength = GetDlgItemInt(hwndDlg, IDC_STRINGS_MIN_LENGTH, &valid, FALSE);
+    if (!valid || minLength < STRINGS_MIN_LENGTH) {
+        minLength = STRINGS_MIN_LENGTH;
+    }
+
+    context.listed = context.strings->filter(context.state->fileData.data(), text, minLength);
+
+    HWND hList = GetDlgItem(hwndDlg, IDC_STRINGS_LIST);
+    SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+    SendMessage(hList, LB_SETCOUNT, context.listed.size(), 0);
+    SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(hList, NULL, TRUE);
+
+    size_t count = context.listed.size();
+    std::string status = std::to_string(count);
+    if (count != context.strings->count()) {
+        status += " of " + std::to_string(context.strings->count());
+    }
+    status += context.strings->count() == 1 ? " string" : " strings";
+    SetDlgItemText(hwndDlg, IDC_STRINGS_STATUS, status.c_str());
+}
+
+// One line of the list: the offset, the encoding and the start of the text
+static void DrawStringItem(const StringsDialogContext& context, const DRAWITEMSTRUCT& item)
+{
+    bool selected = (item.itemState & ODS_SELECTED) != 0;
+    FillRect(item.hDC, &item.rcItem, GetSysColorBrush(selected ? COLOR_HIGHLIGHT : COLOR_WINDOW));
+    if (item.itemID == (UINT)-1 || item.itemID >= context.listed.size()) {
+        return;
+    }
+
+    static const char* const encodingNames[] = { "ASCII", "UTF-8", "UTF-16LE", "UTF-16BE" };
+    StringRun run = context.strings->at(context.listed[item.itemID]);
+    char prefix[40];
+    sprintf_s(prefix, sizeof(prefix), "%08llX  %-8s  ", static_cast<unsigned long long>(run.offset), encodingNames[run.encoding]);
+    std::string line = std::string(prefix) + StringText(context.state->fileData.data(), run, STRINGS_SHOWN_CHARS);
+
+    int wideLength = MultiByteToWideChar(CP_UTF8, 0, line.data(), static_cast<int>(line.size()), NULL, 0);
+    std::wstring wide(wideLength, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, line.data(), static_cast<int>(line.size()), wide.data(), wideLength);
+
+    SetBkMode(item.hDC, TRANSPARENT);
+    SetTextColor(item.hDC, GetSysColor(selected ? COLOR_HIGHLIGHTTEXT : COLOR_WINDOWTEXT));
+    TextOutW(item.hDC, item.rcItem.left + 2, item.rcItem.top, wide.data(), wideLength);
+    if (item.itemState & ODS_FOCUS) {
+        DrawFocusRect(item.hDC, &item.rcItem);
+    }
+}
+
+// Navigate to the selected string, or the first one if none is selected.
+// Returns false if the list is empty.
+static bool GoToSelectedString(HWND hwndDlg, StringsDialogContext& context)
+{
+    LRESULT item = SendDlgItemMessage(hwndDlg, IDC_STRINGS_LIST, LB_GETCURSEL, 0, 0);
+    if (item == LB_ERR) {
+        if (context.listed.empty()) {
+            return false;
+        }
+        item = 0;
+    }
+
+    StringRun run = context.strings->at(context.listed[item]);
+    if (run.end() - 1 <= INT_MAX) {
+        GoToByteRange(context.viewer, *context.state, static_cast<int>(run.offset), static_cast<int>(run.end() - 1));
+    }
+    return true;
+}
+
+// Annotate every listed string with its own text. ASCII and UTF-8 strings
+// are shown as "ascii" and UTF-16LE ones as "unicode"; UTF-16BE has no
+// display format of its own and is left as hex.
+static void AnnotateAllStrings(HWND hwndDlg, StringsDialogContext& context)
+{
+    size_t count = context.listed.size();
+    if (count == 0) {
+        MessageBox(hwndDlg, "There are no strings to annotate.", "Annotate All", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+    std::string question = "Annotate " + std::to_string(count) + (count == 1 ? " string?" : " strings?");
+    if (MessageBox(hwndDlg, question.c_str(), "Annotate All", MB_YESNO | MB_ICONQUESTION) != IDYES) {
+        return;
+    }
+
+    DocumentWindowState& state = *context.state;
+    const uint8_t* data = state.fileData.data();
+    const int colorIndex = static_cast<int>(state.annotations.size() % std::size(annotationColors));
+
+    std::vector<Annotation> found;
+    found.reserve(count);
+    uint64_t nextFree = 0;
+    for (uint32_t index : context.listed) {
+        StringRun run = context.strings->at(index);
+        if (run.offset < nextFree || run.end() - 1 > INT_MAX) {
+            continue;
+        }
+
+        // Labels are in the ANSI code page, like typed ones
+        std::string text = StringText(data, run, STRINGS_LABEL_CHARS);
+        if (run.encoding == SE_UTF8) {
+            int wideLength = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), NULL, 0);
+            std::wstring wide(wideLength, L'\0');
+            MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), wideLength);
+            int length = WideCharToMultiByte(CP_ACP, 0, wide.data(), wideLength, NULL, 0, NULL, NULL);
+            text.assign(length, '\0');
+            WideCharToMultiByte(CP_ACP, 0, wide.data(), wideLength, text.data(), length, NULL, NULL);
+        }
+        if (StringCharacters(data, run) > STRINGS_LABEL_CHARS) {
+            text += "...";
+        }
+
+        Annotation annotation;
+        annotation.startOffset = static_cast<int>(run.offset);
+        annotation.endOffset = static_cast<int>(run.end() - 1);
+        annotation.label = std::move(text);
+        annotation.displayFormat = run.encoding == SE_UTF16LE ? "unicode" : run.encoding == SE_UTF16BE ? "hex" : "ascii";
+        annotation.colorIndex = colorIndex;
+        found.push_back(std::move(annotation));
+        nextFree = run.end();
+    }
+
+    size_t added = found.size();
+    size_t firstIndex = state.annotations.size();
+    AppendAnnotations(state, std::move(found));
+    tagAppendedAnnotations(state, firstIndex);
+    InvalidateRect(context.viewer, NULL, TRUE);
+
+    std::string message = "Added " + std::to_string(added) + (added == 1 ? " annotation." : " annotations.");
+    MessageBox(hwndDlg, message.c_str(), "Annotate All", MB_OK | MB_ICONINFORMATION);
+}
+
+INT_PTR CALLBACK StringsDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static StringsDialogContext* context = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        context = reinterpret_cast<StringsDialogContext*>(lParam);
+        {
+            // Owner-drawn items are as tall as a line of the list's font
+            HWND hList = GetDlgItem(hwndDlg, IDC_STRINGS_LIST);
+            HDC hdc = GetDC(hList);
+            HGDIOBJ oldFont = SelectObject(hdc, (HFONT)SendMessage(hList, WM_GETFONT, 0, 0));
+            TEXTMETRIC metrics;
+            GetTextMetrics(hdc, &metrics);
+            SelectObject(hdc, oldFont);
+            ReleaseDC(hList, hdc);
+            SendMessage(hList, LB_SETITEMHEIGHT, 0, metrics.tmHeight);
+        }
+        RefreshStringsList(hwndDlg, *context);
+        SetFocus(GetDlgItem(hwndDlg, IDC_STRINGS_FILTER));
+        return FALSE;   // Focus was set explicitly
+
+    case WM_DRAWITEM:
+        if (wParam == IDC_STRINGS_LIST) {
+            DrawStringItem(*context, *reinterpret_cast<const DRAWITEMSTRUCT*>(lParam));
+            return TRUE;
+        }
+        break;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDC_STRINGS_FILTER:
+        case IDC_STRINGS_MIN_LENGTH:
+            if (HIWORD(wParam) == EN_CHANGE) {
+                RefreshStringsList(hwndDlg, *context);
+            }
+            return TRUE;
+
+        case IDC_STRINGS_LIST:
+            // Browsing the list follows along in the document
+            if (HIWORD(wParam) == LBN_SELCHANGE) {
+                GoToSelectedString(hwndDlg, *context);
+            }
+            else if (HIWORD(wParam) == LBN_DBLCLK && GoToSelectedString(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDC_STRINGS_ANNOTATE:
+            AnnotateAllStrings(hwndDlg, *context);
+            return TRUE;
+
+        case IDOK:
+            if (GoToSelectedString(hwndDlg, *context)) {
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the hash dialog
+#define IDC_HASH_RANGE   1051
+#define IDC_HASH_RESULTS 1052
+#define IDC_HASH_STATUS  1053
+
+// Posted by a running hash job as it makes progress and when it finishes
+#define WM_HASH_PROGRESS (WM_APP + 2)
+
+INT_PTR CALLBACK HashDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// The range hashed and the job hashing it. Destroying the context cancels
+// the job.
+struct HashDialogContext {
+    size_t offset;
+    size_t length;
+    std::unique_ptr<HashJob> job;
+    std::chrono::steady_clock::time_point started;
+};
+
+//-------------------------------------------------------------------
+// Hash Dialog - Checksums and hashes of the selection
+//-------------------------------------------------------------------
+// Every algorithm of Hashing.h over the selection, or the whole document
+// when nothing is selected. The job runs on the worker pool so a large
+// range can be watched, or the dialog closed, while it is hashed.
+void ShowHashDialog(HWND hwnd, DocumentWindowState& state)
+{
+    HashDialogContext context = { 0, state.fileData.size() };
+    if (state.selectionStart >= 0 && state.selectionEnd >= 0) {
+        context.offset = std::min(state.selectionStart, state.selectionEnd);
+        context.length = std::abs(state.selectionEnd - state.selectionStart) + 1;
+    }
+
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 4;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 300;
+    lpdt->cy = 150;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Hash Selection", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    lpw = AppendDialogItem(lpw, 10, 10, 280, 10, IDC_HASH_RANGE, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 10, 24, 280, 92, IDC_HASH_RESULTS,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | ES_MULTILINE | ES_READONLY | WS_TABSTOP, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 10, 126, 225, 10, IDC_HASH_STATUS, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 240, 124, 50, 16, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "Close");
+
+    context.job = std::make_unique<HashJob>(state.fileData.data() + context.offset, context.length);
+    DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)HashDialogProc, (LPARAM)&context);
+
+    GlobalFree(lpdt);
+}
+
+// Report how far the job has got, and the digests once it has finished
+static void ShowHashProgress(HWND hwndDlg, HashDialogContext& context)
+{
+    HashJob& job = *context.job;
+    job.acknowledge();
+
+    char status[160];
+    if (!job.finished()) {
+        const uint64_t total = static_cast<uint64_t>(context.length) * HASH_ALGORITHM_COUNT;
+        sprintf_s(status, sizeof(status), "Hashing %llu%%...",
+            static_cast<unsigned long long>(total == 0 ? 100 : job.hashedBytes() * 100 / total));
+        SetDlgItemText(hwndDlg, IDC_HASH_STATUS, status);
+        return;
+    }
+
+    std::string results;
+    for (int algorithm = 0; algorithm < HASH_ALGORITHM_COUNT; ++algorithm) {
+        results += HashName(static_cast<HashAlgorithm>(algorithm));
+        results += "\t" + job.digestText(static_cast<HashAlgorithm>(algorithm)) + "\r\n";
+    }
+    SetDlgItemText(hwndDlg, IDC_HASH_RESULTS, results.c_str());
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - context.started).count();
+    sprintf_s(status, sizeof(status), "Hashed in %.2f s. Accelerated: %s", seconds, HashAccelerations().c_str());
+    SetDlgItemText(hwndDlg, IDC_HASH_STATUS, status);
+}
+
+INT_PTR CALLBACK HashDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static HashDialogContext* context = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        context = reinterpret_cast<HashDialogContext*>(lParam);
+        {
+            char range[128];
+            if (context->length == 0) {
+                sprintf_s(range, sizeof(range), "The document is empty.");
+            }
+            else {
+                sprintf_s(range, sizeof(range), "Offsets %08zX to %08zX, %zu bytes",
+                    context->offset, context->offset + context->length - 1, context->length);
+            }
+            SetDlgItemText(hwndDlg, IDC_HASH_RANGE, range);
+        }
+        context->started = std::chrono::steady_clock::now();
+        context->job->start([hwndDlg] { PostMessage(hwndDlg, WM_HASH_PROGRESS, 0, 0); });
+        ShowHashProgress(hwndDlg, *context);
+        return TRUE;
+
+    case WM_HASH_PROGRESS:
+        ShowHashProgress(hwndDlg, *context);
+        return TRUE;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDOK:
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the checksum dialog
+#define IDC_CHECKSUM_ALGORITHM  1061
+#define IDC_CHECKSUM_COVERED    1062
+#define IDC_CHECKSUM_LITTLE     1063
+#define IDC_CHECKSUM_BIG        1064
+
+INT_PTR CALLBACK ChecksumDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+//-------------------------------------------------------------------
+// Checksum Dialog - Declare what an annotation is a checksum of
+//-------------------------------------------------------------------
+// algorithm and covered are both bufferSize bytes. An empty algorithm means
+// the annotation is no checksum. Returns false if the dialog was cancelled.
+bool ShowChecksumDialog(HWND hwnd, char* algorithm, char* covered, bool& bigEndian, int bufferSize)
+{
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 9;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 220;
+    lpdt->cy = 110;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Checksum", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    const DWORD labelStyle = WS_CHILD | WS_VISIBLE | SS_LEFT;
+
+    lpw = AppendDialogItem(lpw, 10, 10, 50, 12, IDC_STATIC, labelStyle, 0x0082, "Algorithm:");
+    lpw = AppendDialogItem(lpw, 65, 8, 145, 120, IDC_CHECKSUM_ALGORITHM,
+        WS_CHILD | WS_VISIBLE | CBS_DROPDOWNLIST | WS_VSCROLL | WS_TABSTOP, 0x0085, "");
+    lpw = AppendDialogItem(lpw, 10, 30, 50, 12, IDC_STATIC, labelStyle, 0x0082, "Covers label:");
+    lpw = AppendDialogItem(lpw, 65, 28, 145, 14, IDC_CHECKSUM_COVERED,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | ES_AUTOHSCROLL | WS_TABSTOP, 0x0081, "");
+    lpw = AppendDialogItem(lpw, 10, 50, 50, 12, IDC_STATIC, labelStyle, 0x0082, "Integers:");
+    lpw = AppendDialogItem(lpw, 65, 48, 70, 12, IDC_CHECKSUM_LITTLE,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON | WS_GROUP | WS_TABSTOP, 0x0080, "Little-endian");
+    lpw = AppendDialogItem(lpw, 140, 48, 70, 12, IDC_CHECKSUM_BIG,
+        WS_CHILD | WS_VISIBLE | BS_AUTORADIOBUTTON, 0x0080, "Big-endian");
+    lpw = AppendDialogItem(lpw, 55, 80, 50, 20, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP | WS_GROUP, 0x0080, "OK");
+    lpw = AppendDialogItem(lpw, 115, 80, 50, 20, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Cancel");
+
+    LPARAM dialogParams[4] = { (LPARAM)algorithm, (LPARAM)covered, (LPARAM)&bigEndian, (LPARAM)bufferSize };
+    INT_PTR result = DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)ChecksumDialogProc, (LPARAM)dialogParams);
+
+    GlobalFree(lpdt);
+    return result == IDOK;
+}
+
+INT_PTR CALLBACK ChecksumDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static LPARAM* params = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+    {
+        params = reinterpret_cast<LPARAM*>(lParam);
+        const char* algorithm = reinterpret_cast<char*>(params[0]);
+
+        // The first entry takes the declaration away
+        HWND hCombo = GetDlgItem(hwndDlg, IDC_CHECKSUM_ALGORITHM);
+        SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)"(none)");
+        int selected = 0;
+        const std::vector<std::string>& names = ChecksumAlgorithmNames();
+        for (size_t i = 0; i < names.size(); i++) {
+            SendMessage(hCombo, CB_ADDSTRING, 0, (LPARAM)names[i].c_str());
+            if (names[i] == algorithm) {
+                selected = static_cast<int>(i) + 1;
+            }
+        }
+        SendMessage(hCombo, CB_SETCURSEL, selected, 0);
+
+        SetDlgItemText(hwndDlg, IDC_CHECKSUM_COVERED, reinterpret_cast<char*>(params[1]));
+        CheckDlgButton(hwndDlg, *reinterpret_cast<bool*>(params[2]) ? IDC_CHECKSUM_BIG : IDC_CHECKSUM_LITTLE, BST_CHECKED);
+        SetFocus(hCombo);
+        return FALSE;   // Focus was set explicitly
+    }
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDOK:
+        {
+            int bufferSize = static_cast<int>(params[3]);
+            char* algorithm = reinterpret_cast<char*>(params[0]);
+            int index = static_cast<int>(SendDlgItemMessage(hwndDlg, IDC_CHECKSUM_ALGORITHM, CB_GETCURSEL, 0, 0));
+            const std::vector<std::string>& names = ChecksumAlgorithmNames();
+            if (index >= 1 && index <= static_cast<int>(names.size())) {
+                strcpy_s(algorithm, bufferSize, names[index - 1].c_str());
+            }
+            else {
+                algorithm[0] = '\0';
+            }
+            GetDlgItemText(hwndDlg, IDC_CHECKSUM_COVERED, reinterpret_cast<char*>(params[1]), bufferSize);
+            *reinterpret_cast<bool*>(params[2]) = IsDlgButtonChecked(hwndDlg, IDC_CHECKSUM_BIG) == BST_CHECKED;
+            EndDialog(hwndDlg, IDOK);
+            return TRUE;
+        }
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
+
+// Control IDs for the embedded files dialog
+#define IDC_EMBEDDED_RESULTS 1071
+#define IDC_EMBEDDED_COUNT   1072
+
+INT_PTR CALLBACK EmbeddedFilesDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam);
+
+// The files found, the annotations made for them and the window they are in
+struct EmbeddedFilesContext {
+    HWND viewer;
+    DocumentWindowState* state;
+    const std::vector<EmbeddedFile>* files;
+    size_t firstIndex;
+};
+
+//-------------------------------------------------------------------
+// Embedded Files Dialog - List the files found and jump to them
+//-------------------------------------------------------------------
+// files[i] was annotated as annotation firstIndex + i
+void ShowEmbeddedFilesDialog(HWND hwnd, DocumentWindowState& state, const std::vector<EmbeddedFile>& files, size_t firstIndex)
+{
+    LPDLGTEMPLATE lpdt = (LPDLGTEMPLATE)GlobalAlloc(GPTR, 4096);
+
+    lpdt->style = WS_POPUP | WS_BORDER | WS_SYSMENU | DS_MODALFRAME | WS_CAPTION | DS_CENTER | DS_SETFONT;
+    lpdt->cdit = 4;
+    lpdt->x = 10;
+    lpdt->y = 10;
+    lpdt->cx = 300;
+    lpdt->cy = 210;
+
+    LPWORD lpw = (LPWORD)(lpdt + 1);
+    *lpw++ = 0; // No menu
+    *lpw++ = 0; // Default dialog box class
+
+    int nchar = MultiByteToWideChar(CP_ACP, 0, "Embedded Files", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    *lpw++ = 8; // Font size (in points)
+
+    nchar = MultiByteToWideChar(CP_ACP, 0, "MS Shell Dlg 2", -1, (LPWSTR)lpw, 50);
+    lpw += nchar;
+
+    lpw = AppendDialogItem(lpw, 10, 8, 280, 169, IDC_EMBEDDED_RESULTS,
+        WS_CHILD | WS_VISIBLE | WS_BORDER | WS_VSCROLL | LBS_NOTIFY | LBS_NOINTEGRALHEIGHT | WS_TABSTOP, 0x0083, "");
+    lpw = AppendDialogItem(lpw, 10, 186, 160, 10, IDC_EMBEDDED_COUNT, WS_CHILD | WS_VISIBLE | SS_LEFT, 0x0082, "");
+    lpw = AppendDialogItem(lpw, 180, 184, 50, 16, IDOK, WS_CHILD | WS_VISIBLE | BS_DEFPUSHBUTTON | WS_TABSTOP, 0x0080, "Go To");
+    lpw = AppendDialogItem(lpw, 240, 184, 50, 16, IDCANCEL, WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON | WS_TABSTOP, 0x0080, "Close");
+
+    EmbeddedFilesContext context = { hwnd, &state, &files, firstIndex };
+    DialogBoxIndirectParam(g_hInstance, lpdt, hwnd, (DLGPROC)EmbeddedFilesDialogProc, (LPARAM)&context);
+
+    GlobalFree(lpdt);
+}
+
+// Offset, format and size of each file, as many as FIND_MAX_LISTED
+static void ListEmbeddedFiles(HWND hwndDlg, const EmbeddedFilesContext& context)
+{
+    const std::vector<EmbeddedFile>& files = *context.files;
+    HWND hList = GetDlgItem(hwndDlg, IDC_EMBEDDED_RESULTS);
+    SendMessage(hList, WM_SETREDRAW, FALSE, 0);
+
+    size_t listed = std::min(files.size(), FIND_MAX_LISTED);
+    size_t totalSize = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        totalSize += files[i].size;
+        if (i >= listed) {
+            continue;
+        }
+
+        char line[100];
+        sprintf_s(line, sizeof(line), "%08zX  %-16s %zu bytes", files[i].offset, files[i].format, files[i].size);
+        LRESULT item = SendMessage(hList, LB_ADDSTRING, 0, (LPARAM)line);
+        SendMessage(hList, LB_SETITEMDATA, item, (LPARAM)(context.firstIndex + i));
+    }
+
+    SendMessage(hList, WM_SETREDRAW, TRUE, 0);
+    InvalidateRect(hList, NULL, TRUE);
+
+    std::string count = std::to_string(files.size()) + (files.size() == 1 ? " file, " : " files, ") +
+        std::to_string(totalSize) + " bytes";
+    if (listed < files.size()) {
+        count += ", first " + std::to_string(listed) + " shown";
+    }
+    SetDlgItemText(hwndDlg, IDC_EMBEDDED_COUNT, count.c_str());
+}
+
+// Navigate to the selected file, or the first one if none is selected
+static void GoToSelectedFile(HWND hwndDlg, const EmbeddedFilesContext& context)
+{
+    HWND hList = GetDlgItem(hwndDlg, IDC_EMBEDDED_RESULTS);
+    LRESULT item = SendMessage(hList, LB_GETCURSEL, 0, 0);
+    if (item == LB_ERR) {
+        item = 0;
+    }
+
+    int index = static_cast<int>(SendMessage(hList, LB_GETITEMDATA, item, 0));
+    GoToAnnotation(context.viewer, *context.state, index);
+}
+
+INT_PTR CALLBACK EmbeddedFilesDialogProc(HWND hwndDlg, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    static EmbeddedFilesContext* context = NULL;
+
+    switch (message)
+    {
+    case WM_INITDIALOG:
+        context = reinterpret_cast<EmbeddedFilesContext*>(lParam);
+        ListEmbeddedFiles(hwndDlg, *context);
+        SetFocus(GetDlgItem(hwndDlg, IDC_EMBEDDED_RESULTS));
+        return FALSE;   // Focus was set explicitly
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam))
+        {
+        case IDC_EMBEDDED_RESULTS:
+            // Browsing the list follows along in the document
+            if (HIWORD(wParam) == LBN_SELCHANGE) {
+                GoToSelectedFile(hwndDlg, *context);
+            }
+            else if (HIWORD(wParam) == LBN_DBLCLK) {
+                GoToSelectedFile(hwndDlg, *context);
+                EndDialog(hwndDlg, IDOK);
+            }
+            return TRUE;
+
+        case IDOK:
+            GoToSelectedFile(hwndDlg, *context);
+            EndDialog(hwndDlg, IDOK);
+            return TRUE;
+
+        case IDCANCEL:
+            EndDialog(hwndDlg, IDCANCEL);
+            return TRUE;
+        }
+        break;
+    }
+
+    return FALSE;
+}
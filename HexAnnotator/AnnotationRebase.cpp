@@ -0,0 +1,384 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstring>
+#include <unordered_map>
+#include "AnnotationRebase.h"
+#include "ContentFingerprint.h"
+#include "WorkerPool.h"
+
+// Chunk sizes: a cut is made where the top REBASE_CUT_BITS of the rolling hash
+// are zero, giving chunks of about 2 KB past the minimum. Small chunks keep
+// the bytes lost around each edit few before the runs are extended.
+const size_t REBASE_MIN_CHUNK = 512;
+const size_t REBASE_MAX_CHUNK = 16384;
+const int REBASE_CUT_BITS = 11;
+
+// Gaps left between runs, where edits fall closer together than a chunk,
+// are searched again rsync style: old blocks of REBASE_BLOCK_SIZE bytes are
+// looked up at every offset of the new gap with a rolling hash. Gaps larger
+// than REBASE_MAX_REFINED_GAP on either side are rewritten regions and are
+// left alone.
+const size_t REBASE_BLOCK_SIZE = 32;
+const size_t REBASE_MAX_REFINED_GAP = 1024 * 1024;
+
+// Annotations mapped by one pool task
+const size_t REBASE_ANNOTATIONS_PER_TASK = 65536;
+
+//-------------------------------------------------------------------
+// Content-defined chunking
+//-------------------------------------------------------------------
+struct ContentChunk {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t length;
+};
+
+// Random value per byte for the gear hash, fixed so chunking is reproducible
+static const std::array<uint64_t, 256>& gearTable() {
+    static const auto table = [] {
+        std::array<uint64_t, 256> entries{};
+        uint64_t state = 0x9E3779B97F4A7C15ull;
+        for (auto& entry : entries) {
+            // splitmix64
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            entry = z ^ (z >> 31);
+        }
+        return entries;
+    }();
+    return table;
+}
+
+// Each byte shifts the hash left by one, so its top bits depend on the last
+// 64 bytes only and a cut point moves with the content around it
+static std::vector<ContentChunk> chunkContents(const BYTE* data, size_t size) {
+    const auto& gear = gearTable();
+    std::vector<ContentChunk> chunks;
+    chunks.reserve(size / 2048 + 1);
+
+    size_t start = 0;
+    while (start < size) {
+        size_t limit = std::min(size - start, REBASE_MAX_CHUNK);
+        size_t length = limit;
+
+        if (limit > REBASE_MIN_CHUNK) {
+            uint64_t hash = 0;
+            for (size_t i = REBASE_MIN_CHUNK - 64; i < limit; ++i) {
+                hash = (hash << 1) + gear[data[start + i]];
+                if (i >= REBASE_MIN_CHUNK && (hash >> (64 - REBASE_CUT_BITS)) == 0) {
+                    length = i + 1;
+                    break;
+                }
+            }
+        }
+
+        chunks.push_back({ Xxh64(data + start, length, 0), start, static_cast<uint32_t>(length) });
+        start += length;
+    }
+    return chunks;
+}
+
+//-------------------------------------------------------------------
+// Gap refinement
+//-------------------------------------------------------------------
+const uint64_t ROLLING_BASE = 0x100000001B3ull;
+
+// Runs between old [oldStart, oldEnd) and new [newStart, newEnd), in order in
+// both versions
+static std::vector<RebaseMatch> refineGap(const BYTE* oldData, uint64_t oldStart, uint64_t oldEnd,
+    const BYTE* newData, uint64_t newStart, uint64_t newEnd) {
+    std::vector<RebaseMatch> found;
+    if (oldEnd - oldStart < REBASE_BLOCK_SIZE || newEnd - newStart < REBASE_BLOCK_SIZE) {
+        return found;
+    }
+
+    auto hashBlock = [](const BYTE* p) {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < REBASE_BLOCK_SIZE; ++i) hash = hash * ROLLING_BASE + p[i];
+        return hash;
+    };
+
+    // Aligned old blocks by hash; the first of equal blocks wins
+    std::unordered_map<uint64_t, uint64_t> blocks;
+    blocks.reserve((oldEnd - oldStart) / REBASE_BLOCK_SIZE);
+    for (uint64_t offset = oldStart; offset + REBASE_BLOCK_SIZE <= oldEnd; offset += REBASE_BLOCK_SIZE) {
+        blocks.emplace(hashBlock(oldData + offset), offset);
+    }
+
+    uint64_t outgoingWeight = 1;
+    for (size_t i = 1; i < REBASE_BLOCK_SIZE; ++i) outgoingWeight *= ROLLING_BASE;
+
+    // Matches are accepted greedily and only past the previous one in both
+    // versions, which keeps them ordered without a full alignment
+    uint64_t oldFloor = oldStart;
+    uint64_t position = newStart;
+    uint64_t hash = hashBlock(newData + position);
+
+    while (true) {
+        auto it = blocks.find(hash);
+        if (it != blocks.end() && it->second >= oldFloor &&
+            memcmp(oldData + it->second, newData + position, REBASE_BLOCK_SIZE) == 0) {
+            RebaseMatch match = { it->second, position, REBASE_BLOCK_SIZE };
+            uint64_t newFloor = found.empty() ? newStart : found.back().newOffset + found.back().length;
+
+            while (match.oldOffset > oldFloor && match.newOffset > newFloor &&
+                oldData[match.oldOffset - 1] == newData[match.newOffset - 1]) {
+                --match.oldOffset;
+                --match.newOffset;
+                ++match.length;
+            }
+            while (match.oldOffset + match.length < oldEnd && match.newOffset + match.length < newEnd &&
+                oldData[match.oldOffset + match.length] == newData[match.newOffset + match.length]) {
+                ++match.length;
+            }
+
+            found.push_back(match);
+            oldFloor = match.oldOffset + match.length;
+            position = match.newOffset + match.length;
+            if (position + REBASE_BLOCK_SIZE > newEnd) {
+                break;
+            }
+            hash = hashBlock(newData + position);
+            continue;
+        }
+
+        if (position + REBASE_BLOCK_SIZE >= newEnd) {
+            break;
+        }
+        hash = (hash - newData[position] * outgoingWeight) * ROLLING_BASE + newData[position + REBASE_BLOCK_SIZE];
+        ++position;
+    }
+    return found;
+}
+
+//-------------------------------------------------------------------
+// MatchContents
+//-------------------------------------------------------------------
+std::vector<RebaseMatch> MatchContents(const BYTE* oldData, size_t oldSize, const BYTE* newData, size_t newSize) {
+    // Both versions are chunked at the same time
+    std::vector<ContentChunk> oldChunks;
+    std::vector<ContentChunk> newChunks;
+    WorkerPool::shared().parallelFor(2, [&](size_t which) {
+        if (which == 0)
+            oldChunks = chunkContents(oldData, oldSize);
+        else
+            newChunks = chunkContents(newData, newSize);
+    });
+
+    // New chunks by hash, then offset, so repeated content such as padding
+    // can be matched to the copy nearest where it is expected
+    std::sort(newChunks.begin(), newChunks.end(), [](const ContentChunk& a, const ContentChunk& b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.offset < b.offset;
+    });
+
+    std::vector<RebaseMatch> runs;
+    int64_t delta = 0;
+
+    for (const auto& chunk : oldChunks) {
+        auto first = std::lower_bound(newChunks.begin(), newChunks.end(), chunk.hash,
+            [](const ContentChunk& c, uint64_t hash) { return c.hash < hash; });
+        auto last = std::upper_bound(first, newChunks.end(), chunk.hash,
+            [](uint64_t hash, const ContentChunk& c) { return hash < c.hash; });
+        if (first == last) {
+            continue;
+        }
+
+        // Closest candidate to the current displacement
+        int64_t expected = static_cast<int64_t>(chunk.offset) + delta;
+        auto best = std::lower_bound(first, last, expected,
+            [](const ContentChunk& c, int64_t offset) { return static_cast<int64_t>(c.offset) < offset; });
+        if (best == last || (best != first &&
+            expected - static_cast<int64_t>((best - 1)->offset) < static_cast<int64_t>(best->offset) - expected)) {
+            --best;
+        }
+        if (best->length != chunk.length) {
+            continue;
+        }
+
+        delta = static_cast<int64_t>(best->offset) - static_cast<int64_t>(chunk.offset);
+        if (!runs.empty() && runs.back().oldOffset + runs.back().length == chunk.offset &&
+            runs.back().newOffset + runs.back().length == best->offset) {
+            runs.back().length += chunk.length;
+        }
+        else {
+            runs.push_back({ chunk.offset, best->offset, chunk.length });
+        }
+    }
+
+    // Grow each run over the unchanged bytes of the chunks next to it, up to
+    // the edit itself, without crossing its neighbours in the old version
+    for (size_t i = 0; i < runs.size(); ++i) {
+        RebaseMatch& run = runs[i];
+        uint64_t lowest = i > 0 ? runs[i - 1].oldOffset + runs[i - 1].length : 0;
+        uint64_t highest = i + 1 < runs.size() ? runs[i + 1].oldOffset : oldSize;
+
+        while (run.oldOffset > lowest && run.newOffset > 0 &&
+            oldData[run.oldOffset - 1] == newData[run.newOffset - 1]) {
+            --run.oldOffset;
+            --run.newOffset;
+            ++run.length;
+        }
+        while (run.oldOffset + run.length < highest && run.newOffset + run.length < newSize &&
+            oldData[run.oldOffset + run.length] == newData[run.newOffset + run.length]) {
+            ++run.length;
+        }
+    }
+
+    // Search the gaps between consecutive runs, and before the first and
+    // after the last, in parallel. A gap only exists where both versions have
+    // bytes between the runs.
+    size_t gapCount = runs.size() + 1;
+    std::vector<std::vector<RebaseMatch>> refined(gapCount);
+    WorkerPool::shared().parallelFor(gapCount, [&](size_t gap) {
+        uint64_t oldStart = gap > 0 ? runs[gap - 1].oldOffset + runs[gap - 1].length : 0;
+        uint64_t newStart = gap > 0 ? runs[gap - 1].newOffset + runs[gap - 1].length : 0;
+        uint64_t oldEnd = gap < runs.size() ? runs[gap].oldOffset : oldSize;
+        uint64_t newEnd = gap < runs.size() ? runs[gap].newOffset : newSize;
+
+        if (oldEnd > oldStart && newEnd > newStart &&
+            oldEnd - oldStart <= REBASE_MAX_REFINED_GAP && newEnd - newStart <= REBASE_MAX_REFINED_GAP) {
+            refined[gap] = refineGap(oldData, oldStart, oldEnd, newData, newStart, newEnd);
+        }
+    });
+
+    std::vector<RebaseMatch> all;
+    all.reserve(runs.size());
+    for (size_t gap = 0; gap < gapCount; ++gap) {
+        all.insert(all.end(), refined[gap].begin(), refined[gap].end());
+        if (gap < runs.size()) {
+            all.push_back(runs[gap]);
+        }
+    }
+
+    // Runs that now touch with the same displacement are one
+    std::vector<RebaseMatch> merged;
+    merged.reserve(all.size());
+    for (const auto& run : all) {
+        if (!merged.empty() && merged.back().oldOffset + merged.back().length == run.oldOffset &&
+            merged.back().newOffset + merged.back().length == run.newOffset) {
+            merged.back().length += run.length;
+        }
+        else {
+            merged.push_back(run);
+        }
+    }
+    return merged;
+}
+
+//-------------------------------------------------------------------
+// RebaseAnnotations
+//-------------------------------------------------------------------
+enum RebaseOutcome : BYTE {
+    REBASE_MOVED,
+    REBASE_STALE,
+    REBASE_DROPPED
+};
+
+// Index of the run containing offset, or of the last run before it (-1 if none)
+static ptrdiff_t runAtOrBefore(const std::vector<RebaseMatch>& runs, uint64_t offset) {
+    auto next = std::upper_bound(runs.begin(), runs.end(), offset,
+        [](uint64_t value, const RebaseMatch& run) { return value < run.oldOffset; });
+    return (next - runs.begin()) - 1;
+}
+
+static bool runContains(const std::vector<RebaseMatch>& runs, ptrdiff_t index, uint64_t offset) {
+    return index >= 0 && offset < runs[index].oldOffset + runs[index].length;
+}
+
+static RebaseOutcome rebaseOne(Annotation& anno, const std::vector<RebaseMatch>& runs, size_t newSize) {
+    uint64_t start = static_cast<uint64_t>(anno.startOffset);
+    uint64_t end = static_cast<uint64_t>(anno.endOffset);
+
+    ptrdiff_t startRun = runAtOrBefore(runs, start);
+    ptrdiff_t endRun = runAtOrBefore(runs, end);
+
+    // Entirely inside one run: the bytes are unchanged
+    if (startRun == endRun && runContains(runs, startRun, start) && runContains(runs, endRun, end)) {
+        int64_t delta = static_cast<int64_t>(runs[startRun].newOffset) - static_cast<int64_t>(runs[startRun].oldOffset);
+        int64_t newEnd = static_cast<int64_t>(end) + delta;
+        if (newEnd > INT_MAX) {
+            return REBASE_DROPPED;
+        }
+        anno.startOffset = static_cast<int>(static_cast<int64_t>(start) + delta);
+        anno.endOffset = static_cast<int>(newEnd);
+        return REBASE_MOVED;
+    }
+
+    // Bytes that are not in any run are placed relative to the run before
+    // them, or the first run if there is none, and kept within the gap the
+    // edit left in the new version
+    auto mapOffset = [&](uint64_t offset, ptrdiff_t run) -> int64_t {
+        if (runs.empty()) {
+            return static_cast<int64_t>(offset);
+        }
+
+        const RebaseMatch& anchor = runs[std::max<ptrdiff_t>(run, 0)];
+        int64_t mapped = static_cast<int64_t>(offset) - static_cast<int64_t>(anchor.oldOffset) +
+            static_cast<int64_t>(anchor.newOffset);
+        if (runContains(runs, run, offset)) {
+            return mapped;
+        }
+
+        int64_t gapStart = run >= 0 ? static_cast<int64_t>(runs[run].newOffset + runs[run].length) : 0;
+        int64_t gapEnd = run + 1 < static_cast<ptrdiff_t>(runs.size())
+            ? static_cast<int64_t>(runs[run + 1].newOffset) : static_cast<int64_t>(newSize);
+        return std::clamp(mapped, gapStart, std::max(gapStart, gapEnd - 1));
+    };
+
+    int64_t newStart = mapOffset(start, startRun);
+    int64_t newEnd = mapOffset(end, endRun);
+
+    // Nothing left of a range that fell wholly inside a deletion
+    bool deleted = startRun == endRun && !runContains(runs, startRun, start) && !runs.empty() &&
+        (startRun + 1 < static_cast<ptrdiff_t>(runs.size()) ? runs[startRun + 1].newOffset : newSize) <=
+        (startRun >= 0 ? runs[startRun].newOffset + runs[startRun].length : 0);
+
+    // Record arrays keep the extent their layout describes
+    if (newEnd < newStart || anno.layout) {
+        newEnd = newStart + static_cast<int64_t>(end - start);
+    }
+    if (anno.layout && newEnd >= static_cast<int64_t>(newSize)) {
+        return REBASE_DROPPED;
+    }
+    newEnd = std::min<int64_t>(newEnd, static_cast<int64_t>(newSize) - 1);
+
+    if (deleted || newStart < 0 || newStart > newEnd || newEnd > INT_MAX) {
+        return REBASE_DROPPED;
+    }
+
+    anno.startOffset = static_cast<int>(newStart);
+    anno.endOffset = static_cast<int>(newEnd);
+    anno.stale = true;
+    return REBASE_STALE;
+}
+
+RebaseResult RebaseAnnotations(const std::vector<Annotation>& annotations, const std::vector<RebaseMatch>& matches,
+    size_t newSize) {
+    std::vector<Annotation> mapped = annotations;
+    std::vector<RebaseOutcome> outcomes(mapped.size());
+
+    size_t taskCount = (mapped.size() + REBASE_ANNOTATIONS_PER_TASK - 1) / REBASE_ANNOTATIONS_PER_TASK;
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t first = task * REBASE_ANNOTATIONS_PER_TASK;
+        size_t last = std::min(first + REBASE_ANNOTATIONS_PER_TASK, mapped.size());
+        for (size_t i = first; i < last; ++i) {
+            outcomes[i] = newSize == 0 ? REBASE_DROPPED : rebaseOne(mapped[i], matches, newSize);
+        }
+    });
+
+    RebaseResult result;
+    result.annotations.reserve(mapped.size());
+    for (size_t i = 0; i < mapped.size(); ++i) {
+        switch (outcomes[i]) {
+        case REBASE_MOVED:   ++result.moved; break;
+        case REBASE_STALE:   ++result.stale; break;
+        case REBASE_DROPPED: ++result.dropped; continue;
+        }
+        result.annotations.push_back(std::move(mapped[i]));
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "includes.h"
+
+// Moving annotations onto a new version of their document, rsync style.
+// Both versions are cut into content-defined chunks with a rolling gear
+// hash, so an insertion or deletion only disturbs the chunks it touches.
+// Chunks found in both versions become runs of identical bytes, which are
+// then extended byte by byte up to the actual edits.
+
+// Bytes [oldOffset, oldOffset + length) of the old version equal
+// [newOffset, newOffset + length) of the new one
+struct RebaseMatch {
+    uint64_t oldOffset;
+    uint64_t newOffset;
+    uint64_t length;
+};
+
+// Identical runs, ordered and non-overlapping in the old version. The old
+// version is read front to back once, so it can be a mapped multi-GB file.
+std::vector<RebaseMatch> MatchContents(const BYTE* oldData, size_t oldSize, const BYTE* newData, size_t newSize);
+
+struct RebaseResult {
+    std::vector<Annotation> annotations;
+    size_t moved = 0;           // Same bytes, new place
+    size_t stale = 0;           // Mapped, but the bytes under them changed
+    size_t dropped = 0;         // No longer in the document
+};
+
+// Map every annotation from old to new offsets. An annotation whose bytes
+// all lie in one run keeps its flag; anything else is placed by the
+// nearest run and flagged stale. Order is preserved.
+RebaseResult RebaseAnnotations(const std::vector<Annotation>& annotations, const std::vector<RebaseMatch>& matches,
+    size_t newSize);
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+//-------------------------------------------------------------------
+// AnnotationText - label or format of an annotation
+//-------------------------------------------------------------------
+// Immutable text that copies share instead of duplicating. The bytes live in
+// a reference-counted block, which is either the text's own or a string
+// table that many texts point into: ReadAnnotationFile copies a version 2
+// file's string table into one block, and every label and format it loads
+// refers to it by offset, so loading allocates nothing per annotation.
+//
+// A text keeps its whole block alive, so one label surviving from a loaded
+// file holds on to that file's entire string table until it is replaced or
+// deleted. The loader copies texts out instead when only a small part of the
+// table would be referenced; a label that is edited gets a block of its own.
+//
+// Converts to std::string_view; use str() where a std::string is needed.
+class AnnotationText {
+public:
+    // Reference-counted bytes, followed in memory by size chars
+    struct Block {
+        std::atomic<size_t> references;
+        size_t size;
+
+        const char* chars() const { return reinterpret_cast<const char*>(this + 1); }
+        char* chars() { return reinterpret_cast<char*>(this + 1); }
+
+        // A block holding one reference for the caller
+        static Block* create(std::string_view bytes) {
+            Block* block = new (::operator new(sizeof(Block) + bytes.size())) Block{ { 1 }, bytes.size() };
+            memcpy(block->chars(), bytes.data(), bytes.size());
+            return block;
+        }
+
+        void retain(size_t count = 1) { references.fetch_add(count, std::memory_order_relaxed); }
+
+        void release(size_t count = 1) {
+            if (references.fetch_sub(count, std::memory_order_acq_rel) == count) {
+                this->~Block();
+                ::operator delete(this);
+            }
+        }
+    };
+
+    AnnotationText() = default;
+    AnnotationText(std::string_view text) {
+        if (!text.empty()) {
+            block = Block::create(text);
+            length = static_cast<uint32_t>(text.size());
+        }
+    }
+    AnnotationText(const std::string& text) : AnnotationText(std::string_view(text)) {}
+    AnnotationText(const char* text) : AnnotationText(std::string_view(text)) {}
+
+    // Bytes [offset, offset + length) of block, taking over one reference
+    // to it that the caller already holds
+    static AnnotationText adopt(Block* block, uint32_t offset, uint32_t length) {
+        AnnotationText text;
+        text.block = block;
+        text.offset = offset;
+        text.length = length;
+        return text;
+    }
+
+    AnnotationText(const AnnotationText& other) : block(other.block), offset(other.offset), length(other.length) {
+        if (block) block->retain();
+    }
+    AnnotationText(AnnotationText&& other) noexcept : block(other.block), offset(other.offset), length(other.length) {
+        other.block = nullptr;
+        other.offset = other.length = 0;
+    }
+    AnnotationText& operator=(AnnotationText other) noexcept {
+        std::swap(block, other.block);
+        std::swap(offset, other.offset);
+        std::swap(length, other.length);
+        return *this;
+    }
+    ~AnnotationText() {
+        if (block) block->release();
+    }
+
+    const char* data() const { return block ? block->chars() + offset : ""; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    std::string_view view() const { return std::string_view(data(), length); }
+    operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(view()); }
+
+    friend bool operator==(const AnnotationText& text, std::string_view other) { return text.view() == other; }
+
+    friend std::string operator+(const AnnotationText& text, std::string_view other) {
+        std::string joined;
+        joined.reserve(text.size() + other.size());
+        joined.append(text.view()).append(other);
+        return joined;
+    }
+
+private:
+    Block* block = nullptr;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
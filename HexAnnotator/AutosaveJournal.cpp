@@ -0,0 +1,717 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include "AutosaveJournal.h"
+#include "AnnotationFile.h"
+
+// The journal is merged into the snapshot once it reaches this size and is
+// at least half as large as the snapshot, so the bytes rewritten by merging
+// stay proportional to the bytes journaled
+const uint64_t AUTOSAVE_MIN_COMPACT_BYTES = 1024 * 1024;
+
+// Largest single WriteFile call
+const DWORD AUTOSAVE_WRITE_CHUNK = 1 << 30;
+
+//-------------------------------------------------------------------
+// Journal layout
+//-------------------------------------------------------------------
+// Host byte order, like the version 1 annotation file:
+//
+//   JournalHeader
+//   { JournalRecordHeader, payload }...
+//
+// A payload is a JournalOp byte, an int32 index, a uint32 annotation count and
+// that many annotations in AppendAnnotationBytes form. The journal is only
+// ever appended to, so after a crash it ends in at most one torn record,
+// which fails its checksum and is dropped together with anything after it.
+struct JournalHeader {
+    char signature[4];          // "HVJ\0" (Hex Viewer Journal)
+    uint32_t version;
+    uint64_t generation;        // Matches the snapshot the journal extends
+};
+
+struct JournalRecordHeader {
+    uint64_t length;            // Payload bytes
+    uint32_t checksum;          // CRC-32 of the payload, filled in by the writer thread
+    uint32_t reserved;
+};
+
+const uint32_t JOURNAL_VERSION = 1;
+const size_t JOURNAL_PAYLOAD_FIXED = 1 + sizeof(int32_t) + sizeof(uint32_t);
+
+// The change a record redoes. Stored in files, so values must not change.
+enum JournalOp : BYTE {
+    JOURNAL_INSERT = 1,         // One annotation inserted at index
+    JOURNAL_ERASE,              // annotations[index] removed
+    JOURNAL_UPDATE,             // annotations[index] replaced
+    JOURNAL_REPLACE_ALL,        // The whole collection replaced
+    JOURNAL_APPEND,             // Annotations added at index == size
+    JOURNAL_REMOVE_TAIL         // Annotations from index onward removed
+};
+
+static uint32_t crc32(const BYTE* data, size_t length) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> entries{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value >> 1) ^ (0xEDB88320u & (0u - (value & 1)));
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static std::string snapshotPathFor(const std::string& documentPath) {
+    return documentPath + ".autosave.hva";
+}
+
+static std::string journalPathFor(const std::string& documentPath) {
+    return documentPath + ".autosave.hvj";
+}
+
+//-------------------------------------------------------------------
+// File helpers
+//-------------------------------------------------------------------
+static bool fileExists(const std::string& path) {
+    return GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+static void writeAll(HANDLE file, const char* data, size_t length) {
+    while (length > 0) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, AUTOSAVE_WRITE_CHUNK));
+        DWORD written = 0;
+        if (!WriteFile(file, data, chunk, &written, NULL) || written != chunk) {
+            throw std::runtime_error("Failed to write the autosave journal.");
+        }
+        data += chunk;
+        length -= chunk;
+    }
+}
+
+static void flushToDisk(HANDLE file) {
+    if (!FlushFileBuffers(file)) {
+        throw std::runtime_error("Failed to flush the autosave journal to disk.");
+    }
+}
+
+// Files written through a stream are flushed by reopening them
+static uint64_t flushFileToDisk(const std::string& path) {
+    HANDLE file = CreateFile(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    bool ok = file != INVALID_HANDLE_VALUE && FlushFileBuffers(file) && GetFileSizeEx(file, &size);
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    if (!ok) {
+        throw std::runtime_error("Failed to flush the autosave snapshot to disk.");
+    }
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+static void replaceFile(const std::string& from, const std::string& to) {
+    if (!MoveFileEx(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw std::runtime_error("Failed to replace " + to + ".");
+    }
+}
+
+// Journal handles do not share write or delete access, so a second window on
+// the same document cannot journal into or replace the first one's files
+static HANDLE openJournalFile(const std::string& path, DWORD disposition) {
+    return CreateFile(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, disposition, FILE_ATTRIBUTE_NORMAL, NULL);
+}
+
+// Empty journal for generation, written beside the old one and renamed over it
+static HANDLE createJournal(const std::string& path, uint64_t generation) {
+    JournalHeader header = {};
+    memcpy(header.signature, "HVJ", 4);
+    header.version = JOURNAL_VERSION;
+    header.generation = generation;
+
+    std::string temp = path + ".tmp";
+    HANDLE file = openJournalFile(temp, CREATE_ALWAYS);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to create the autosave journal.");
+    }
+    try {
+        writeAll(file, reinterpret_cast<const char*>(&header), sizeof(header));
+        flushToDisk(file);
+    }
+    catch (...) {
+        CloseHandle(file);
+        throw;
+    }
+    CloseHandle(file);
+
+    replaceFile(temp, path);
+
+    file = openJournalFile(path, OPEN_EXISTING);
+    LARGE_INTEGER end = {};
+    if (file == INVALID_HANDLE_VALUE || !SetFilePointerEx(file, end, NULL, FILE_END)) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        throw std::runtime_error("Failed to open the autosave journal.");
+    }
+    return file;
+}
+
+// Existing journal, cut back to its valid records
+static HANDLE reopenJournal(const std::string& path, uint64_t validBytes) {
+    HANDLE file = openJournalFile(path, OPEN_EXISTING);
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(validBytes);
+    if (file == INVALID_HANDLE_VALUE || !SetFilePointerEx(file, position, NULL, FILE_BEGIN) ||
+        !SetEndOfFile(file) || !FlushFileBuffers(file)) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        throw std::runtime_error("Failed to open the autosave journal.");
+    }
+    return file;
+}
+
+//-------------------------------------------------------------------
+// Recovery
+//-------------------------------------------------------------------
+static bool fitsDocument(const Annotation& anno, size_t documentSize) {
+    return anno.startOffset >= 0 && anno.startOffset <= anno.endOffset &&
+        static_cast<size_t>(anno.endOffset) < documentSize &&
+        anno.colorIndex >= 0 && anno.colorIndex < static_cast<int>(std::size(annotationColors));
+}
+
+// Apply the record at position and advance past it. Returns false, changing
+// nothing, at the end of the journal or at a record that is torn, corrupt or
+// does not apply.
+static bool replayRecord(const std::vector<BYTE>& journal, size_t& position,
+    std::vector<Annotation>& annotations, size_t documentSize) {
+    JournalRecordHeader header;
+    if (journal.size() - position < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, journal.data() + position, sizeof(header));
+
+    size_t payloadStart = position + sizeof(header);
+    if (header.length < JOURNAL_PAYLOAD_FIXED || header.length > journal.size() - payloadStart) {
+        return false;
+    }
+
+    const BYTE* payload = journal.data() + payloadStart;
+    size_t length = static_cast<size_t>(header.length);
+    if (crc32(payload, length) != header.checksum) {
+        return false;
+    }
+
+    BYTE op = payload[0];
+    int32_t index;
+    uint32_t count;
+    memcpy(&index, payload + 1, sizeof(index));
+    memcpy(&count, payload + 1 + sizeof(index), sizeof(count));
+
+    // Decode the whole record before applying any of it
+    std::vector<Annotation> decoded;
+    decoded.reserve(std::min<size_t>(count, length / 24));
+    try {
+        size_t offset = JOURNAL_PAYLOAD_FIXED;
+        for (uint32_t i = 0; i < count; ++i) {
+            decoded.push_back(ReadAnnotationBytes(payload, length, offset));
+            if (!fitsDocument(decoded.back(), documentSize)) {
+                return false;
+            }
+        }
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+
+    size_t size = annotations.size();
+    bool inRange = index >= 0 && static_cast<size_t>(index) <= size;
+
+    switch (op) {
+    case JOURNAL_INSERT:
+        if (count != 1 || !inRange) return false;
+        annotations.insert(annotations.begin() + index, std::move(decoded[0]));
+        break;
+
+    case JOURNAL_ERASE:
+        if (count != 0 || !inRange || static_cast<size_t>(index) == size) return false;
+        annotations.erase(annotations.begin() + index);
+        break;
+
+    case JOURNAL_UPDATE:
+        if (count != 1 || !inRange || static_cast<size_t>(index) == size) return false;
+        annotations[index] = std::move(decoded[0]);
+        break;
+
+    case JOURNAL_REPLACE_ALL:
+        annotations = std::move(decoded);
+        break;
+
+    case JOURNAL_APPEND:
+        if (static_cast<size_t>(index) != size || index < 0) return false;
+        annotations.insert(annotations.end(),
+            std::make_move_iterator(decoded.begin()), std::make_move_iterator(decoded.end()));
+        break;
+
+    case JOURNAL_REMOVE_TAIL:
+        if (count != 0 || !inRange) return false;
+        annotations.erase(annotations.begin() + index, annotations.end());
+        break;
+
+    default:
+        return false;
+    }
+
+    position = payloadStart + length;
+    return true;
+}
+
+struct AutosaveContents {
+    std::vector<Annotation> annotations;
+    uint64_t generation = 0;
+    uint64_t snapshotBytes = 0;
+    uint64_t journalBytes = 0;  // Valid prefix of the journal, 0 if it has to be recreated
+};
+
+// Snapshot plus the journal records that extend it. Throws
+// std::runtime_error if the snapshot cannot be used.
+static AutosaveContents loadAutosave(const std::string& documentPath, size_t documentSize,
+    const ContentFingerprint& fingerprint) {
+    AutosaveContents contents;
+
+    std::string snapshotPath = snapshotPathFor(documentPath);
+    if (fileExists(snapshotPath)) {
+        AnnotationFileContents snapshot = ReadAnnotationFile(snapshotPath, documentSize);
+        if (snapshot.fingerprint.known() && snapshot.fingerprint != fingerprint) {
+            throw std::runtime_error("The document was changed after its annotations were autosaved.");
+        }
+        if (snapshot.skipped > 0) {
+            // The document changed since, so journal indices would be off too
+            throw std::runtime_error("The autosaved annotations do not fit the document.");
+        }
+        contents.annotations = std::move(snapshot.annotations);
+        contents.generation = snapshot.journalGeneration;
+
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (GetFileAttributesEx(snapshotPath.c_str(), GetFileExInfoStandard, &attributes)) {
+            contents.snapshotBytes = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        }
+    }
+
+    std::ifstream file(journalPathFor(documentPath), std::ios::binary);
+    if (!file) {
+        return contents;
+    }
+    std::vector<BYTE> journal((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // A journal from another generation was already merged into the
+    // snapshot, or belongs to one that is gone
+    JournalHeader header;
+    if (journal.size() < sizeof(header)) {
+        return contents;
+    }
+    memcpy(&header, journal.data(), sizeof(header));
+    if (memcmp(header.signature, "HVJ", 4) != 0 || header.version != JOURNAL_VERSION ||
+        header.generation != contents.generation) {
+        return contents;
+    }
+
+    size_t position = sizeof(header);
+    while (replayRecord(journal, position, contents.annotations, documentSize)) {
+    }
+    contents.journalBytes = position;
+    return contents;
+}
+
+//-------------------------------------------------------------------
+// Records
+//-------------------------------------------------------------------
+static void appendRaw(std::string& out, const void* value, size_t size) {
+    out.append(static_cast<const char*>(value), size);
+}
+
+// Frame one change as a journal record, checksum included
+static void appendRecord(std::string& out, AnnotationDelta::Kind kind, int index,
+    const std::vector<Annotation>& annotations) {
+    JournalOp op;
+    switch (kind) {
+    case AnnotationDelta::Insert:     op = JOURNAL_INSERT; break;
+    case AnnotationDelta::Erase:      op = JOURNAL_ERASE; break;
+    case AnnotationDelta::Update:     op = JOURNAL_UPDATE; break;
+    case AnnotationDelta::ReplaceAll: op = JOURNAL_REPLACE_ALL; break;
+    case AnnotationDelta::Append:     op = JOURNAL_APPEND; break;
+    case AnnotationDelta::RemoveTail: op = JOURNAL_REMOVE_TAIL; break;
+    default: return;
+    }
+
+    size_t start = out.size();
+    out.resize(start + sizeof(JournalRecordHeader));
+
+    int32_t recordIndex = index;
+    uint32_t count = static_cast<uint32_t>(annotations.size());
+    appendRaw(out, &op, sizeof(op));
+    appendRaw(out, &recordIndex, sizeof(recordIndex));
+    appendRaw(out, &count, sizeof(count));
+    for (const Annotation& anno : annotations) {
+        AppendAnnotationBytes(out, anno);
+    }
+
+    JournalRecordHeader header = {};
+    size_t payloadStart = start + sizeof(header);
+    header.length = out.size() - payloadStart;
+    header.checksum = crc32(reinterpret_cast<const BYTE*>(out.data()) + payloadStart, static_cast<size_t>(header.length));
+    memcpy(out.data() + start, &header, sizeof(header));
+}
+
+//-------------------------------------------------------------------
+// AutosaveJournal
+//-------------------------------------------------------------------
+AutosaveJournal::AutosaveJournal(std::string documentPath, size_t documentSize, ContentFingerprint fingerprint,
+    HANDLE journalFile, uint64_t generation, uint64_t journalBytes, uint64_t snapshotBytes)
+    : documentPath(std::move(documentPath)), documentSize(documentSize), fingerprint(fingerprint), journalFile(journalFile),
+    generation(generation), journalFileBytes(journalBytes),
+    journalBytes(journalBytes > 0 ? journalBytes - sizeof(JournalHeader) : 0), snapshotBytes(snapshotBytes) {
+    writer = std::thread(&AutosaveJournal::writerLoop, this);
+}
+
+AutosaveJournal::~AutosaveJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+
+    if (journalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(journalFile);
+    }
+}
+
+void AutosaveJournal::append(AnnotationDelta::Kind kind, int index, std::vector<Annotation> annotations) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed) {
+            return;
+        }
+
+        // Changes queued while the writer is busy join the batch it commits next
+        if (queue.empty() || queue.back().kind != Batch::Records) {
+            queue.emplace_back();
+        }
+        queue.back().changes.push_back(Change{ kind, index, std::move(annotations) });
+        queue.back().sequence = ++queuedSequence;
+    }
+    wake.notify_one();
+}
+
+void AutosaveJournal::snapshot(std::vector<Annotation> annotations) {
+    Batch batch;
+    batch.kind = Batch::Snapshot;
+    batch.annotations = std::move(annotations);
+    queueBatch(std::move(batch));
+    snapshotDue = false;
+}
+
+void AutosaveJournal::compact() {
+    Batch batch;
+    batch.kind = Batch::Compact;
+    queueBatch(std::move(batch));
+    journalBytes = 0;
+}
+
+void AutosaveJournal::discard() {
+    Batch batch;
+    batch.kind = Batch::Discard;
+    queueBatch(std::move(batch));
+    snapshotDue = false;
+}
+
+void AutosaveJournal::rebase() {
+    discard();
+    snapshotDue = true;
+}
+
+void AutosaveJournal::queueBatch(Batch batch) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed) {
+            return;
+        }
+
+        batch.sequence = ++queuedSequence;
+        queue.push_back(std::move(batch));
+    }
+    wake.notify_one();
+}
+
+void AutosaveJournal::waitUntilCommitted() {
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t target = queuedSequence;
+    committedChanged.wait(lock, [&] { return committedSequence >= target || failed; });
+}
+
+bool AutosaveJournal::wantsCompaction() const {
+    uint64_t journaled = journalBytes;
+    return journaled >= AUTOSAVE_MIN_COMPACT_BYTES && journaled * 2 >= snapshotBytes;
+}
+
+std::string AutosaveJournal::takeError() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::exchange(error, std::string());
+}
+
+void AutosaveJournal::writerLoop() {
+    for (;;) {
+        Batch batch;
+        bool skip;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (queue.empty()) {
+                return;
+            }
+
+            batch = std::move(queue.front());
+            queue.pop_front();
+            skip = failed;
+        }
+
+        if (!skip) {
+            try {
+                switch (batch.kind) {
+                case Batch::Records:  commitChanges(batch.changes); break;
+                case Batch::Snapshot: writeSnapshot(batch.annotations); break;
+                case Batch::Compact:  mergeSnapshot(); break;
+                case Batch::Discard:  removeFiles(); break;
+                }
+            }
+            catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                error = e.what();
+                queue.clear();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            committedSequence = batch.sequence;
+        }
+        committedChanged.notify_all();
+    }
+}
+
+// Group commit: one write and one flush for every change in the batch
+void AutosaveJournal::commitChanges(const std::vector<Change>& changes) {
+    std::string records;
+    for (const Change& change : changes) {
+        appendRecord(records, change.kind, change.index, change.annotations);
+    }
+
+    if (journalFile == INVALID_HANDLE_VALUE) {
+        journalFile = createJournal(journalPathFor(documentPath), generation);
+        journalFileBytes = sizeof(JournalHeader);
+    }
+
+    writeAll(journalFile, records.data(), records.size());
+    flushToDisk(journalFile);
+    journalFileBytes += records.size();
+    journalBytes += records.size();
+}
+
+// Every change queued before the request has been committed, so the files
+// on disk hold exactly the state to snapshot
+void AutosaveJournal::mergeSnapshot() {
+    if (journalFile == INVALID_HANDLE_VALUE) {
+        return;     // Nothing journaled since the last snapshot
+    }
+
+    AutosaveContents contents = loadAutosave(documentPath, documentSize, fingerprint);
+    if (contents.generation != generation || contents.journalBytes != journalFileBytes) {
+        throw std::runtime_error("The autosave files were changed by another program.");
+    }
+    writeSnapshot(contents.annotations);
+}
+
+// The old journal is stale once the snapshot is in place. Recovery ignores it
+// if a crash leaves it behind, and the next change creates a new one over it.
+void AutosaveJournal::writeSnapshot(const std::vector<Annotation>& annotations) {
+    std::string snapshotPath = snapshotPathFor(documentPath);
+    std::string temp = snapshotPath + ".tmp";
+    WriteAnnotationFile(temp, documentPath, fingerprint, annotations, generation + 1);
+    uint64_t size = flushFileToDisk(temp);
+    replaceFile(temp, snapshotPath);
+
+    if (journalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(journalFile);
+        journalFile = INVALID_HANDLE_VALUE;
+    }
+
+    ++generation;
+    journalFileBytes = 0;
+    journalBytes = 0;
+    snapshotBytes = size;
+}
+
+// The snapshot goes first: a journal left without it no longer matches the
+// generation recovery expects, so a crash in between restores an empty set.
+// The generation then starts over, as for a document never autosaved.
+void AutosaveJournal::removeFiles() {
+    if (journalFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(journalFile);
+        journalFile = INVALID_HANDLE_VALUE;
+    }
+
+    for (const std::string& path : { snapshotPathFor(documentPath), journalPathFor(documentPath) }) {
+        if (!DeleteFile(path.c_str()) && fileExists(path)) {
+            throw std::runtime_error("Failed to remove " + path + ".");
+        }
+    }
+
+    generation = 0;
+    journalFileBytes = 0;
+    journalBytes = 0;
+    snapshotBytes = 0;
+}
+
+//-------------------------------------------------------------------
+// Document hooks
+//-------------------------------------------------------------------
+bool OpenAutosave(HWND hwnd, DocumentWindowState& state) {
+    if (state.fileName.empty()) {
+        return false;
+    }
+
+    std::string snapshotPath = snapshotPathFor(state.fileName);
+    std::string journalPath = journalPathFor(state.fileName);
+    if (!fileExists(snapshotPath) && !fileExists(journalPath)) {
+        return false;
+    }
+
+    AutosaveContents contents;
+    try {
+        contents = loadAutosave(state.fileName, state.fileData.size(), state.fingerprint);
+    }
+    catch (const std::exception& e) {
+        std::string message = std::string("The autosaved annotations for this document could not be restored.\n\n") +
+            e.what() + "\n\nDiscard them? Choose No to keep " + snapshotPath +
+            " for later; autosave is then off for this window.";
+        if (MessageBox(hwnd, message.c_str(), "Autosave", MB_YESNO | MB_ICONWARNING) != IDYES) {
+            return true;
+        }
+
+        DeleteFile(snapshotPath.c_str());
+        DeleteFile(journalPath.c_str());
+        if (fileExists(snapshotPath) || fileExists(journalPath)) {
+            MessageBox(hwnd, ("Failed to remove " + snapshotPath + ". Autosave is off for this window.").c_str(),
+                "Autosave", MB_OK | MB_ICONWARNING);
+            return true;
+        }
+        return false;
+    }
+
+    state.annotations = std::move(contents.annotations);
+
+    // A second window on the same document, or a read-only location, restores
+    // the annotations but does not journal them
+    HANDLE journal = INVALID_HANDLE_VALUE;
+    if (contents.journalBytes > 0) {
+        try {
+            journal = reopenJournal(journalPath, contents.journalBytes);
+        }
+        catch (const std::runtime_error&) {
+            return true;
+        }
+    }
+
+    state.autosave = std::make_shared<AutosaveJournal>(state.fileName, state.fileData.size(), state.fingerprint,
+        journal, contents.generation, contents.journalBytes, contents.snapshotBytes);
+    return true;
+}
+
+void StartAutosave(DocumentWindowState& state) {
+    if (state.fileName.empty()) {
+        return;
+    }
+
+    state.autosave = std::make_shared<AutosaveJournal>(state.fileName, state.fileData.size(), state.fingerprint,
+        INVALID_HANDLE_VALUE, 0, 0, 0);
+    if (!state.annotations.empty()) {
+        state.autosave->rebase();
+    }
+}
+
+// Changes hand the writer thread copies of the annotations they set, which
+// share their text and layouts with the document; serializing them is left
+// to that thread.
+void JournalAnnotationChange(DocumentWindowState& state, AnnotationDelta::Kind kind, int index) {
+    if (!state.autosave) {
+        return;
+    }
+
+    AutosaveJournal& autosave = *state.autosave;
+    const std::vector<Annotation>& annotations = state.annotations;
+
+    // No files restore the same empty set
+    if (annotations.empty()) {
+        autosave.discard();
+        return;
+    }
+    if (kind == AnnotationDelta::ReplaceAll || autosave.needsSnapshot()) {
+        autosave.snapshot(annotations);
+        return;
+    }
+
+    switch (kind) {
+    case AnnotationDelta::Insert:
+    case AnnotationDelta::Update:
+        autosave.append(kind, index, { annotations[index] });
+        break;
+
+    case AnnotationDelta::Append:
+        autosave.append(kind, index, std::vector<Annotation>(annotations.begin() + index, annotations.end()));
+        break;
+
+    case AnnotationDelta::Erase:
+    case AnnotationDelta::RemoveTail:
+        autosave.append(kind, index, {});
+        break;
+
+    default:
+        break;
+    }
+}
+
+void AutosaveSaved(DocumentWindowState& state) {
+    if (state.autosave) {
+        state.autosave->rebase();
+    }
+}
+
+void CompactAutosave(DocumentWindowState& state) {
+    if (state.autosave && state.autosave->wantsCompaction()) {
+        state.autosave->compact();
+    }
+}
+
+std::string TakeAutosaveError(DocumentWindowState& state) {
+    if (!state.autosave) {
+        return std::string();
+    }
+
+    std::string error = state.autosave->takeError();
+    if (!error.empty()) {
+        state.autosave.reset();
+    }
+    return error;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "includes.h"
+
+// Annotations are saved automatically next to the document:
+//
+//   <document>.autosave.hva   snapshot, in the version 2 annotation format
+//   <document>.autosave.hvj   journal of the changes made since the snapshot
+//
+// Every change to state.annotations appends a checksummed record to the
+// journal, which is created by the first one. A background thread serializes
+// the records, writes them and flushes them to disk, committing everything
+// that queued up during the previous flush in one write. Once the journal has
+// grown large enough, the same thread merges it into a new snapshot and
+// starts an empty journal. Both files carry a generation number, so a journal
+// left behind by a crash between those two steps is recognised as already
+// merged. The files are removed once the annotations are saved, or once none
+// are left, as there is then nothing for them to restore.
+
+class AutosaveJournal {
+public:
+    // Takes ownership of journalFile, open for appending after journalBytes
+    // of valid content. INVALID_HANDLE_VALUE, with journalBytes 0, if the
+    // journal is still to be created.
+    AutosaveJournal(std::string documentPath, size_t documentSize, ContentFingerprint fingerprint,
+        HANDLE journalFile, uint64_t generation, uint64_t journalBytes, uint64_t snapshotBytes);
+
+    // Commits everything still queued before returning
+    ~AutosaveJournal();
+
+    AutosaveJournal(const AutosaveJournal&) = delete;
+    AutosaveJournal& operator=(const AutosaveJournal&) = delete;
+
+    // Queue one change, with the annotations it sets. Returns at once; the
+    // record is serialized by the writer thread and on disk after the next
+    // commit.
+    void append(AnnotationDelta::Kind kind, int index, std::vector<Annotation> annotations);
+
+    // Queue the whole set as a new snapshot, in place of a record
+    void snapshot(std::vector<Annotation> annotations);
+
+    // Queue a merge of the journal into a new snapshot
+    void compact();
+
+    // Queue removal of both files, leaving the journal to extend an empty set
+    void discard();
+
+    // Queue removal of both files for annotations kept elsewhere, e.g. in a
+    // saved file. The next change then goes into a new snapshot.
+    void rebase();
+
+    // True from rebase() until the next snapshot
+    bool needsSnapshot() const { return snapshotDue; }
+
+    // Block until everything queued so far is on disk or autosave has failed
+    void waitUntilCommitted();
+
+    // True when the journal is large next to the snapshot it extends
+    bool wantsCompaction() const;
+
+    // Why autosave stopped, once; empty while it works
+    std::string takeError();
+
+private:
+    struct Change {
+        AnnotationDelta::Kind kind;
+        int index;
+        std::vector<Annotation> annotations;
+    };
+
+    struct Batch {
+        enum Kind { Records, Snapshot, Compact, Discard };
+
+        Kind kind = Records;
+        std::vector<Change> changes;            // Records
+        std::vector<Annotation> annotations;    // Snapshot
+        uint64_t sequence = 0;      // Of the last change or request in the batch
+    };
+
+    void queueBatch(Batch batch);
+    void writerLoop();
+    void commitChanges(const std::vector<Change>& changes);
+    void mergeSnapshot();
+    void writeSnapshot(const std::vector<Annotation>& annotations);
+    void removeFiles();
+
+    const std::string documentPath;
+    const size_t documentSize;
+    const ContentFingerprint fingerprint;
+    HANDLE journalFile;                     // Writer thread only, as are the next two
+    uint64_t generation;
+    uint64_t journalFileBytes;
+    bool snapshotDue = false;               // UI thread only
+
+    std::mutex mutex;
+    std::condition_variable wake;           // Work queued or stopping
+    std::condition_variable committedChanged;
+    std::deque<Batch> queue;
+    uint64_t queuedSequence = 0;
+    uint64_t committedSequence = 0;
+    bool stopping = false;
+    bool failed = false;
+    std::string error;
+
+    std::atomic<uint64_t> journalBytes;     // Written since the last snapshot
+    std::atomic<uint64_t> snapshotBytes;
+
+    std::thread writer;
+};
+
+// Restores the annotations autosaved for state.fileName, then starts the
+// journal. Autosave stays off if the files cannot be opened, e.g. for a
+// document on read-only media. Returns false, without starting autosave, if
+// there was nothing to restore.
+bool OpenAutosave(HWND hwnd, DocumentWindowState& state);
+
+// Starts autosave for a document with nothing to restore. Annotations it
+// already has are kept elsewhere, so they are only written along with the
+// first change.
+void StartAutosave(DocumentWindowState& state);
+
+// Called by the undo journal after every change to state.annotations. kind
+// and index describe the change that was just applied.
+void JournalAnnotationChange(DocumentWindowState& state, AnnotationDelta::Kind kind, int index);
+
+// Called after state.annotations were saved to a file, which now holds
+// everything the autosave files would restore
+void AutosaveSaved(DocumentWindowState& state);
+
+// Called periodically; merges the journal into the snapshot when it has
+// grown large enough to be worth it
+void CompactAutosave(DocumentWindowState& state);
+
+// Why autosave stopped for this document, once; empty otherwise
+std::string TakeAutosaveError(DocumentWindowState& state);
@@ -0,0 +1,825 @@
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include "ByteRegex.h"
+
+typedef std::bitset<256> ByteSet;
+
+// Runs from a candidate that die within this many bytes are cheap enough to
+// try at every candidate
+const size_t REGEX_SHORT_RUN = 64;
+
+// Longest literal prefix used to find candidates
+const size_t REGEX_MAX_PREFIX = 64;
+
+// Deepest nesting of groups
+const int REGEX_MAX_DEPTH = 100;
+
+static const SearchHit NO_HIT = { SEARCH_NO_MATCH, 0 };
+
+//-------------------------------------------------------------------
+// RegexParser - pattern text to syntax tree
+//-------------------------------------------------------------------
+struct RegexNode {
+    enum Kind { BYTES, CONCAT, ALTERNATE, REPEAT };
+
+    Kind kind = CONCAT;
+    ByteSet bytes;                      // BYTES
+    std::vector<RegexNode> children;
+    int min = 1;                        // REPEAT; max < 0 is unbounded
+    int max = 1;
+};
+
+class RegexParser {
+public:
+    explicit RegexParser(const std::string& text) : text(text) {}
+
+    RegexNode parse() {
+        RegexNode node = alternation();
+        if (!atEnd()) {
+            // Only a ')' ends the top level early
+            throw error("there is no '(' for this ')'.");
+        }
+        return node;
+    }
+
+private:
+    std::runtime_error error(const std::string& message) const {
+        return std::runtime_error("Character " + std::to_string(position + 1) + ": " + message);
+    }
+
+    bool atEnd() const { return position >= text.size(); }
+    char peek() const { return text[position]; }
+
+    RegexNode alternation() {
+        RegexNode first = concatenation();
+        if (atEnd() || peek() != '|') {
+            return first;
+        }
+
+        RegexNode node;
+        node.kind = RegexNode::ALTERNATE;
+        node.children.push_back(std::move(first));
+        while (!atEnd() && peek() == '|') {
+            ++position;
+            node.children.push_back(concatenation());
+        }
+        return node;
+    }
+
+    RegexNode concatenation() {
+        RegexNode node;
+        node.kind = RegexNode::CONCAT;
+        while (!atEnd() && peek() != '|' && peek() != ')') {
+            node.children.push_back(repetition());
+        }
+        return node;
+    }
+
+    RegexNode repetition() {
+        RegexNode node = atom();
+        while (!atEnd()) {
+            int min, max;
+            switch (peek()) {
+            case '*': min = 0; max = -1; ++position; break;
+            case '+': min = 1; max = -1; ++position; break;
+            case '?': min = 0; max = 1; ++position; break;
+            case '{': bounds(min, max); break;
+            default: return node;
+            }
+
+            RegexNode repeat;
+            repeat.kind = RegexNode::REPEAT;
+            repeat.min = min;
+            repeat.max = max;
+            repeat.children.push_back(std::move(node));
+            node = std::move(repeat);
+        }
+        return node;
+    }
+
+    // "{n}", "{n,}" or "{n,m}"
+    void bounds(int& min, int& max) {
+        ++position;
+        if (!number(min)) {
+            throw error("expected {n}, {n,} or {n,m}.");
+        }
+        max = min;
+        if (!atEnd() && peek() == ',') {
+            ++position;
+            if (!number(max)) {
+                max = -1;
+            }
+        }
+        if (atEnd() || peek() != '}') {
+            throw error("expected {n}, {n,} or {n,m}.");
+        }
+        ++position;
+
+        if (max >= 0 && max < min) {
+            throw error("the repeat count range is backwards.");
+        }
+    }
+
+    bool number(int& value) {
+        size_t start = position;
+        value = 0;
+        while (!atEnd() && isdigit(static_cast<unsigned char>(peek()))) {
+            value = std::min(value * 10 + (text[position++] - '0'), REGEX_MAX_REPEAT + 1);
+        }
+        if (value > REGEX_MAX_REPEAT) {
+            throw error("repeat counts can be at most " + std::to_string(REGEX_MAX_REPEAT) + ".");
+        }
+        return position > start;
+    }
+
+    RegexNode atom() {
+        RegexNode node;
+        node.kind = RegexNode::BYTES;
+
+        char c = peek();
+        switch (c) {
+        case '(':
+            if (++depth > REGEX_MAX_DEPTH) {
+                throw error("groups are nested too deeply.");
+            }
+            ++position;
+            if (text.compare(position, 2, "?:") == 0) {
+                position += 2;
+            }
+            node = alternation();
+            if (atEnd()) {
+                throw error("missing ')'.");
+            }
+            ++position;
+            --depth;
+            return node;
+
+        case '*': case '+': case '?': case '{':
+            throw error("'" + std::string(1, c) + "' has nothing to repeat.");
+
+        case '^': case '$':
+            throw error("anchors are not supported; every offset is searched.");
+
+        case '.':
+            ++position;
+            node.bytes.set();
+            return node;
+
+        case '[':
+            ++position;
+            node.bytes = byteClass();
+            return node;
+
+        case '\\': {
+            ++position;
+            int byte = escape(node.bytes);
+            if (byte >= 0) {
+                node.bytes.set(byte);
+            }
+            return node;
+        }
+
+        default:
+            ++position;
+            node.bytes.set(static_cast<uint8_t>(c));
+            return node;
+        }
+    }
+
+    // The escape after a '\'. Returns its byte, or -1 for a class such as \d,
+    // whose bytes are added to set.
+    int escape(ByteSet& set) {
+        if (atEnd()) {
+            throw error("the pattern ends with '\\'.");
+        }
+
+        char c = text[position++];
+        switch (c) {
+        case 'x': {
+            int high = position < text.size() ? hexDigit(text[position]) : -1;
+            int low = position + 1 < text.size() ? hexDigit(text[position + 1]) : -1;
+            if (high < 0 || low < 0) {
+                throw error("\\x needs two hex digits.");
+            }
+            position += 2;
+            return (high << 4) | low;
+        }
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case '0': return 0;
+
+        case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+            ByteSet bytes;
+            for (int b = 0; b < 256; ++b) {
+                switch (tolower(c)) {
+                case 'd': bytes[b] = b >= '0' && b <= '9'; break;
+                case 'w': bytes[b] = b < 128 && (isalnum(b) || b == '_'); break;
+                case 's': bytes[b] = b == ' ' || (b >= '\t' && b <= '\r'); break;
+                }
+            }
+            if (isupper(static_cast<unsigned char>(c))) {
+                bytes.flip();
+            }
+            set |= bytes;
+            return -1;
+        }
+
+        default:
+            if (ispunct(static_cast<unsigned char>(c)) || c == ' ') {
+                return static_cast<uint8_t>(c);
+            }
+            throw error("unknown escape '\\" + std::string(1, c) + "'.");
+        }
+    }
+
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // After the '[': members up to the closing ']'
+    ByteSet byteClass() {
+        ByteSet set;
+        bool negated = !atEnd() && peek() == '^';
+        if (negated) {
+            ++position;
+        }
+
+        // A ']' right at the start is a member
+        for (bool first = true;; first = false) {
+            if (atEnd()) {
+                throw error("missing ']'.");
+            }
+            if (peek() == ']' && !first) {
+                ++position;
+                break;
+            }
+
+            int low = classMember(set);
+            if (low < 0) {
+                continue;
+            }
+
+            int high = low;
+            if (position + 1 < text.size() && peek() == '-' && text[position + 1] != ']') {
+                ++position;
+                high = classMember(set);
+                if (high < 0) {
+                    throw error("a range cannot end with a class escape.");
+                }
+                if (high < low) {
+                    throw error("the range is backwards.");
+                }
+            }
+            for (int b = low; b <= high; ++b) {
+                set.set(b);
+            }
+        }
+
+        if (negated) {
+            set.flip();
+        }
+        if (set.none()) {
+            throw error("the set contains no bytes.");
+        }
+        return set;
+    }
+
+    int classMember(ByteSet& set) {
+        char c = text[position++];
+        return c == '\\' ? escape(set) : static_cast<uint8_t>(c);
+    }
+
+    const std::string& text;
+    size_t position = 0;
+    int depth = 0;
+};
+
+//-------------------------------------------------------------------
+// Nfa - Thompson automaton of the syntax tree
+//-------------------------------------------------------------------
+struct NfaState {
+    enum Kind { BYTES, SPLIT, MATCH };
+
+    Kind kind;
+    int32_t next;           // BYTES and SPLIT
+    int32_t alternative;    // SPLIT
+    ByteSet bytes;          // BYTES
+};
+
+struct Nfa {
+    std::vector<NfaState> states;
+    int32_t start = 0;
+
+    // Bytes that no state tells apart share a class, and the DFA keeps one
+    // transition per class instead of per byte
+    uint8_t classOf[256] = {};
+    size_t classCount = 1;
+
+    int32_t add(NfaState state) {
+        if (states.size() >= REGEX_MAX_NFA_STATES) {
+            throw std::runtime_error("The pattern is too large; use smaller repeat counts.");
+        }
+        states.push_back(state);
+        return static_cast<int32_t>(states.size() - 1);
+    }
+
+    // Add the states of node, whose matches continue at next. Returns its entry.
+    int32_t compile(const RegexNode& node, int32_t next) {
+        switch (node.kind) {
+        case RegexNode::BYTES:
+            return add({ NfaState::BYTES, next, -1, node.bytes });
+
+        case RegexNode::CONCAT:
+            for (auto child = node.children.rbegin(); child != node.children.rend(); ++child) {
+                next = compile(*child, next);
+            }
+            return next;
+
+        case RegexNode::ALTERNATE: {
+            int32_t entry = compile(node.children.back(), next);
+            for (size_t i = node.children.size() - 1; i-- > 0;) {
+                int32_t branch = compile(node.children[i], next);
+                entry = add({ NfaState::SPLIT, branch, entry });
+            }
+            return entry;
+        }
+
+        case RegexNode::REPEAT: {
+            const RegexNode& body = node.children[0];
+            int32_t entry = next;
+            if (node.max < 0) {
+                int32_t loop = add({ NfaState::SPLIT, -1, next });
+                int32_t repeated = compile(body, loop);
+                states[loop].next = repeated;
+                entry = loop;
+            }
+            else {
+                // Each optional copy may stop early
+                for (int i = node.min; i < node.max; ++i) {
+                    int32_t repeated = compile(body, entry);
+                    entry = add({ NfaState::SPLIT, repeated, next });
+                }
+            }
+            for (int i = 0; i < node.min; ++i) {
+                entry = compile(body, entry);
+            }
+            return entry;
+        }
+        }
+        return next;
+    }
+
+    void buildClasses() {
+        for (const NfaState& state : states) {
+            if (state.kind != NfaState::BYTES) {
+                continue;
+            }
+
+            // Split every class by whether its bytes are in the set
+            int renumbered[512];
+            std::fill(std::begin(renumbered), std::end(renumbered), -1);
+            int count = 0;
+            for (int b = 0; b < 256; ++b) {
+                int key = classOf[b] * 2 + (state.bytes[b] ? 1 : 0);
+                if (renumbered[key] < 0) {
+                    renumbered[key] = count++;
+                }
+                classOf[b] = static_cast<uint8_t>(renumbered[key]);
+            }
+            classCount = count;
+        }
+    }
+
+    // Replace set with the states reachable from it without reading a byte,
+    // keeping only those that read one or match, in ascending order
+    void close(std::vector<int32_t>& set) const {
+        std::vector<int32_t> stack;
+        stack.swap(set);
+        std::vector<char> seen(states.size(), 0);
+
+        while (!stack.empty()) {
+            int32_t s = stack.back();
+            stack.pop_back();
+            if (seen[s]) {
+                continue;
+            }
+            seen[s] = 1;
+
+            if (states[s].kind == NfaState::SPLIT) {
+                stack.push_back(states[s].alternative);
+                stack.push_back(states[s].next);
+            }
+            else {
+                set.push_back(s);
+            }
+        }
+        std::sort(set.begin(), set.end());
+    }
+
+    // The states after reading byte from those in set. Without an anchor, a
+    // new match may also begin after every byte.
+    void step(const std::vector<int32_t>& set, uint8_t byte, bool unanchored, std::vector<int32_t>& next) const {
+        next.clear();
+        for (int32_t s : set) {
+            if (states[s].kind == NfaState::BYTES && states[s].bytes[byte]) {
+                next.push_back(states[s].next);
+            }
+        }
+        if (unanchored) {
+            next.push_back(start);
+        }
+        close(next);
+    }
+
+    bool accepts(const std::vector<int32_t>& set) const {
+        return std::any_of(set.begin(), set.end(), [this](int32_t s) { return states[s].kind == NfaState::MATCH; });
+    }
+};
+
+//-------------------------------------------------------------------
+// LazyDfa - subset construction on demand, shared by the search threads
+//-------------------------------------------------------------------
+// A state is handed out as the offset of its row in the transition table,
+// doubled, plus 1 if it accepts, so a step is one load and an add. Reading a
+// known transition takes no lock: a state's row and set are written under
+// the mutex before any transition to it is published.
+class LazyDfa {
+public:
+    static const int32_t FULL = -1;     // No room to cache the state
+    static const int32_t DEAD = 0;      // No match is possible any more
+
+    LazyDfa(const Nfa& nfa, bool unanchored)
+        : nfa(nfa), unanchored(unanchored),
+          capacity(std::clamp(REGEX_DFA_CACHE_BYTES / (nfa.classCount * sizeof(int32_t)), size_t(2), REGEX_MAX_DFA_STATES)),
+          table(new std::atomic<int32_t>[capacity * nfa.classCount]) {
+        for (size_t i = 0; i < capacity * nfa.classCount; ++i) {
+            table[i].store(i < nfa.classCount ? DEAD : UNKNOWN, std::memory_order_relaxed);
+        }
+
+        std::vector<int32_t> start(1, nfa.start);
+        nfa.close(start);
+        intern({});
+        startState = intern(std::move(start));
+    }
+
+    int32_t start() const { return startState; }
+
+    int32_t next(int32_t state, uint8_t byte) {
+        int32_t target = table[(state >> 1) + nfa.classOf[byte]].load(std::memory_order_acquire);
+        return target != UNKNOWN ? target : build(state, byte);
+    }
+
+    static bool accepting(int32_t state) { return (state & 1) != 0; }
+
+    // The NFA states of a state, to carry on without the cache
+    std::vector<int32_t> nfaStates(int32_t state) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *sets[(state >> 1) / nfa.classCount];
+    }
+
+private:
+    static const int32_t UNKNOWN = -2;
+
+    int32_t build(int32_t state, uint8_t byte) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::atomic<int32_t>& slot = table[(state >> 1) + nfa.classOf[byte]];
+        int32_t target = slot.load(std::memory_order_relaxed);
+        if (target != UNKNOWN) {
+            return target;
+        }
+
+        std::vector<int32_t> next;
+        nfa.step(*sets[(state >> 1) / nfa.classCount], byte, unanchored, next);
+        target = intern(std::move(next));
+        if (target != FULL) {
+            slot.store(target, std::memory_order_release);
+        }
+        return target;
+    }
+
+    int32_t intern(std::vector<int32_t>&& set) {
+        auto found = index.find(set);
+        if (found != index.end()) {
+            return found->second;
+        }
+        if (sets.size() >= capacity) {
+            return FULL;
+        }
+
+        int32_t row = static_cast<int32_t>(sets.size() * nfa.classCount);
+        int32_t state = row * 2 + (nfa.accepts(set) ? 1 : 0);
+        auto added = index.emplace(std::move(set), state).first;
+        sets.push_back(&added->first);
+        return state;
+    }
+
+    const Nfa& nfa;
+    bool unanchored;
+    size_t capacity;
+    std::unique_ptr<std::atomic<int32_t>[]> table;
+    int32_t startState = DEAD;
+    std::mutex mutex;
+    std::map<std::vector<int32_t>, int32_t> index;
+    std::vector<const std::vector<int32_t>*> sets;      // Keys of index, by row
+};
+
+//-------------------------------------------------------------------
+// RegexPattern
+//-------------------------------------------------------------------
+// The same pattern read from right to left
+static RegexNode reversed(const RegexNode& node) {
+    RegexNode result = node;
+    result.children.clear();
+    for (const RegexNode& child : node.children) {
+        result.children.push_back(reversed(child));
+    }
+    if (node.kind == RegexNode::CONCAT) {
+        std::reverse(result.children.begin(), result.children.end());
+    }
+    return result;
+}
+
+static Nfa compileNfa(const RegexNode& tree) {
+    Nfa nfa;
+    int32_t match = nfa.add({ NfaState::MATCH, -1, -1, ByteSet() });
+    nfa.start = nfa.compile(tree, match);
+    nfa.buildClasses();
+    return nfa;
+}
+
+struct RegexPattern::Program {
+    Program(Nfa forwardNfa, Nfa reverseNfa)
+        : forward(std::move(forwardNfa)), reverse(std::move(reverseNfa)),
+          anchored(forward, false), unanchored(forward, true), backward(reverse, true) {}
+
+    Nfa forward;
+    Nfa reverse;
+    LazyDfa anchored;       // One match from a given start
+    LazyDfa unanchored;     // Every start at once, to find where a match ends
+    LazyDfa backward;       // Every end at once, run backward to find starts
+
+    std::vector<uint8_t> prefix;
+    std::unique_ptr<BytePattern> prefixFinder;
+    bool firstBytes[256] = {};
+
+    // The first offset in [from, limit) where a match may start, or
+    // SEARCH_NO_MATCH
+    size_t nextCandidate(const uint8_t* data, size_t size, size_t from, size_t limit) const {
+        if (prefixFinder) {
+            return prefixFinder->find(data, size, from, limit).offset;
+        }
+        while (from < limit && !firstBytes[data[from]]) {
+            ++from;
+        }
+        return from < limit ? from : SEARCH_NO_MATCH;
+    }
+
+    // Length of the longest match at start, or 0. run is set to the number of
+    // bytes read.
+    size_t matchAt(const uint8_t* data, size_t size, size_t start, size_t& run) {
+        const size_t limit = std::min(size, start + REGEX_MAX_MATCH_LENGTH);
+        size_t length = 0;
+        size_t i = start;
+
+        int32_t state = anchored.start();
+        for (; i < limit; ++i) {
+            int32_t target = anchored.next(state, data[i]);
+            if (target == LazyDfa::FULL) {
+                break;
+            }
+            if (target == LazyDfa::DEAD) {
+                run = i + 1 - start;
+                return length;
+            }
+            state = target;
+            if (LazyDfa::accepting(state)) {
+                length = i + 1 - start;
+            }
+        }
+
+        if (i < limit) {
+            // Out of cache; simulate the rest
+            std::vector<int32_t> set = anchored.nfaStates(state), next;
+            for (; i < limit; ++i) {
+                forward.step(set, data[i], false, next);
+                if (next.empty()) {
+                    break;
+                }
+                set.swap(next);
+                if (forward.accepts(set)) {
+                    length = i + 1 - start;
+                }
+            }
+        }
+
+        run = i - start;
+        return length;
+    }
+
+    // The offset just past the first byte at which a match starting at from
+    // or later ends, reading no further than limit, or SEARCH_NO_MATCH
+    size_t firstMatchEnd(const uint8_t* data, size_t from, size_t limit) {
+        size_t i = from;
+        int32_t state = unanchored.start();
+        for (; i < limit; ++i) {
+            int32_t target = unanchored.next(state, data[i]);
+            if (target == LazyDfa::FULL) {
+                break;
+            }
+            state = target;
+            if (LazyDfa::accepting(state)) {
+                return i + 1;
+            }
+        }
+
+        if (i < limit) {
+            std::vector<int32_t> set = unanchored.nfaStates(state), next;
+            for (; i < limit; ++i) {
+                forward.step(set, data[i], true, next);
+                set.swap(next);
+                if (forward.accepts(set)) {
+                    return i + 1;
+                }
+            }
+        }
+        return SEARCH_NO_MATCH;
+    }
+
+    // Set starts[i - begin] for every offset i in [begin, limit) where a match
+    // ending at or before right starts
+    void markStarts(const uint8_t* data, size_t begin, size_t limit, size_t right, std::vector<char>& starts) {
+        size_t i = right;
+        int32_t state = backward.start();
+
+        // Bytes after limit only carry matches that start before it
+        while (i > limit) {
+            int32_t target = backward.next(state, data[--i]);
+            if (target == LazyDfa::FULL) {
+                markStartsSlowly(data, begin, limit, i, backward.nfaStates(state), starts);
+                return;
+            }
+            state = target;
+        }
+        while (i > begin) {
+            int32_t target = backward.next(state, data[--i]);
+            if (target == LazyDfa::FULL) {
+                markStartsSlowly(data, begin, limit, i, backward.nfaStates(state), starts);
+                return;
+            }
+            state = target;
+            starts[i - begin] = LazyDfa::accepting(state);
+        }
+    }
+
+    // markStarts without the cache, from the byte before right in state set
+    void markStartsSlowly(const uint8_t* data, size_t begin, size_t limit, size_t right,
+                          std::vector<int32_t> set, std::vector<char>& starts) const {
+        std::vector<int32_t> next;
+        for (size_t i = right + 1; i > begin;) {
+            reverse.step(set, data[--i], true, next);
+            set.swap(next);
+            if (i < limit) {
+                starts[i - begin] = reverse.accepts(set);
+            }
+        }
+    }
+};
+
+RegexPattern::RegexPattern(const std::string& text) {
+    if (text.empty()) {
+        throw std::runtime_error("Enter a pattern.");
+    }
+    RegexNode tree = RegexParser(text).parse();
+    program = std::make_unique<Program>(compileNfa(tree), compileNfa(reversed(tree)));
+
+    Program& p = *program;
+    const int32_t start = p.anchored.start();
+    if (LazyDfa::accepting(start)) {
+        throw std::runtime_error("The pattern can match no bytes at all, which would match at every offset.");
+    }
+
+    for (int b = 0; b < 256; ++b) {
+        p.firstBytes[b] = p.anchored.next(start, static_cast<uint8_t>(b)) != LazyDfa::DEAD;
+    }
+
+    // Follow the start while exactly one byte keeps a match possible and no
+    // match can end yet
+    int32_t state = start;
+    while (p.prefix.size() < REGEX_MAX_PREFIX && !LazyDfa::accepting(state)) {
+        int only = -1;
+        int32_t target = LazyDfa::DEAD;
+        for (int b = 0; b < 256 && only != -2; ++b) {
+            int32_t next = p.anchored.next(state, static_cast<uint8_t>(b));
+            if (next == LazyDfa::FULL || (next != LazyDfa::DEAD && only >= 0)) {
+                only = -2;
+            }
+            else if (next != LazyDfa::DEAD) {
+                only = b;
+                target = next;
+            }
+        }
+        if (only < 0) {
+            break;
+        }
+        p.prefix.push_back(static_cast<uint8_t>(only));
+        state = target;
+    }
+    if (!p.prefix.empty()) {
+        p.prefixFinder = std::make_unique<BytePattern>(p.prefix);
+    }
+}
+
+RegexPattern::~RegexPattern() = default;
+
+const std::vector<uint8_t>& RegexPattern::literalPrefix() const {
+    return program->prefix;
+}
+
+SearchHit RegexPattern::find(const uint8_t* data, size_t size, size_t begin, size_t end) const {
+    Program& p = *program;
+    const size_t limit = std::min(end, size);
+
+    size_t position = begin;
+    while (position < limit) {
+        position = p.nextCandidate(data, size, position, limit);
+        if (position == SEARCH_NO_MATCH) {
+            return NO_HIT;
+        }
+
+        size_t run;
+        if (size_t length = p.matchAt(data, size, position, run)) {
+            return { position, length };
+        }
+        if (run <= REGEX_SHORT_RUN) {
+            ++position;
+            continue;
+        }
+
+        // A long run failed, so the data may be full of near misses. Find
+        // where the next match ends: it starts no later than that, and
+        // neither does the leftmost match.
+        size_t matchEnd = p.firstMatchEnd(data, position + 1, std::min(size, limit - 1 + REGEX_MAX_MATCH_LENGTH));
+        if (matchEnd == SEARCH_NO_MATCH) {
+            return NO_HIT;
+        }
+
+        const size_t last = std::min(matchEnd, limit);
+        for (size_t start = p.nextCandidate(data, size, position + 1, last); start != SEARCH_NO_MATCH;
+             start = p.nextCandidate(data, size, start + 1, last)) {
+            if (size_t length = p.matchAt(data, size, start, run)) {
+                return { start, length };
+            }
+        }
+
+        // Only a match longer than REGEX_MAX_MATCH_LENGTH ends there
+        position = last;
+    }
+    return NO_HIT;
+}
+
+void RegexPattern::findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                           const std::function<bool(const SearchHit&)>& onMatch) const {
+    Program& p = *program;
+    if (p.prefixFinder) {
+        SearchPattern::findAll(data, size, begin, end, onMatch);
+        return;
+    }
+
+    const size_t limit = std::min(end, size);
+    if (begin >= limit) {
+        return;
+    }
+
+    std::vector<char> starts(limit - begin, 0);
+    p.markStarts(data, begin, limit, std::min(size, limit - 1 + REGEX_MAX_MATCH_LENGTH), starts);
+
+    for (size_t offset = begin; offset < limit;) {
+        const void* mark = memchr(&starts[offset - begin], 1, limit - offset);
+        if (!mark) {
+            return;
+        }
+        offset = begin + (static_cast<const char*>(mark) - starts.data());
+
+        size_t run;
+        size_t length = p.matchAt(data, size, offset, run);
+        if (length == 0) {
+            // Only a match longer than REGEX_MAX_MATCH_LENGTH starts here
+            ++offset;
+            continue;
+        }
+        if (!onMatch({ offset, length })) {
+            return;
+        }
+        offset += length;
+    }
+}
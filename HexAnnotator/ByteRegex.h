@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ByteSearch.h"
+
+// Longest match a RegexPattern finds, and so how far past the end of its
+// range a search may read. A match that would be longer is not found.
+const size_t REGEX_MAX_MATCH_LENGTH = 64 * 1024;
+
+// Size limits of a compiled pattern. DFA states are built as the data needs
+// them and cached, in a table of this many bytes per DFA, or this many states
+// if fewer. Once it is full, runs that need a new state fall back to
+// simulating the NFA, which gives the same matches more slowly.
+const size_t REGEX_MAX_NFA_STATES = 50000;
+const size_t REGEX_DFA_CACHE_BYTES = 2 * 1024 * 1024;
+const size_t REGEX_MAX_DFA_STATES = 65536;
+const int REGEX_MAX_REPEAT = 1000;
+
+//-------------------------------------------------------------------
+// RegexPattern - regular expression over raw bytes
+//-------------------------------------------------------------------
+// Characters stand for their own bytes, except for:
+//   .                  any byte
+//   [a-z\x80-\xFF]     a set of bytes; [^...] is its complement
+//   \xHH \n \r \t \0   a byte, and \ before punctuation quotes it
+//   \d \w \s           ASCII digits, word and space bytes; \D \W \S differ
+//   ( ) (?: ) |        grouping and alternatives
+//   * + ? {n} {n,} {n,m}
+// For example, a type-length-value record with a one-byte type and length
+// followed by printable text:   \x01[\x04-\x40][\x20-\x7E]{4,}
+//
+// A match is the longest one starting at the leftmost offset, and matches do
+// not overlap. A pattern that can match no bytes at all is rejected, as it
+// would match everywhere.
+//
+// A pattern whose matches all begin with the same literal bytes finds them
+// with BytePattern, and confirms each by running a DFA from it. Once a run has
+// gone a long way and failed, a second DFA that follows every start at once
+// finds where the next match ends before more starts are tried, so a region
+// without matches is read once rather than from every offset.
+//
+// Other patterns are searched a chunk at a time: the pattern reversed is run
+// backward over the chunk, marking every offset a match starts at without a
+// branch per byte, and the DFA is run only from the marks.
+class RegexPattern : public SearchPattern {
+public:
+    // Throws std::runtime_error describing the first problem
+    explicit RegexPattern(const std::string& text);
+    ~RegexPattern();
+
+    SearchHit find(const uint8_t* data, size_t size, size_t begin, size_t end) const override;
+    bool overlapping() const override { return false; }
+    void findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                 const std::function<bool(const SearchHit&)>& onMatch) const override;
+
+    // Bytes every match starts with; empty if there are none
+    const std::vector<uint8_t>& literalPrefix() const;
+
+private:
+    struct Program;
+    std::unique_ptr<Program> program;
+};
@@ -0,0 +1,840 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include "ByteSearch.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BYTE_SEARCH_SSE2
+#endif
+
+static const SearchHit NO_HIT = { SEARCH_NO_MATCH, 0 };
+
+#ifdef BYTE_SEARCH_SSE2
+// Two bytes of a pattern, each compared under a mask, tested for 32
+// consecutive starting positions at once
+class ProbePair {
+public:
+    ProbePair(size_t firstOffset, uint8_t firstValue, uint8_t firstMask,
+              size_t secondOffset, uint8_t secondValue, uint8_t secondMask)
+        : firstOffset(firstOffset), secondOffset(secondOffset),
+          firstValue(_mm_set1_epi8(static_cast<char>(firstValue))),
+          firstMask(_mm_set1_epi8(static_cast<char>(firstMask))),
+          secondValue(_mm_set1_epi8(static_cast<char>(secondValue))),
+          secondMask(_mm_set1_epi8(static_cast<char>(secondMask))) {}
+
+    // Bit i is set if both probes match for a pattern starting at p + i
+    unsigned candidates(const uint8_t* p) const {
+        return match16(p) | match16(p + 16) << 16;
+    }
+
+private:
+    unsigned match16(const uint8_t* p) const {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + firstOffset));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + secondOffset));
+        __m128i matched = _mm_and_si128(
+            _mm_cmpeq_epi8(_mm_and_si128(a, firstMask), firstValue),
+            _mm_cmpeq_epi8(_mm_and_si128(b, secondMask), secondValue));
+        return static_cast<unsigned>(_mm_movemask_epi8(matched));
+    }
+
+    size_t firstOffset;
+    size_t secondOffset;
+    __m128i firstValue;
+    __m128i firstMask;
+    __m128i secondValue;
+    __m128i secondMask;
+};
+#endif
+
+//-------------------------------------------------------------------
+// SearchPattern
+//-------------------------------------------------------------------
+void SearchPattern::findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                            const std::function<bool(const SearchHit&)>& onMatch) const {
+    const bool overlaps = overlapping();
+    for (size_t from = begin; from < end;) {
+        SearchHit hit = find(data, size, from, end);
+        if (hit.offset == SEARCH_NO_MATCH || !onMatch(hit)) {
+            return;
+        }
+        from = hit.offset + (overlaps ? 1 : std::max<size_t>(hit.length, 1));
+    }
+}
+
+//-------------------------------------------------------------------
+// BytePattern
+//-------------------------------------------------------------------
+static bool isCommonByte(uint8_t b) {
+    return b == 0x00 || b == 0xFF;
+}
+
+BytePattern::BytePattern(std::vector<uint8_t> bytes) : pattern(std::move(bytes)) {
+    if (pattern.empty()) {
+        throw std::runtime_error("The search pattern is empty.");
+    }
+    const size_t n = pattern.size();
+
+    // Move the probes inward to rarer bytes, keeping them apart; a pattern
+    // of nothing but common bytes keeps its ends
+    firstProbe = 0;
+    secondProbe = n - 1;
+    while (firstProbe + 1 < secondProbe && isCommonByte(pattern[firstProbe])) {
+        ++firstProbe;
+    }
+    while (secondProbe > firstProbe + 1 && isCommonByte(pattern[secondProbe])) {
+        --secondProbe;
+    }
+    if (isCommonByte(pattern[firstProbe]) && isCommonByte(pattern[secondProbe])) {
+        firstProbe = 0;
+        secondProbe = n - 1;
+    }
+
+    // Horspool shifts: how far the last byte of a window is from the last
+    // occurrence of the same byte in the pattern, excluding its final byte
+    std::fill(std::begin(skip), std::end(skip), n);
+    for (size_t i = 0; i + 1 < n; ++i) {
+        skip[pattern[i]] = n - 1 - i;
+    }
+}
+
+SearchHit BytePattern::find(const uint8_t* data, size_t size, size_t begin, size_t end) const {
+    const size_t n = pattern.size();
+    if (size < n) {
+        return NO_HIT;
+    }
+
+    // Matches start before limit
+    const size_t limit = std::min(end, size - n + 1);
+    if (begin >= limit) {
+        return NO_HIT;
+    }
+
+    if (n == 1) {
+        const void* hit = memchr(data + begin, pattern[0], limit - begin);
+        return hit ? SearchHit{ static_cast<size_t>(static_cast<const uint8_t*>(hit) - data), 1 } : NO_HIT;
+    }
+
+    size_t position = begin;
+#ifdef BYTE_SEARCH_SSE2
+    // Every candidate in a step is a valid start, so the loads stay inside
+    // the data
+    const ProbePair probes(firstProbe, pattern[firstProbe], 0xFF, secondProbe, pattern[secondProbe], 0xFF);
+    for (; position + 32 <= limit; position += 32) {
+        unsigned mask = probes.candidates(data + position);
+        while (mask != 0) {
+            size_t candidate = position + std::countr_zero(mask);
+            if (memcmp(data + candidate, pattern.data(), n) == 0) {
+                return { candidate, n };
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    size_t hit = findHorspool(data, position, limit);
+    return hit == SEARCH_NO_MATCH ? NO_HIT : SearchHit{ hit, n };
+}
+
+size_t BytePattern::findHorspool(const uint8_t* data, size_t begin, size_t limit) const {
+    const size_t n = pattern.size();
+    const uint8_t last = pattern[n - 1];
+
+    for (size_t position = begin; position < limit; position += skip[data[position + n - 1]]) {
+        if (data[position + n - 1] == last && memcmp(data + position, pattern.data(), n - 1) == 0) {
+            return position;
+        }
+    }
+    return SEARCH_NO_MATCH;
+}
+
+static int hexDigitValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::vector<uint8_t> ParseHexBytes(const std::string& text) {
+    std::vector<uint8_t> bytes;
+    int high = -1;
+
+    for (char c : text) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (high >= 0) {
+                throw std::runtime_error("Each byte needs two hex digits.");
+            }
+            continue;
+        }
+
+        int value = hexDigitValue(c);
+        if (value < 0) {
+            throw std::runtime_error(std::string("'") + c + "' is not a hex digit.");
+        }
+        if (high < 0) {
+            high = value;
+        }
+        else {
+            bytes.push_back(static_cast<uint8_t>((high << 4) | value));
+            high = -1;
+        }
+    }
+
+    if (high >= 0) {
+        throw std::runtime_error("Each byte needs two hex digits.");
+    }
+    if (bytes.empty()) {
+        throw std::runtime_error("Enter at least one byte.");
+    }
+    return bytes;
+}
+
+//-------------------------------------------------------------------
+// WildcardPattern
+//-------------------------------------------------------------------
+static bool maskedEqual(const uint8_t* p, const std::vector<uint8_t>& bytes, const std::vector<uint8_t>& mask) {
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        if ((p[i] & mask[i]) != bytes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// How far a byte compared under mask narrows down the candidates
+static int selectivity(uint8_t value, uint8_t mask) {
+    int bits = std::popcount(mask);
+    return mask == 0xFF && isCommonByte(value) ? bits / 2 : bits;
+}
+
+// "[n]" or "[n-m]", without the brackets
+static void parseGap(const std::string& text, size_t& minGap, size_t& maxGap) {
+    auto number = [&text](size_t& i, size_t& value) {
+        size_t start = i;
+        value = 0;
+        while (i < text.size() && isdigit(static_cast<unsigned char>(text[i]))) {
+            value = std::min(value * 10 + (text[i++] - '0'), SEARCH_MAX_GAP + 1);
+        }
+        return i > start;
+    };
+
+    size_t i = 0;
+    bool valid = number(i, minGap);
+    maxGap = minGap;
+    if (valid && i < text.size() && text[i] == '-') {
+        valid = number(++i, maxGap);
+    }
+    if (!valid || i != text.size()) {
+        throw std::runtime_error("'[" + text + "]' is not a gap; write [n] or [n-m].");
+    }
+    if (maxGap > SEARCH_MAX_GAP) {
+        throw std::runtime_error("Gaps can be at most " + std::to_string(SEARCH_MAX_GAP) + " bytes.");
+    }
+    if (minGap > maxGap) {
+        throw std::runtime_error("'[" + text + "]' ends before it starts.");
+    }
+}
+
+WildcardPattern::WildcardPattern(const std::string& text) {
+    segments.emplace_back();
+
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (isspace(static_cast<unsigned char>(c))) {
+            ++i;
+            continue;
+        }
+
+        if (c == '[') {
+            size_t close = text.find(']', i);
+            if (close == std::string::npos) {
+                throw std::runtime_error("A gap is missing its ']'.");
+            }
+            size_t minGap, maxGap;
+            parseGap(text.substr(i + 1, close - i - 1), minGap, maxGap);
+            i = close + 1;
+
+            Segment& last = segments.back();
+            if (minGap == maxGap) {
+                // Fixed gaps are wildcard bytes
+                last.bytes.insert(last.bytes.end(), minGap, 0);
+                last.mask.insert(last.mask.end(), minGap, 0);
+            }
+            else if (segments.size() == 1 && last.bytes.empty()) {
+                throw std::runtime_error("A pattern cannot start with a variable gap.");
+            }
+            else if (last.bytes.empty()) {
+                // Consecutive gaps add up
+                last.minGap += minGap;
+                last.maxGap += maxGap;
+                if (last.maxGap > SEARCH_MAX_GAP) {
+                    throw std::runtime_error("Gaps can be at most " + std::to_string(SEARCH_MAX_GAP) + " bytes.");
+                }
+            }
+            else {
+                segments.emplace_back();
+                segments.back().minGap = minGap;
+                segments.back().maxGap = maxGap;
+            }
+            continue;
+        }
+
+        // Two digits, either of which may be '?', then an optional "/mask"
+        if (i + 1 >= text.size()) {
+            throw std::runtime_error("Each byte needs two hex digits.");
+        }
+        uint8_t value = 0;
+        uint8_t mask = 0;
+        for (int digit = 0; digit < 2; ++digit, ++i) {
+            int shift = digit == 0 ? 4 : 0;
+            if (text[i] == '?') {
+                continue;
+            }
+            int nibble = hexDigitValue(text[i]);
+            if (nibble < 0) {
+                throw std::runtime_error(std::string("'") + text[i] + "' is not a hex digit or '?'.");
+            }
+            value |= static_cast<uint8_t>(nibble << shift);
+            mask |= static_cast<uint8_t>(0xF << shift);
+        }
+        if (i < text.size() && text[i] == '/') {
+            int high = i + 1 < text.size() ? hexDigitValue(text[i + 1]) : -1;
+            int low = i + 2 < text.size() ? hexDigitValue(text[i + 2]) : -1;
+            if (high < 0 || low < 0) {
+                throw std::runtime_error("A mask after '/' needs two hex digits.");
+            }
+            mask &= static_cast<uint8_t>((high << 4) | low);
+            i += 3;
+        }
+
+        segments.back().bytes.push_back(value & mask);
+        segments.back().mask.push_back(mask);
+    }
+
+    if (segments.size() == 1 && segments[0].bytes.empty()) {
+        throw std::runtime_error("Enter at least one byte.");
+    }
+    if (segments.back().bytes.empty()) {
+        throw std::runtime_error("A pattern cannot end with a variable gap.");
+    }
+
+    for (const Segment& segment : segments) {
+        minLength += segment.minGap + segment.bytes.size();
+    }
+
+    // The most selective byte of the first segment, then the next most
+    // selective, as far from it as possible
+    const Segment& head = segments[0];
+    auto score = [&head](size_t i) { return selectivity(head.bytes[i], head.mask[i]); };
+    firstProbe = 0;
+    for (size_t i = 1; i < head.bytes.size(); ++i) {
+        if (score(i) > score(firstProbe)) {
+            firstProbe = i;
+        }
+    }
+    if (score(firstProbe) == 0) {
+        throw std::runtime_error("The bytes before the first variable gap cannot all be wildcards.");
+    }
+
+    secondProbe = firstProbe;
+    auto distance = [this](size_t i) { return i > firstProbe ? i - firstProbe : firstProbe - i; };
+    for (size_t i = 0; i < head.bytes.size(); ++i) {
+        if (i == firstProbe || score(i) == 0) {
+            continue;
+        }
+        if (secondProbe == firstProbe || score(i) > score(secondProbe)
+            || (score(i) == score(secondProbe) && distance(i) > distance(secondProbe))) {
+            secondProbe = i;
+        }
+    }
+}
+
+SearchHit WildcardPattern::find(const uint8_t* data, size_t size, size_t begin, size_t end) const {
+    if (size < minLength) {
+        return NO_HIT;
+    }
+
+    // Matches start before limit
+    const size_t limit = std::min(end, size - minLength + 1);
+    const Segment& head = segments[0];
+    size_t position = begin;
+
+#ifdef BYTE_SEARCH_SSE2
+    // The probes lie in the first segment, within the shortest match, so the
+    // loads stay inside the data as for BytePattern
+    const ProbePair probes(firstProbe, head.bytes[firstProbe], head.mask[firstProbe],
+                           secondProbe, head.bytes[secondProbe], head.mask[secondProbe]);
+    for (; position + 32 <= limit; position += 32) {
+        unsigned mask = probes.candidates(data + position);
+        while (mask != 0) {
+            size_t candidate = position + std::countr_zero(mask);
+            if (size_t length = matchLength(data, size, candidate)) {
+                return { candidate, length };
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; position < limit; ++position) {
+        const uint8_t* p = data + position;
+        if ((p[firstProbe] & head.mask[firstProbe]) != head.bytes[firstProbe]
+            || (p[secondProbe] & head.mask[secondProbe]) != head.bytes[secondProbe]) {
+            continue;
+        }
+        if (size_t length = matchLength(data, size, position)) {
+            return { position, length };
+        }
+    }
+    return NO_HIT;
+}
+
+size_t WildcardPattern::matchLength(const uint8_t* data, size_t size, size_t start) const {
+    if (!maskedEqual(data + start, segments[0].bytes, segments[0].mask)) {
+        return 0;
+    }
+    if (segments.size() == 1) {
+        return segments[0].bytes.size();
+    }
+
+    // Every offset, ascending, where the segment so far can begin. Each is
+    // reachable from an earlier segment and its gap, and the bytes match.
+    std::vector<size_t> reached(1, start);
+    std::vector<size_t> next;
+    size_t following = minLength - segments[0].bytes.size();
+
+    for (size_t s = 1; s < segments.size(); ++s) {
+        const size_t previousLength = segments[s - 1].bytes.size();
+        const Segment& segment = segments[s];
+
+        // The shortest rest of the pattern after this segment must still fit
+        following -= segment.minGap + segment.bytes.size();
+        size_t first = reached.front() + previousLength + segment.minGap;
+        size_t last = std::min(reached.back() + previousLength + segment.maxGap,
+                               size - following - segment.bytes.size());
+
+        next.clear();
+        size_t from = 0;
+        for (size_t offset = first; offset <= last; ++offset) {
+            while (reached[from] + previousLength + segment.maxGap < offset) {
+                ++from;
+            }
+            if (reached[from] + previousLength + segment.minGap <= offset
+                && maskedEqual(data + offset, segment.bytes, segment.mask)) {
+                next.push_back(offset);
+            }
+        }
+        if (next.empty()) {
+            return 0;
+        }
+        reached.swap(next);
+    }
+
+    return reached.front() + segments.back().bytes.size() - start;
+}
+
+std::shared_ptr<const SearchPattern> ParseSearchPattern(const std::string& text) {
+    if (text.find_first_of("?/[") == std::string::npos) {
+        return std::make_shared<BytePattern>(ParseHexBytes(text));
+    }
+    return std::make_shared<WildcardPattern>(text);
+}
+
+//-------------------------------------------------------------------
+// DocumentSearch
+//-------------------------------------------------------------------
+DocumentSearch::DocumentSearch(std::shared_ptr<const SearchPattern> pattern, const uint8_t* data, size_t size)
+    : pattern(std::move(pattern)), data(data), size(size),
+      chunkCount((size + SEARCH_CHUNK_SIZE - 1) / SEARCH_CHUNK_SIZE),
+      pending(chunkCount), chunkDone(chunkCount, 0) {}
+
+DocumentSearch::~DocumentSearch() {
+    cancel();
+    wait();
+}
+
+void DocumentSearch::start(std::function<void()> onProgress) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (started) {
+            return;
+        }
+        started = true;
+    }
+
+    this->onProgress = std::move(onProgress);
+    WorkerPool::shared().submit([this] { run(); });
+}
+
+void DocumentSearch::acknowledge() {
+    notified = false;
+}
+
+void DocumentSearch::cancel() {
+    cancelRequested = true;
+    stopRequested = true;
+}
+
+void DocumentSearch::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !started || exited; });
+}
+
+bool DocumentSearch::finished() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete;
+}
+
+bool DocumentSearch::truncated() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hitLimit;
+}
+
+size_t DocumentSearch::searchedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::min(size, publishedChunks * SEARCH_CHUNK_SIZE);
+}
+
+size_t DocumentSearch::matchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return results.size();
+}
+
+std::vector<SearchHit> DocumentSearch::matches(size_t first, size_t count) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    first = std::min(first, results.size());
+    count = std::min(count, results.size() - first);
+    return std::vector<SearchHit>(results.begin() + first, results.begin() + first + count);
+}
+
+void DocumentSearch::notify() {
+    if (onProgress && !notified.exchange(true)) {
+        onProgress();
+    }
+}
+
+void DocumentSearch::run() {
+    WorkerPool::shared().parallelFor(chunkCount, [this](size_t chunk) {
+        searchChunk(chunk);
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        complete = true;
+    }
+    notified = false;
+    notify();
+
+    // Nothing may touch the search after this; the destructor may be waiting
+    std::lock_guard<std::mutex> lock(mutex);
+    exited = true;
+    done.notify_all();
+}
+
+// Search one chunk, then publish every finished chunk that no longer has an
+// unfinished one before it
+void DocumentSearch::searchChunk(size_t chunk) {
+    std::vector<SearchHit> hits;
+    if (!stopRequested) {
+        size_t begin = chunk * SEARCH_CHUNK_SIZE;
+        size_t end = std::min(begin + SEARCH_CHUNK_SIZE, size);
+        pattern->findAll(data, size, begin, end, [&](const SearchHit& hit) {
+            hits.push_back(hit);
+            return hits.size() < SEARCH_MAX_MATCHES && !stopRequested;
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[chunk] = std::move(hits);
+        chunkDone[chunk] = 1;
+
+        while (publishedChunks < chunkCount && chunkDone[publishedChunks]) {
+            std::vector<SearchHit>& part = pending[publishedChunks];
+            if (!pattern->overlapping() && !stopRequested) {
+                resynchronize(publishedChunks, part);
+            }
+            size_t room = SEARCH_MAX_MATCHES - results.size();
+            if (part.size() >= room) {
+                part.resize(room);
+                if (!hitLimit) {
+                    hitLimit = true;
+                    stopRequested = true;
+                }
+            }
+            results.insert(results.end(), part.begin(), part.end());
+            std::vector<SearchHit>().swap(part);
+            ++publishedChunks;
+        }
+    }
+    notify();
+}
+
+// Correct the matches of a chunk about to be published if the last match
+// published runs into it
+void DocumentSearch::resynchronize(size_t chunk, std::vector<SearchHit>& hits) const {
+    if (results.empty()) {
+        return;
+    }
+    size_t from = results.back().offset + std::max<size_t>(results.back().length, 1);
+    size_t begin = chunk * SEARCH_CHUNK_SIZE;
+    size_t end = std::min(begin + SEARCH_CHUNK_SIZE, size);
+    if (from <= begin) {
+        return;
+    }
+
+    // Search from the end of that match until a match agrees with the
+    // chunk's own; the matches after it follow from it alike
+    std::vector<SearchHit> corrected;
+    size_t agreed = 0;
+    while (true) {
+        SearchHit hit = from < end ? pattern->find(data, size, from, end) : NO_HIT;
+        if (hit.offset == SEARCH_NO_MATCH) {
+            agreed = hits.size();
+            break;
+        }
+        while (agreed < hits.size() && hits[agreed].offset < hit.offset) {
+            ++agreed;
+        }
+        if (agreed < hits.size() && hits[agreed].offset == hit.offset) {
+            break;
+        }
+        corrected.push_back(hit);
+        from = hit.offset + std::max<size_t>(hit.length, 1);
+    }
+
+    corrected.insert(corrected.end(), hits.begin() + agreed, hits.end());
+    hits = std::move(corrected);
+}
+
+//-------------------------------------------------------------------
+// SearchCursor
+//-------------------------------------------------------------------
+// Matches starting in [begin, end), up to limit of them. Returns how far the
+// matches found cover: end, or just past the last one if limit stopped it.
+static size_t scanForward(const SearchPattern& pattern, const uint8_t* data, size_t size,
+                          size_t begin, size_t end, size_t limit, std::vector<SearchHit>& hits) {
+    size_t from = begin;
+    while (from < end && hits.size() < limit) {
+        SearchHit hit = pattern.find(data, size, from, end);
+        if (hit.offset == SEARCH_NO_MATCH) {
+            return end;
+        }
+        hits.push_back(hit);
+        from = hit.offset + 1;
+    }
+    return std::min(from, end);
+}
+
+// The last limit matches starting in [begin, end). Returns where the matches
+// kept cover from: begin, or the first one kept if earlier ones were dropped.
+static size_t scanBackward(const SearchPattern& pattern, const uint8_t* data, size_t size,
+                           size_t begin, size_t end, size_t limit, std::deque<SearchHit>& hits) {
+    bool dropped = false;
+    size_t from = begin;
+    while (from < end) {
+        SearchHit hit = pattern.find(data, size, from, end);
+        if (hit.offset == SEARCH_NO_MATCH) {
+            break;
+        }
+        hits.push_back(hit);
+        if (hits.size() > limit) {
+            hits.pop_front();
+            dropped = true;
+        }
+        from = hit.offset + 1;
+    }
+    return dropped ? hits.front().offset : begin;
+}
+
+static bool hitBefore(const SearchHit& hit, size_t offset) {
+    return hit.offset < offset;
+}
+
+SearchCursor::SearchCursor(std::shared_ptr<const SearchPattern> pattern, const uint8_t* data, size_t size)
+    : pattern(std::move(pattern)), data(data), size(size) {}
+
+SearchCursor::~SearchCursor() {
+    stopLookahead();
+}
+
+void SearchCursor::rebind(const uint8_t* data, size_t size) {
+    if (data == this->data && size == this->size) {
+        return;
+    }
+
+    stopLookahead();
+    std::lock_guard<std::mutex> lock(mutex);
+    this->data = data;
+    this->size = size;
+    stopping = false;
+    replaceWindow(0);
+}
+
+SearchHit SearchCursor::next(size_t from) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (from < low || from > high) {
+        replaceWindow(from);
+    }
+
+    while (true) {
+        auto it = std::lower_bound(window.begin(), window.end(), from, hitBefore);
+        if (it != window.end()) {
+            SearchHit hit = *it;
+            position = hit.offset;
+            trimWindow();
+            wake();
+            return hit;
+        }
+        if (high >= size) {
+            return NO_HIT;
+        }
+
+        // Search on from the end of the window. The lookahead may grow it
+        // meanwhile, but only with matches before the one found here.
+        const size_t begin = high;
+        const uint64_t started = generation;
+        lock.unlock();
+        SearchHit hit = pattern->find(data, size, begin, size);
+        lock.lock();
+        if (generation != started) {
+            return hit;
+        }
+        if (hit.offset == SEARCH_NO_MATCH) {
+            high = size;
+        }
+        else if (high <= hit.offset) {
+            window.push_back(hit);
+            high = hit.offset + 1;
+        }
+    }
+}
+
+SearchHit SearchCursor::previous(size_t before) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (before < low || before > high) {
+        replaceWindow(before);
+    }
+
+    while (true) {
+        auto it = std::lower_bound(window.begin(), window.end(), before, hitBefore);
+        if (it != window.begin()) {
+            SearchHit hit = *--it;
+            position = hit.offset;
+            trimWindow();
+            wake();
+            return hit;
+        }
+        if (low == 0) {
+            return NO_HIT;
+        }
+
+        // Search back from the start of the window in growing spans until
+        // there is a match
+        const size_t end = low;
+        const uint64_t started = generation;
+        lock.unlock();
+        std::deque<SearchHit> hits;
+        size_t covered = end;
+        for (size_t span = SEARCH_CHUNK_SIZE / 16; hits.empty() && covered > 0; span = std::min(span * 2, 16 * SEARCH_CHUNK_SIZE)) {
+            size_t begin = covered > span ? covered - span : 0;
+            covered = scanBackward(*pattern, data, size, begin, covered, SEARCH_LOOKAHEAD, hits);
+        }
+        lock.lock();
+        if (generation != started) {
+            return hits.empty() ? NO_HIT : hits.back();
+        }
+        if (covered < low) {
+            while (!hits.empty() && hits.back().offset >= low) {
+                hits.pop_back();
+            }
+            window.insert(window.begin(), hits.begin(), hits.end());
+            low = covered;
+        }
+    }
+}
+
+// Start the lookahead unless it is running. Called with the lock held.
+void SearchCursor::wake() {
+    if (!running && !stopping) {
+        running = true;
+        WorkerPool::shared().submit([this] { lookAhead(); });
+    }
+}
+
+void SearchCursor::stopLookahead() {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopping = true;
+    idle.wait(lock, [this] { return !running; });
+}
+
+// Start an empty window at offset. Called with the lock held.
+void SearchCursor::replaceWindow(size_t offset) {
+    ++generation;
+    window.clear();
+    low = high = position = std::min(offset, size);
+}
+
+// Drop matches beyond SEARCH_LOOKAHEAD on either side of position. Called
+// with the lock held.
+void SearchCursor::trimWindow() {
+    auto it = std::lower_bound(window.begin(), window.end(), position, hitBefore);
+    size_t behind = it - window.begin();
+    for (; behind > SEARCH_LOOKAHEAD; --behind) {
+        low = window.front().offset + 1;
+        window.pop_front();
+    }
+    // Past the match at position itself
+    while (window.size() - behind > SEARCH_LOOKAHEAD + 1) {
+        high = window.back().offset;
+        window.pop_back();
+    }
+}
+
+// Grow the window one chunk at a time, ahead first, until both sides are
+// full or the document ends
+void SearchCursor::lookAhead() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        auto it = std::lower_bound(window.begin(), window.end(), position, hitBefore);
+        const size_t behind = it - window.begin();
+        const size_t ahead = window.size() - behind;
+        const uint64_t started = generation;
+
+        if (ahead <= SEARCH_LOOKAHEAD && high < size) {
+            const size_t begin = high;
+            const size_t end = begin + std::min(SEARCH_CHUNK_SIZE, size - begin);
+            lock.unlock();
+            std::vector<SearchHit> hits;
+            size_t covered = scanForward(*pattern, data, size, begin, end, SEARCH_LOOKAHEAD + 1 - ahead, hits);
+            lock.lock();
+            if (generation == started && high == begin) {
+                window.insert(window.end(), hits.begin(), hits.end());
+                high = covered;
+            }
+        }
+        else if (behind < SEARCH_LOOKAHEAD && low > 0) {
+            const size_t end = low;
+            const size_t begin = end - std::min(SEARCH_CHUNK_SIZE, end);
+            lock.unlock();
+            std::deque<SearchHit> hits;
+            size_t covered = scanBackward(*pattern, data, size, begin, end, SEARCH_LOOKAHEAD - behind, hits);
+            lock.lock();
+            if (generation == started && low == end) {
+                window.insert(window.begin(), hits.begin(), hits.end());
+                low = covered;
+            }
+        }
+        else {
+            break;
+        }
+    }
+
+    // Nothing may touch the cursor after this; the destructor may be waiting
+    running = false;
+    idle.notify_all();
+}
@@ -0,0 +1,256 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Searching a document for byte patterns. A SearchPattern finds matches in a
+// range of the bytes; DocumentSearch runs one over the whole document in
+// parallel chunks in the background and hands out the matches in offset
+// order while the rest of the document is still being searched, and
+// SearchCursor steps from one match to the next.
+
+// Documents are searched in chunks of this many bytes. Small enough that
+// cancelling takes effect quickly and the first match arrives early.
+const size_t SEARCH_CHUNK_SIZE = 1024 * 1024;
+
+// A search stops once it has this many matches
+const size_t SEARCH_MAX_MATCHES = 1000000;
+
+const size_t SEARCH_NO_MATCH = SIZE_MAX;
+
+struct SearchHit {
+    size_t offset;      // SEARCH_NO_MATCH if there was none
+    size_t length;
+};
+
+class SearchPattern {
+public:
+    virtual ~SearchPattern() = default;
+
+    // The first match starting in [begin, end), or SEARCH_NO_MATCH. Matches
+    // may extend past end; bytes up to data + size may be read to find them.
+    // The match found at a given offset must not depend on begin.
+    virtual SearchHit find(const uint8_t* data, size_t size, size_t begin, size_t end) const = 0;
+
+    // Whether a match may start inside the previous one. If not, the search
+    // resumes after the end of each match.
+    virtual bool overlapping() const { return true; }
+
+    // Report the matches starting in [begin, end) in order, as repeated calls
+    // to find would, until onMatch returns false. Patterns that can find
+    // them together faster than one at a time override it.
+    virtual void findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                         const std::function<bool(const SearchHit&)>& onMatch) const;
+};
+
+//-------------------------------------------------------------------
+// BytePattern - exact byte string
+//-------------------------------------------------------------------
+// Candidates are found 32 positions at a time by comparing two probe bytes of
+// the pattern, as memchr does for one, and then compared in full. The probes
+// are the first and last bytes unless those are 00 or FF, which dominate
+// binary files and make poor filters. Without SSE2, and for the last few
+// positions, Boyer-Moore-Horspool is used instead.
+class BytePattern : public SearchPattern {
+public:
+    // Throws std::runtime_error if bytes is empty
+    explicit BytePattern(std::vector<uint8_t> bytes);
+
+    SearchHit find(const uint8_t* data, size_t size, size_t begin, size_t end) const override;
+
+    const std::vector<uint8_t>& bytes() const { return pattern; }
+
+private:
+    size_t findHorspool(const uint8_t* data, size_t begin, size_t limit) const;
+
+    std::vector<uint8_t> pattern;
+    size_t firstProbe = 0;
+    size_t secondProbe = 0;
+    size_t skip[256];
+};
+
+// Bytes written as hex pairs, such as "4D 5A 90 00" or "4d5a9000". Throws
+// std::runtime_error describing the first problem.
+std::vector<uint8_t> ParseHexBytes(const std::string& text);
+
+// Longest variable gap a WildcardPattern may contain
+const size_t SEARCH_MAX_GAP = 4096;
+
+//-------------------------------------------------------------------
+// WildcardPattern - bytes with don't-care bits and variable gaps
+//-------------------------------------------------------------------
+// Written as hex pairs where either digit may be '?'. A byte followed by
+// "/mask" compares only the mask's bits, and "[n]" or "[n-m]" skips n, or n
+// to m, bytes of anything:   4D 5A ?? ?? 50 45   A? 0F   40/F0 [2-8] FF
+//
+// The pattern is split into segments at the variable gaps. Candidates are
+// found as BytePattern finds them, by the two most selective bytes of the
+// first segment, and then verified; each later segment is tried at every
+// offset its gap allows. A match is the shortest one from its start.
+class WildcardPattern : public SearchPattern {
+public:
+    // Throws std::runtime_error describing the first problem
+    explicit WildcardPattern(const std::string& text);
+
+    SearchHit find(const uint8_t* data, size_t size, size_t begin, size_t end) const override;
+
+    size_t minimumLength() const { return minLength; }
+
+private:
+    struct Segment {
+        size_t minGap = 0;      // Bytes skipped before the segment, 0 for the first
+        size_t maxGap = 0;
+        std::vector<uint8_t> bytes;
+        std::vector<uint8_t> mask;
+    };
+
+    // Length of the shortest match starting at start, or 0 if there is none
+    size_t matchLength(const uint8_t* data, size_t size, size_t start) const;
+
+    std::vector<Segment> segments;
+    size_t minLength = 0;
+    size_t firstProbe = 0;      // Offsets in the first segment
+    size_t secondProbe = 0;
+};
+
+// A BytePattern for plain hex bytes, or a WildcardPattern if the text has
+// wildcards, masks or gaps. Throws std::runtime_error.
+std::shared_ptr<const SearchPattern> ParseSearchPattern(const std::string& text);
+
+//-------------------------------------------------------------------
+// DocumentSearch - background search of a whole document
+//-------------------------------------------------------------------
+// Chunks are claimed in ascending order by the shared worker pool. A chunk's
+// matches are published once every chunk before it is done, so matches()
+// only ever grows at the end and the first match is available as soon as it
+// and everything before it has been searched.
+//
+// Without overlapping matches, each chunk is searched from its own start,
+// which is wrong if a match from the chunk before runs into it. Such a chunk
+// is searched again at publication, from the end of that match, until it
+// finds a match the chunk found too; from there on the two agree.
+class DocumentSearch {
+public:
+    // data must stay valid until the search is finished or destroyed
+    DocumentSearch(std::shared_ptr<const SearchPattern> pattern, const uint8_t* data, size_t size);
+
+    // Cancels the search and waits for it
+    ~DocumentSearch();
+
+    DocumentSearch(const DocumentSearch&) = delete;
+    DocumentSearch& operator=(const DocumentSearch&) = delete;
+
+    // Start searching on the worker pool. onProgress is called from a worker
+    // when matches are published and when the search finishes, and not again
+    // until acknowledge() is called, so it can post a window message without
+    // flooding the queue.
+    void start(std::function<void()> onProgress);
+
+    // Re-arm onProgress; call before reading the results it announced
+    void acknowledge();
+
+    void cancel();
+    void wait();
+
+    bool finished() const;
+    bool cancelled() const { return cancelRequested; }
+    bool truncated() const;     // Stopped at SEARCH_MAX_MATCHES
+
+    // Bytes searched and published so far
+    size_t searchedBytes() const;
+
+    size_t matchCount() const;
+    // Up to count published matches from index first
+    std::vector<SearchHit> matches(size_t first, size_t count) const;
+
+private:
+    void run();
+    void searchChunk(size_t chunk);
+    void resynchronize(size_t chunk, std::vector<SearchHit>& hits) const;
+    void notify();
+
+    std::shared_ptr<const SearchPattern> pattern;
+    const uint8_t* data;
+    size_t size;
+    size_t chunkCount;
+    std::function<void()> onProgress;
+
+    std::atomic<bool> cancelRequested{ false };
+    std::atomic<bool> stopRequested{ false };     // Cancelled or truncated
+    std::atomic<bool> notified{ false };
+
+    mutable std::mutex mutex;
+    std::condition_variable done;
+    bool started = false;
+    bool complete = false;
+    bool exited = false;        // run() no longer touches the search
+    bool hitLimit = false;
+    size_t publishedChunks = 0;
+    std::vector<std::vector<SearchHit>> pending;    // Finished chunks not yet published
+    std::vector<char> chunkDone;
+    std::vector<SearchHit> results;
+};
+
+// Matches a SearchCursor keeps ready on each side of the last one it handed out
+const size_t SEARCH_LOOKAHEAD = 64;
+
+//-------------------------------------------------------------------
+// SearchCursor - find next and find previous without rescanning
+//-------------------------------------------------------------------
+// Holds every match starting in a window [low, high) of the document, in
+// order, around the match last handed out. A task on the shared worker pool
+// grows the window a chunk at a time, ahead and behind, until it holds
+// SEARCH_LOOKAHEAD matches on each side or reaches the ends of the document,
+// so stepping through matches is a lookup. Stepping past the window searches
+// on from its edge; jumping elsewhere starts a new window there.
+//
+// The matches are those find() reports at each offset, so stepping backwards
+// meets the same ones as stepping forwards, and they may overlap.
+class SearchCursor {
+public:
+    // data must stay valid until the cursor is destroyed or rebound
+    SearchCursor(std::shared_ptr<const SearchPattern> pattern, const uint8_t* data, size_t size);
+
+    // Stops the lookahead and waits for it
+    ~SearchCursor();
+
+    SearchCursor(const SearchCursor&) = delete;
+    SearchCursor& operator=(const SearchCursor&) = delete;
+
+    // Forget every match unless the document is still data and size
+    void rebind(const uint8_t* data, size_t size);
+
+    // The first match starting at or after from, or the last one starting
+    // before before; offset SEARCH_NO_MATCH if there is none. Blocks only
+    // while searching beyond the window.
+    SearchHit next(size_t from);
+    SearchHit previous(size_t before);
+
+private:
+    void lookAhead();
+    void wake();
+    void stopLookahead();
+    void replaceWindow(size_t offset);
+    void trimWindow();
+
+    std::shared_ptr<const SearchPattern> pattern;
+    const uint8_t* data;
+    size_t size;
+
+    std::mutex mutex;
+    std::condition_variable idle;
+    bool running = false;       // A lookahead task is queued or running
+    bool stopping = false;
+    uint64_t generation = 0;    // Changed whenever the window is replaced
+    std::deque<SearchHit> window;
+    size_t low = 0;
+    size_t high = 0;
+    size_t position = 0;        // Offset the window is kept around
+};
@@ -0,0 +1,434 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include "ChecksumFields.h"
+#include "Hashing.h"
+#include "WorkerPool.h"
+
+// A verification task takes fields until it has this many covered bytes or
+// CHECKSUM_FIELDS_PER_TASK fields, so one large field does not hold up many
+// small ones
+const size_t CHECKSUM_BYTES_PER_TASK = 4 * 1024 * 1024;
+const size_t CHECKSUM_FIELDS_PER_TASK = 1024;
+
+// The byte sum is not in Hashing.h; it takes the next value after its algorithms
+const int CHECKSUM_SUM = HASH_ALGORITHM_COUNT;
+
+// Parallel to CHECKSUM_ALGORITHM_NAMES
+struct ChecksumAlgorithm {
+    int kind;           // HashAlgorithm or CHECKSUM_SUM
+    bool integer;       // Stored in the declared byte order
+};
+
+const ChecksumAlgorithm CHECKSUM_ALGORITHMS[] = {
+    { HASH_CRC32, true },
+    { HASH_CRC32C, true },
+    { HASH_ADLER32, true },
+    { HASH_XXH64, true },
+    { CHECKSUM_SUM, true },
+    { HASH_MD5, false },
+    { HASH_SHA1, false },
+    { HASH_SHA256, false },
+};
+static_assert(std::size(CHECKSUM_ALGORITHMS) == std::size(CHECKSUM_ALGORITHM_NAMES));
+
+static const ChecksumAlgorithm* findAlgorithm(const std::string& name) {
+    for (size_t i = 0; i < std::size(CHECKSUM_ALGORITHM_NAMES); ++i) {
+        if (name == CHECKSUM_ALGORITHM_NAMES[i]) {
+            return &CHECKSUM_ALGORITHMS[i];
+        }
+    }
+    return nullptr;
+}
+
+const std::vector<std::string>& ChecksumAlgorithmNames() {
+    static const std::vector<std::string> names(std::begin(CHECKSUM_ALGORITHM_NAMES), std::end(CHECKSUM_ALGORITHM_NAMES));
+    return names;
+}
+
+void CheckChecksumAlgorithm(const std::string& algorithm) {
+    if (!findAlgorithm(algorithm)) {
+        throw std::runtime_error("'" + algorithm + "' is not a checksum algorithm.");
+    }
+}
+
+//-------------------------------------------------------------------
+// Checksum table
+//-------------------------------------------------------------------
+struct ChecksumPair {
+    int field;
+    int covered = -1;                                   // Annotation index, or -1 if no such label
+    int nextReader = -1;                                // Next pair with the same covered label
+    std::shared_ptr<const ChecksumField> declaration;
+
+    // Extents the status was verified with
+    int fieldStart = -1;
+    int fieldEnd = -1;
+    int coveredStart = -1;
+    int coveredEnd = -1;
+
+    ChecksumStatus status = CHECKSUM_ERROR;
+    std::string detail;     // Expected value of a mismatch, or the error
+};
+
+// A label some fields cover. The fields naming it are chained through
+// ChecksumPair::nextReader; the key views the covered label of one of them.
+struct CoveredLabel {
+    int index = -1;         // First annotation with the label, or -1
+    int firstReader = -1;
+};
+
+struct ChecksumTable {
+    std::vector<ChecksumPair> pairs;
+    std::vector<int> pairOf;                                    // Annotation index -> pair, or -1
+    std::vector<int> readersOf;                                 // Annotation index -> first pair covering it, or -1
+    std::unordered_map<std::string_view, CoveredLabel> labels;
+};
+
+static ChecksumTable& tableOf(DocumentWindowState& state) {
+    if (!state.checksumTable) {
+        state.checksumTable = std::make_shared<ChecksumTable>();
+    }
+    return *state.checksumTable;
+}
+
+static bool verifiedAsIs(const DocumentWindowState& state, const ChecksumPair& pair) {
+    const Annotation& field = state.annotations[pair.field];
+    if (field.startOffset != pair.fieldStart || field.endOffset != pair.fieldEnd) {
+        return false;
+    }
+    if (pair.covered < 0) {
+        return pair.coveredStart < 0;
+    }
+    const Annotation& covered = state.annotations[pair.covered];
+    return covered.startOffset == pair.coveredStart && covered.endOffset == pair.coveredEnd;
+}
+
+//-------------------------------------------------------------------
+// Verification
+//-------------------------------------------------------------------
+// Most significant byte first, as Hasher::finish gives them
+static std::vector<uint8_t> computeChecksum(const ChecksumAlgorithm& algorithm, const uint8_t* data, size_t size, size_t width) {
+    if (algorithm.kind == CHECKSUM_SUM) {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += data[i];
+        }
+        std::vector<uint8_t> digest(width);
+        for (size_t i = 0; i < width; ++i) {
+            digest[width - 1 - i] = static_cast<uint8_t>(sum >> (8 * i));
+        }
+        return digest;
+    }
+
+    std::unique_ptr<Hasher> hasher = CreateHasher(static_cast<HashAlgorithm>(algorithm.kind));
+    hasher->update(data, size);
+    return hasher->finish();
+}
+
+static size_t digestSize(const ChecksumAlgorithm& algorithm) {
+    switch (algorithm.kind) {
+    case HASH_XXH64: return 8;
+    case HASH_MD5: return 16;
+    case HASH_SHA1: return 20;
+    case HASH_SHA256: return 32;
+    default: return 4;
+    }
+}
+
+static std::string displayName(const ChecksumAlgorithm& algorithm, bool capital = true) {
+    if (algorithm.kind == CHECKSUM_SUM) {
+        return capital ? "The byte sum" : "byte sum";
+    }
+    return HashName(static_cast<HashAlgorithm>(algorithm.kind));
+}
+
+static void verifyPair(const DocumentWindowState& state, ChecksumPair& pair) {
+    const Annotation& field = state.annotations[pair.field];
+    pair.fieldStart = field.startOffset;
+    pair.fieldEnd = field.endOffset;
+    pair.coveredStart = pair.covered < 0 ? -1 : state.annotations[pair.covered].startOffset;
+    pair.coveredEnd = pair.covered < 0 ? -1 : state.annotations[pair.covered].endOffset;
+    pair.status = CHECKSUM_ERROR;
+
+    const ChecksumAlgorithm* algorithm = findAlgorithm(pair.declaration->algorithm);
+    if (!algorithm) {
+        pair.detail = "'" + pair.declaration->algorithm + "' is not a checksum algorithm.";
+        return;
+    }
+    if (pair.covered < 0) {
+        pair.detail = "No annotation is labelled '" + pair.declaration->covered + "'.";
+        return;
+    }
+
+    const size_t width = static_cast<size_t>(field.endOffset - field.startOffset) + 1;
+    if (algorithm->kind == CHECKSUM_SUM ? (width != 1 && width != 2 && width != 4 && width != 8) : width != digestSize(*algorithm)) {
+        pair.detail = algorithm->kind == CHECKSUM_SUM
+            ? "A byte sum field must be 1, 2, 4 or 8 bytes long."
+            : displayName(*algorithm) + " takes " + std::to_string(digestSize(*algorithm)) + " bytes, not " + std::to_string(width) + ".";
+        return;
+    }
+
+    const uint8_t* data = state.fileData.data();
+    std::vector<uint8_t> expected = computeChecksum(*algorithm, data + pair.coveredStart,
+        static_cast<size_t>(pair.coveredEnd - pair.coveredStart) + 1, width);
+    if (algorithm->integer && !pair.declaration->bigEndian) {
+        std::reverse(expected.begin(), expected.end());
+    }
+
+    if (std::equal(expected.begin(), expected.end(), data + field.startOffset)) {
+        pair.status = CHECKSUM_MATCH;
+        pair.detail.clear();
+    }
+    else {
+        pair.status = CHECKSUM_MISMATCH;
+        pair.detail = DigestText(expected);
+    }
+}
+
+// Verifies the listed pairs across the worker pool
+static void verifyPairs(const DocumentWindowState& state, ChecksumTable& table, const std::vector<int>& ids) {
+    std::vector<size_t> taskStarts;
+    size_t bytes = 0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (taskStarts.empty() || bytes >= CHECKSUM_BYTES_PER_TASK || i - taskStarts.back() >= CHECKSUM_FIELDS_PER_TASK) {
+            taskStarts.push_back(i);
+            bytes = 0;
+        }
+        const ChecksumPair& pair = table.pairs[ids[i]];
+        if (pair.covered >= 0) {
+            const Annotation& covered = state.annotations[pair.covered];
+            bytes += static_cast<size_t>(covered.endOffset - covered.startOffset) + 1;
+        }
+    }
+    taskStarts.push_back(ids.size());
+
+    WorkerPool::shared().parallelFor(taskStarts.size() - 1, [&](size_t task) {
+        for (size_t i = taskStarts[task]; i < taskStarts[task + 1]; ++i) {
+            verifyPair(state, table.pairs[ids[i]]);
+        }
+    });
+}
+
+//-------------------------------------------------------------------
+// VerifyAllChecksums
+//-------------------------------------------------------------------
+void VerifyAllChecksums(DocumentWindowState& state) {
+    ChecksumTable& table = tableOf(state);
+    ChecksumTable previous = std::move(table);
+    table = ChecksumTable();
+
+    const auto& annotations = state.annotations;
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        if (annotations[i].checksum) {
+            if (table.pairs.empty()) {
+                table.pairOf.assign(annotations.size(), -1);
+                table.pairs.reserve(previous.pairs.size());
+            }
+            table.pairOf[i] = static_cast<int>(table.pairs.size());
+            table.pairs.push_back({ static_cast<int>(i) });
+            table.pairs.back().declaration = annotations[i].checksum;
+        }
+    }
+    if (table.pairs.empty()) {
+        return;
+    }
+
+    // Chain the fields by the label they cover, in reverse so each chain
+    // runs in annotation order
+    table.labels.reserve(table.pairs.size());
+    for (size_t id = table.pairs.size(); id-- > 0;) {
+        ChecksumPair& pair = table.pairs[id];
+        CoveredLabel& label = table.labels[pair.declaration->covered];
+        pair.nextReader = label.firstReader;
+        label.firstReader = static_cast<int>(id);
+    }
+
+    table.readersOf.assign(annotations.size(), -1);
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        auto it = table.labels.find(annotations[i].label);
+        if (it != table.labels.end() && it->second.index < 0) {
+            it->second.index = static_cast<int>(i);
+            table.readersOf[i] = it->second.firstReader;
+            for (int id = it->second.firstReader; id >= 0; id = table.pairs[id].nextReader) {
+                table.pairs[id].covered = static_cast<int>(i);
+            }
+        }
+    }
+
+    // Results that still apply, by what they were verified with. Fields
+    // usually keep their index, so the pair there is tried first and the map
+    // is only built for the rest.
+    using Key = std::tuple<const void*, int, int, int, int>;
+    std::map<Key, int> verified;
+    auto keyOf = [](const ChecksumPair& pair) {
+        return Key{ pair.declaration.get(), pair.fieldStart, pair.fieldEnd, pair.coveredStart, pair.coveredEnd };
+    };
+
+    std::vector<int> pending;
+    for (size_t id = 0; id < table.pairs.size(); ++id) {
+        ChecksumPair& pair = table.pairs[id];
+        pair.fieldStart = annotations[pair.field].startOffset;
+        pair.fieldEnd = annotations[pair.field].endOffset;
+        pair.coveredStart = pair.covered < 0 ? -1 : annotations[pair.covered].startOffset;
+        pair.coveredEnd = pair.covered < 0 ? -1 : annotations[pair.covered].endOffset;
+
+        ChecksumPair* before = nullptr;
+        int previousId = pair.field < static_cast<int>(previous.pairOf.size()) ? previous.pairOf[pair.field] : -1;
+        if (previousId >= 0 && keyOf(previous.pairs[previousId]) == keyOf(pair)) {
+            before = &previous.pairs[previousId];
+        }
+        else if (!previous.pairs.empty()) {
+            if (verified.empty()) {
+                for (size_t i = 0; i < previous.pairs.size(); ++i) {
+                    verified.emplace(keyOf(previous.pairs[i]), static_cast<int>(i));
+                }
+            }
+            auto it = verified.find(keyOf(pair));
+            if (it != verified.end()) {
+                before = &previous.pairs[it->second];
+            }
+        }
+
+        if (before) {
+            pair.status = before->status;
+            pair.detail = std::move(before->detail);
+        }
+        else {
+            pending.push_back(static_cast<int>(id));
+        }
+    }
+
+    verifyPairs(state, table, pending);
+}
+
+//-------------------------------------------------------------------
+// VerifyAppendedChecksums
+//-------------------------------------------------------------------
+void VerifyAppendedChecksums(DocumentWindowState& state, size_t firstIndex) {
+    const auto& annotations = state.annotations;
+    ChecksumTable& table = tableOf(state);
+
+    // A new field may cover any annotation, so its label has to be looked up
+    // everywhere
+    if (std::any_of(annotations.begin() + firstIndex, annotations.end(), [](const Annotation& anno) { return anno.checksum != nullptr; })) {
+        VerifyAllChecksums(state);
+        return;
+    }
+    if (table.pairs.empty()) {
+        return;
+    }
+
+    table.pairOf.resize(annotations.size(), -1);
+    table.readersOf.resize(annotations.size(), -1);
+    std::vector<int> pending;
+    for (size_t i = firstIndex; i < annotations.size(); ++i) {
+        auto it = table.labels.find(annotations[i].label);
+        if (it == table.labels.end() || it->second.index >= 0) {
+            continue;
+        }
+
+        // The first annotation with a label fields were missing
+        it->second.index = static_cast<int>(i);
+        table.readersOf[i] = it->second.firstReader;
+        for (int id = it->second.firstReader; id >= 0; id = table.pairs[id].nextReader) {
+            table.pairs[id].covered = static_cast<int>(i);
+            pending.push_back(id);
+        }
+    }
+
+    verifyPairs(state, table, pending);
+}
+
+//-------------------------------------------------------------------
+// VerifyEditedChecksums
+//-------------------------------------------------------------------
+void VerifyEditedChecksums(DocumentWindowState& state, const std::vector<int>& edited) {
+    const auto& annotations = state.annotations;
+    ChecksumTable& table = tableOf(state);
+
+    std::vector<int> pending;
+    for (int index : edited) {
+        if (index < 0 || index >= static_cast<int>(annotations.size())) {
+            continue;
+        }
+        if (table.pairs.empty()) {
+            if (annotations[index].checksum) {
+                VerifyAllChecksums(state);
+                return;
+            }
+            continue;
+        }
+
+        const Annotation& anno = annotations[index];
+        const int id = index < static_cast<int>(table.pairOf.size()) ? table.pairOf[index] : -1;
+        if (id < 0 ? anno.checksum != nullptr : table.pairs[id].declaration != anno.checksum) {
+            VerifyAllChecksums(state);
+            return;
+        }
+
+        // A relabelled annotation may stop or start being the one covered
+        const int firstReader = index < static_cast<int>(table.readersOf.size()) ? table.readersOf[index] : -1;
+        if (firstReader >= 0 && table.pairs[firstReader].declaration->covered != anno.label) {
+            VerifyAllChecksums(state);
+            return;
+        }
+        auto covered = table.labels.find(anno.label);
+        if (covered != table.labels.end() && (covered->second.index < 0 || covered->second.index > index)) {
+            VerifyAllChecksums(state);
+            return;
+        }
+
+        if (id >= 0) {
+            pending.push_back(id);
+        }
+        for (int reader = firstReader; reader >= 0; reader = table.pairs[reader].nextReader) {
+            pending.push_back(reader);
+        }
+    }
+
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+    pending.erase(std::remove_if(pending.begin(), pending.end(),
+        [&](int id) { return verifiedAsIs(state, table.pairs[id]); }), pending.end());
+    verifyPairs(state, table, pending);
+}
+
+//-------------------------------------------------------------------
+// Queries
+//-------------------------------------------------------------------
+static const ChecksumPair* findPair(const DocumentWindowState& state, size_t index) {
+    const ChecksumTable* table = state.checksumTable.get();
+    if (!table || index >= table->pairOf.size() || table->pairOf[index] < 0) {
+        return nullptr;
+    }
+    return &table->pairs[table->pairOf[index]];
+}
+
+ChecksumStatus GetChecksumStatus(const DocumentWindowState& state, size_t index) {
+    const ChecksumPair* pair = findPair(state, index);
+    return pair ? pair->status : CHECKSUM_NONE;
+}
+
+std::string ChecksumStatusText(const DocumentWindowState& state, size_t index) {
+    const ChecksumPair* pair = findPair(state, index);
+    if (!pair) {
+        return std::string();
+    }
+
+    const ChecksumAlgorithm* algorithm = findAlgorithm(pair->declaration->algorithm);
+    switch (pair->status) {
+    case CHECKSUM_MATCH:
+        return displayName(*algorithm) + " of '" + pair->declaration->covered + "' matches.";
+    case CHECKSUM_MISMATCH:
+        return "The field should hold the bytes " + pair->detail + " for the " +
+            displayName(*algorithm, false) + " of '" + pair->declaration->covered + "'.";
+    default:
+        return pair->detail;
+    }
+}
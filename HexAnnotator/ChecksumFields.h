@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "includes.h"
+
+// A checksum field holds one of these over the bytes of the annotation its
+// ChecksumField names:
+//
+//   crc32 crc32c adler32 xxh64   integers, in the declared byte order
+//   sum                           the bytes added up, truncated to the
+//                                 field's 1, 2, 4 or 8 bytes
+//   md5 sha1 sha256               digests, as written
+//
+// A covered label that occurs more than once refers to its first annotation,
+// as in computed expressions.
+//
+// The document's bytes never change, so a result stands until the extent of
+// the field or of the covered annotation changes, or the declaration does.
+// Only those fields are verified again, in a batch spread across the worker
+// pool.
+
+// Algorithm names, in the order the checksum dialog lists them. Inline so
+// that AnnotationFile.cpp can validate .hva files without linking the
+// verifier, as HexCatalog does.
+inline const char* const CHECKSUM_ALGORITHM_NAMES[] = {
+    "crc32", "crc32c", "adler32", "xxh64", "sum", "md5", "sha1", "sha256",
+};
+
+inline bool IsChecksumAlgorithm(std::string_view name) {
+    for (const char* algorithm : CHECKSUM_ALGORITHM_NAMES) {
+        if (name == algorithm) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<std::string>& ChecksumAlgorithmNames();
+
+// Throws std::runtime_error unless algorithm is one of the names
+void CheckChecksumAlgorithm(const std::string& algorithm);
+
+enum ChecksumStatus {
+    CHECKSUM_NONE,      // Not a checksum field
+    CHECKSUM_MATCH,
+    CHECKSUM_MISMATCH,
+    CHECKSUM_ERROR      // Could not be verified; see ChecksumStatusText
+};
+
+// Resolves every checksum field and verifies those not verified as they are
+// now. For when the byte map is rebuilt: on open, undo, removal and so on.
+void VerifyAllChecksums(DocumentWindowState& state);
+
+// Verifies checksum fields appended from firstIndex onward, and earlier
+// fields whose covered label they are the first to carry
+void VerifyAppendedChecksums(DocumentWindowState& state, size_t firstIndex);
+
+// Verifies the checksum fields among the edited annotations and those that
+// cover them. Falls back to VerifyAllChecksums if a declaration or a covered
+// label changed.
+void VerifyEditedChecksums(DocumentWindowState& state, const std::vector<int>& edited);
+
+ChecksumStatus GetChecksumStatus(const DocumentWindowState& state, size_t index);
+
+// "CRC-32 matches.", the value expected on a mismatch, or why the field
+// could not be verified; empty for other annotations
+std::string ChecksumStatusText(const DocumentWindowState& state, size_t index);
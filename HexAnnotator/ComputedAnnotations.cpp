@@ -0,0 +1,943 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include "ComputedAnnotations.h"
+
+// Deepest operand stack an expression may need
+const int EXPRESSION_STACK_DEPTH = 64;
+
+//-------------------------------------------------------------------
+// Expressions
+//-------------------------------------------------------------------
+struct ExprOp {
+    enum Kind {
+        Constant, Reference, Negate, Complement,
+        Add, Subtract, Multiply, Divide, Modulo,
+        And, Or, Xor, ShiftLeft, ShiftRight
+    };
+    enum Field { Value, Start, End, Length };
+
+    Kind kind;
+    long long value = 0;    // Constant
+    int slot = 0;           // Reference: index into the node's inputs
+    Field field = Value;    // Reference
+};
+
+// Compiled to postfix so evaluation is a single loop over a fixed-size stack
+struct Expression {
+    std::vector<ExprOp> ops;
+
+    bool empty() const { return ops.empty(); }
+};
+
+// Recursive descent over the usual C precedence levels. Referenced labels
+// are collected into names; Reference ops index into that list.
+class ExpressionParser {
+public:
+    ExpressionParser(const std::string& text, std::vector<std::string>& names)
+        : text(text), names(names) {}
+
+    Expression parse() {
+        Expression expression;
+        out = &expression.ops;
+
+        parseLevel(0);
+        skipSpace();
+        if (pos < text.size()) {
+            fail(std::string("unexpected '") + text[pos] + "'");
+        }
+        if (maxDepth > EXPRESSION_STACK_DEPTH) {
+            fail("expression is nested too deeply");
+        }
+        return expression;
+    }
+
+private:
+    static const int UNARY_LEVEL = 6;
+
+    [[noreturn]] void fail(const std::string& message) const {
+        throw std::runtime_error("Expression column " + std::to_string(pos + 1) + ": " + message + ".");
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+    }
+
+    bool accept(const char* token) {
+        skipSpace();
+        size_t length = strlen(token);
+        if (text.compare(pos, length, token) != 0) {
+            return false;
+        }
+        pos += length;
+        return true;
+    }
+
+    void emit(ExprOp op) {
+        if (op.kind == ExprOp::Constant || op.kind == ExprOp::Reference) {
+            maxDepth = std::max(maxDepth, ++depth);
+        }
+        else if (op.kind != ExprOp::Negate && op.kind != ExprOp::Complement) {
+            --depth;
+        }
+        out->push_back(op);
+    }
+
+    // Matches a binary operator of the given precedence level
+    bool acceptOperator(int level, ExprOp::Kind& kind) {
+        switch (level) {
+        case 0: if (accept("|")) { kind = ExprOp::Or; return true; } break;
+        case 1: if (accept("^")) { kind = ExprOp::Xor; return true; } break;
+        case 2: if (accept("&")) { kind = ExprOp::And; return true; } break;
+        case 3:
+            if (accept("<<")) { kind = ExprOp::ShiftLeft; return true; }
+            if (accept(">>")) { kind = ExprOp::ShiftRight; return true; }
+            break;
+        case 4:
+            if (accept("+")) { kind = ExprOp::Add; return true; }
+            if (accept("-")) { kind = ExprOp::Subtract; return true; }
+            break;
+        case 5:
+            if (accept("*")) { kind = ExprOp::Multiply; return true; }
+            if (accept("/")) { kind = ExprOp::Divide; return true; }
+            if (accept("%")) { kind = ExprOp::Modulo; return true; }
+            break;
+        }
+        return false;
+    }
+
+    void parseLevel(int level) {
+        if (level == UNARY_LEVEL) {
+            parseUnary();
+            return;
+        }
+
+        parseLevel(level + 1);
+        ExprOp::Kind kind;
+        while (acceptOperator(level, kind)) {
+            parseLevel(level + 1);
+            emit({ kind });
+        }
+    }
+
+    void parseUnary() {
+        // Every parenthesis and unary operator passes through here
+        if (++nesting > EXPRESSION_STACK_DEPTH) {
+            fail("expression is nested too deeply");
+        }
+
+        if (accept("-")) {
+            parseUnary();
+            emit({ ExprOp::Negate });
+        }
+        else if (accept("~")) {
+            parseUnary();
+            emit({ ExprOp::Complement });
+        }
+        else if (accept("+")) {
+            parseUnary();
+        }
+        else {
+            parsePrimary();
+        }
+        --nesting;
+    }
+
+    void parsePrimary() {
+        skipSpace();
+        if (pos >= text.size()) {
+            fail("expression ends early");
+        }
+
+        char c = text[pos];
+        if (c == '(') {
+            ++pos;
+            parseLevel(0);
+            if (!accept(")")) {
+                fail("expected ')'");
+            }
+        }
+        else if (isdigit(static_cast<unsigned char>(c))) {
+            parseNumber();
+        }
+        else if (c == '{') {
+            parseReference();
+        }
+        else {
+            fail("expected a number, '(' or {label}");
+        }
+    }
+
+    void parseNumber() {
+        int base = 10;
+        if (text[pos] == '0' && pos + 1 < text.size() && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) {
+            base = 16;
+            pos += 2;
+        }
+
+        unsigned long long value = 0;
+        size_t start = pos;
+        while (pos < text.size() && isxdigit(static_cast<unsigned char>(text[pos]))) {
+            char c = text[pos];
+            int digit = isdigit(static_cast<unsigned char>(c)) ? c - '0' : toupper(c) - 'A' + 10;
+            if (digit >= base) {
+                break;
+            }
+            value = value * base + digit;
+            ++pos;
+        }
+
+        if (pos == start || (pos < text.size() && isalnum(static_cast<unsigned char>(text[pos])))) {
+            fail("malformed number");
+        }
+        emit({ ExprOp::Constant, static_cast<long long>(value) });
+    }
+
+    void parseReference() {
+        size_t close = text.find('}', pos + 1);
+        if (close == std::string::npos) {
+            fail("missing '}'");
+        }
+
+        std::string label = text.substr(pos + 1, close - pos - 1);
+        label.erase(0, label.find_first_not_of(" \t"));
+        label.erase(label.find_last_not_of(" \t") + 1);
+        if (label.empty()) {
+            fail("empty label");
+        }
+        pos = close + 1;
+
+        ExprOp op{ ExprOp::Reference };
+        if (pos < text.size() && text[pos] == '.') {
+            size_t start = ++pos;
+            while (pos < text.size() && isalpha(static_cast<unsigned char>(text[pos]))) ++pos;
+            std::string field = text.substr(start, pos - start);
+
+            if (field == "value") op.field = ExprOp::Value;
+            else if (field == "start") op.field = ExprOp::Start;
+            else if (field == "end") op.field = ExprOp::End;
+            else if (field == "length") op.field = ExprOp::Length;
+            else fail("unknown field '" + field + "', expected start, end, length or value");
+        }
+
+        auto existing = std::find(names.begin(), names.end(), label);
+        op.slot = static_cast<int>(existing - names.begin());
+        if (existing == names.end()) {
+            names.push_back(std::move(label));
+        }
+        emit(op);
+    }
+
+    const std::string& text;
+    std::vector<std::string>& names;
+    std::vector<ExprOp>* out = nullptr;
+    size_t pos = 0;
+    int depth = 0;
+    int maxDepth = 0;
+    int nesting = 0;
+};
+
+void CheckComputedExpression(const std::string& text) {
+    std::vector<std::string> names;
+    ExpressionParser(text, names).parse();
+}
+
+//-------------------------------------------------------------------
+// Dependency graph
+//-------------------------------------------------------------------
+struct ComputedNode {
+    int annotation;
+    Expression start;
+    Expression length;
+    Expression value;
+    std::vector<std::string> names;     // Referenced labels, by slot
+    std::vector<int> inputs;            // Annotation index per slot
+
+    int rank = INT_MAX;                 // Position in a topological order
+    bool queued = false;
+    bool broken = false;                // Never evaluated: syntax, reference or cycle error
+    long long result = 0;
+    std::string error;                  // Shown in place of the value when set
+    std::string detail;
+};
+
+struct ComputedGraph {
+    std::vector<ComputedNode> nodes;
+    std::vector<int> nodeOf;                                // Annotation index -> node, or -1
+    std::unordered_map<std::string, int> labelIndex;        // First annotation with each label
+    std::unordered_map<int, std::vector<int>> dependents;   // Annotation index -> nodes reading it
+    int nextRank = 0;
+    size_t evaluations = 0;                                 // Nodes evaluated, for ComputedEvaluationCount
+
+    // Changes noted since the last evaluation
+    std::vector<int> dirty;
+    std::vector<int> unresolved;                            // Broken by an erased label
+    size_t appendedFrom = SIZE_MAX;
+    bool needsRebuild = true;
+};
+
+static ComputedGraph& graphOf(DocumentWindowState& state) {
+    if (!state.computedGraph) {
+        state.computedGraph = std::make_shared<ComputedGraph>();
+    }
+    return *state.computedGraph;
+}
+
+static bool hasExpressions(const Annotation& anno) {
+    return anno.computed &&
+        (!anno.computed->start.empty() || !anno.computed->length.empty() || !anno.computed->value.empty());
+}
+
+static void compileNode(ComputedGraph& graph, const Annotation& anno, int index) {
+    ComputedNode node;
+    node.annotation = index;
+
+    try {
+        const ComputedFields& fields = *anno.computed;
+        if (!fields.start.empty()) node.start = ExpressionParser(fields.start, node.names).parse();
+        if (!fields.length.empty()) node.length = ExpressionParser(fields.length, node.names).parse();
+        if (!fields.value.empty()) node.value = ExpressionParser(fields.value, node.names).parse();
+    }
+    catch (const std::exception& e) {
+        node.broken = true;
+        node.error = "#SYNTAX";
+        node.detail = e.what();
+    }
+
+    graph.nodeOf[index] = static_cast<int>(graph.nodes.size());
+    graph.nodes.push_back(std::move(node));
+}
+
+static void resolveNode(ComputedGraph& graph, int id) {
+    ComputedNode& node = graph.nodes[id];
+    if (node.broken) {
+        return;
+    }
+
+    for (const auto& name : node.names) {
+        auto it = graph.labelIndex.find(name);
+        if (it == graph.labelIndex.end()) {
+            node.broken = true;
+            node.error = "#REF";
+            node.detail = name;
+            node.inputs.clear();
+            return;
+        }
+        node.inputs.push_back(it->second);
+    }
+
+    for (int input : node.inputs) {
+        graph.dependents[input].push_back(id);
+    }
+}
+
+// Kahn's algorithm over nodes [first, end). Older nodes are already ranked
+// and never read newer ones. Whatever cannot be ranked sits on or below a cycle.
+static void rankNodes(ComputedGraph& graph, size_t first) {
+    size_t count = graph.nodes.size() - first;
+    std::vector<int> pending(count, 0);
+    std::vector<int> ready;
+
+    for (size_t i = 0; i < count; ++i) {
+        for (int input : graph.nodes[first + i].inputs) {
+            if (graph.nodeOf[input] >= static_cast<int>(first)) {
+                ++pending[i];
+            }
+        }
+        if (pending[i] == 0) {
+            ready.push_back(static_cast<int>(first + i));
+        }
+    }
+
+    while (!ready.empty()) {
+        int id = ready.back();
+        ready.pop_back();
+        graph.nodes[id].rank = graph.nextRank++;
+
+        auto it = graph.dependents.find(graph.nodes[id].annotation);
+        if (it == graph.dependents.end()) {
+            continue;
+        }
+        for (int dependent : it->second) {
+            if (dependent >= static_cast<int>(first) && --pending[dependent - first] == 0) {
+                ready.push_back(dependent);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        ComputedNode& node = graph.nodes[first + i];
+        if (node.rank == INT_MAX && !node.broken) {
+            node.broken = true;
+            node.error = "#CYCLE";
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+// Evaluation
+//-------------------------------------------------------------------
+// Little-endian integer in the annotation's first 8 bytes, sign-extended for "int"
+static long long decodeValue(const DocumentWindowState& state, const Annotation& anno) {
+    int length = std::min(anno.endOffset - anno.startOffset + 1, 8);
+    unsigned long long value = 0;
+    for (int i = length - 1; i >= 0; --i) {
+        value = (value << 8) | state.fileData[anno.startOffset + i];
+    }
+
+    if (anno.displayFormat == "int" && length < 8 && (value >> (length * 8 - 1)) & 1) {
+        value |= ~0ULL << (length * 8);
+    }
+    return static_cast<long long>(value);
+}
+
+// Arithmetic wraps rather than overflowing. Returns an error code, or nullptr.
+static const char* evaluate(const Expression& expression, const ComputedNode& node,
+    const ComputedGraph& graph, const DocumentWindowState& state, long long& result) {
+    unsigned long long stack[EXPRESSION_STACK_DEPTH];
+    int top = 0;
+
+    for (const ExprOp& op : expression.ops) {
+        switch (op.kind) {
+        case ExprOp::Constant:
+            stack[top++] = static_cast<unsigned long long>(op.value);
+            continue;
+
+        case ExprOp::Reference:
+        {
+            int index = node.inputs[op.slot];
+            const Annotation& input = state.annotations[index];
+
+            int inputNode = graph.nodeOf[index];
+            if (inputNode >= 0 && !graph.nodes[inputNode].error.empty()) {
+                return "#INPUT";
+            }
+
+            long long value = 0;
+            switch (op.field) {
+            case ExprOp::Start: value = input.startOffset; break;
+            case ExprOp::End: value = input.endOffset + 1LL; break;
+            case ExprOp::Length: value = input.endOffset - input.startOffset + 1LL; break;
+            case ExprOp::Value:
+                value = (inputNode >= 0 && !graph.nodes[inputNode].value.empty())
+                    ? graph.nodes[inputNode].result
+                    : decodeValue(state, input);
+                break;
+            }
+            stack[top++] = static_cast<unsigned long long>(value);
+            continue;
+        }
+
+        case ExprOp::Negate: stack[top - 1] = 0 - stack[top - 1]; continue;
+        case ExprOp::Complement: stack[top - 1] = ~stack[top - 1]; continue;
+        default: break;
+        }
+
+        unsigned long long b = stack[--top];
+        unsigned long long& a = stack[top - 1];
+        long long sa = static_cast<long long>(a), sb = static_cast<long long>(b);
+
+        switch (op.kind) {
+        case ExprOp::Add: a += b; break;
+        case ExprOp::Subtract: a -= b; break;
+        case ExprOp::Multiply: a *= b; break;
+        case ExprOp::Divide:
+        case ExprOp::Modulo:
+            if (sb == 0) {
+                return "#DIV0";
+            }
+            if (sb == -1) {
+                a = op.kind == ExprOp::Divide ? 0 - a : 0;
+            }
+            else {
+                a = static_cast<unsigned long long>(op.kind == ExprOp::Divide ? sa / sb : sa % sb);
+            }
+            break;
+        case ExprOp::And: a &= b; break;
+        case ExprOp::Or: a |= b; break;
+        case ExprOp::Xor: a ^= b; break;
+        case ExprOp::ShiftLeft: a <<= (b & 63); break;
+        case ExprOp::ShiftRight: a = static_cast<unsigned long long>(sa >> (b & 63)); break;
+        default: break;
+        }
+    }
+
+    result = static_cast<long long>(stack[0]);
+    return nullptr;
+}
+
+// Recomputes one node. A computed start moves the annotation and keeps its
+// length unless that is computed too. Returns true if anything visible changed.
+static bool evaluateNode(DocumentWindowState& state, ComputedGraph& graph, ComputedNode& node) {
+    if (node.broken) {
+        return false;
+    }
+    ++graph.evaluations;
+
+    Annotation& anno = state.annotations[node.annotation];
+    long long start = anno.startOffset;
+    long long end = anno.endOffset;
+    long long result = node.result;
+    const char* error = nullptr;
+
+    if (!node.start.empty()) {
+        error = evaluate(node.start, node, graph, state, start);
+        end = start + (anno.endOffset - anno.startOffset);
+    }
+    if (!error && !node.length.empty()) {
+        long long length = 0;
+        error = evaluate(node.length, node, graph, state, length);
+        end = start + length - 1;
+    }
+    if (!error && (start < 0 || end < start || end >= static_cast<long long>(state.fileData.size()))) {
+        error = "#RANGE";
+    }
+    // A record array's extent is fixed by its layout; only its start may move
+    if (!error && anno.layout && end - start != anno.endOffset - anno.startOffset) {
+        error = "#RANGE";
+    }
+    if (!error && !node.value.empty()) {
+        error = evaluate(node.value, node, graph, state, result);
+    }
+
+    std::string newError = error ? error : "";
+    bool changed = newError != node.error;
+    node.error = std::move(newError);
+
+    if (!error) {
+        changed |= start != anno.startOffset || end != anno.endOffset || result != node.result;
+        anno.startOffset = static_cast<int>(start);
+        anno.endOffset = static_cast<int>(end);
+        node.result = result;
+    }
+    return changed;
+}
+
+static void rebuild(DocumentWindowState& state, ComputedGraph& graph) {
+    graph.nodes.clear();
+    graph.nodeOf.clear();
+    graph.labelIndex.clear();
+    graph.dependents.clear();
+    graph.nextRank = 0;
+    graph.dirty.clear();
+    graph.unresolved.clear();
+    graph.appendedFrom = SIZE_MAX;
+    graph.needsRebuild = false;
+
+    const auto& annotations = state.annotations;
+    if (std::none_of(annotations.begin(), annotations.end(), hasExpressions)) {
+        return;
+    }
+
+    graph.nodeOf.assign(annotations.size(), -1);
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        graph.labelIndex.emplace(annotations[i].label, static_cast<int>(i));
+        if (hasExpressions(annotations[i])) {
+            compileNode(graph, annotations[i], static_cast<int>(i));
+        }
+    }
+
+    for (size_t id = 0; id < graph.nodes.size(); ++id) {
+        resolveNode(graph, static_cast<int>(id));
+    }
+    rankNodes(graph, 0);
+
+    std::vector<int> order(graph.nodes.size());
+    for (size_t id = 0; id < order.size(); ++id) order[id] = static_cast<int>(id);
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return graph.nodes[a].rank < graph.nodes[b].rank; });
+
+    for (int id : order) {
+        evaluateNode(state, graph, graph.nodes[id]);
+    }
+}
+
+// Adds annotations from first onward. They sort after every existing
+// annotation, so they cannot change what an existing label resolves to;
+// only a previously missing label can, and that needs a rebuild.
+static void appendNodes(DocumentWindowState& state, ComputedGraph& graph, size_t first, std::vector<int>& changed) {
+    const auto& annotations = state.annotations;
+    bool anyNew = std::any_of(annotations.begin() + first, annotations.end(), hasExpressions);
+
+    if (graph.nodes.empty()) {
+        graph.needsRebuild = anyNew;
+        return;
+    }
+
+    graph.nodeOf.resize(annotations.size(), -1);
+    for (size_t i = first; i < annotations.size(); ++i) {
+        graph.labelIndex.emplace(annotations[i].label, static_cast<int>(i));
+    }
+
+    for (const auto& node : graph.nodes) {
+        if (node.error == "#REF" && graph.labelIndex.count(node.detail)) {
+            graph.needsRebuild = true;
+            return;
+        }
+    }
+
+    size_t firstNode = graph.nodes.size();
+    for (size_t i = first; i < annotations.size(); ++i) {
+        if (hasExpressions(annotations[i])) {
+            compileNode(graph, annotations[i], static_cast<int>(i));
+        }
+    }
+    for (size_t id = firstNode; id < graph.nodes.size(); ++id) {
+        resolveNode(graph, static_cast<int>(id));
+    }
+    rankNodes(graph, firstNode);
+
+    std::vector<int> order;
+    for (size_t id = firstNode; id < graph.nodes.size(); ++id) order.push_back(static_cast<int>(id));
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return graph.nodes[a].rank < graph.nodes[b].rank; });
+
+    for (int id : order) {
+        if (evaluateNode(state, graph, graph.nodes[id])) {
+            changed.push_back(graph.nodes[id].annotation);
+        }
+    }
+}
+
+// Re-evaluates everything downstream of the seed annotations in rank order.
+// A node whose result does not change does not wake its dependents.
+static void propagate(DocumentWindowState& state, ComputedGraph& graph, const std::vector<int>& seeds, std::vector<int>& changed) {
+    using Entry = std::pair<int, int>;  // rank, node
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    auto enqueue = [&](int id) {
+        ComputedNode& node = graph.nodes[id];
+        if (!node.queued) {
+            node.queued = true;
+            queue.push({ node.rank, id });
+        }
+    };
+    auto enqueueDependents = [&](int annotation) {
+        auto it = graph.dependents.find(annotation);
+        if (it != graph.dependents.end()) {
+            for (int id : it->second) enqueue(id);
+        }
+    };
+
+    for (int index : seeds) {
+        if (index < 0 || index >= static_cast<int>(graph.nodeOf.size())) {
+            continue;
+        }
+        if (graph.nodeOf[index] >= 0) {
+            enqueue(graph.nodeOf[index]);
+        }
+        enqueueDependents(index);
+    }
+
+    while (!queue.empty()) {
+        ComputedNode& node = graph.nodes[queue.top().second];
+        queue.pop();
+        node.queued = false;
+
+        if (evaluateNode(state, graph, node)) {
+            changed.push_back(node.annotation);
+            enqueueDependents(node.annotation);
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+// Change notifications
+//-------------------------------------------------------------------
+void NoteAnnotationUpdated(DocumentWindowState& state, int index, const Annotation& previous) {
+    ComputedGraph& graph = graphOf(state);
+    if (graph.needsRebuild) {
+        return;
+    }
+
+    const Annotation& current = state.annotations[index];
+    if (current.computed != previous.computed || current.label != previous.label) {
+        // Edges or label resolution may have changed
+        graph.needsRebuild = !graph.nodes.empty() || hasExpressions(current);
+        return;
+    }
+
+    if (!graph.nodes.empty()) {
+        graph.dirty.push_back(index);
+    }
+}
+
+void NoteAnnotationsAppended(DocumentWindowState& state, size_t firstIndex) {
+    ComputedGraph& graph = graphOf(state);
+    graph.appendedFrom = std::min(graph.appendedFrom, firstIndex);
+}
+
+// Takes a node out of its inputs' dependents. It is never evaluated again;
+// its id stays valid so that no other node moves.
+static void detachNode(ComputedGraph& graph, int id) {
+    ComputedNode& node = graph.nodes[id];
+    for (int input : node.inputs) {
+        auto it = graph.dependents.find(input);
+        if (it == graph.dependents.end()) {
+            continue;
+        }
+        auto& readers = it->second;
+        readers.erase(std::remove(readers.begin(), readers.end(), id), readers.end());
+        if (readers.empty()) {
+            graph.dependents.erase(it);
+        }
+    }
+    node.inputs.clear();
+    node.broken = true;
+}
+
+// Applies shift to every annotation index the graph holds
+template <typename Shift>
+static void renumberGraph(ComputedGraph& graph, Shift shift) {
+    for (auto& node : graph.nodes) {
+        if (node.annotation >= 0) shift(node.annotation);
+        for (int& input : node.inputs) shift(input);
+    }
+
+    std::unordered_map<int, std::vector<int>> dependents;
+    dependents.reserve(graph.dependents.size());
+    for (auto& [annotation, readers] : graph.dependents) {
+        int index = annotation;
+        shift(index);
+        dependents.emplace(index, std::move(readers));
+    }
+    graph.dependents.swap(dependents);
+
+    for (auto& entry : graph.labelIndex) shift(entry.second);
+    for (int& index : graph.dirty) shift(index);
+    for (int& index : graph.unresolved) shift(index);
+}
+
+// Moves the nodes reading annotation from onto annotation to, which has no
+// expressions of its own, and marks them for evaluation
+static void redirectReaders(ComputedGraph& graph, std::vector<int> readers, int from, int to) {
+    for (int id : readers) {
+        for (int& input : graph.nodes[id].inputs) {
+            if (input == from) input = to;
+        }
+        graph.dirty.push_back(graph.nodes[id].annotation);
+    }
+    auto& moved = graph.dependents[to];
+    moved.insert(moved.end(), readers.begin(), readers.end());
+}
+
+static std::vector<int> takeReaders(ComputedGraph& graph, int index) {
+    std::vector<int> readers;
+    auto it = graph.dependents.find(index);
+    if (it != graph.dependents.end()) {
+        readers = std::move(it->second);
+        graph.dependents.erase(it);
+    }
+    return readers;
+}
+
+// The graph is shifted over the new annotation rather than rebuilt. Only a
+// node of its own and, if it is now the first with its label, the nodes that
+// read that label are evaluated.
+void NoteAnnotationInserted(DocumentWindowState& state, int index) {
+    ComputedGraph& graph = graphOf(state);
+    const Annotation& anno = state.annotations[index];
+    if (graph.appendedFrom != SIZE_MAX && graph.appendedFrom > static_cast<size_t>(index)) {
+        ++graph.appendedFrom;
+    }
+    if (graph.needsRebuild) {
+        return;
+    }
+    if (graph.nodes.empty()) {
+        graph.needsRebuild = hasExpressions(anno);
+        return;
+    }
+    if (index >= static_cast<int>(graph.nodeOf.size())) {
+        return; // Among annotations appended since the last evaluation
+    }
+
+    const std::string name = anno.label.str();
+    std::vector<int> readers;
+    auto label = graph.labelIndex.find(name);
+    if (label == graph.labelIndex.end()) {
+        for (const auto& node : graph.nodes) {
+            if (node.error == "#REF" && node.detail == name) {
+                graph.needsRebuild = true;
+                return;
+            }
+        }
+    }
+    else if (label->second >= index) {
+        readers = takeReaders(graph, label->second);
+        // Readers ranked before a node of the new annotation would evaluate too early
+        if (!readers.empty() && hasExpressions(anno)) {
+            graph.needsRebuild = true;
+            return;
+        }
+    }
+
+    graph.nodeOf.insert(graph.nodeOf.begin() + index, -1);
+    renumberGraph(graph, [index](int& i) { if (i >= index) ++i; });
+
+    if (label == graph.labelIndex.end()) {
+        graph.labelIndex.emplace(name, index);
+    }
+    else if (label->second > index) {
+        redirectReaders(graph, std::move(readers), label->second, index);
+        label->second = index;
+    }
+
+    if (hasExpressions(anno)) {
+        compileNode(graph, anno, index);
+        int id = static_cast<int>(graph.nodes.size()) - 1;
+        resolveNode(graph, id);
+        rankNodes(graph, id);
+        graph.dirty.push_back(index);
+    }
+}
+
+// The graph is shifted over the gap rather than rebuilt. If the erased
+// annotation was the first with its label, the nodes reading that label move
+// on to the next annotation with it and are evaluated, or break with #REF.
+void NoteAnnotationErased(DocumentWindowState& state, int index, const Annotation& erased) {
+    ComputedGraph& graph = graphOf(state);
+    if (graph.appendedFrom != SIZE_MAX && graph.appendedFrom > static_cast<size_t>(index)) {
+        --graph.appendedFrom;
+    }
+    const int known = static_cast<int>(graph.nodeOf.size());
+    if (graph.needsRebuild || index >= known) {
+        return;
+    }
+
+    if (graph.nodeOf[index] >= 0) {
+        int id = graph.nodeOf[index];
+        detachNode(graph, id);
+        graph.nodes[id].annotation = -1;
+    }
+    graph.dirty.erase(std::remove(graph.dirty.begin(), graph.dirty.end(), index), graph.dirty.end());
+    graph.unresolved.erase(std::remove(graph.unresolved.begin(), graph.unresolved.end(), index), graph.unresolved.end());
+
+    const std::string name = erased.label.str();
+    auto label = graph.labelIndex.find(name);
+    if (label != graph.labelIndex.end() && label->second == index) {
+        std::vector<int> readers = takeReaders(graph, index);
+
+        // The next annotation with the label, numbered as before the erase
+        int next = -1;
+        for (int i = index; i + 1 < known; ++i) {
+            if (state.annotations[i].label == name) {
+                next = i + 1;
+                break;
+            }
+        }
+
+        if (next >= 0) {
+            // Readers ranked before a node of the next annotation would evaluate too early
+            if (!readers.empty() && graph.nodeOf[next] >= 0) {
+                graph.needsRebuild = true;
+                return;
+            }
+            redirectReaders(graph, std::move(readers), index, next);
+            label->second = next;
+        }
+        else {
+            for (int id : readers) {
+                if (graph.nodes[id].error == "#CYCLE") {
+                    graph.needsRebuild = true; // The rest of the cycle may resolve
+                    return;
+                }
+            }
+            for (int id : readers) {
+                ComputedNode& node = graph.nodes[id];
+                detachNode(graph, id);
+                node.error = "#REF";
+                node.detail = name;
+                graph.unresolved.push_back(node.annotation);
+                graph.dirty.push_back(node.annotation);
+            }
+            graph.labelIndex.erase(label);
+        }
+    }
+
+    graph.nodeOf.erase(graph.nodeOf.begin() + index);
+    renumberGraph(graph, [index](int& i) { if (i > index) --i; });
+}
+
+void NoteAnnotationsReordered(DocumentWindowState& state) {
+    graphOf(state).needsRebuild = true;
+}
+
+//-------------------------------------------------------------------
+// EvaluateComputedAnnotations
+//-------------------------------------------------------------------
+bool EvaluateComputedAnnotations(DocumentWindowState& state, std::vector<int>& changed) {
+    ComputedGraph& graph = graphOf(state);
+
+    if (!graph.needsRebuild && graph.appendedFrom != SIZE_MAX) {
+        size_t first = graph.appendedFrom;
+        graph.appendedFrom = SIZE_MAX;
+        appendNodes(state, graph, first, changed);
+    }
+
+    if (graph.needsRebuild) {
+        rebuild(state, graph);
+        return false;
+    }
+
+    if (!graph.dirty.empty()) {
+        std::vector<int> seeds;
+        seeds.swap(graph.dirty);
+        propagate(state, graph, seeds, changed);
+    }
+    changed.insert(changed.end(), graph.unresolved.begin(), graph.unresolved.end());
+    graph.unresolved.clear();
+    return true;
+}
+
+//-------------------------------------------------------------------
+// Queries
+//-------------------------------------------------------------------
+size_t ComputedEvaluationCount(const DocumentWindowState& state) {
+    return state.computedGraph ? state.computedGraph->evaluations : 0;
+}
+
+static const ComputedNode* findNode(const DocumentWindowState& state, size_t index) {
+    const ComputedGraph* graph = state.computedGraph.get();
+    if (!graph || index >= graph->nodeOf.size() || graph->nodeOf[index] < 0) {
+        return nullptr;
+    }
+    return &graph->nodes[graph->nodeOf[index]];
+}
+
+bool GetComputedValueText(const DocumentWindowState& state, size_t index, std::string& text) {
+    const ComputedNode* node = findNode(state, index);
+    if (!node) {
+        return false;
+    }
+
+    if (!node->error.empty()) {
+        text = node->error;
+        return true;
+    }
+    if (!node->value.empty()) {
+        text = std::to_string(node->result);
+        return true;
+    }
+    return false;
+}
+
+std::string ComputedAnnotationError(const DocumentWindowState& state, size_t index) {
+    const ComputedNode* node = findNode(state, index);
+    if (!node || node->error.empty()) {
+        return std::string();
+    }
+
+    const std::string& error = node->error;
+    if (error == "#SYNTAX") return node->detail;
+    if (error == "#REF") return "No annotation is labelled '" + node->detail + "'.";
+    if (error == "#CYCLE") return "The expressions depend on their own result through a cycle.";
+    if (error == "#RANGE") return "The computed extent falls outside the file.";
+    if (error == "#DIV0") return "An expression divides by zero.";
+    if (error == "#INPUT") return "An annotation these expressions read could not be evaluated.";
+    return error;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "includes.h"
+
+// Computed annotation expressions are integer arithmetic over other
+// annotations, referenced by label in braces:
+//
+//   {Header.size}          decoded value (little-endian, signed for "int")
+//   {Header.size}.start    first byte offset
+//   {Header.size}.end      offset one past the last byte
+//   {Header.size}.length   byte count
+//
+// with + - * / % & | ^ << >> ~, parentheses and decimal or 0x numbers. A
+// label that occurs more than once refers to its first annotation.
+
+// Throws std::runtime_error describing the first syntax error in text
+void CheckComputedExpression(const std::string& text);
+
+// Called by the undo journal after every change to state.annotations
+void NoteAnnotationUpdated(DocumentWindowState& state, int index, const Annotation& previous);
+void NoteAnnotationsAppended(DocumentWindowState& state, size_t firstIndex);
+void NoteAnnotationInserted(DocumentWindowState& state, int index);
+void NoteAnnotationErased(DocumentWindowState& state, int index, const Annotation& erased);
+void NoteAnnotationsReordered(DocumentWindowState& state);
+
+// Brings computed annotations up to date with the changes noted since the
+// last call. Only annotations downstream of an edit are re-evaluated, in
+// dependency order, stopping wherever a result comes out unchanged. Indices
+// whose extent or value changed are appended to changed. Returns false if
+// the graph had to be rebuilt and everything was re-evaluated.
+bool EvaluateComputedAnnotations(DocumentWindowState& state, std::vector<int>& changed);
+
+// Computed annotations evaluated since the document was opened, rebuilds
+// included. The difference across a call to EvaluateComputedAnnotations is
+// the work that call did.
+size_t ComputedEvaluationCount(const DocumentWindowState& state);
+
+// Text to show for a computed value or evaluation error; false if the
+// annotation's bytes should be formatted as usual
+bool GetComputedValueText(const DocumentWindowState& state, size_t index, std::string& text);
+
+// Why the annotation's expressions could not be evaluated, or empty
+std::string ComputedAnnotationError(const DocumentWindowState& state, size_t index);
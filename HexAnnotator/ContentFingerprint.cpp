@@ -0,0 +1,138 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <shlobj.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include "ContentFingerprint.h"
+#include "AnnotationFile.h"
+#include "LabelIndex.h"
+#include "StringIndex.h"
+#include "WorkerPool.h"
+
+void ReplaceAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+
+//-------------------------------------------------------------------
+// Fingerprints
+//-------------------------------------------------------------------
+ContentFingerprint FingerprintContents(const BYTE* data, size_t size) {
+    size_t chunkCount = std::max<size_t>((size + FINGERPRINT_CHUNK_SIZE - 1) / FINGERPRINT_CHUNK_SIZE, 1);
+    std::vector<uint64_t> digests(chunkCount);
+
+    WorkerPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        size_t first = chunk * FINGERPRINT_CHUNK_SIZE;
+        size_t length = std::min(FINGERPRINT_CHUNK_SIZE, size - first);
+        digests[chunk] = Xxh64(data + first, length, 0);
+    });
+
+    ContentFingerprint fingerprint;
+    fingerprint.size = size;
+    fingerprint.hash = Xxh64(digests.data(), digests.size() * sizeof(uint64_t), size);
+    return fingerprint;
+}
+
+std::string FingerprintText(const ContentFingerprint& fingerprint) {
+    char text[40];
+    sprintf_s(text, sizeof(text), "%016llx-%016llx",
+        static_cast<unsigned long long>(fingerprint.size), static_cast<unsigned long long>(fingerprint.hash));
+    return text;
+}
+
+//-------------------------------------------------------------------
+// Catalog
+//-------------------------------------------------------------------
+// %LOCALAPPDATA%\HexAnnotator\Catalog, created on first use; empty if the
+// profile directory cannot be found or written
+static std::string catalogDirectory() {
+    char base[MAX_PATH];
+    if (!SUCCEEDED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, base))) {
+        return std::string();
+    }
+
+    std::string directory = std::string(base) + "\\HexAnnotator";
+    CreateDirectory(directory.c_str(), NULL);
+    directory += "\\Catalog";
+    CreateDirectory(directory.c_str(), NULL);
+
+    if (GetFileAttributes(directory.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        return std::string();
+    }
+    return directory;
+}
+
+static std::string catalogPathFor(const ContentFingerprint& fingerprint, const char* extension = ".hva") {
+    std::string directory = catalogDirectory();
+    if (directory.empty()) {
+        return std::string();
+    }
+    return directory + "\\" + FingerprintText(fingerprint) + extension;
+}
+
+bool AddToCatalog(const std::string& annotationFile, const ContentFingerprint& fingerprint) {
+    if (!fingerprint.known()) {
+        return false;
+    }
+
+    std::string path = catalogPathFor(fingerprint);
+    return !path.empty() && CopyFile(annotationFile.c_str(), path.c_str(), FALSE);
+}
+
+bool AttachCatalogAnnotations(DocumentWindowState& state) {
+    if (!state.fingerprint.known()) {
+        return false;
+    }
+
+    std::string path = catalogPathFor(state.fingerprint);
+    if (path.empty() || GetFileAttributes(path.c_str()) == INVALID_FILE_ATTRIBUTES) {
+        return false;
+    }
+
+    try {
+        AnnotationFileContents contents = ReadAnnotationFile(path, state.fileData.size());
+        if (contents.fingerprint != state.fingerprint || contents.annotations.empty()) {
+            return false;
+        }
+
+        ReplaceAnnotations(state, std::move(contents.annotations));
+        AdoptLabelIndex(state, std::move(contents.labelIndex));
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        // A damaged catalog entry is no worse than a missing one
+        return false;
+    }
+}
+
+std::shared_ptr<StringIndex> DocumentStrings(DocumentWindowState& state) {
+    if (state.stringIndex) {
+        return state.stringIndex;
+    }
+
+    const uint8_t* data = state.fileData.data();
+    const size_t size = state.fileData.size();
+    std::string path = state.fingerprint.known() ? catalogPathFor(state.fingerprint, ".strings") : std::string();
+    if (!path.empty()) {
+        std::ifstream file(path, std::ios::binary);
+        if (file) {
+            std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            try {
+                state.stringIndex = std::make_shared<StringIndex>(
+                    reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), size);
+                return state.stringIndex;
+            }
+            catch (const std::runtime_error&) {
+                // Scanned again and replaced below
+            }
+        }
+    }
+
+    state.stringIndex = std::make_shared<StringIndex>(data, size);
+    if (!path.empty()) {
+        std::string bytes;
+        state.stringIndex->serialize(bytes);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+    return state.stringIndex;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Hashing.h"
+#include "includes.h"
+
+// Annotation sets are bound to the bytes they describe rather than to a file
+// name. A document's fingerprint is its size plus a tree hash: XXH64 of each
+// FINGERPRINT_CHUNK_SIZE chunk, computed in parallel, then XXH64 of the
+// chunk digests seeded with the size. The chunk size is part of the
+// definition, so it must not change.
+const size_t FINGERPRINT_CHUNK_SIZE = 4 * 1024 * 1024;
+
+ContentFingerprint FingerprintContents(const BYTE* data, size_t size);
+
+// "<size>-<hash>" in hex, as used for catalog file names
+std::string FingerprintText(const ContentFingerprint& fingerprint);
+
+//-------------------------------------------------------------------
+// Annotation catalog
+//-------------------------------------------------------------------
+// A per-user directory of .hva files named by fingerprint. Saving annotations
+// also files a copy there, and opening a document with the same contents
+// under any name attaches them again.
+
+// Copy a saved annotation file into the catalog. Returns false if the
+// catalog directory is not available.
+bool AddToCatalog(const std::string& annotationFile, const ContentFingerprint& fingerprint);
+
+// Replace state.annotations with the catalogued set for state.fingerprint as
+// one undo step. Returns false if there is none or it cannot be read.
+bool AttachCatalogAnnotations(DocumentWindowState& state);
+
+// The strings of the document: state.stringIndex, else the index catalogued
+// for state.fingerprint as a .strings file, else a new one, which is filed
+// there so the next document with the same contents need not scan for them.
+std::shared_ptr<StringIndex> DocumentStrings(DocumentWindowState& state);
@@ -0,0 +1,520 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include "DataInterpreter.h"
+
+// Characters shown by the string rows
+const size_t MAX_STRING_LENGTH = 32;
+const size_t MAX_WSTRING_LENGTH = 16;
+
+// Longest LEB128 encoding of a 64-bit value
+const size_t MAX_LEB128_BYTES = 10;
+
+// Days from 1970-01-01 back to the OLE automation epoch, 1899-12-30
+const int64_t OLE_EPOCH_DAYS = -25569;
+
+// Dates outside years 1 to 9999 are not shown
+const int64_t MIN_YEAR = 1;
+const int64_t MAX_YEAR = 9999;
+
+// Magnitude beyond which an OLE date is certainly out of range; keeps the
+// conversion to whole days from overflowing
+const double MAX_OLE_DAYS = 4e6;
+
+const char* const NOT_ENOUGH_DATA = "Not enough data";
+const char* const OUT_OF_RANGE = "Out of range";
+
+// Grid row labels, by DataType
+static const char* const DATA_TYPE_NAMES[] = {
+    "Byte (8-bit)",
+    "Unsigned Byte",
+    "Short (16-bit)",
+    "Unsigned Short",
+    "Int24 (24-bit)",
+    "Unsigned Int24",
+    "Int (32-bit)",
+    "Unsigned Int",
+    "Int64 (64-bit)",
+    "Unsigned Int64",
+    "Half Float",
+    "bfloat16",
+    "Float",
+    "Double",
+    "Fixed 8.8",
+    "Fixed 16.16",
+    "ULEB128",
+    "SLEB128",
+    "ASCII String",
+    "Unicode String",
+    "time_t",
+    "time64_t",
+    "OLE Time",
+};
+static_assert(std::size(DATA_TYPE_NAMES) == DT_COUNT, "every DataType needs a name");
+
+//-------------------------------------------------------------------
+// Scratch buffer
+//-------------------------------------------------------------------
+// Appends to the scratch buffer. DATA_INTERPRETATION_SCRATCH covers the
+// longest output, so running out of room only truncates.
+class ScratchWriter {
+public:
+    explicit ScratchWriter(DataInterpretation& out) : position(out.scratch),
+        end(out.scratch + DATA_INTERPRETATION_SCRATCH - 1) {}
+
+    // Start a text, pointing slot at it
+    void begin(const char*& slot) {
+        slot = position;
+    }
+
+    // Terminate the current text
+    void finish() {
+        *position = '\0';
+        if (position < end) {
+            ++position;
+        }
+    }
+
+    void put(char c) {
+        if (position < end) {
+            *position++ = c;
+        }
+    }
+
+    void put(const char* text) {
+        while (*text) {
+            put(*text++);
+        }
+    }
+
+    template <typename T>
+    void number(T value, int base = 10) {
+        auto result = std::to_chars(position, end, value, base);
+        position = result.ec == std::errc() ? result.ptr : position;
+    }
+
+    template <typename T>
+    void fixed(T value, int precision) {
+        auto result = std::to_chars(position, end, value, std::chars_format::fixed, precision);
+        position = result.ec == std::errc() ? result.ptr : position;
+    }
+
+    // The fewest digits that read back as value
+    template <typename T>
+    void fixed(T value) {
+        auto result = std::to_chars(position, end, value, std::chars_format::fixed);
+        position = result.ec == std::errc() ? result.ptr : position;
+    }
+
+    // Zero padded to width digits
+    void digits(int64_t value, int width) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        for (int pad = width - static_cast<int>(result.ptr - buffer); pad > 0; --pad) {
+            put('0');
+        }
+        for (const char* c = buffer; c < result.ptr; ++c) {
+            put(*c);
+        }
+    }
+
+private:
+    char* position;
+    char* end;
+};
+
+//-------------------------------------------------------------------
+// Loading
+//-------------------------------------------------------------------
+// The bytes at the cursor. The first 8 are loaded once, zero padded, and
+// byte-swapped once, so a decoder of any width up to 8 bytes in either order
+// is a shift or a mask of a register.
+struct Window {
+    const uint8_t* data;
+    size_t size;
+    uint64_t little;    // First 8 bytes as a little-endian number
+    uint64_t big;       // First 8 bytes as a big-endian number
+};
+
+static inline uint64_t byteSwap(uint64_t value) {
+#ifdef _MSC_VER
+    return _byteswap_uint64(value);
+#else
+    return __builtin_bswap64(value);
+#endif
+}
+
+static Window loadWindow(const uint8_t* data, size_t size) {
+    uint64_t bytes = 0;
+    memcpy(&bytes, data, std::min<size_t>(size, sizeof(bytes)));
+    if constexpr (std::endian::native == std::endian::big) {
+        bytes = byteSwap(bytes);
+    }
+    return { data, size, bytes, byteSwap(bytes) };
+}
+
+// The first Width bytes in the given order, zero extended
+template <size_t Width, ByteOrder Order>
+static uint64_t load(const Window& window) {
+    static_assert(Width >= 1 && Width <= 8, "the window holds 8 bytes");
+    if constexpr (Order == BO_LITTLE_ENDIAN) {
+        return Width == 8 ? window.little : window.little & ((uint64_t(1) << (8 * Width)) - 1);
+    }
+    else {
+        return window.big >> (64 - 8 * Width);
+    }
+}
+
+//-------------------------------------------------------------------
+// Decoders
+//-------------------------------------------------------------------
+// A decoder formats the window as one type. WIDTH is the bytes it needs and
+// ORDERED whether it has a big-endian reading; format<Order> is only
+// instantiated for the orders it has.
+
+// "<decimal> (0x<hex>)", the hex of the value's own width. Widths short of
+// sizeof(T) are sign extended.
+template <typename T, size_t Width = sizeof(T)>
+struct IntegerDecoder {
+    static constexpr size_t WIDTH = Width;
+    static constexpr bool ORDERED = Width > 1;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        uint64_t bits = load<Width, Order>(window);
+        T value = static_cast<T>(bits);
+        if constexpr (std::is_signed_v<T> && Width < sizeof(T)) {
+            value = static_cast<T>(static_cast<int64_t>(bits << (64 - 8 * Width)) >> (64 - 8 * Width));
+        }
+        writer.number(value);
+        writer.put(" (0x");
+        writer.number(bits, 16);
+        writer.put(')');
+    }
+};
+
+// Float is T's unsigned integer of the same width
+template <typename T, typename Bits, int Precision>
+struct FloatDecoder {
+    static constexpr size_t WIDTH = sizeof(T);
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        writer.fixed(std::bit_cast<T>(static_cast<Bits>(load<sizeof(T), Order>(window))), Precision);
+    }
+};
+
+// binary16 widened to float, which holds every value exactly
+static float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0x1F) {
+        return std::bit_cast<float>(sign | 0x7F800000 | (mantissa << 13));
+    }
+    if (exponent == 0) {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// Shown with the fewest digits, since 6 decimals would hide most subnormals
+struct HalfDecoder {
+    static constexpr size_t WIDTH = 2;
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        writer.fixed(halfToFloat(static_cast<uint16_t>(load<2, Order>(window))));
+    }
+};
+
+struct BFloat16Decoder {
+    static constexpr size_t WIDTH = 2;
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        writer.fixed(std::bit_cast<float>(static_cast<uint32_t>(load<2, Order>(window) << 16)));
+    }
+};
+
+// Two's complement T scaled by 2^-FractionBits, exact in a double
+template <typename T, int FractionBits>
+struct FixedPointDecoder {
+    static constexpr size_t WIDTH = sizeof(T);
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        T value = static_cast<T>(load<sizeof(T), Order>(window));
+        writer.fixed(std::ldexp(static_cast<double>(value), -FractionBits));
+    }
+};
+
+// "<value> (<n> bytes)". Reads past the window, up to MAX_LEB128_BYTES.
+template <bool Signed>
+struct Leb128Decoder {
+    static constexpr size_t WIDTH = 1;
+    static constexpr bool ORDERED = false;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        uint64_t value = 0;
+        size_t length = 0;
+        uint8_t byte = 0x80;
+        for (unsigned shift = 0; byte & 0x80; shift += 7, ++length) {
+            if (length == MAX_LEB128_BYTES) {
+                writer.put(OUT_OF_RANGE);
+                return;
+            }
+            if (length == window.size) {
+                writer.put(NOT_ENOUGH_DATA);
+                return;
+            }
+            byte = window.data[length];
+            // The last byte of ten holds bit 63 only, plus its sign extension
+            uint8_t extension = Signed && (byte & 0x01) ? 0x7E : 0x00;
+            if (shift == 63 && (byte & 0x7E) != extension) {
+                writer.put(OUT_OF_RANGE);
+                return;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (Signed && !(byte & 0x80) && shift + 7 < 64 && (byte & 0x40)) {
+                value |= ~uint64_t(0) << (shift + 7);
+            }
+        }
+
+        if constexpr (Signed) {
+            writer.number(static_cast<int64_t>(value));
+        }
+        else {
+            writer.number(value);
+        }
+        writer.put(" (");
+        writer.number(length);
+        writer.put(length == 1 ? " byte)" : " bytes)");
+    }
+};
+
+// Up to the terminator, with non-printable bytes shown as dots
+struct AsciiDecoder {
+    static constexpr size_t WIDTH = 1;
+    static constexpr bool ORDERED = false;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        for (size_t k = 0; k < MAX_STRING_LENGTH && k < window.size && window.data[k] != 0; ++k) {
+            uint8_t c = window.data[k];
+            writer.put(c >= 32 && c <= 126 ? static_cast<char>(c) : '.');
+        }
+    }
+};
+
+// UTF-16, showing Basic Latin only
+struct Utf16Decoder {
+    static constexpr size_t WIDTH = 2;
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        const size_t high = Order == BO_LITTLE_ENDIAN ? 1 : 0;
+        for (size_t k = 0; k < MAX_WSTRING_LENGTH && k * 2 + 1 < window.size; ++k) {
+            const uint8_t* unit = window.data + k * 2;
+            uint16_t ch = static_cast<uint16_t>((unit[high] << 8) | unit[1 - high]);
+            if (ch == 0) {
+                break;
+            }
+            writer.put(ch >= 32 && ch <= 126 ? static_cast<char>(ch) : '.');
+        }
+    }
+};
+
+//-------------------------------------------------------------------
+// Dates
+//-------------------------------------------------------------------
+// Year, month and day of a count of days since 1970-01-01 in the proleptic
+// Gregorian calendar. Works in 400-year eras of 146097 days, shifted so
+// that years start in March and the leap day falls at the end of one.
+static void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;     // Days from 0000-03-01 to 1970-01-01
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned shiftedMonth = (5 * dayOfYear + 2) / 153;
+
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2 ? 1 : 0);
+}
+
+// "YYYY-MM-DD hh:mm:ss"
+static void putDateTime(ScratchWriter& writer, int64_t days, int64_t secondOfDay) {
+    int64_t year;
+    unsigned month;
+    unsigned day;
+    civilFromDays(days, year, month, day);
+    if (year < MIN_YEAR || year > MAX_YEAR) {
+        writer.put(OUT_OF_RANGE);
+        return;
+    }
+
+    writer.digits(year, 4);
+    writer.put('-');
+    writer.digits(month, 2);
+    writer.put('-');
+    writer.digits(day, 2);
+    writer.put(' ');
+    writer.digits(secondOfDay / 3600, 2);
+    writer.put(':');
+    writer.digits(secondOfDay / 60 % 60, 2);
+    writer.put(':');
+    writer.digits(secondOfDay % 60, 2);
+}
+
+static void putUnixTime(ScratchWriter& writer, int64_t seconds) {
+    // Floor division, without overflowing near the ends of the range
+    int64_t days = seconds / 86400;
+    int64_t secondOfDay = seconds % 86400;
+    if (secondOfDay < 0) {
+        secondOfDay += 86400;
+        --days;
+    }
+    putDateTime(writer, days, secondOfDay);
+}
+
+// The whole part counts days from the epoch and the fraction is the time of
+// day, even for dates before the epoch: -1.25 is 1899-12-29 06:00
+static void putOleTime(ScratchWriter& writer, double value) {
+    if (!std::isfinite(value) || std::fabs(value) > MAX_OLE_DAYS) {
+        writer.put(OUT_OF_RANGE);
+        return;
+    }
+
+    double wholeDays = std::trunc(value);
+    int64_t days = static_cast<int64_t>(wholeDays) + OLE_EPOCH_DAYS;
+    int64_t secondOfDay = std::llround(std::fabs(value - wholeDays) * 86400);
+    if (secondOfDay == 86400) {
+        secondOfDay = 0;
+        ++days;
+    }
+    putDateTime(writer, days, secondOfDay);
+}
+
+template <typename T>
+struct UnixTimeDecoder {
+    static constexpr size_t WIDTH = sizeof(T);
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        putUnixTime(writer, static_cast<T>(load<sizeof(T), Order>(window)));
+    }
+};
+
+struct OleTimeDecoder {
+    static constexpr size_t WIDTH = 8;
+    static constexpr bool ORDERED = true;
+
+    template <ByteOrder Order>
+    static void format(ScratchWriter& writer, const Window& window) {
+        putOleTime(writer, std::bit_cast<double>(load<8, Order>(window)));
+    }
+};
+
+//-------------------------------------------------------------------
+// Row table
+//-------------------------------------------------------------------
+template <DataType Type, typename Decoder>
+struct Row {
+    static constexpr DataType TYPE = Type;
+    using RowDecoder = Decoder;
+
+    static void interpret(ScratchWriter& writer, const Window& window, DataInterpretation& out) {
+        const char** text = out.text[Type];
+        if (window.size < Decoder::WIDTH) {
+            text[BO_LITTLE_ENDIAN] = NOT_ENOUGH_DATA;
+            text[BO_BIG_ENDIAN] = Decoder::ORDERED ? NOT_ENOUGH_DATA : "";
+            return;
+        }
+
+        writer.begin(text[BO_LITTLE_ENDIAN]);
+        Decoder::template format<BO_LITTLE_ENDIAN>(writer, window);
+        writer.finish();
+
+        if constexpr (Decoder::ORDERED) {
+            writer.begin(text[BO_BIG_ENDIAN]);
+            Decoder::template format<BO_BIG_ENDIAN>(writer, window);
+            writer.finish();
+        }
+        else {
+            text[BO_BIG_ENDIAN] = "";
+        }
+    }
+};
+
+// Expands to one inlined call per row
+template <typename... Rows>
+struct RowTable {
+    static void interpret(ScratchWriter& writer, const Window& window, DataInterpretation& out) {
+        (Rows::interpret(writer, window, out), ...);
+    }
+
+    // Exactly one row per DataType, in enum order
+    static constexpr bool complete() {
+        const DataType types[] = { Rows::TYPE... };
+        for (size_t i = 0; i < sizeof...(Rows); ++i) {
+            if (types[i] != static_cast<DataType>(i)) {
+                return false;
+            }
+        }
+        return sizeof...(Rows) == DT_COUNT;
+    }
+};
+
+using InterpreterRows = RowTable<
+    Row<DT_BYTE,            IntegerDecoder<int8_t>>,
+    Row<DT_UBYTE,           IntegerDecoder<uint8_t>>,
+    Row<DT_SHORT,           IntegerDecoder<int16_t>>,
+    Row<DT_USHORT,          IntegerDecoder<uint16_t>>,
+    Row<DT_INT24,           IntegerDecoder<int32_t, 3>>,
+    Row<DT_UINT24,          IntegerDecoder<uint32_t, 3>>,
+    Row<DT_INT,             IntegerDecoder<int32_t>>,
+    Row<DT_UINT,            IntegerDecoder<uint32_t>>,
+    Row<DT_INT64,           IntegerDecoder<int64_t>>,
+    Row<DT_UINT64,          IntegerDecoder<uint64_t>>,
+    Row<DT_HALF,            HalfDecoder>,
+    Row<DT_BFLOAT16,        BFloat16Decoder>,
+    Row<DT_FLOAT,           FloatDecoder<float, uint32_t, 6>>,
+    Row<DT_DOUBLE,          FloatDecoder<double, uint64_t, 10>>,
+    Row<DT_FIXED_8_8,       FixedPointDecoder<int16_t, 8>>,
+    Row<DT_FIXED_16_16,     FixedPointDecoder<int32_t, 16>>,
+    Row<DT_ULEB128,         Leb128Decoder<false>>,
+    Row<DT_SLEB128,         Leb128Decoder<true>>,
+    Row<DT_STRING,          AsciiDecoder>,
+    Row<DT_UNICODE_STRING,  Utf16Decoder>,
+    Row<DT_TIME_T,          UnixTimeDecoder<int32_t>>,
+    Row<DT_TIME64_T,        UnixTimeDecoder<int64_t>>,
+    Row<DT_OLETIME,         OleTimeDecoder>>;
+
+static_assert(InterpreterRows::complete(), "the row table must list every DataType in enum order");
+
+//-------------------------------------------------------------------
+// Interpretation
+//-------------------------------------------------------------------
+void InterpretData(const uint8_t* data, size_t size, DataInterpretation& out) {
+    ScratchWriter writer(out);
+    InterpreterRows::interpret(writer, loadWindow(data, size), out);
+}
+
+const char* GetDataTypeName(DataType type) {
+    return type >= 0 && type < DT_COUNT ? DATA_TYPE_NAMES[type] : "Unknown";
+}
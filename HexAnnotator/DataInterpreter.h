@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// The data interpreter grid shows the bytes at the cursor as every DataType
+// at once, in both byte orders. They are decoded together from one load of
+// the first 8 bytes and formatted into a fixed buffer, so moving the cursor or
+// dragging a selection allocates nothing. Nothing here depends on Windows;
+// dates are computed with a proleptic Gregorian calendar rather than the C
+// runtime or OLE automation.
+//
+// Each row is a decoder template instantiated for its type and byte order and
+// listed in the row table in DataInterpreter.cpp, so adding a row is one enum
+// value, one name and one table entry, and costs no dispatch at run time.
+
+// Grid data types
+enum DataType {
+    DT_BYTE,
+    DT_UBYTE,
+    DT_SHORT,
+    DT_USHORT,
+    DT_INT24,
+    DT_UINT24,
+    DT_INT,
+    DT_UINT,
+    DT_INT64,
+    DT_UINT64,
+    DT_HALF,            // IEEE 754 binary16
+    DT_BFLOAT16,        // Upper half of a float
+    DT_FLOAT,
+    DT_DOUBLE,
+    DT_FIXED_8_8,       // Signed, 8 fraction bits
+    DT_FIXED_16_16,     // Signed, 16 fraction bits
+    DT_ULEB128,         // Unsigned varint, up to 10 bytes
+    DT_SLEB128,         // Signed varint, up to 10 bytes
+    DT_STRING,
+    DT_UNICODE_STRING,  // UTF-16
+    DT_TIME_T,          // 32-bit seconds since 1970, UTC
+    DT_TIME64_T,        // 64-bit seconds since 1970, UTC
+    DT_OLETIME,         // Days since December 30, 1899, as a double
+    DT_COUNT  // Total number of data types
+};
+
+enum ByteOrder {
+    BO_LITTLE_ENDIAN,
+    BO_BIG_ENDIAN,
+    BO_COUNT
+};
+
+// Large enough for every representation at once; a fixed-point double alone
+// can take 330 characters, and there is one per byte order
+const size_t DATA_INTERPRETATION_SCRATCH = 4096;
+
+struct DataInterpretation {
+    // Null-terminated, within scratch. Types a single byte wide, and the
+    // varints, have no byte order; their big-endian text is empty.
+    const char* text[DT_COUNT][BO_COUNT];
+    char scratch[DATA_INTERPRETATION_SCRATCH];
+};
+
+// Interpret the size bytes at data as every DataType. Types wider than size
+// read "Not enough data".
+void InterpretData(const uint8_t* data, size_t size, DataInterpretation& out);
+
+// Row label of a type in the grid
+const char* GetDataTypeName(DataType type);
@@ -0,0 +1,824 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+#include "EmbeddedFiles.h"
+#include "Hashing.h"
+#include "SignatureScanner.h"
+#include "WorkerPool.h"
+
+// Bytes of the document scanned by one pool task
+const size_t EMBEDDED_CHUNK_SIZE = 4 * 1024 * 1024;
+
+static uint16_t le16(const BYTE* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+static uint16_t be16(const BYTE* p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+static uint32_t le32(const BYTE* p) { return le16(p) | static_cast<uint32_t>(le16(p + 2)) << 16; }
+static uint32_t be32(const BYTE* p) { return static_cast<uint32_t>(be16(p)) << 16 | be16(p + 2); }
+static uint64_t le64(const BYTE* p) { return le32(p) | static_cast<uint64_t>(le32(p + 4)) << 32; }
+static uint64_t be64(const BYTE* p) { return static_cast<uint64_t>(be32(p)) << 32 | be32(p + 4); }
+
+struct CarveContext {
+    const BYTE* data;
+    size_t size;
+
+    // Start of the archive each ZIP end of central directory record points
+    // back to -> end of the archive
+    std::unordered_map<size_t, size_t> zipEnds;
+
+    // True if length bytes at pos lie inside the document
+    bool within(uint64_t pos, uint64_t length) const {
+        return pos <= size && length <= size - pos;
+    }
+};
+
+//-------------------------------------------------------------------
+// Images
+//-------------------------------------------------------------------
+static bool isAsciiLetter(BYTE b) {
+    return (b >= 'A' && b <= 'Z') || (b >= 'a' && b <= 'z');
+}
+
+static size_t pngSize(const CarveContext& c, size_t offset) {
+    // The signature is followed by a 13-byte IHDR chunk
+    size_t pos = offset + 8;
+    if (!c.within(pos, 25) || be32(c.data + pos) != 13 || memcmp(c.data + pos + 4, "IHDR", 4) != 0 ||
+        Crc32(c.data + pos + 4, 17) != be32(c.data + pos + 21)) {
+        return 0;
+    }
+
+    while (c.within(pos, 12)) {
+        uint32_t length = be32(c.data + pos);
+        const BYTE* type = c.data + pos + 4;
+        if (length > 0x7FFFFFFF || !std::all_of(type, type + 4, isAsciiLetter) || !c.within(pos, 12ull + length)) {
+            return 0;
+        }
+        pos += 12 + static_cast<size_t>(length);
+        if (memcmp(type, "IEND", 4) == 0) {
+            return pos - offset;
+        }
+    }
+    return 0;
+}
+
+static size_t jpegSize(const CarveContext& c, size_t offset) {
+    size_t pos = offset + 2;
+    bool scanned = false;
+
+    while (c.within(pos, 2)) {
+        BYTE marker = c.data[pos + 1];
+        if (c.data[pos] != 0xFF) {
+            return 0;
+        }
+        if (marker == 0xFF) {           // Fill byte
+            ++pos;
+            continue;
+        }
+        if (marker == 0xD9) {           // EOI
+            return scanned ? pos + 2 - offset : 0;
+        }
+        if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) {
+            pos += 2;
+            continue;
+        }
+        if (marker < 0xC0 || !c.within(pos, 4)) {
+            return 0;
+        }
+
+        size_t length = be16(c.data + pos + 2);
+        if (length < 2 || !c.within(pos + 2, length)) {
+            return 0;
+        }
+        pos += 2 + length;
+
+        if (marker == 0xDA) {           // SOS
+            // Entropy-coded data runs to the next marker that is not a
+            // stuffed zero or a restart
+            scanned = true;
+            for (;;) {
+                const BYTE* ff = static_cast<const BYTE*>(memchr(c.data + pos, 0xFF, c.size - pos));
+                if (!ff || ff + 1 >= c.data + c.size) {
+                    return 0;
+                }
+                pos = ff - c.data;
+                BYTE next = ff[1];
+                if (next == 0x00 || (next >= 0xD0 && next <= 0xD7)) {
+                    pos += 2;
+                }
+                else if (next == 0xFF) {
+                    ++pos;
+                }
+                else {
+                    break;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Skips data sub-blocks up to and including the empty one that ends them
+static bool skipGifSubBlocks(const CarveContext& c, size_t& pos) {
+    while (c.within(pos, 1)) {
+        BYTE length = c.data[pos++];
+        if (length == 0) {
+            return true;
+        }
+        pos += length;
+    }
+    return false;
+}
+
+static size_t gifSize(const CarveContext& c, size_t offset) {
+    // GIF87a or GIF89a, then the logical screen descriptor
+    if (!c.within(offset, 13) || (c.data[offset + 4] != '7' && c.data[offset + 4] != '9')) {
+        return 0;
+    }
+    BYTE flags = c.data[offset + 10];
+    size_t pos = offset + 13 + ((flags & 0x80) ? 3u << ((flags & 7) + 1) : 0);
+
+    while (c.within(pos, 1)) {
+        BYTE block = c.data[pos];
+        if (block == 0x3B) {            // Trailer
+            return pos + 1 - offset;
+        }
+        if (block == 0x21) {            // Extension: label, then sub-blocks
+            pos += 2;
+        }
+        else if (block == 0x2C) {       // Image descriptor, color table, LZW code size
+            if (!c.within(pos, 10)) {
+                return 0;
+            }
+            BYTE local = c.data[pos + 9];
+            pos += 10 + ((local & 0x80) ? 3u << ((local & 7) + 1) : 0);
+            if (!c.within(pos, 1) || c.data[pos] < 2 || c.data[pos] > 8) {
+                return 0;
+            }
+            ++pos;
+        }
+        else {
+            return 0;
+        }
+
+        if (!skipGifSubBlocks(c, pos)) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+//-------------------------------------------------------------------
+// Archives
+//-------------------------------------------------------------------
+const uint32_t ZIP_LOCAL_HEADER = 0x04034B50;
+const uint32_t ZIP_CENTRAL_HEADER = 0x02014B50;
+
+static bool knownZipMethod(uint16_t method) {
+    switch (method) {
+    case 0: case 8: case 9: case 12: case 14: case 93: case 95: case 98: case 99:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Remember the archive an end of central directory record closes
+static void indexZipEnd(CarveContext& c, size_t pos) {
+    if (!c.within(pos, 22) || le16(c.data + pos + 4) != 0 || le16(c.data + pos + 6) != 0) {
+        return;     // Multi-disk archives can't be carved from one file
+    }
+
+    uint64_t directorySize = le32(c.data + pos + 12);
+    uint64_t directoryOffset = le32(c.data + pos + 16);
+    uint64_t end = pos + 22ull + le16(c.data + pos + 20);
+    if (directorySize + directoryOffset > pos || end > c.size) {
+        return;
+    }
+
+    size_t start = static_cast<size_t>(pos - directorySize - directoryOffset);
+    if (directorySize == 0 || le32(c.data + start + directoryOffset) == ZIP_CENTRAL_HEADER) {
+        c.zipEnds.emplace(start, static_cast<size_t>(end));
+    }
+}
+
+static size_t zipSize(const CarveContext& c, size_t offset) {
+    auto end = c.zipEnds.find(offset);
+    if (end != c.zipEnds.end()) {
+        return end->second - offset;
+    }
+
+    // No directory points here, so walk the local entries that give their size
+    size_t pos = offset;
+    while (c.within(pos, 30) && le32(c.data + pos) == ZIP_LOCAL_HEADER) {
+        const BYTE* header = c.data + pos;
+        if (le16(header + 4) > 63 || (le16(header + 6) & 8) || !knownZipMethod(le16(header + 8))) {
+            break;      // Bit 3: the sizes follow the data in a descriptor
+        }
+        uint64_t entry = 30ull + le16(header + 26) + le16(header + 28) + le32(header + 18);
+        if (!c.within(pos, entry)) {
+            break;
+        }
+        pos += static_cast<size_t>(entry);
+    }
+    return pos - offset;
+}
+
+// Deflate is walked rather than inflated: symbols are decoded to find where
+// the stream ends and how long its output is, but nothing is written
+const int HUFFMAN_FAST_BITS = 10;
+
+struct HuffmanCode {
+    uint16_t counts[16];                        // Codes of each length
+    uint16_t symbols[288];                      // Ordered by code
+    uint16_t fast[1 << HUFFMAN_FAST_BITS];      // Next bits -> symbol << 4 | length, or 0 if the code is longer
+
+    // False if the lengths describe more codes than there are
+    bool build(const BYTE* lengths, int count) {
+        std::fill(std::begin(counts), std::end(counts), uint16_t(0));
+        for (int i = 0; i < count; ++i) {
+            counts[lengths[i]]++;
+        }
+
+        int left = 1;
+        for (int len = 1; len < 16; ++len) {
+            left = (left << 1) - counts[len];
+            if (left < 0) {
+                return false;
+            }
+        }
+
+        uint16_t offsets[16] = {};
+        for (int len = 1; len < 15; ++len) {
+            offsets[len + 1] = offsets[len] + counts[len];
+        }
+        for (int symbol = 0; symbol < count; ++symbol) {
+            if (lengths[symbol]) {
+                symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+            }
+        }
+
+        // Codes are stored first bit first, so the table is indexed by their
+        // reversed bits
+        std::fill(std::begin(fast), std::end(fast), uint16_t(0));
+        int code = 0;
+        int index = 0;
+        for (int len = 1; len <= HUFFMAN_FAST_BITS; ++len) {
+            for (int i = 0; i < counts[len]; ++i, ++code) {
+                int reversed = 0;
+                for (int bit = 0; bit < len; ++bit) {
+                    reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+                }
+                uint16_t entry = static_cast<uint16_t>(symbols[index++] << 4 | len);
+                for (int slot = reversed; slot < (1 << HUFFMAN_FAST_BITS); slot += 1 << len) {
+                    fast[slot] = entry;
+                }
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+};
+
+// Bits of the stream, least significant first. Reading past the end yields
+// zeros and sets overrun.
+struct BitReader {
+    const BYTE* data;
+    size_t size;
+    size_t pos;
+    uint64_t bits = 0;
+    int count = 0;
+    bool overrun = false;
+
+    void refill() {
+        while (count <= 56 && pos < size) {
+            bits |= static_cast<uint64_t>(data[pos++]) << count;
+            count += 8;
+        }
+    }
+
+    void drop(int n) {
+        if (n > count) {
+            overrun = true;
+            n = count;
+        }
+        bits = n < 64 ? bits >> n : 0;
+        count -= n;
+    }
+
+    uint32_t take(int n) {
+        if (n == 0) {
+            return 0;
+        }
+        refill();
+        uint32_t value = static_cast<uint32_t>(bits & ((1ull << n) - 1));
+        drop(n);
+        return value;
+    }
+
+    // Discards the rest of the current byte and returns the offset of the next
+    size_t alignToByte() {
+        drop(count % 8);
+        return pos - count / 8;
+    }
+
+    void seek(size_t offset) {
+        pos = offset;
+        bits = 0;
+        count = 0;
+    }
+};
+
+// Symbol of the next code, or -1 if the bits are no code
+static int decodeSymbol(BitReader& in, const HuffmanCode& code) {
+    in.refill();
+    uint16_t entry = code.fast[in.bits & ((1u << HUFFMAN_FAST_BITS) - 1)];
+    if (entry) {
+        in.drop(entry & 15);
+        return entry >> 4;
+    }
+
+    // Longer codes, canonically, one bit at a time
+    int value = 0;
+    int first = 0;
+    int index = 0;
+    uint64_t bits = in.bits;
+    for (int len = 1; len < 16; ++len) {
+        value |= static_cast<int>(bits & 1);
+        bits >>= 1;
+        if (value - first < code.counts[len]) {
+            in.drop(len);
+            return code.symbols[index + value - first];
+        }
+        index += code.counts[len];
+        first = (first + code.counts[len]) << 1;
+        value <<= 1;
+    }
+    return -1;
+}
+
+const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Walks one compressed block, adding its output length to inflated
+static bool walkBlock(BitReader& in, const HuffmanCode& literals, const HuffmanCode& distances, uint64_t& inflated) {
+    for (;;) {
+        int symbol = decodeSymbol(in, literals);
+        if (symbol < 0 || in.overrun) {
+            return false;
+        }
+        if (symbol < 256) {
+            ++inflated;
+            continue;
+        }
+        if (symbol == 256) {
+            return true;
+        }
+
+        symbol -= 257;
+        if (symbol >= 29) {
+            return false;
+        }
+        uint32_t length = LENGTH_BASE[symbol] + in.take(LENGTH_EXTRA[symbol]);
+
+        int code = decodeSymbol(in, distances);
+        if (code < 0 || code >= 30) {
+            return false;
+        }
+        uint64_t distance = DISTANCE_BASE[code] + in.take(DISTANCE_EXTRA[code]);
+        if (distance > inflated) {
+            return false;   // Before the start of the stream
+        }
+        inflated += length;
+    }
+}
+
+// Reads the code lengths of a dynamic block and builds its codes
+static bool readDynamicCodes(BitReader& in, HuffmanCode& literals, HuffmanCode& distances) {
+    static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int literalCount = static_cast<int>(in.take(5)) + 257;
+    int distanceCount = static_cast<int>(in.take(5)) + 1;
+    int lengthCount = static_cast<int>(in.take(4)) + 4;
+    if (literalCount > 286 || distanceCount > 30) {
+        return false;
+    }
+
+    BYTE lengths[320] = {};
+    for (int i = 0; i < lengthCount; ++i) {
+        lengths[ORDER[i]] = static_cast<BYTE>(in.take(3));
+    }
+    HuffmanCode lengthCode;
+    if (!lengthCode.build(lengths, 19)) {
+        return false;
+    }
+
+    const int total = literalCount + distanceCount;
+    std::fill(std::begin(lengths), std::end(lengths), BYTE(0));
+    for (int i = 0; i < total;) {
+        int symbol = decodeSymbol(in, lengthCode);
+        if (symbol < 0 || in.overrun) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[i++] = static_cast<BYTE>(symbol);
+            continue;
+        }
+
+        BYTE value = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (i == 0) {
+                return false;
+            }
+            value = lengths[i - 1];
+            repeat = 3 + static_cast<int>(in.take(2));
+        }
+        else {
+            repeat = symbol == 17 ? 3 + static_cast<int>(in.take(3)) : 11 + static_cast<int>(in.take(7));
+        }
+        if (i + repeat > total) {
+            return false;
+        }
+        std::fill(lengths + i, lengths + i + repeat, value);
+        i += repeat;
+    }
+
+    return lengths[256] != 0 && literals.build(lengths, literalCount) &&
+        distances.build(lengths + literalCount, distanceCount);
+}
+
+struct FixedCodes {
+    HuffmanCode literals;
+    HuffmanCode distances;
+
+    FixedCodes() {
+        BYTE lengths[288];
+        std::fill(lengths, lengths + 144, BYTE(8));
+        std::fill(lengths + 144, lengths + 256, BYTE(9));
+        std::fill(lengths + 256, lengths + 280, BYTE(7));
+        std::fill(lengths + 280, lengths + 288, BYTE(8));
+        literals.build(lengths, 288);
+
+        std::fill(lengths, lengths + 30, BYTE(5));
+        distances.build(lengths, 30);
+    }
+};
+
+// Walks the deflate stream at pos to its final block. On success pos is the
+// first byte after it and inflated is the length of its output.
+static bool walkDeflate(const BYTE* data, size_t size, size_t& pos, uint64_t& inflated) {
+    static const FixedCodes fixed;
+
+    BitReader in{ data, size, pos };
+    HuffmanCode literals;
+    HuffmanCode distances;
+    inflated = 0;
+
+    bool last = false;
+    while (!last) {
+        last = in.take(1) != 0;
+        uint32_t type = in.take(2);
+
+        if (type == 0) {
+            // Stored: the length and its complement, then the bytes as is
+            size_t start = in.alignToByte();
+            if (start > size || size - start < 4) {
+                return false;
+            }
+            uint16_t length = le16(data + start);
+            if (static_cast<uint16_t>(~le16(data + start + 2)) != length || size - start - 4 < length) {
+                return false;
+            }
+            in.seek(start + 4 + length);
+            inflated += length;
+        }
+        else if (type == 1) {
+            if (!walkBlock(in, fixed.literals, fixed.distances, inflated)) {
+                return false;
+            }
+        }
+        else if (type != 2 || !readDynamicCodes(in, literals, distances) || !walkBlock(in, literals, distances, inflated)) {
+            return false;
+        }
+
+        if (in.overrun) {
+            return false;
+        }
+    }
+
+    pos = in.alignToByte();
+    return true;
+}
+
+static size_t gzipSize(const CarveContext& c, size_t offset) {
+    if (!c.within(offset, 10)) {
+        return 0;
+    }
+    BYTE flags = c.data[offset + 3];
+    if (flags & 0xE0) {
+        return 0;
+    }
+
+    // Optional extra field, name, comment and header CRC
+    size_t pos = offset + 10;
+    if (flags & 0x04) {
+        if (!c.within(pos, 2)) {
+            return 0;
+        }
+        pos += 2 + le16(c.data + pos);
+    }
+    for (BYTE field : { BYTE(0x08), BYTE(0x10) }) {
+        if (flags & field) {
+            const void* zero = pos < c.size ? memchr(c.data + pos, 0, c.size - pos) : nullptr;
+            if (!zero) {
+                return 0;
+            }
+            pos = static_cast<const BYTE*>(zero) - c.data + 1;
+        }
+    }
+    if (flags & 0x02) {
+        pos += 2;
+    }
+
+    // The trailer holds the CRC-32 and length of the inflated data
+    uint64_t inflated = 0;
+    if (pos > c.size || !walkDeflate(c.data, c.size, pos, inflated) || !c.within(pos, 8) ||
+        le32(c.data + pos + 4) != static_cast<uint32_t>(inflated)) {
+        return 0;
+    }
+    return pos + 8 - offset;
+}
+
+static size_t squashfsSize(const CarveContext& c, size_t offset) {
+    // Version 4 superblock, always little-endian
+    if (!c.within(offset, 96)) {
+        return 0;
+    }
+    const BYTE* super = c.data + offset;
+    uint32_t blockSize = le32(super + 12);
+    uint16_t compression = le16(super + 20);
+    uint16_t blockLog = le16(super + 22);
+    uint64_t bytesUsed = le64(super + 40);
+
+    if (le16(super + 28) != 4 || le16(super + 30) != 0 || compression < 1 || compression > 6 ||
+        blockLog < 12 || blockLog > 20 || blockSize != 1u << blockLog ||
+        bytesUsed < 96 || bytesUsed > c.size - offset) {
+        return 0;
+    }
+    return static_cast<size_t>(bytesUsed);
+}
+
+//-------------------------------------------------------------------
+// Executables
+//-------------------------------------------------------------------
+static size_t elfSize(const CarveContext& c, size_t offset) {
+    if (!c.within(offset, 52)) {
+        return 0;
+    }
+    const BYTE* header = c.data + offset;
+    const bool wide = header[4] == 2;
+    const bool big = header[5] == 2;
+    if ((header[4] != 1 && header[4] != 2) || (header[5] != 1 && header[5] != 2) || header[6] != 1) {
+        return 0;
+    }
+
+    auto half = [big](const BYTE* p) -> uint64_t { return big ? be16(p) : le16(p); };
+    auto word = [big](const BYTE* p) -> uint64_t { return big ? be32(p) : le32(p); };
+    auto address = [big, wide](const BYTE* p) -> uint64_t {
+        return wide ? (big ? be64(p) : le64(p)) : (big ? be32(p) : le32(p));
+    };
+
+    const uint64_t headerSize = wide ? 64 : 52;
+    if (!c.within(offset, headerSize) || half(header + 16) < 1 || half(header + 16) > 4 || word(header + 20) != 1) {
+        return 0;
+    }
+
+    const BYTE* sizes = header + (wide ? 52 : 40);
+    if (half(sizes) != headerSize) {
+        return 0;
+    }
+
+    const uint64_t available = c.size - offset;
+    uint64_t end = headerSize;
+
+    // Adds [start, start + length) to the file, or returns false if it
+    // reaches past the document
+    auto extend = [&](uint64_t start, uint64_t length) {
+        if (start > available || length > available - start) {
+            return false;
+        }
+        end = std::max(end, start + length);
+        return true;
+    };
+
+    // Program headers: the segments' file images
+    uint64_t programOffset = address(header + (wide ? 32 : 28));
+    uint64_t programCount = half(sizes + 4);
+    uint64_t programSize = wide ? 56 : 32;
+    if (programCount) {
+        if (half(sizes + 2) != programSize || !extend(programOffset, programCount * programSize)) {
+            return 0;
+        }
+        for (uint64_t i = 0; i < programCount; ++i) {
+            const BYTE* entry = header + programOffset + i * programSize;
+            if (!extend(address(entry + (wide ? 8 : 4)), address(entry + (wide ? 32 : 16)))) {
+                return 0;
+            }
+        }
+    }
+
+    // Section headers: every section that occupies the file
+    uint64_t sectionOffset = address(header + (wide ? 40 : 32));
+    uint64_t sectionCount = half(sizes + 8);
+    uint64_t sectionSize = wide ? 64 : 40;
+    if (sectionCount) {
+        if (half(sizes + 6) != sectionSize || !extend(sectionOffset, sectionCount * sectionSize)) {
+            return 0;
+        }
+        for (uint64_t i = 0; i < sectionCount; ++i) {
+            const BYTE* entry = header + sectionOffset + i * sectionSize;
+            uint64_t type = word(entry + 4);
+            if (type != 0 && type != 8 &&       // SHT_NULL, SHT_NOBITS
+                !extend(address(entry + (wide ? 24 : 16)), address(entry + (wide ? 32 : 20)))) {
+                return 0;
+            }
+        }
+    }
+
+    return static_cast<size_t>(end);
+}
+
+static size_t peSize(const CarveContext& c, size_t offset) {
+    if (!c.within(offset, 64)) {
+        return 0;
+    }
+    const BYTE* header = c.data + offset;
+    const uint64_t available = c.size - offset;
+
+    uint64_t pe = le32(header + 0x3C);
+    if (pe < 0x40 || pe > available || available - pe < 24 || le32(header + pe) != 0x00004550) {
+        return 0;
+    }
+
+    uint64_t sectionCount = le16(header + pe + 6);
+    uint64_t optionalSize = le16(header + pe + 20);
+    uint64_t sectionTable = pe + 24 + optionalSize;
+    uint64_t end = sectionTable + sectionCount * 40;
+    if (sectionCount == 0 || optionalSize < 64 || end > available) {
+        return 0;
+    }
+
+    const BYTE* optional = header + pe + 24;
+    uint16_t magic = le16(optional);
+    if (magic != 0x10B && magic != 0x20B) {
+        return 0;
+    }
+
+    auto extend = [&](uint64_t start, uint64_t length) {
+        if (start > available || length > available - start) {
+            return false;
+        }
+        end = std::max(end, start + length);
+        return true;
+    };
+
+    // SizeOfHeaders, then each section's raw data
+    if (!extend(0, le32(optional + 60))) {
+        return 0;
+    }
+    for (uint64_t i = 0; i < sectionCount; ++i) {
+        const BYTE* section = header + sectionTable + i * 40;
+        uint32_t rawSize = le32(section + 16);
+        if (rawSize && !extend(le32(section + 20), rawSize)) {
+            return 0;
+        }
+    }
+
+    // The certificate table follows the sections; its directory entry holds
+    // a file offset rather than an address
+    uint64_t directories = magic == 0x10B ? 96 : 112;
+    if (optionalSize >= directories + 5 * 8 && le32(optional + directories - 4) > 4) {
+        const BYTE* certificates = optional + directories + 4 * 8;
+        uint32_t size = le32(certificates + 4);
+        if (size && !extend(le32(certificates), size)) {
+            return 0;
+        }
+    }
+
+    return static_cast<size_t>(end);
+}
+
+//-------------------------------------------------------------------
+// FindEmbeddedFiles
+//-------------------------------------------------------------------
+struct EmbeddedFormat {
+    const char* name;
+    const char* magic;      // Masked pattern, as in signature rules
+
+    // Length of the file at offset, or 0 if it is not one
+    size_t (*size)(const CarveContext& context, size_t offset);
+};
+
+const EmbeddedFormat EMBEDDED_FORMATS[] = {
+    { "PNG image", "89 50 4E 47 0D 0A 1A 0A", pngSize },
+    { "JPEG image", "FF D8 FF", jpegSize },
+    { "GIF image", "47 49 46 38 3? 61", gifSize },
+    { "ZIP archive", "50 4B 03 04", zipSize },
+    { "gzip stream", "1F 8B 08", gzipSize },
+    { "ELF executable", "7F 45 4C 46", elfSize },
+    { "PE executable", "4D 5A", peSize },
+    { "SquashFS image", "68 73 71 73", squashfsSize },
+};
+
+// Not a file, but found in the same pass for zipSize
+const int ZIP_END_PATTERN = static_cast<int>(std::size(EMBEDDED_FORMATS));
+
+static const MultiPatternMatcher& embeddedFormatMatcher() {
+    static const MultiPatternMatcher matcher = [] {
+        MultiPatternMatcher built;
+        MaskedPattern pattern;
+        for (size_t i = 0; i < std::size(EMBEDDED_FORMATS); ++i) {
+            ParseMaskedPattern(EMBEDDED_FORMATS[i].magic, pattern);
+            built.add(pattern, static_cast<int>(i));
+        }
+        ParseMaskedPattern("50 4B 05 06", pattern);
+        built.add(pattern, ZIP_END_PATTERN);
+        built.build();
+        return built;
+    }();
+    return matcher;
+}
+
+std::vector<EmbeddedFile> FindEmbeddedFiles(const std::vector<BYTE>& data) {
+    std::vector<EmbeddedFile> files;
+    if (data.empty()) {
+        return files;
+    }
+    const MultiPatternMatcher& matcher = embeddedFormatMatcher();
+
+    struct Hit {
+        size_t offset;
+        int format;
+        size_t size = 0;
+        bool operator<(const Hit& other) const {
+            return offset != other.offset ? offset < other.offset : format < other.format;
+        }
+    };
+
+    size_t chunkCount = (data.size() + EMBEDDED_CHUNK_SIZE - 1) / EMBEDDED_CHUNK_SIZE;
+    std::vector<std::vector<Hit>> hits(chunkCount);
+    std::vector<std::vector<size_t>> zipEnds(chunkCount);
+
+    // One pass finds every magic number, and the ZIP end records
+    WorkerPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        size_t begin = chunk * EMBEDDED_CHUNK_SIZE;
+        size_t end = std::min(begin + EMBEDDED_CHUNK_SIZE, data.size());
+
+        matcher.scan(data.data(), data.size(), begin, end, [&](int format, size_t offset) {
+            if (format == ZIP_END_PATTERN) {
+                zipEnds[chunk].push_back(offset);
+            }
+            else {
+                hits[chunk].push_back({ offset, format });
+            }
+        });
+
+        // Matches arrive in order of anchor end, not start
+        std::sort(hits[chunk].begin(), hits[chunk].end());
+    });
+
+    CarveContext context{ data.data(), data.size() };
+    for (const auto& part : zipEnds) {
+        for (size_t pos : part) {
+            indexZipEnd(context, pos);
+        }
+    }
+
+    // Every hit is validated on its own, so the results don't depend on how
+    // the document was split
+    WorkerPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        for (Hit& hit : hits[chunk]) {
+            hit.size = EMBEDDED_FORMATS[hit.format].size(context, hit.offset);
+        }
+    });
+
+    size_t lastEnd = 0;
+    for (const auto& part : hits) {
+        for (const Hit& hit : part) {
+            if (hit.size == 0 || hit.offset < lastEnd) {
+                continue;
+            }
+            files.push_back({ hit.offset, hit.size, EMBEDDED_FORMATS[hit.format].name, hit.format });
+            lastEnd = hit.offset + hit.size;
+        }
+    }
+
+    return files;
+}
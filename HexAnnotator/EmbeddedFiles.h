@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "includes.h"
+
+// Files embedded in a document, such as the images, archives and
+// executables packed into a firmware blob. Every format's magic bytes are
+// found in one multi-pattern pass over the document, then a validator for
+// the format parses the header and structure at each hit to find where the
+// file ends:
+//
+//   PNG        chunks up to IEND; the IHDR CRC must match
+//   JPEG       segments and entropy-coded data up to EOI
+//   GIF        blocks up to the trailer
+//   ZIP        the end of central directory record that points back to the
+//              header; failing that, the last local entry with its size
+//   gzip       the deflate stream is walked to its final block, and the
+//              length in the trailer must match what it inflates to
+//   ELF        the furthest of its header tables, segments and sections
+//   PE         the furthest section, and the certificate table after them
+//   SquashFS   bytes_used from a version 4 superblock
+//
+// Only files that end inside the document are reported.
+
+struct EmbeddedFile {
+    size_t offset;
+    size_t size;
+    const char* format;     // Such as "PNG image"
+    int formatIndex;        // Position of the format in the list above
+};
+
+// Scan the document in parallel chunks and return the files found, ordered
+// by offset. A file that starts inside an earlier one is dropped, so the
+// results never overlap each other and a container is reported rather than
+// what it stores.
+std::vector<EmbeddedFile> FindEmbeddedFiles(const std::vector<BYTE>& data);
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "EntropyIndex.h"
+#include "WorkerPool.h"
+
+// Blocks up to this size look up count * log2(count) in a table instead of
+// computing it for each of their 256 counts
+const size_t ENTROPY_TABLE_LIMIT = 65536;
+
+// Bytes counted into one set of 32-bit tables before they are added up; a
+// quarter of it goes to each table
+const size_t ENTROPY_COUNT_PIECE = size_t(1) << 30;
+
+typedef uint32_t CountTables[4][256];
+
+// Add the bytes of data to tables, byte i to table i % 4
+static void countInterleaved(const uint8_t* data, size_t size, CountTables& tables) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        uint64_t low, high;
+        memcpy(&low, data + i, 8);
+        memcpy(&high, data + i + 8, 8);
+        for (int shift = 0; shift < 64; shift += 32) {
+            ++tables[0][(low >> shift) & 0xFF];
+            ++tables[1][(low >> (shift + 8)) & 0xFF];
+            ++tables[2][(low >> (shift + 16)) & 0xFF];
+            ++tables[3][(low >> (shift + 24)) & 0xFF];
+        }
+        for (int shift = 0; shift < 64; shift += 32) {
+            ++tables[0][(high >> shift) & 0xFF];
+            ++tables[1][(high >> (shift + 8)) & 0xFF];
+            ++tables[2][(high >> (shift + 16)) & 0xFF];
+            ++tables[3][(high >> (shift + 24)) & 0xFF];
+        }
+    }
+    for (; i < size; ++i) {
+        ++tables[i & 3][data[i]];
+    }
+}
+
+void CountBytes(const uint8_t* data, size_t size, ByteHistogram& histogram) {
+    for (size_t done = 0; done < size; ) {
+        const size_t length = std::min(ENTROPY_COUNT_PIECE, size - done);
+        CountTables tables = {};
+        countInterleaved(data + done, length, tables);
+        for (int value = 0; value < 256; ++value) {
+            histogram.counts[value] += uint64_t(tables[0][value]) + tables[1][value] + tables[2][value] + tables[3][value];
+        }
+        histogram.total += length;
+        done += length;
+    }
+}
+
+// With n bytes and counts c, the entropy is log2(n) - sum(c * log2(c)) / n
+double ByteHistogram::entropy() const {
+    if (total == 0) {
+        return 0;
+    }
+    double sum = 0;
+    for (uint64_t count : counts) {
+        if (count != 0) {
+            sum += count * std::log2(static_cast<double>(count));
+        }
+    }
+    return std::log2(static_cast<double>(total)) - sum / total;
+}
+
+static void checkBlockSize(size_t blockSize) {
+    if (blockSize < ENTROPY_MIN_BLOCK || blockSize > ENTROPY_MAX_BLOCK || (blockSize & (blockSize - 1)) != 0) {
+        throw std::runtime_error("The entropy block size must be a power of two from 256 bytes to 1 MB.");
+    }
+}
+
+EntropyIndex::EntropyIndex(const uint8_t* data, size_t size, size_t blockSize, const std::atomic<bool>* cancel)
+    : size(size), block(blockSize) {
+    checkBlockSize(blockSize);
+
+    entropies.resize((size + block - 1) / block);
+    spans.resize((size + ENTROPY_SPAN - 1) / ENTROPY_SPAN);
+
+    std::vector<float> weights;
+    if (block <= ENTROPY_TABLE_LIMIT) {
+        weights.resize(block + 1);
+        for (size_t count = 1; count <= block; ++count) {
+            weights[count] = static_cast<float>(count * std::log2(static_cast<double>(count)));
+        }
+    }
+
+    WorkerPool::shared().parallelFor(spans.size(), [&](size_t span) {
+        if (cancel && *cancel) {
+            return;
+        }
+        std::array<uint32_t, 256>& spanCounts = spans[span];
+        spanCounts.fill(0);
+
+        const size_t begin = span * ENTROPY_SPAN;
+        const size_t end = std::min(begin + ENTROPY_SPAN, size);
+        for (size_t offset = begin; offset < end; offset += block) {
+            const size_t length = std::min(block, end - offset);
+            CountTables tables = {};
+            countInterleaved(data + offset, length, tables);
+
+            double sum = 0;
+            for (int value = 0; value < 256; ++value) {
+                const uint32_t count = tables[0][value] + tables[1][value] + tables[2][value] + tables[3][value];
+                spanCounts[value] += count;
+                if (!weights.empty()) {
+                    sum += weights[count];
+                }
+                else if (count != 0) {
+                    sum += count * std::log2(static_cast<double>(count));
+                }
+            }
+            entropies[offset / block] = static_cast<float>(std::log2(static_cast<double>(length)) - sum / length);
+        }
+    });
+}
+
+ByteHistogram EntropyIndex::histogram(const uint8_t* data, size_t begin, size_t end) const {
+    ByteHistogram result;
+    end = std::min(end, size);
+    if (begin >= end) {
+        return result;
+    }
+
+    // Whole spans come from the index, the bytes around them are counted
+    const size_t firstSpan = (begin + ENTROPY_SPAN - 1) / ENTROPY_SPAN;
+    const size_t lastSpan = end / ENTROPY_SPAN;
+    if (firstSpan >= lastSpan) {
+        CountBytes(data + begin, end - begin, result);
+        return result;
+    }
+
+    CountBytes(data + begin, firstSpan * ENTROPY_SPAN - begin, result);
+    for (size_t span = firstSpan; span < lastSpan; ++span) {
+        for (int value = 0; value < 256; ++value) {
+            result.counts[value] += spans[span][value];
+        }
+        result.total += ENTROPY_SPAN;
+    }
+    CountBytes(data + lastSpan * ENTROPY_SPAN, end - lastSpan * ENTROPY_SPAN, result);
+    return result;
+}
+
+//-------------------------------------------------------------------
+// EntropyBuild
+//-------------------------------------------------------------------
+EntropyBuild::EntropyBuild(const uint8_t* data, size_t size, size_t blockSize)
+    : data(data), size(size), block(blockSize) {
+    checkBlockSize(blockSize);
+}
+
+EntropyBuild::~EntropyBuild() {
+    cancelRequested = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !started || exited; });
+}
+
+void EntropyBuild::start(std::function<void()> onDone) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (started) {
+            return;
+        }
+        started = true;
+    }
+
+    this->onDone = std::move(onDone);
+    WorkerPool::shared().submit([this] { run(); });
+}
+
+const EntropyIndex* EntropyBuild::index() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return result.get();
+}
+
+void EntropyBuild::run() {
+    auto index = std::make_unique<EntropyIndex>(data, size, block, &cancelRequested);
+    if (!cancelRequested) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result = std::move(index);
+        }
+        if (onDone) {
+            onDone();
+        }
+    }
+
+    // Nothing may touch the build after this; the destructor may be waiting
+    std::lock_guard<std::mutex> lock(mutex);
+    exited = true;
+    done.notify_all();
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Shannon entropy of a document's bytes, in bits per byte from 0 for a run
+// of one value to 8 for bytes that are all equally common. Compressed and
+// encrypted data sits near 8, code and tables well below.
+
+// Sizes an EntropyIndex can measure blocks of; each a power of two
+const size_t ENTROPY_MIN_BLOCK = 256;
+const size_t ENTROPY_MAX_BLOCK = 1024 * 1024;
+
+// Bytes covered by each histogram an EntropyIndex keeps, a multiple of
+// every block size
+const size_t ENTROPY_SPAN = ENTROPY_MAX_BLOCK;
+
+struct ByteHistogram {
+    uint64_t counts[256] = {};
+    uint64_t total = 0;
+
+    double entropy() const;
+};
+
+// Count the bytes of data into histogram. Successive bytes go to four
+// interleaved tables, summed at the end, so a run of one value does not make
+// every increment wait for the store of the one before.
+void CountBytes(const uint8_t* data, size_t size, ByteHistogram& histogram);
+
+//-------------------------------------------------------------------
+// EntropyIndex - entropy of every block of a document
+//-------------------------------------------------------------------
+// Built in parallel on the shared worker pool, one ENTROPY_SPAN of blocks per
+// task. Keeps one float per block for drawing and the histogram of each
+// span, so the histogram of any range only counts the bytes at its ends that
+// do not fill a span.
+class EntropyIndex {
+public:
+    // Throws std::runtime_error unless blockSize is a power of two from
+    // ENTROPY_MIN_BLOCK to ENTROPY_MAX_BLOCK. Once *cancel is set, the spans
+    // not yet counted are skipped and the index must not be used.
+    EntropyIndex(const uint8_t* data, size_t size, size_t blockSize, const std::atomic<bool>* cancel = nullptr);
+
+    size_t blockSize() const { return block; }
+    size_t blockCount() const { return entropies.size(); }
+
+    // Bits per byte of the block holding offset, which must be in the document
+    float entropyAt(size_t offset) const { return entropies[offset / block]; }
+
+    // Histogram of [begin, end) of data, the document the index was built for
+    ByteHistogram histogram(const uint8_t* data, size_t begin, size_t end) const;
+
+private:
+    size_t size;
+    size_t block;
+    std::vector<float> entropies;
+    std::vector<std::array<uint32_t, 256>> spans;
+};
+
+//-------------------------------------------------------------------
+// EntropyBuild - an EntropyIndex built in the background
+//-------------------------------------------------------------------
+// For the viewer, which draws no entropy margin until the index is ready
+// rather than holding up painting while a large document is read.
+class EntropyBuild {
+public:
+    // data must stay valid until the build is finished or destroyed. Throws
+    // std::runtime_error for block sizes EntropyIndex does not take.
+    EntropyBuild(const uint8_t* data, size_t size, size_t blockSize);
+
+    // Cancels the build and waits for it
+    ~EntropyBuild();
+
+    EntropyBuild(const EntropyBuild&) = delete;
+    EntropyBuild& operator=(const EntropyBuild&) = delete;
+
+    // Build on the worker pool. onDone is called from a worker once the index
+    // is ready, and not if the build was cancelled.
+    void start(std::function<void()> onDone);
+
+    size_t blockSize() const { return block; }
+
+    // Null until the build has finished
+    const EntropyIndex* index() const;
+
+private:
+    void run();
+
+    const uint8_t* data;
+    size_t size;
+    size_t block;
+    std::function<void()> onDone;
+
+    std::atomic<bool> cancelRequested{ false };
+    mutable std::mutex mutex;
+    std::condition_variable done;
+    bool started = false;
+    bool exited = false;
+    std::unique_ptr<EntropyIndex> result;
+};
@@ -0,0 +1,952 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+#include "Hashing.h"
+#include "WorkerPool.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define HASH_TARGET(features)
+#else
+#include <cpuid.h>
+#define HASH_TARGET(features) __attribute__((target(features)))
+#endif
+#define HASH_X86
+#endif
+
+// Little-endian hosts only, like the annotation file format
+static uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t read64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t readBigEndian32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+//-------------------------------------------------------------------
+// CPU features
+//-------------------------------------------------------------------
+struct CpuFeatures {
+    bool crc32c = false;    // SSE4.2
+    bool pclmul = false;    // With SSE4.1
+    bool sha = false;       // With SSSE3 and SSE4.1
+};
+
+static std::atomic<bool> accelerationEnabled{ true };
+
+static const CpuFeatures& detectedFeatures() {
+    static const CpuFeatures features = [] {
+        CpuFeatures found;
+#ifdef HASH_X86
+        auto cpuid = [](unsigned leaf, unsigned registers[4]) {
+#ifdef _MSC_VER
+            int values[4];
+            __cpuidex(values, static_cast<int>(leaf), 0);
+            for (int i = 0; i < 4; ++i) {
+                registers[i] = static_cast<unsigned>(values[i]);
+            }
+#else
+            __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+        };
+
+        unsigned registers[4];
+        cpuid(0, registers);
+        const unsigned maxLeaf = registers[0];
+        cpuid(1, registers);
+        const bool ssse3 = (registers[2] >> 9) & 1;
+        const bool sse41 = (registers[2] >> 19) & 1;
+        found.crc32c = (registers[2] >> 20) & 1;
+        found.pclmul = ((registers[2] >> 1) & 1) && sse41;
+        if (maxLeaf >= 7) {
+            cpuid(7, registers);
+            found.sha = ((registers[1] >> 29) & 1) && ssse3 && sse41;
+        }
+#endif
+        return found;
+    }();
+    return features;
+}
+
+static const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures none;
+    return accelerationEnabled.load(std::memory_order_relaxed) ? detectedFeatures() : none;
+}
+
+void SetHashAcceleration(bool enabled) {
+    accelerationEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::string HashAccelerations() {
+    const CpuFeatures& features = cpuFeatures();
+    std::string text;
+    for (auto [present, name] : { std::pair{ features.crc32c, "SSE4.2 CRC32" },
+                                  std::pair{ features.pclmul, "PCLMUL" },
+                                  std::pair{ features.sha, "SHA" } }) {
+        if (present) {
+            text += (text.empty() ? "" : ", ") + std::string(name);
+        }
+    }
+    return text.empty() ? "none" : text;
+}
+
+//-------------------------------------------------------------------
+// CRC-32 and CRC-32C
+//-------------------------------------------------------------------
+// Both are reflected; CRC-32 is the zlib polynomial, CRC-32C Castagnoli's
+const uint32_t CRC32_POLYNOMIAL = 0xEDB88320;
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+// Table k gives the CRC of a byte followed by k zero bytes, so eight bytes
+// are taken at once with eight independent lookups
+struct CrcTables {
+    uint32_t table[8][256];
+
+    explicit CrcTables(uint32_t polynomial) {
+        for (uint32_t value = 0; value < 256; ++value) {
+            uint32_t crc = value;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (polynomial & (0 - (crc & 1)));
+            }
+            table[0][value] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int value = 0; value < 256; ++value) {
+                table[k][value] = (table[k - 1][value] >> 8) ^ table[0][table[k - 1][value] & 0xFF];
+            }
+        }
+    }
+};
+
+// crc is the register, not the inverted value callers see
+static uint32_t crcSlicing(const CrcTables& tables, const uint8_t* p, size_t size, uint32_t crc) {
+    const auto& t = tables.table;
+    for (; size >= 8; p += 8, size -= 8) {
+        const uint32_t low = read32(p) ^ crc;
+        const uint32_t high = read32(p + 4);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; size > 0; --size) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+static const CrcTables& crc32Tables() {
+    static const CrcTables tables(CRC32_POLYNOMIAL);
+    return tables;
+}
+
+static const CrcTables& crc32cTables() {
+    static const CrcTables tables(CRC32C_POLYNOMIAL);
+    return tables;
+}
+
+#ifdef HASH_X86
+// lane moved forward 128 bits and added to next
+HASH_TARGET("pclmul,sse4.1")
+static __m128i crc32Fold(__m128i lane, __m128i next, __m128i k3k4) {
+    __m128i product = _mm_clmulepi64_si128(lane, k3k4, 0x00);
+    lane = _mm_clmulepi64_si128(lane, k3k4, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lane, next), product);
+}
+
+// Four 128-bit lanes of the message are folded forward 64 bytes at a time by
+// carry-less multiplication with x^(512+64) and x^512 mod P, then into one
+// lane, down to 64 bits, and to the CRC by Barrett reduction. The constants
+// are those of Intel's "Fast CRC Computation Using PCLMULQDQ" for the
+// reflected zlib polynomial. size is at least 64 and a multiple of 16.
+HASH_TARGET("pclmul,sse4.1")
+static uint32_t crc32Folded(const uint8_t* p, size_t size, uint32_t crc) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163CD6124);
+    const __m128i polynomial = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    p += 64;
+    size -= 64;
+
+    for (; size >= 64; p += 64, size -= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)));
+    }
+
+    // Fold the lanes, and any 16-byte blocks left, into one
+    x1 = crc32Fold(x1, x2, k3k4);
+    x1 = crc32Fold(x1, x3, k3k4);
+    x1 = crc32Fold(x1, x4, k3k4);
+    for (; size >= 16; p += 16, size -= 16) {
+        x1 = crc32Fold(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), k3k4);
+    }
+
+    // 128 bits to 64
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, low32);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+    // Barrett reduction to 32
+    x2 = _mm_and_si128(x1, low32);
+    x2 = _mm_clmulepi64_si128(x2, polynomial, 0x10);
+    x2 = _mm_and_si128(x2, low32);
+    x2 = _mm_clmulepi64_si128(x2, polynomial, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+
+HASH_TARGET("sse4.2")
+static uint32_t crc32cInstruction(const uint8_t* p, size_t size, uint32_t crc) {
+    uint64_t wide = crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        wide = _mm_crc32_u64(wide, read64(p));
+    }
+    crc = static_cast<uint32_t>(wide);
+    for (; size > 0; --size) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc) {
+    crc = ~crc;
+#ifdef HASH_X86
+    if (size >= 64 && cpuFeatures().pclmul) {
+        const size_t folded = size & ~size_t(15);
+        crc = crc32Folded(data, folded, crc);
+        data += folded;
+        size -= folded;
+    }
+#endif
+    return ~crcSlicing(crc32Tables(), data, size, crc);
+}
+
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc) {
+    crc = ~crc;
+#ifdef HASH_X86
+    if (cpuFeatures().crc32c) {
+        return ~crc32cInstruction(data, size, crc);
+    }
+#endif
+    return ~crcSlicing(crc32cTables(), data, size, crc);
+}
+
+//-------------------------------------------------------------------
+// Adler-32
+//-------------------------------------------------------------------
+const uint32_t ADLER_MODULUS = 65521;
+
+// Most bytes summed before the sums must be reduced to stay within 32 bits
+const size_t ADLER_MAX_RUN = 5552;
+
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t run = std::min(size, ADLER_MAX_RUN);
+        size -= run;
+        // b gains a once per byte, so 16 bytes add 16 * a plus the bytes
+        // weighted by how many times each is counted
+        for (; run >= 16; run -= 16, data += 16) {
+            uint32_t sum = 0;
+            uint32_t weighted = 0;
+            for (int i = 0; i < 16; ++i) {
+                sum += data[i];
+                weighted += (16 - i) * data[i];
+            }
+            b += 16 * a + weighted;
+            a += sum;
+        }
+        for (; run > 0; --run) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_MODULUS;
+        b %= ADLER_MODULUS;
+    }
+    return (b << 16) | a;
+}
+
+//-------------------------------------------------------------------
+// MD5, SHA-1 and SHA-256
+//-------------------------------------------------------------------
+// All three take 64-byte blocks and pad the input the same way: 0x80, zeros,
+// and its length in bits in the last 8 bytes of the final block
+class BlockHasher : public Hasher {
+public:
+    void update(const uint8_t* data, size_t size) override {
+        total += size;
+        if (buffered > 0) {
+            size_t taken = std::min(size, sizeof(buffer) - buffered);
+            memcpy(buffer + buffered, data, taken);
+            buffered += taken;
+            data += taken;
+            size -= taken;
+            if (buffered < sizeof(buffer)) {
+                return;
+            }
+            process(buffer, 1);
+            buffered = 0;
+        }
+        if (size >= sizeof(buffer)) {
+            process(data, size / sizeof(buffer));
+            data += size - size % sizeof(buffer);
+            size %= sizeof(buffer);
+        }
+        memcpy(buffer, data, size);
+        buffered = size;
+    }
+
+protected:
+    virtual void process(const uint8_t* blocks, size_t count) = 0;
+
+    void pad(bool bigEndianLength) {
+        const uint64_t bits = total * 8;
+        uint8_t tail[72] = { 0x80 };
+        const size_t padding = (buffered < 56 ? 56 : 120) - buffered;
+        for (int i = 0; i < 8; ++i) {
+            tail[padding + i] = static_cast<uint8_t>(bits >> (bigEndianLength ? 56 - 8 * i : 8 * i));
+        }
+        update(tail, padding + 8);
+    }
+
+private:
+    uint64_t total = 0;
+    uint8_t buffer[64];
+    size_t buffered = 0;
+};
+
+const uint32_t MD5_CONSTANTS[64] = {
+    0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+    0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+    0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+    0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+    0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+    0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+    0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+    0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391
+};
+
+const int MD5_SHIFTS[4][4] = { { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 } };
+
+// The rounds are unrolled by instantiating one step per round, so the
+// working variables are renamed rather than moved: in step i, a is v[-i % 4],
+// b the next and so on. Likewise for SHA-1 and SHA-256 below.
+template <int Step>
+inline void md5Step(uint32_t v[4], const uint32_t m[16]) {
+    uint32_t& a = v[(4 - Step % 4) % 4];
+    const uint32_t b = v[(5 - Step % 4) % 4];
+    const uint32_t c = v[(6 - Step % 4) % 4];
+    const uint32_t d = v[(7 - Step % 4) % 4];
+    uint32_t f;
+    int word;
+    if constexpr (Step < 16) {
+        f = (b & c) | (~b & d);
+        word = Step;
+    }
+    else if constexpr (Step < 32) {
+        f = (d & b) | (~d & c);
+        word = (5 * Step + 1) % 16;
+    }
+    else if constexpr (Step < 48) {
+        f = b ^ c ^ d;
+        word = (3 * Step + 5) % 16;
+    }
+    else {
+        f = c ^ (b | ~d);
+        word = (7 * Step) % 16;
+    }
+    a = b + std::rotl(f + a + MD5_CONSTANTS[Step] + m[word], MD5_SHIFTS[Step / 16][Step % 4]);
+}
+
+template <int... Steps>
+inline void md5Steps(uint32_t v[4], const uint32_t m[16], std::integer_sequence<int, Steps...>) {
+    (md5Step<Steps>(v, m), ...);
+}
+
+class Md5Hasher : public BlockHasher {
+public:
+    std::vector<uint8_t> finish() override {
+        pad(false);
+        std::vector<uint8_t> digest;
+        for (uint32_t word : state) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                digest.push_back(static_cast<uint8_t>(word >> shift));
+            }
+        }
+        return digest;
+    }
+
+private:
+    void process(const uint8_t* blocks, size_t count) override {
+        for (; count > 0; --count, blocks += 64) {
+            uint32_t m[16];
+            for (int i = 0; i < 16; ++i) {
+                m[i] = read32(blocks + 4 * i);
+            }
+            uint32_t v[4] = { state[0], state[1], state[2], state[3] };
+            md5Steps(v, m, std::make_integer_sequence<int, 64>());
+            for (int i = 0; i < 4; ++i) {
+                state[i] += v[i];
+            }
+        }
+    }
+
+    uint32_t state[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+};
+
+// w holds the last 16 words of the message schedule
+template <int Step>
+inline void sha1Step(uint32_t v[5], uint32_t w[16]) {
+    const uint32_t a = v[(5 - Step % 5) % 5];
+    uint32_t& b = v[(6 - Step % 5) % 5];
+    const uint32_t c = v[(7 - Step % 5) % 5];
+    const uint32_t d = v[(8 - Step % 5) % 5];
+    uint32_t& e = v[(9 - Step % 5) % 5];
+    if constexpr (Step >= 16) {
+        w[Step % 16] = std::rotl(w[(Step - 3) % 16] ^ w[(Step - 8) % 16] ^ w[(Step - 14) % 16] ^ w[Step % 16], 1);
+    }
+    uint32_t f, k;
+    if constexpr (Step < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+    }
+    else if constexpr (Step < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+    }
+    else if constexpr (Step < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+    }
+    else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+    }
+    e += std::rotl(a, 5) + f + k + w[Step % 16];
+    b = std::rotl(b, 30);
+}
+
+template <int... Steps>
+inline void sha1Steps(uint32_t v[5], uint32_t w[16], std::integer_sequence<int, Steps...>) {
+    (sha1Step<Steps>(v, w), ...);
+}
+
+static void sha1Portable(uint32_t state[5], const uint8_t* blocks, size_t count) {
+    for (; count > 0; --count, blocks += 64) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = readBigEndian32(blocks + 4 * i);
+        }
+        uint32_t v[5] = { state[0], state[1], state[2], state[3], state[4] };
+        sha1Steps(v, w, std::make_integer_sequence<int, 80>());
+        for (int i = 0; i < 5; ++i) {
+            state[i] += v[i];
+        }
+    }
+}
+
+#ifdef HASH_X86
+// Four rounds per sha1rnds4, with sha1msg1, xor and sha1msg2 computing the
+// message schedule four words at a time, two, one and none groups ahead. Each
+// group is its own instantiation so the message words stay in registers.
+template <int Group>
+HASH_TARGET("sha,ssse3,sse4.1")
+inline void sha1Group(__m128i& abcd, __m128i e[2], __m128i m[4]) {
+    const __m128i& current = m[Group % 4];
+    if constexpr (Group == 0) {
+        e[0] = _mm_add_epi32(e[0], current);
+    }
+    else {
+        e[Group & 1] = _mm_sha1nexte_epu32(e[Group & 1], current);
+    }
+    const __m128i roundsE = e[Group & 1];
+    e[(Group + 1) & 1] = abcd;
+    if constexpr (Group >= 3 && Group <= 18) {
+        m[(Group + 1) % 4] = _mm_sha1msg2_epu32(m[(Group + 1) % 4], current);
+    }
+    abcd = _mm_sha1rnds4_epu32(abcd, roundsE, Group / 5);
+    if constexpr (Group >= 1 && Group <= 16) {
+        m[(Group + 3) % 4] = _mm_sha1msg1_epu32(m[(Group + 3) % 4], current);
+    }
+    if constexpr (Group >= 2 && Group <= 17) {
+        m[(Group + 2) % 4] = _mm_xor_si128(m[(Group + 2) % 4], current);
+    }
+}
+
+template <int... Groups>
+HASH_TARGET("sha,ssse3,sse4.1")
+inline void sha1Groups(__m128i& abcd, __m128i e[2], __m128i m[4], std::integer_sequence<int, Groups...>) {
+    (sha1Group<Groups>(abcd, e, m), ...);
+}
+
+HASH_TARGET("sha,ssse3,sse4.1")
+static void sha1Extensions(uint32_t state[5], const uint8_t* blocks, size_t count) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ll, 0x08090A0B0C0D0E0Fll);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+    __m128i e[2] = { _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0), _mm_setzero_si128() };
+
+    for (; count > 0; --count, blocks += 64) {
+        const __m128i abcdBefore = abcd;
+        const __m128i eBefore = e[0];
+        __m128i m[4];
+        for (int i = 0; i < 4; ++i) {
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), byteSwap);
+        }
+        sha1Groups(abcd, e, m, std::make_integer_sequence<int, 20>());
+        e[0] = _mm_sha1nexte_epu32(e[0], eBefore);
+        abcd = _mm_add_epi32(abcd, abcdBefore);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = static_cast<uint32_t>(_mm_extract_epi32(e[0], 3));
+}
+#endif
+
+class Sha1Hasher : public BlockHasher {
+public:
+    std::vector<uint8_t> finish() override {
+        pad(true);
+        std::vector<uint8_t> digest;
+        for (uint32_t word : state) {
+            appendBigEndian(digest, word, 4);
+        }
+        return digest;
+    }
+
+private:
+    void process(const uint8_t* blocks, size_t count) override {
+#ifdef HASH_X86
+        if (cpuFeatures().sha) {
+            sha1Extensions(state, blocks, count);
+            return;
+        }
+#endif
+        sha1Portable(state, blocks, count);
+    }
+
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+};
+
+const uint32_t SHA256_CONSTANTS[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+template <int Step>
+inline void sha256Step(uint32_t v[8], uint32_t w[16]) {
+    const uint32_t a = v[(8 - Step) & 7];
+    const uint32_t b = v[(9 - Step) & 7];
+    const uint32_t c = v[(10 - Step) & 7];
+    uint32_t& d = v[(11 - Step) & 7];
+    const uint32_t e = v[(12 - Step) & 7];
+    const uint32_t f = v[(13 - Step) & 7];
+    const uint32_t g = v[(14 - Step) & 7];
+    uint32_t& h = v[(15 - Step) & 7];
+    if constexpr (Step >= 16) {
+        const uint32_t w15 = w[(Step - 15) % 16];
+        const uint32_t w2 = w[(Step - 2) % 16];
+        const uint32_t s0 = std::rotr(w15, 7) ^ std::rotr(w15, 18) ^ (w15 >> 3);
+        const uint32_t s1 = std::rotr(w2, 17) ^ std::rotr(w2, 19) ^ (w2 >> 10);
+        w[Step % 16] += s0 + w[(Step - 7) % 16] + s1;
+    }
+    const uint32_t s1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+    const uint32_t choice = (e & f) ^ (~e & g);
+    const uint32_t t1 = h + s1 + choice + SHA256_CONSTANTS[Step] + w[Step % 16];
+    const uint32_t s0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+    const uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+    d += t1;
+    h = t1 + s0 + majority;
+}
+
+template <int... Steps>
+inline void sha256Steps(uint32_t v[8], uint32_t w[16], std::integer_sequence<int, Steps...>) {
+    (sha256Step<Steps>(v, w), ...);
+}
+
+static void sha256Portable(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    for (; count > 0; --count, blocks += 64) {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = readBigEndian32(blocks + 4 * i);
+        }
+        uint32_t v[8];
+        std::copy(state, state + 8, v);
+        sha256Steps(v, w, std::make_integer_sequence<int, 64>());
+        for (int i = 0; i < 8; ++i) {
+            state[i] += v[i];
+        }
+    }
+}
+
+#ifdef HASH_X86
+// The state is held as ABEF and CDGH for sha256rnds2, which does two rounds;
+// sha256msg1, an alignment and sha256msg2 compute the message schedule four
+// words at a time. As for SHA-1, one instantiation per group of four rounds.
+template <int Group>
+HASH_TARGET("sha,ssse3,sse4.1")
+inline void sha256Group(__m128i& abef, __m128i& cdgh, __m128i m[4]) {
+    const __m128i& current = m[Group % 4];
+    const __m128i message = _mm_add_epi32(current, _mm_loadu_si128(reinterpret_cast<const __m128i*>(SHA256_CONSTANTS + 4 * Group)));
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+    if constexpr (Group >= 3 && Group <= 14) {
+        __m128i& next = m[(Group + 1) % 4];
+        next = _mm_add_epi32(next, _mm_alignr_epi8(current, m[(Group + 3) % 4], 4));
+        next = _mm_sha256msg2_epu32(next, current);
+    }
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+    if constexpr (Group >= 1 && Group <= 12) {
+        m[(Group + 3) % 4] = _mm_sha256msg1_epu32(m[(Group + 3) % 4], current);
+    }
+}
+
+template <int... Groups>
+HASH_TARGET("sha,ssse3,sse4.1")
+inline void sha256Groups(__m128i& abef, __m128i& cdgh, __m128i m[4], std::integer_sequence<int, Groups...>) {
+    (sha256Group<Groups>(abef, cdgh, m), ...);
+}
+
+HASH_TARGET("sha,ssse3,sse4.1")
+static void sha256Extensions(uint32_t state[8], const uint8_t* blocks, size_t count) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0C0D0E0F08090A0Bll, 0x0405060700010203ll);
+    __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i hgfe = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i abef = _mm_alignr_epi8(dcba, hgfe, 8);
+    __m128i cdgh = _mm_blend_epi16(hgfe, dcba, 0xF0);
+
+    for (; count > 0; --count, blocks += 64) {
+        const __m128i abefBefore = abef;
+        const __m128i cdghBefore = cdgh;
+        __m128i m[4];
+        for (int i = 0; i < 4; ++i) {
+            m[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * i)), byteSwap);
+        }
+        sha256Groups(abef, cdgh, m, std::make_integer_sequence<int, 16>());
+        abef = _mm_add_epi32(abef, abefBefore);
+        cdgh = _mm_add_epi32(cdgh, cdghBefore);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+#endif
+
+class Sha256Hasher : public BlockHasher {
+public:
+    std::vector<uint8_t> finish() override {
+        pad(true);
+        std::vector<uint8_t> digest;
+        for (uint32_t word : state) {
+            appendBigEndian(digest, word, 4);
+        }
+        return digest;
+    }
+
+private:
+    void process(const uint8_t* blocks, size_t count) override {
+#ifdef HASH_X86
+        if (cpuFeatures().sha) {
+            sha256Extensions(state, blocks, count);
+            return;
+        }
+#endif
+        sha256Portable(state, blocks, count);
+    }
+
+    uint32_t state[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+};
+
+//-------------------------------------------------------------------
+// XXH64
+//-------------------------------------------------------------------
+const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ull;
+const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ull;
+const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+static uint64_t xxhRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * XXH_PRIME64_2;
+    accumulator = std::rotl(accumulator, 31);
+    return accumulator * XXH_PRIME64_1;
+}
+
+static uint64_t xxhMergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= xxhRound(0, value);
+    return accumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static uint64_t xxhMergeLanes(const uint64_t lanes[4]) {
+    uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+    for (int i = 0; i < 4; ++i) {
+        hash = xxhMergeRound(hash, lanes[i]);
+    }
+    return hash;
+}
+
+// Mix in the last bytes, fewer than 32, and avalanche
+static uint64_t xxhFinish(uint64_t hash, const uint8_t* p, const uint8_t* end) {
+    for (; p + 8 <= end; p += 8) {
+        hash ^= xxhRound(0, read64(p));
+        hash = std::rotl(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(p)) * XXH_PRIME64_1;
+        hash = std::rotl(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * XXH_PRIME64_5;
+        hash = std::rotl(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t Xxh64(const void* data, size_t length, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        // Four independent lanes keep the multiplier pipelines busy
+        uint64_t lanes[4] = { seed + XXH_PRIME64_1 + XXH_PRIME64_2, seed + XXH_PRIME64_2, seed, seed - XXH_PRIME64_1 };
+        const uint8_t* limit = end - 32;
+        do {
+            for (int i = 0; i < 4; ++i) {
+                lanes[i] = xxhRound(lanes[i], read64(p + 8 * i));
+            }
+            p += 32;
+        } while (p <= limit);
+        hash = xxhMergeLanes(lanes);
+    }
+    else {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    return xxhFinish(hash + static_cast<uint64_t>(length), p, end);
+}
+
+class Xxh64Hasher : public Hasher {
+public:
+    void update(const uint8_t* data, size_t size) override {
+        total += size;
+        if (buffered > 0) {
+            size_t taken = std::min(size, sizeof(buffer) - buffered);
+            memcpy(buffer + buffered, data, taken);
+            buffered += taken;
+            data += taken;
+            size -= taken;
+            if (buffered < sizeof(buffer)) {
+                return;
+            }
+            stripe(buffer);
+            buffered = 0;
+        }
+        for (; size >= sizeof(buffer); data += sizeof(buffer), size -= sizeof(buffer)) {
+            stripe(data);
+        }
+        memcpy(buffer, data, size);
+        buffered = size;
+    }
+
+    std::vector<uint8_t> finish() override {
+        uint64_t hash = total >= sizeof(buffer) ? xxhMergeLanes(lanes) : XXH_PRIME64_5;
+        hash = xxhFinish(hash + total, buffer, buffer + buffered);
+        std::vector<uint8_t> digest;
+        appendBigEndian(digest, hash, 8);
+        return digest;
+    }
+
+private:
+    void stripe(const uint8_t* p) {
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = xxhRound(lanes[i], read64(p + 8 * i));
+        }
+    }
+
+    uint64_t lanes[4] = { XXH_PRIME64_1 + XXH_PRIME64_2, XXH_PRIME64_2, 0, 0 - XXH_PRIME64_1 };
+    uint64_t total = 0;
+    uint8_t buffer[32];
+    size_t buffered = 0;
+};
+
+//-------------------------------------------------------------------
+// Hashers
+//-------------------------------------------------------------------
+// Checksums kept as a running value
+template <uint32_t (*Update)(const uint8_t*, size_t, uint32_t), uint32_t Initial>
+class ChecksumHasher : public Hasher {
+public:
+    void update(const uint8_t* data, size_t size) override {
+        value = Update(data, size, value);
+    }
+
+    std::vector<uint8_t> finish() override {
+        std::vector<uint8_t> digest;
+        appendBigEndian(digest, value, 4);
+        return digest;
+    }
+
+private:
+    uint32_t value = Initial;
+};
+
+const char* HashName(HashAlgorithm algorithm) {
+    static const char* const names[HASH_ALGORITHM_COUNT] = {
+        "CRC-32", "CRC-32C", "Adler-32", "MD5", "SHA-1", "SHA-256", "XXH64"
+    };
+    return names[algorithm];
+}
+
+std::unique_ptr<Hasher> CreateHasher(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HASH_CRC32:   return std::make_unique<ChecksumHasher<Crc32, 0>>();
+    case HASH_CRC32C:  return std::make_unique<ChecksumHasher<Crc32c, 0>>();
+    case HASH_ADLER32: return std::make_unique<ChecksumHasher<Adler32, 1>>();
+    case HASH_MD5:     return std::make_unique<Md5Hasher>();
+    case HASH_SHA1:    return std::make_unique<Sha1Hasher>();
+    case HASH_SHA256:  return std::make_unique<Sha256Hasher>();
+    default:           return std::make_unique<Xxh64Hasher>();
+    }
+}
+
+std::string DigestText(const std::vector<uint8_t>& digest) {
+    static const char digits[] = "0123456789abcdef";
+    std::string text;
+    for (uint8_t byte : digest) {
+        text += digits[byte >> 4];
+        text += digits[byte & 15];
+    }
+    return text;
+}
+
+//-------------------------------------------------------------------
+// HashJob
+//-------------------------------------------------------------------
+HashJob::HashJob(const uint8_t* data, size_t size)
+    : data(data), size(size), digests(HASH_ALGORITHM_COUNT) {}
+
+HashJob::~HashJob() {
+    cancel();
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return !started || exited; });
+}
+
+void HashJob::start(std::function<void()> onProgress) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (started) {
+            return;
+        }
+        started = true;
+    }
+
+    this->onProgress = std::move(onProgress);
+    WorkerPool::shared().submit([this] { run(); });
+}
+
+void HashJob::acknowledge() {
+    notified = false;
+}
+
+void HashJob::cancel() {
+    cancelRequested = true;
+}
+
+bool HashJob::finished() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete;
+}
+
+uint64_t HashJob::hashedBytes() const {
+    return hashed;
+}
+
+std::string HashJob::digestText(HashAlgorithm algorithm) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return complete ? digests[algorithm] : std::string();
+}
+
+void HashJob::notify() {
+    if (onProgress && !notified.exchange(true)) {
+        onProgress();
+    }
+}
+
+void HashJob::run() {
+    WorkerPool::shared().parallelFor(HASH_ALGORITHM_COUNT, [this](size_t index) {
+        std::unique_ptr<Hasher> hasher = CreateHasher(static_cast<HashAlgorithm>(index));
+        for (size_t offset = 0; offset < size && !cancelRequested; offset += HASH_BLOCK_SIZE) {
+            const size_t length = std::min(HASH_BLOCK_SIZE, size - offset);
+            hasher->update(data + offset, length);
+            hashed += length;
+            notify();
+        }
+        if (!cancelRequested) {
+            std::string text = DigestText(hasher->finish());
+            std::lock_guard<std::mutex> lock(mutex);
+            digests[index] = std::move(text);
+        }
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        complete = true;
+    }
+    notified = false;
+    notify();
+
+    // Nothing may touch the job after this; the destructor may be waiting
+    std::lock_guard<std::mutex> lock(mutex);
+    exited = true;
+    done.notify_all();
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Checksums and hashes of byte ranges. Each algorithm is a Hasher fed in
+// pieces of any size. On x86-64 the CPU is asked once which instructions it
+// has: CRC-32C then uses the SSE4.2 crc32 instruction, CRC-32 folds 64 bytes
+// at a time with carry-less multiplies, and SHA-1 and SHA-256 use the SHA
+// extensions. Otherwise, and on other CPUs, portable code gives the same
+// results: slicing-by-8 tables for the CRCs and the reference round
+// functions for the rest.
+
+enum HashAlgorithm {
+    HASH_CRC32,         // zlib, PNG, ZIP
+    HASH_CRC32C,        // Castagnoli, as in iSCSI and ext4
+    HASH_ADLER32,
+    HASH_MD5,
+    HASH_SHA1,
+    HASH_SHA256,
+    HASH_XXH64,         // Seed 0
+    HASH_ALGORITHM_COUNT
+};
+
+// Name as shown to the user, such as "SHA-256"
+const char* HashName(HashAlgorithm algorithm);
+
+class Hasher {
+public:
+    virtual ~Hasher() = default;
+
+    virtual void update(const uint8_t* data, size_t size) = 0;
+
+    // The digest as it is usually written out. Checksums and XXH64 are
+    // integers, given most significant byte first so the hex reads as their
+    // value. The hasher may not be updated afterwards.
+    virtual std::vector<uint8_t> finish() = 0;
+};
+
+std::unique_ptr<Hasher> CreateHasher(HashAlgorithm algorithm);
+
+// Lowercase hex
+std::string DigestText(const std::vector<uint8_t>& digest);
+
+// The accelerated paths this CPU takes, such as "SSE4.2 CRC32, PCLMUL, SHA",
+// or "none"
+std::string HashAccelerations();
+
+// Turns the accelerated paths off, or back on, so the portable ones can be
+// timed or tested on the same CPU. On by default.
+void SetHashAcceleration(bool enabled);
+
+// Running checksums: pass the result of one call as the last argument of the
+// next to continue it
+uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t Crc32c(const uint8_t* data, size_t size, uint32_t crc = 0);
+uint32_t Adler32(const uint8_t* data, size_t size, uint32_t adler = 1);
+
+// XXH64 of a single buffer
+uint64_t Xxh64(const void* data, size_t length, uint64_t seed);
+
+// Bytes hashed between checks for cancellation and progress reports
+const size_t HASH_BLOCK_SIZE = 1024 * 1024;
+
+//-------------------------------------------------------------------
+// HashJob - every algorithm over one range, in the background
+//-------------------------------------------------------------------
+// Each algorithm streams through the range on its own worker, so the job
+// takes as long as the slowest of them rather than all of them together.
+class HashJob {
+public:
+    // data must stay valid until the job is finished or destroyed
+    HashJob(const uint8_t* data, size_t size);
+
+    // Cancels the job and waits for it
+    ~HashJob();
+
+    HashJob(const HashJob&) = delete;
+    HashJob& operator=(const HashJob&) = delete;
+
+    // Start hashing on the worker pool. onProgress is called from a worker as
+    // blocks are hashed and when the job finishes, and not again until
+    // acknowledge() is called, as with DocumentSearch.
+    void start(std::function<void()> onProgress);
+    void acknowledge();
+    void cancel();
+
+    bool finished() const;
+
+    // Bytes hashed so far, summed over the algorithms
+    uint64_t hashedBytes() const;
+
+    // Empty until the job has finished
+    std::string digestText(HashAlgorithm algorithm) const;
+
+private:
+    void run();
+    void notify();
+
+    const uint8_t* data;
+    size_t size;
+    std::function<void()> onProgress;
+
+    std::atomic<bool> cancelRequested{ false };
+    std::atomic<bool> notified{ false };
+    std::atomic<uint64_t> hashed{ 0 };
+
+    mutable std::mutex mutex;
+    std::condition_variable done;
+    bool started = false;
+    bool complete = false;
+    bool exited = false;
+    std::vector<std::string> digests;
+};
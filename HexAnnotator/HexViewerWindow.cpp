@@ -6,7 +6,17 @@
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
+#include <iterator>
 #include "includes.h"
+#include "AutosaveJournal.h"
+#include "ByteSearch.h"
+#include "ChecksumFields.h"
+#include "ComputedAnnotations.h"
+#include "ContentFingerprint.h"
+#include "EntropyIndex.h"
+#include "SelectionUpdates.h"
+#include "StructTemplate.h"
+#include "WorkerPool.h"
 
 // Constants for visualization - adjusted for better spacing
 const int BYTES_PER_ROW = 16;
@@ -18,20 +28,75 @@ const int HEX_BYTE_SPACING = 20;
 const int ASCII_MARGIN = 440;
 const int ANNOTATION_MARGIN = 3;
 
+// Bar between the offset and the hex bytes showing the entropy of the row's block
+const int ENTROPY_BAR_X = 88;
+const int ENTROPY_BAR_WIDTH = 6;
+
+// Annotations formatted by one pool task when the byte map is built
+const size_t ANNOTATIONS_PER_TASK = 16384;
+
+// Shown after the label of annotations whose bytes changed in a rebase
+const char* const STALE_SUFFIX = " [stale]";
+
+// Shown after the label of checksum fields that do not match, or could not
+// be verified, in checksumMismatchColor
+const char* const MISMATCH_SUFFIX = " [checksum mismatch]";
+const char* const UNVERIFIED_SUFFIX = " [checksum not verified]";
+
+// How often a document checks whether its autosave journal needs compacting
+const UINT_PTR AUTOSAVE_TIMER_ID = 1;
+const UINT AUTOSAVE_INTERVAL_MS = 30000;
+
+// Coalesces selection changes into one interpreter and status bar update
+// per frame, see SelectionUpdates.h
+const UINT_PTR SELECTION_TIMER_ID = 2;
+const UINT SELECTION_UPDATE_INTERVAL_MS = 16;
+
+// Posted to a viewer by the worker that built its entropy index
+#define WM_ENTROPY_READY (WM_APP + 3)
+
 extern std::unordered_map<HWND, DocumentWindowState*> windowStates;
 extern HWND g_hActiveHexViewer;
 extern HWND g_hGridView;
+extern size_t g_entropyBlockSize;
 
-void UpdateGridView(HWND hGridView, int offset, const std::vector<BYTE>& data);
+void UpdateGridView(HWND hGridView, const DataInterpretation& values);
 void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state);
 void DrawAnnotations(HWND hwnd, HDC hdc, DocumentWindowState& state);
-std::string FormatData(const std::vector<BYTE>& data, int offset, int length, const std::string& format);
+std::string FormatData(const std::vector<BYTE>& data, int offset, int length, std::string_view format);
 void ShowContextMenu(HWND hwnd, int x, int y, DocumentWindowState& state);
 void CreateAnnotation(HWND hwnd, DocumentWindowState& state);
 void EditAnnotation(HWND hwnd, int index, DocumentWindowState& state);
 void ShowAnnotationInputDialog(HWND hwnd, char* buffer, int bufferSize, char* format, int formatSize);
+bool ShowExpressionDialog(HWND hwnd, char* start, char* length, char* value, int bufferSize);
+void EditAnnotationExpressions(HWND hwnd, int index, DocumentWindowState& state);
+bool ShowChecksumDialog(HWND hwnd, char* algorithm, char* covered, bool& bigEndian, int bufferSize);
+void EditAnnotationChecksum(HWND hwnd, int index, DocumentWindowState& state);
 void tagBytesThatAreAnnotated(DocumentWindowState& state);
-void UpdateStatusbar(int offset, int length);
+void UpdateStatusbar(int offset, int length, const char* summary);
+void InsertAnnotation(DocumentWindowState& state, int index, Annotation annotation);
+void UpdateAnnotation(DocumentWindowState& state, int index, Annotation annotation);
+void EraseAnnotation(DocumentWindowState& state, int index);
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+void tagAppendedAnnotations(DocumentWindowState& state, size_t firstIndex);
+void retagEditedAnnotation(DocumentWindowState& state, int index);
+void retagInsertedAnnotation(DocumentWindowState& state, int index);
+void retagErasedAnnotation(DocumentWindowState& state, int index);
+void ApplyStructTemplateAtCursor(HWND hwnd, DocumentWindowState& state);
+bool UndoAnnotationEdit(DocumentWindowState& state);
+bool RedoAnnotationEdit(DocumentWindowState& state);
+void UndoLastEdit(HWND hwnd, DocumentWindowState& state);
+void ShowFindAnnotationsDialog(HWND hwnd, DocumentWindowState& state);
+void ShowFindBytesDialog(HWND hwnd, DocumentWindowState& state);
+void FindNextMatch(HWND hwnd, DocumentWindowState& state, bool forward);
+void RedoLastEdit(HWND hwnd, DocumentWindowState& state);
+void SelectionChanged(HWND hwnd, DocumentWindowState& state);
+const EntropyIndex* DocumentEntropy(HWND hwnd, DocumentWindowState& state);
+void ApplySelectionUpdate(HWND hwnd, DocumentWindowState& state);
+
+// Tracks which document's values the interpreter grid shows
+static InterpreterGrid interpreterGrid;
+
 //-------------------------------------------------------------------
 // Hex Viewer Window Procedure
 //-------------------------------------------------------------------
@@ -67,6 +132,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
                 pState->fileData.resize(fileSize);
                 file.read(reinterpret_cast<char*>(pState->fileData.data()), fileSize);
                 pState->fileName = fileName;
+                pState->fingerprint = FingerprintContents(pState->fileData.data(), fileSize);
 
                 // Setup scrollbars
                 pState->totalRows = (fileSize + BYTES_PER_ROW - 1) / BYTES_PER_ROW;
@@ -75,6 +141,14 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
                 // Update window title
                 std::string title = "Hex View - " + pState->fileName;
                 SetWindowText(hwnd, title.c_str());
+
+                // Annotations autosaved for this path win; otherwise any set
+                // catalogued for the same contents under another name
+                if (!OpenAutosave(hwnd, *pState)) {
+                    AttachCatalogAnnotations(*pState);
+                    StartAutosave(*pState);
+                }
+                SetTimer(hwnd, AUTOSAVE_TIMER_ID, AUTOSAVE_INTERVAL_MS, NULL);
                 tagBytesThatAreAnnotated(*pState);
             }
         }
@@ -94,6 +168,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
         for (int i = 0; i < std::size(annotationColors); ++i) {
             pState->gdi.annotationPen[i] = CreatePen(PS_SOLID, 1, annotationColors[i]);
         }
+        pState->gdi.mismatchPen = CreatePen(PS_SOLID, 1, checksumMismatchColor);
 
         return 0;
     }
@@ -104,11 +179,11 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
         if ((HWND)lParam == hwnd) {
             g_hActiveHexViewer = hwnd;
 
-            int gridViewOffset = std::min(pState->selectionStart, pState->selectionEnd); // pState->cursorPosition;
-
-            // Update grid view if there's a selection
-            if (pState && gridViewOffset >= 0 && !pState->fileData.empty()) {
-                UpdateGridView(g_hGridView, gridViewOffset, pState->fileData);
+            // Show this document's values, and apply any update it still
+            // has scheduled rather than waiting for the timer
+            if (pState && pState->selectionUpdates) {
+                KillTimer(hwnd, SELECTION_TIMER_ID);
+                ApplySelectionUpdate(hwnd, *pState);
             }
         }
         return 0;
@@ -243,9 +318,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
             pState->selectionEnd = offset;
             pState->isSelecting = true;
 
-            // Update the grid view with the new selection
-            UpdateGridView(g_hGridView, offset, pState->fileData);
-            UpdateStatusbar(offset, 1);
+            SelectionChanged(hwnd, *pState);
             InvalidateRect(hwnd, NULL, TRUE);
         }
 
@@ -295,10 +368,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
             pState->cursorPosition = offset;
             pState->selectionEnd = offset;
 
-            int gridViewOffset = std::min(pState->selectionStart, pState->selectionEnd); // pState->cursorPosition;
-            // Update grid view with new selection
-            UpdateGridView(g_hGridView, gridViewOffset, pState->fileData);
-            UpdateStatusbar(gridViewOffset, abs(pState->selectionEnd - pState->selectionStart)+1);
+            SelectionChanged(hwnd, *pState);
             InvalidateRect(hwnd, NULL, TRUE);
         }
 
@@ -312,6 +382,31 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
         return 0;
     }
 
+    case WM_KEYDOWN:
+    {
+        if (!pState) return 0;
+
+        bool ctrl = GetKeyState(VK_CONTROL) < 0;
+        bool shift = GetKeyState(VK_SHIFT) < 0;
+
+        if (ctrl && (wParam == 'Z') && !shift) {
+            UndoLastEdit(hwnd, *pState);
+        }
+        else if (ctrl && (wParam == 'Y' || (wParam == 'Z' && shift))) {
+            RedoLastEdit(hwnd, *pState);
+        }
+        else if (ctrl && shift && wParam == 'F') {
+            ShowFindAnnotationsDialog(hwnd, *pState);
+        }
+        else if (ctrl && !shift && wParam == 'F') {
+            ShowFindBytesDialog(hwnd, *pState);
+        }
+        else if (!ctrl && wParam == VK_F3) {
+            FindNextMatch(hwnd, *pState, !shift);
+        }
+        return 0;
+    }
+
     case WM_PAINT:
     {
         if (!pState) return 0;
@@ -382,9 +477,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
         if (offset >= 0 && offset < pState->fileData.size()) {
             pState->cursorPosition = offset;
 
-            // Update grid view
-            int gridViewOffset = std::min(pState->selectionStart, pState->selectionEnd); // pState->cursorPosition;
-            UpdateGridView(g_hGridView, gridViewOffset, pState->fileData);
+            SelectionChanged(hwnd, *pState);
         }
 
         return 0;
@@ -434,7 +527,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
 
             if (annotationIndex >= 0) {
                 EditAnnotation(hwnd, annotationIndex, *pState);
-                tagBytesThatAreAnnotated(*pState);
+                retagEditedAnnotation(*pState, annotationIndex);
             }
             break;
         }
@@ -451,8 +544,8 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
             }
 
             if (annotationIndex >= 0) {
-                pState->annotations.erase(pState->annotations.begin() + annotationIndex);
-                tagBytesThatAreAnnotated(*pState);
+                EraseAnnotation(*pState, annotationIndex);
+                retagErasedAnnotation(*pState, annotationIndex);
                 InvalidateRect(hwnd, NULL, TRUE);
             }
             break;
@@ -476,15 +569,17 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
 
             if (annotationIndex >= 0) {
                 // Set the format based on the menu item
+                Annotation edited = pState->annotations[annotationIndex];
                 switch (wmId) {
-                case 2003: pState->annotations[annotationIndex].displayFormat = "hex"; break;
-                case 2004: pState->annotations[annotationIndex].displayFormat = "int"; break;
-                case 2005: pState->annotations[annotationIndex].displayFormat = "float"; break;
-                case 2006: pState->annotations[annotationIndex].displayFormat = "double"; break;
-                case 2007: pState->annotations[annotationIndex].displayFormat = "ascii"; break;
-                case 2008: pState->annotations[annotationIndex].displayFormat = "unicode"; break;
+                case 2003: edited.displayFormat = "hex"; break;
+                case 2004: edited.displayFormat = "int"; break;
+                case 2005: edited.displayFormat = "float"; break;
+                case 2006: edited.displayFormat = "double"; break;
+                case 2007: edited.displayFormat = "ascii"; break;
+                case 2008: edited.displayFormat = "unicode"; break;
                 }
-                tagBytesThatAreAnnotated(*pState);
+                UpdateAnnotation(*pState, annotationIndex, std::move(edited));
+                retagEditedAnnotation(*pState, annotationIndex);
 
                 InvalidateRect(hwnd, NULL, TRUE);
             }
@@ -493,19 +588,99 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
 
         case 2009: // Create Annotation
             if (pState->selectionStart >= 0 && pState->selectionEnd >= 0) {
+                size_t firstIndex = pState->annotations.size();
                 CreateAnnotation(hwnd, *pState);
-                tagBytesThatAreAnnotated(*pState);
+                if (pState->annotations.size() > firstIndex) {
+                    tagAppendedAnnotations(*pState, firstIndex);
+                }
+            }
+            break;
+
+        case 2010: // Apply Struct Template
+            if (pState->cursorPosition >= 0) {
+                ApplyStructTemplateAtCursor(hwnd, *pState);
             }
             break;
+
+        case 2011: // Edit Expressions
+        {
+            int annotationIndex = -1;
+            for (size_t i = 0; i < pState->annotations.size(); i++) {
+                const auto& anno = pState->annotations[i];
+                if (pState->cursorPosition >= anno.startOffset && pState->cursorPosition <= anno.endOffset) {
+                    annotationIndex = static_cast<int>(i);
+                    break;
+                }
+            }
+
+            if (annotationIndex >= 0) {
+                EditAnnotationExpressions(hwnd, annotationIndex, *pState);
+            }
+            break;
+        }
+
+        case 2012: // Checksum
+        {
+            int annotationIndex = -1;
+            for (size_t i = 0; i < pState->annotations.size(); i++) {
+                const auto& anno = pState->annotations[i];
+                if (pState->cursorPosition >= anno.startOffset && pState->cursorPosition <= anno.endOffset) {
+                    annotationIndex = static_cast<int>(i);
+                    break;
+                }
+            }
+
+            if (annotationIndex >= 0) {
+                EditAnnotationChecksum(hwnd, annotationIndex, *pState);
+            }
+            break;
+        }
         }
 
         return 0;
     }
 
+    case WM_TIMER:
+    {
+        if (pState && wParam == SELECTION_TIMER_ID) {
+            KillTimer(hwnd, SELECTION_TIMER_ID);
+            ApplySelectionUpdate(hwnd, *pState);
+        }
+        if (pState && wParam == AUTOSAVE_TIMER_ID) {
+            CompactAutosave(*pState);
+
+            std::string error = TakeAutosaveError(*pState);
+            if (!error.empty()) {
+                KillTimer(hwnd, AUTOSAVE_TIMER_ID);
+                std::string message = "Autosave stopped for this document.\n\n" + error;
+                MessageBox(hwnd, message.c_str(), "Autosave", MB_OK | MB_ICONWARNING);
+            }
+        }
+        return 0;
+    }
+
+    case WM_ENTROPY_READY:
+    {
+        // Draw the margin, and the entropy of the selection with it
+        if (pState) {
+            InvalidateRect(hwnd, NULL, FALSE);
+            if (hwnd == g_hActiveHexViewer && pState->selectionStart >= 0) {
+                SelectionChanged(hwnd, *pState);
+            }
+        }
+        return 0;
+    }
+
     case WM_DESTROY:
     {
-        // Clean up this window's state
+        // Clean up this window's state. Releasing the autosave journal
+        // commits whatever it still has queued.
         if (pState) {
+            KillTimer(hwnd, AUTOSAVE_TIMER_ID);
+            KillTimer(hwnd, SELECTION_TIMER_ID);
+            if (pState->selectionUpdates) {
+                interpreterGrid.forget(*pState->selectionUpdates);
+            }
             DeleteObject(pState->gdi.hFontHex);
             DeleteObject(pState->gdi.hFontAnnotations);
             DeleteObject(pState->gdi.selectionBrush);
@@ -513,6 +688,7 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
             for (int i = 0; i < std::size(annotationColors); ++i) {
                 DeleteObject(pState->gdi.annotationPen[i]);
             }
+            DeleteObject(pState->gdi.mismatchPen);
 
             delete pState;
             windowStates.erase(hwnd);
@@ -524,31 +700,277 @@ LRESULT CALLBACK HexViewerProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam
     return DefMDIChildProc(hwnd, msg, wParam, lParam);
 }
 
-void tagBytesThatAreAnnotated(DocumentWindowState& state) {
+//-------------------------------------------------------------------
+// Selection updates
+//-------------------------------------------------------------------
+// Record the selection and schedule the grid and status bar to follow it
+void SelectionChanged(HWND hwnd, DocumentWindowState& state) {
+    if (!state.selectionUpdates) {
+        state.selectionUpdates = std::make_shared<SelectionUpdates>();
+    }
+
+    int offset = std::min(state.selectionStart, state.selectionEnd);
+    int length = abs(state.selectionEnd - state.selectionStart) + 1;
+    if (state.selectionUpdates->request(offset, length)) {
+        SetTimer(hwnd, SELECTION_TIMER_ID, SELECTION_UPDATE_INTERVAL_MS, NULL);
+    }
+}
+
+// Bring the grid and status bar up to date with the latest selection, writing
+// whichever of them InterpreterGrid says need it
+void ApplySelectionUpdate(HWND hwnd, DocumentWindowState& state) {
+    SelectionUpdates& updates = *state.selectionUpdates;
+    SelectionRefresh refresh = interpreterGrid.apply(updates, state.fileData.data(), state.fileData.size(),
+        hwnd == g_hActiveHexViewer);
+    if (refresh.grid) {
+        UpdateGridView(g_hGridView, updates.interpretation());
+    }
+    if (!refresh.status) {
+        return;
+    }
+
+    // With the entropy margin shown, so is the entropy of the selection
+    char summary[48] = "";
+    if (const EntropyIndex* entropy = DocumentEntropy(hwnd, state)) {
+        size_t begin = static_cast<size_t>(updates.offset());
+        ByteHistogram histogram = entropy->histogram(state.fileData.data(), begin, begin + updates.length());
+        sprintf_s(summary, sizeof(summary), "Entropy: %.3f bits/byte", histogram.entropy());
+    }
+    UpdateStatusbar(updates.offset(), updates.length(), summary);
+}
+
+// The entropy index for the block size the margin shows; null while the
+// margin is hidden or the index is being built. Starts a build if there is
+// none for the block size yet, which posts WM_ENTROPY_READY to hwnd when done.
+const EntropyIndex* DocumentEntropy(HWND hwnd, DocumentWindowState& state) {
+    if (g_entropyBlockSize == 0) {
+        return nullptr;
+    }
+    if (!state.entropyBuild || state.entropyBuild->blockSize() != g_entropyBlockSize) {
+        state.entropyBuild = std::make_shared<EntropyBuild>(state.fileData.data(), state.fileData.size(), g_entropyBlockSize);
+        state.entropyBuild->start([hwnd] { PostMessage(hwnd, WM_ENTROPY_READY, 0, 0); });
+    }
+    return state.entropyBuild->index();
+}
+
+// Blue for uniform bytes through green to red for random ones
+static COLORREF entropyColor(float bits) {
+    int level = std::clamp(static_cast<int>(bits * 64), 0, 511);
+    return level < 256 ? RGB(0, level, 255 - level) : RGB(level - 256, 511 - level, 0);
+}
+
+static void patchByteMap(DocumentWindowState& state, std::vector<int> indices);
+
+static ByteRange formatByteRange(const DocumentWindowState& state, size_t annoIdx) {
+    const auto& anno = state.annotations[annoIdx];
+
+    // Record arrays are formatted per field when looked up; computed values
+    // and evaluation errors replace the bytes' own value
+    std::string formattedValue;
+    if (!anno.layout && !GetComputedValueText(state, annoIdx, formattedValue)) {
+        formattedValue = FormatData(state.fileData, anno.startOffset, anno.endOffset - anno.startOffset + 1, anno.displayFormat);
+    }
+
+    return ByteRange{
+        .start = anno.startOffset,
+        .end = anno.endOffset,
+        .info = {
+            formattedValue,
+            anno.colorIndex,
+            anno.endOffset - anno.startOffset + 1,
+            anno.startOffset,
+            static_cast<int>(annoIdx)
+        },
+        .layout = anno.layout
+    };
+}
+
+// Formats annotations [first, last) into unsorted byte ranges. Formatting
+// dominates, so the range is split across the worker pool.
+static std::vector<ByteRange> formatByteRanges(const DocumentWindowState& state, size_t first, size_t last) {
+    size_t taskCount = (last - first + ANNOTATIONS_PER_TASK - 1) / ANNOTATIONS_PER_TASK;
+    std::vector<std::vector<ByteRange>> parts(taskCount);
+
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t begin = first + task * ANNOTATIONS_PER_TASK;
+        size_t end = std::min(begin + ANNOTATIONS_PER_TASK, last);
+        auto& byteTags = parts[task];
+        byteTags.reserve(end - begin);
+
+        // Pre-populate annotation information for ASCII section formatting
+        for (size_t annoIdx = begin; annoIdx < end; annoIdx++) {
+            byteTags.push_back(formatByteRange(state, annoIdx));
+        }
+    });
+
     std::vector<ByteRange> byteTags;
-    byteTags.reserve(state.annotations.size());
-
-    // Pre-populate annotation information for ASCII section formatting
-    for (size_t annoIdx = 0; annoIdx < state.annotations.size(); annoIdx++) {
-        const auto& anno = state.annotations[annoIdx];
-        std::string formattedValue = FormatData(state.fileData, anno.startOffset, anno.endOffset - anno.startOffset + 1, anno.displayFormat);
-        
-        byteTags.push_back(ByteRange{
-            .start = anno.startOffset,
-            .end = anno.endOffset,
-            .info = {
-                formattedValue,
-                anno.colorIndex,
-                anno.endOffset - anno.startOffset + 1,
-                anno.startOffset,
-                static_cast<int>(annoIdx)
-            }
-        });
+    byteTags.reserve(last - first);
+    for (auto& part : parts) {
+        std::move(part.begin(), part.end(), std::back_inserter(byteTags));
     }
+    return byteTags;
+}
+
+void tagBytesThatAreAnnotated(DocumentWindowState& state) {
+    std::vector<int> changed;
+    EvaluateComputedAnnotations(state, changed);
+    VerifyAllChecksums(state);
+
+    std::vector<ByteRange> byteTags = formatByteRanges(state, 0, state.annotations.size());
 
     std::sort(byteTags.begin(), byteTags.end());
 
     state.annotationMap.ranges = std::move(byteTags);
+    state.annotationMap.data = &state.fileData;
+    std::fill(std::begin(state.annotationMap.elementKey), std::end(state.annotationMap.elementKey), -1);
+}
+
+// Adds annotations appended from firstIndex onward to the byte map without
+// reformatting the ones that are already there.
+void tagAppendedAnnotations(DocumentWindowState& state, size_t firstIndex) {
+    std::vector<int> changed;
+    if (!EvaluateComputedAnnotations(state, changed)) {
+        tagBytesThatAreAnnotated(state);
+        return;
+    }
+
+    std::vector<ByteRange> added = formatByteRanges(state, firstIndex, state.annotations.size());
+    std::sort(added.begin(), added.end());
+
+    auto& ranges = state.annotationMap.ranges;
+    std::vector<ByteRange> merged;
+    merged.reserve(ranges.size() + added.size());
+    std::merge(std::make_move_iterator(ranges.begin()), std::make_move_iterator(ranges.end()),
+        std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()),
+        std::back_inserter(merged));
+
+    ranges = std::move(merged);
+    state.annotationMap.data = &state.fileData;
+    std::fill(std::begin(state.annotationMap.elementKey), std::end(state.annotationMap.elementKey), -1);
+
+    // Existing annotations computed from the new ones
+    changed.erase(std::remove_if(changed.begin(), changed.end(),
+        [&](int index) { return index >= static_cast<int>(firstIndex); }), changed.end());
+    VerifyAppendedChecksums(state, firstIndex);
+    VerifyEditedChecksums(state, changed);
+    if (!changed.empty()) {
+        patchByteMap(state, std::move(changed));
+    }
+}
+
+// Replaces the byte ranges of the listed annotations. The other ranges are
+// neither reformatted nor re-sorted, only shifted to make room.
+static void patchByteMap(DocumentWindowState& state, std::vector<int> indices) {
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    auto& ranges = state.annotationMap.ranges;
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [&](const ByteRange& range) {
+        return std::binary_search(indices.begin(), indices.end(), range.info.annotationIndex);
+    }), ranges.end());
+
+    size_t middle = ranges.size();
+    for (int index : indices) {
+        ranges.push_back(formatByteRange(state, index));
+    }
+    std::sort(ranges.begin() + middle, ranges.end());
+    std::inplace_merge(ranges.begin(), ranges.begin() + middle, ranges.end());
+
+    std::fill(std::begin(state.annotationMap.elementKey), std::end(state.annotationMap.elementKey), -1);
+}
+
+// Re-tags one annotation after an in-place edit, together with the computed
+// annotations downstream of it
+void retagEditedAnnotation(DocumentWindowState& state, int index) {
+    std::vector<int> changed{ index };
+    if (!EvaluateComputedAnnotations(state, changed)) {
+        tagBytesThatAreAnnotated(state);
+        return;
+    }
+    VerifyEditedChecksums(state, changed);
+    patchByteMap(state, std::move(changed));
+}
+
+// Renumbers the byte ranges from index onward by delta, without reformatting
+static void renumberByteMap(DocumentWindowState& state, int index, int delta) {
+    for (ByteRange& range : state.annotationMap.ranges) {
+        if (range.info.annotationIndex >= index) {
+            range.info.annotationIndex += delta;
+        }
+    }
+}
+
+// Re-tags after an annotation was inserted ahead of others, which undoing a
+// removal does: the later ranges are renumbered, not reformatted
+void retagInsertedAnnotation(DocumentWindowState& state, int index) {
+    std::vector<int> changed{ index };
+    if (!EvaluateComputedAnnotations(state, changed)) {
+        tagBytesThatAreAnnotated(state);
+        return;
+    }
+    renumberByteMap(state, index, 1);
+    VerifyAllChecksums(state);
+    patchByteMap(state, std::move(changed));
+}
+
+// Re-tags after an annotation was removed: its range is dropped, the later
+// ones are renumbered, and only the computed annotations that read its label
+// are reformatted
+void retagErasedAnnotation(DocumentWindowState& state, int index) {
+    std::vector<int> changed;
+    if (!EvaluateComputedAnnotations(state, changed)) {
+        tagBytesThatAreAnnotated(state);
+        return;
+    }
+
+    auto& ranges = state.annotationMap.ranges;
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(),
+        [index](const ByteRange& range) { return range.info.annotationIndex == index; }), ranges.end());
+    renumberByteMap(state, index + 1, -1);
+    std::fill(std::begin(state.annotationMap.elementKey), std::end(state.annotationMap.elementKey), -1);
+
+    VerifyAllChecksums(state);
+    if (!changed.empty()) {
+        patchByteMap(state, std::move(changed));
+    }
+}
+
+//-------------------------------------------------------------------
+// ByteMap::elementAt - Field of a record-array element at a byte
+//-------------------------------------------------------------------
+const AnnotationInfo* ByteMap::elementAt(const ByteRange& range, size_t byteOffset) const {
+    const RecordLayout& layout = *range.layout;
+
+    long long relative = static_cast<long long>(byteOffset) - range.start;
+    long long element = relative / layout.stride;
+    int within = static_cast<int>(relative % layout.stride);
+
+    // Fields are sorted by offset; find the last one starting at or before the byte
+    auto field = std::upper_bound(layout.fields.begin(), layout.fields.end(), within,
+        [](int value, const RecordField& f) { return value < f.offset; });
+    if (field == layout.fields.begin()) {
+        return nullptr;
+    }
+    --field;
+    if (within >= field->offset + field->length) {
+        return nullptr; // Padding between fields
+    }
+
+    long long fieldIndex = field - layout.fields.begin();
+    if (elementKey[0] != range.info.annotationIndex || elementKey[1] != element || elementKey[2] != fieldIndex) {
+        int start = static_cast<int>(range.start + element * layout.stride + field->offset);
+
+        elementInfo.formattedValue = data ? FormatData(*data, start, field->length, field->displayFormat) : std::string();
+        elementInfo.colorIndex = field->colorIndex;
+        elementInfo.length = field->length;
+        elementInfo.startOffset = start;
+        elementInfo.annotationIndex = range.info.annotationIndex;
+
+        elementKey[0] = range.info.annotationIndex;
+        elementKey[1] = element;
+        elementKey[2] = fieldIndex;
+    }
+    return &elementInfo;
 }
 
 
@@ -592,6 +1014,8 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
     int startRow = state.scrollPosition;
     int endRow = std::min(startRow + visibleRows, state.totalRows);
 
+    const EntropyIndex* entropy = DocumentEntropy(hwnd, state);
+
     // Draw each row
     for (int row = startRow; row < endRow; row++) {
         int yPos = (row - startRow) * ROW_HEIGHT + ROW_HEIGHT;
@@ -601,6 +1025,12 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
         sprintf_s(headerText, sizeof(headerText), "%08X", offsetBase);
         TextOut(hdc, 10, yPos, headerText, strlen(headerText));
 
+        if (entropy) {
+            RECT barRect = { ENTROPY_BAR_X, yPos, ENTROPY_BAR_X + ENTROPY_BAR_WIDTH, yPos + 16 };
+            SetDCBrushColor(hdc, entropyColor(entropy->entropyAt(offsetBase)));
+            FillRect(hdc, &barRect, (HBRUSH)GetStockObject(DC_BRUSH));
+        }
+
         // Draw hex values and prepare ASCII 
         std::string asciiLine;
         std::vector<bool> drawnInAscii(BYTES_PER_ROW, false);
@@ -700,10 +1130,10 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
                 int currentRow = offset / BYTES_PER_ROW;
                 int posInRow = annotation->positionInRow(offset);
 
-                // Get the annotation this byte belongs to
+                // Get the annotation this byte belongs to. Record-array
+                // elements only exist in the info, so take the extent from there.
                 if (annoIdx >= 0 && annoIdx < state.annotations.size()) {
-                    const auto& anno = state.annotations[annoIdx];
-                    std::string value = annotation->formattedValue;
+                    const std::string& value = annotation->formattedValue;
 
                     // Handle multi-row annotations
                     if (startRow != currentRow) {
@@ -713,8 +1143,8 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
                         // If this is a continuation row, show the remaining part of the value
                         if (posInRow == 0) {  // Only at the start of each row
                             // Calculate how many characters were shown in previous rows
-                            int bytesInPrevRows = offset - anno.startOffset - posInRow;
-                            int charsPerByte = value.length() / (anno.endOffset - anno.startOffset + 1);
+                            int bytesInPrevRows = offset - annotation->startOffset - posInRow;
+                            int charsPerByte = value.length() / annotation->length;
                             charsInPreviousRows = std::min(static_cast<int>(value.length()), bytesInPrevRows * charsPerByte);
 
                             if (charsInPreviousRows < value.length()) {
@@ -737,7 +1167,7 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
                         }
                     }
                     // For the first row of the annotation or single-row annotations
-                    else if (offset == anno.startOffset) {
+                    else if (offset == annotation->startOffset) {
                         // Display the formatted value in the ASCII section
                         SetTextColor(hdc, annotationColors[annotation->colorIndex]);
 
@@ -753,7 +1183,7 @@ void DrawHexView(HWND hwnd, HDC hdc, DocumentWindowState& state) {
                         }
 
                         // For multi-row annotations that start on this row
-                        int bytesInAnnotation = anno.endOffset - anno.startOffset + 1;
+                        int bytesInAnnotation = annotation->length;
                         int bytesInThisRow = std::min(bytesInAnnotation, BYTES_PER_ROW - col);
 
                         // Mark all bytes covered by this annotation in this row as drawn
@@ -823,122 +1253,154 @@ void drawRightRoundedRect(HDC hdc, int startX, int startY, int endX, int endY) {
     LineTo(hdc, endX - 5, endY);
 }
 
-void DrawAnnotations(HWND hwnd, HDC hdc, DocumentWindowState& state) {
-    if (state.fileData.empty() || state.annotations.empty()) {
+// Outlines one annotated byte range row by row and labels it
+static void drawAnnotationOutline(HDC hdc, DocumentWindowState& state, int startOffset, int endOffset, HPEN pen, COLORREF color, const std::string& label) {
+    int startRow = startOffset / BYTES_PER_ROW;
+    int startCol = startOffset % BYTES_PER_ROW;
+    int endRow = endOffset / BYTES_PER_ROW;
+    int endCol = endOffset % BYTES_PER_ROW;
+
+    // Skip annotations outside the visible area
+    if (endRow < state.scrollPosition ||
+        startRow > state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW)) {
         return;
     }
 
+    // Create pen for drawing
+    HPEN hOldPen = (HPEN)SelectObject(hdc, pen);
+    HBRUSH hOldBrush = (HBRUSH)SelectObject(hdc, GetStockObject(NULL_BRUSH));
 
-    HFONT hOldFont = (HFONT)SelectObject(hdc, state.gdi.hFontAnnotations);
-
-    for (const auto& anno : state.annotations) {
-        int startRow = anno.startOffset / BYTES_PER_ROW;
-        int startCol = anno.startOffset % BYTES_PER_ROW;
-        int endRow = anno.endOffset / BYTES_PER_ROW;
-        int endCol = anno.endOffset % BYTES_PER_ROW;
-
-        // Skip annotations outside the visible area
-        if (endRow < state.scrollPosition ||
-            startRow > state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW)) {
+    // Handle multi-row annotations by drawing separate rectangles for each row
+    for (int row = startRow; row <= endRow; row++) {
+        // Skip rows outside visible area
+        if (row < state.scrollPosition ||
+            row > state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW)) {
             continue;
         }
 
-        // Create pen for drawing
-        HPEN hOldPen = (HPEN)SelectObject(hdc, state.gdi.annotationPen[anno.colorIndex]);
-        HBRUSH hOldBrush = (HBRUSH)SelectObject(hdc, GetStockObject(NULL_BRUSH));
-
-        // Handle multi-row annotations by drawing separate rectangles for each row
-        for (int row = startRow; row <= endRow; row++) {
-            // Skip rows outside visible area
-            if (row < state.scrollPosition ||
-                row > state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW)) {
-                continue;
+        int rowY = (row - state.scrollPosition) * ROW_HEIGHT + ROW_HEIGHT;
+        int rowStartCol = (row == startRow) ? startCol : 0;
+        int rowEndCol = (row == endRow) ? endCol : BYTES_PER_ROW - 1;
+
+        // Calculate coordinates for this row
+        int hexStartX = HEX_MARGIN + rowStartCol * HEX_BYTE_SPACING - ANNOTATION_MARGIN;
+        int hexEndX = HEX_MARGIN + rowEndCol * HEX_BYTE_SPACING + CHAR_WIDTH * 2 - 9 + ANNOTATION_MARGIN;
+        int startY = rowY - 0;  // Aligned with text baseline
+        int endY = rowY + 16;   // Extend below text
+
+        // ASCII section coordinates
+        int asciiStartX = ASCII_MARGIN + rowStartCol * CHAR_WIDTH - ANNOTATION_MARGIN;
+        int asciiEndX = ASCII_MARGIN + (rowEndCol + 1) * CHAR_WIDTH + ANNOTATION_MARGIN-5;
+
+        // Determine which part of the annotation this row represents
+        bool isFirstRow = (row == startRow);
+        bool isMiddleRow = (row > startRow && row < endRow);
+        bool isLastRow = (row == endRow);
+
+        // For multi-row annotations, draw the outline according to the specified pattern
+        if (startRow != endRow) {
+            // First row - draw top, left with arcs, and bottom
+            if (isFirstRow) {
+                drawLeftRoundedRect(hdc, hexStartX,   startY, hexEndX,   endY);
+                drawLeftRoundedRect(hdc, asciiStartX, startY, asciiEndX, endY);
             }
-
-            int rowY = (row - state.scrollPosition) * ROW_HEIGHT + ROW_HEIGHT;
-            int rowStartCol = (row == startRow) ? startCol : 0;
-            int rowEndCol = (row == endRow) ? endCol : BYTES_PER_ROW - 1;
-
-            // Calculate coordinates for this row
-            int hexStartX = HEX_MARGIN + rowStartCol * HEX_BYTE_SPACING - ANNOTATION_MARGIN;
-            int hexEndX = HEX_MARGIN + rowEndCol * HEX_BYTE_SPACING + CHAR_WIDTH * 2 - 9 + ANNOTATION_MARGIN;
-            int startY = rowY - 0;  // Aligned with text baseline
-            int endY = rowY + 16;   // Extend below text
-
-            // ASCII section coordinates
-            int asciiStartX = ASCII_MARGIN + rowStartCol * CHAR_WIDTH - ANNOTATION_MARGIN;
-            int asciiEndX = ASCII_MARGIN + (rowEndCol + 1) * CHAR_WIDTH + ANNOTATION_MARGIN-5;
-
-            // Determine which part of the annotation this row represents
-            bool isFirstRow = (row == startRow);
-            bool isMiddleRow = (row > startRow && row < endRow);
-            bool isLastRow = (row == endRow);
-
-            // For multi-row annotations, draw the outline according to the specified pattern
-            if (startRow != endRow) {
-                // First row - draw top, left with arcs, and bottom
-                if (isFirstRow) {
-                    drawLeftRoundedRect(hdc, hexStartX,   startY, hexEndX,   endY);
-                    drawLeftRoundedRect(hdc, asciiStartX, startY, asciiEndX, endY);
-                }
-                // Middle rows - just horizontal lines on top and bottom
-                else if (isMiddleRow) {
-                    // HEX SECTION - Middle row outline
-                    // Top horizontal line
-                    MoveToEx(hdc, hexStartX, startY, NULL);
-                    LineTo(hdc, hexEndX, startY);
-
-                    // Bottom horizontal line
-                    MoveToEx(hdc, hexStartX, endY, NULL);
-                    LineTo(hdc, hexEndX, endY);
-
-                    // ASCII SECTION - Middle row outline
-                    // Top horizontal line
-                    MoveToEx(hdc, asciiStartX, startY, NULL);
-                    LineTo(hdc, asciiEndX, startY);
-
-                    // Bottom horizontal line
-                    MoveToEx(hdc, asciiStartX, endY, NULL);
-                    LineTo(hdc, asciiEndX, endY);
-                }
-                // Last row - draw top, right with arcs, and bottom
-                else if (isLastRow) {
-                    // HEX SECTION - Last row outline
-                    drawRightRoundedRect(hdc, hexStartX,   startY,    hexEndX, endY);
-                    drawRightRoundedRect(hdc, asciiStartX, startY, asciiEndX, endY);
-                }
+            // Middle rows - just horizontal lines on top and bottom
+            else if (isMiddleRow) {
+                // HEX SECTION - Middle row outline
+                // Top horizontal line
+                MoveToEx(hdc, hexStartX, startY, NULL);
+                LineTo(hdc, hexEndX, startY);
+
+                // Bottom horizontal line
+                MoveToEx(hdc, hexStartX, endY, NULL);
+                LineTo(hdc, hexEndX, endY);
+
+                // ASCII SECTION - Middle row outline
+                // Top horizontal line
+                MoveToEx(hdc, asciiStartX, startY, NULL);
+                LineTo(hdc, asciiEndX, startY);
+
+                // Bottom horizontal line
+                MoveToEx(hdc, asciiStartX, endY, NULL);
+                LineTo(hdc, asciiEndX, endY);
             }
-            else {
-                // Single row annotation - use rounded rectangle for both hex and ASCII
-                RoundRect(hdc, hexStartX, startY, hexEndX, endY, 10, 10);
-                RoundRect(hdc, asciiStartX, startY, asciiEndX, endY, 10, 10);
+            // Last row - draw top, right with arcs, and bottom
+            else if (isLastRow) {
+                // HEX SECTION - Last row outline
+                drawRightRoundedRect(hdc, hexStartX,   startY,    hexEndX, endY);
+                drawRightRoundedRect(hdc, asciiStartX, startY, asciiEndX, endY);
             }
+        }
+        else {
+            // Single row annotation - use rounded rectangle for both hex and ASCII
+            RoundRect(hdc, hexStartX, startY, hexEndX, endY, 10, 10);
+            RoundRect(hdc, asciiStartX, startY, asciiEndX, endY, 10, 10);
+        }
 
-            // Draw the label - only on the first visible row
-            if (row == startRow || (startRow < state.scrollPosition && row == state.scrollPosition)) {
-                SetTextColor(hdc, annotationColors[anno.colorIndex]);
-                SetBkMode(hdc, TRANSPARENT);
-                TextOut(hdc, hexStartX, startY - 11, anno.label.c_str(), anno.label.length());
-            }
+        // Draw the label - only on the first visible row
+        if (row == startRow || (startRow < state.scrollPosition && row == state.scrollPosition)) {
+            SetTextColor(hdc, color);
+            SetBkMode(hdc, TRANSPARENT);
+            TextOut(hdc, hexStartX, startY - 11, label.c_str(), label.length());
+        }
+    }
 
-            // Draw the formatted value - only on the last visible row and only for the HEX section
-            // (we already display the value in the ASCII section)
-            if ((row == endRow || (endRow > state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW) &&
-                row == state.scrollPosition + (state.bytesPerPage / BYTES_PER_ROW))) &&
-                (row == endRow)) {  // Only show at the end row
+    // Cleanup
+    SelectObject(hdc, hOldPen);
+    SelectObject(hdc, hOldBrush);
+}
 
-                std::string formattedValue = FormatData(state.fileData, anno.startOffset,
-                    anno.endOffset - anno.startOffset + 1,
-                    anno.displayFormat);
+// Outlines the fields of the record-array elements that are on screen
+static void drawRecordArray(HDC hdc, DocumentWindowState& state, const Annotation& anno) {
+    const RecordLayout& layout = *anno.layout;
 
-                std::string displayText = anno.displayFormat + ": " + formattedValue;
-               // TextOut(hdc, hexStartX, endY - 1, displayText.c_str(), displayText.length());
-            }
+    long long firstVisible = static_cast<long long>(state.scrollPosition) * BYTES_PER_ROW;
+    long long lastVisible = firstVisible + (state.bytesPerPage / BYTES_PER_ROW + 1) * BYTES_PER_ROW - 1;
+    if (lastVisible < anno.startOffset || firstVisible > anno.endOffset) {
+        return;
+    }
+
+    long long firstElement = (std::max<long long>(firstVisible, anno.startOffset) - anno.startOffset) / layout.stride;
+    long long lastElement = (std::min<long long>(lastVisible, anno.endOffset) - anno.startOffset) / layout.stride;
+
+    std::string label;
+    for (long long element = firstElement; element <= lastElement; ++element) {
+        long long elementStart = anno.startOffset + element * layout.stride;
+
+        for (const auto& field : layout.fields) {
+            label = anno.label + "[" + std::to_string(element) + "]." + field.name + (anno.stale ? STALE_SUFFIX : "");
+            int fieldStart = static_cast<int>(elementStart + field.offset);
+            drawAnnotationOutline(hdc, state, fieldStart, fieldStart + field.length - 1,
+                state.gdi.annotationPen[field.colorIndex], annotationColors[field.colorIndex], label);
         }
+    }
+}
 
-        // Cleanup
-        SelectObject(hdc, hOldPen);
-        SelectObject(hdc, hOldBrush);
+void DrawAnnotations(HWND hwnd, HDC hdc, DocumentWindowState& state) {
+    if (state.fileData.empty() || state.annotations.empty()) {
+        return;
+    }
+
+
+    HFONT hOldFont = (HFONT)SelectObject(hdc, state.gdi.hFontAnnotations);
+
+    for (size_t i = 0; i < state.annotations.size(); ++i) {
+        const auto& anno = state.annotations[i];
+        if (anno.layout) {
+            drawRecordArray(hdc, state, anno);
+            continue;
+        }
+
+        std::string label = anno.stale ? anno.label + STALE_SUFFIX : anno.label.str();
+        ChecksumStatus status = anno.checksum ? GetChecksumStatus(state, i) : CHECKSUM_NONE;
+        if (status == CHECKSUM_MISMATCH || status == CHECKSUM_ERROR) {
+            label += status == CHECKSUM_MISMATCH ? MISMATCH_SUFFIX : UNVERIFIED_SUFFIX;
+            drawAnnotationOutline(hdc, state, anno.startOffset, anno.endOffset, state.gdi.mismatchPen, checksumMismatchColor, label);
+        }
+        else {
+            drawAnnotationOutline(hdc, state, anno.startOffset, anno.endOffset,
+                state.gdi.annotationPen[anno.colorIndex], annotationColors[anno.colorIndex], label);
+        }
     }
 
     SelectObject(hdc, hOldFont);
@@ -966,30 +1428,46 @@ void ShowContextMenu(HWND hwnd, int x, int y, DocumentWindowState& state) {
         // Mouse is over an annotation - show annotation-specific menu
         AppendMenu(hPopupMenu, MF_STRING, 2001, "Edit Annotation");
         AppendMenu(hPopupMenu, MF_STRING, 2002, "Remove Annotation");
-        AppendMenu(hPopupMenu, MF_SEPARATOR, 0, NULL);
-
-        // Add format options with checkmark on the current format
-        const std::string& currentFormat = state.annotations[annotationIndex].displayFormat;
-
-        UINT hexFlags = MF_STRING | (currentFormat == "hex" ? MF_CHECKED : MF_UNCHECKED);
-        UINT intFlags = MF_STRING | (currentFormat == "int" ? MF_CHECKED : MF_UNCHECKED);
-        UINT floatFlags = MF_STRING | (currentFormat == "float" ? MF_CHECKED : MF_UNCHECKED);
-        UINT doubleFlags = MF_STRING | (currentFormat == "double" ? MF_CHECKED : MF_UNCHECKED);
-        UINT asciiFlags = MF_STRING | (currentFormat == "ascii" ? MF_CHECKED : MF_UNCHECKED);
-        UINT unicodeFlags = MF_STRING | (currentFormat == "unicode" ? MF_CHECKED : MF_UNCHECKED);
+        if (!state.annotations[annotationIndex].layout) {
+            AppendMenu(hPopupMenu, MF_STRING, 2011, "Edit Expressions...");
+            AppendMenu(hPopupMenu, MF_STRING, 2012, "Checksum...");
+        }
 
-        AppendMenu(hPopupMenu, hexFlags, 2003, "Hex");
-        AppendMenu(hPopupMenu, intFlags, 2004, "Int");
-        AppendMenu(hPopupMenu, floatFlags, 2005, "Float");
-        AppendMenu(hPopupMenu, doubleFlags, 2006, "Double");
-        AppendMenu(hPopupMenu, asciiFlags, 2007, "Ascii");
-        AppendMenu(hPopupMenu, unicodeFlags, 2008, "Unicode");
+        // Record arrays take their formats from the field layout
+        if (!state.annotations[annotationIndex].layout) {
+            AppendMenu(hPopupMenu, MF_SEPARATOR, 0, NULL);
+
+            // Add format options with checkmark on the current format
+            const AnnotationText& currentFormat = state.annotations[annotationIndex].displayFormat;
+
+            UINT hexFlags = MF_STRING | (currentFormat == "hex" ? MF_CHECKED : MF_UNCHECKED);
+            UINT intFlags = MF_STRING | (currentFormat == "int" ? MF_CHECKED : MF_UNCHECKED);
+            UINT floatFlags = MF_STRING | (currentFormat == "float" ? MF_CHECKED : MF_UNCHECKED);
+            UINT doubleFlags = MF_STRING | (currentFormat == "double" ? MF_CHECKED : MF_UNCHECKED);
+            UINT asciiFlags = MF_STRING | (currentFormat == "ascii" ? MF_CHECKED : MF_UNCHECKED);
+            UINT unicodeFlags = MF_STRING | (currentFormat == "unicode" ? MF_CHECKED : MF_UNCHECKED);
+
+            AppendMenu(hPopupMenu, hexFlags, 2003, "Hex");
+            AppendMenu(hPopupMenu, intFlags, 2004, "Int");
+            AppendMenu(hPopupMenu, floatFlags, 2005, "Float");
+            AppendMenu(hPopupMenu, doubleFlags, 2006, "Double");
+            AppendMenu(hPopupMenu, asciiFlags, 2007, "Ascii");
+            AppendMenu(hPopupMenu, unicodeFlags, 2008, "Unicode");
+        }
     }
     else if (state.selectionStart >= 0 && state.selectionEnd >= 0) {
         // There's an active selection - show create option
         AppendMenu(hPopupMenu, MF_STRING, 2009, "Create Annotation");
     }
-    else {
+
+    if (state.cursorPosition >= 0) {
+        // Struct templates apply at the cursor whether or not it is annotated
+        if (GetMenuItemCount(hPopupMenu) > 0) {
+            AppendMenu(hPopupMenu, MF_SEPARATOR, 0, NULL);
+        }
+        AppendMenu(hPopupMenu, MF_STRING, 2010, "Apply Struct Template...");
+    }
+    else if (GetMenuItemCount(hPopupMenu) == 0) {
         // No annotation or selection - no context menu needed
         DestroyMenu(hPopupMenu);
         return;
@@ -1005,7 +1483,7 @@ void ShowContextMenu(HWND hwnd, int x, int y, DocumentWindowState& state) {
 //-------------------------------------------------------------------
 // FormatData - Format data for annotations
 //-------------------------------------------------------------------
-std::string FormatData(const std::vector<BYTE>& data, int offset, int length, const std::string& format) {
+std::string FormatData(const std::vector<BYTE>& data, int offset, int length, std::string_view format) {
     std::stringstream ss;
 
     // Make sure we don't go out of bounds
@@ -1044,13 +1522,14 @@ std::string FormatData(const std::vector<BYTE>& data, int offset, int length, co
             memcpy(&value, &data[offset], sizeof(int64_t));
             ss << value;
         }
-        else {
-            // Handle unusual length
-            int value = 0;
+        else if (length > 0 && length < 8) {
+            // 24, 40, 48 or 56-bit integer, sign extended
+            uint64_t bits = 0;
             for (int i = 0; i < length; ++i) {
-                value |= static_cast<int>(data[offset + i]) << (i * 8);
+                bits |= static_cast<uint64_t>(data[offset + i]) << (i * 8);
             }
-            ss << value;
+            int shift = 64 - length * 8;
+            ss << (static_cast<int64_t>(bits << shift) >> shift);
         }
     }
     else if (format == "float") {
@@ -1098,6 +1577,72 @@ std::string FormatData(const std::vector<BYTE>& data, int offset, int length, co
     return ss.str();
 }
 
+//-------------------------------------------------------------------
+// GoToByteRange - Select bytes first..last and scroll them into view
+//-------------------------------------------------------------------
+void GoToByteRange(HWND hwnd, DocumentWindowState& state, int first, int last) {
+    if (first < 0 || first > last || last >= state.fileData.size()) {
+        return;
+    }
+
+    state.cursorPosition = first;
+    state.selectionStart = first;
+    state.selectionEnd = last;
+    state.isSelecting = false;
+
+    // Only scroll if the first row is not on screen, and then put it a
+    // third of the way down
+    int row = first / BYTES_PER_ROW;
+    int visibleRows = std::max(1, state.bytesPerPage / BYTES_PER_ROW - 1);
+    if (row < state.scrollPosition || row >= state.scrollPosition + visibleRows) {
+        int minScroll, maxScroll;
+        GetScrollRange(hwnd, SB_VERT, &minScroll, &maxScroll);
+        state.scrollPosition = std::max(minScroll, std::min(row - visibleRows / 3, maxScroll));
+        SetScrollPos(hwnd, SB_VERT, state.scrollPosition, TRUE);
+    }
+
+    SelectionChanged(hwnd, state);
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+// Select the next or previous match of the last Find Bytes search, from the
+// cursor. Without a search, opens the dialog to start one.
+void FindNextMatch(HWND hwnd, DocumentWindowState& state, bool forward) {
+    if (!state.searchCursor) {
+        ShowFindBytesDialog(hwnd, state);
+        return;
+    }
+
+    SearchCursor& cursor = *state.searchCursor;
+    cursor.rebind(state.fileData.data(), state.fileData.size());
+    SearchHit hit;
+    if (forward) {
+        hit = cursor.next(state.cursorPosition < 0 ? 0 : static_cast<size_t>(state.cursorPosition) + 1);
+    }
+    else {
+        hit = cursor.previous(state.cursorPosition < 0 ? state.fileData.size() : static_cast<size_t>(state.cursorPosition));
+    }
+
+    size_t last = hit.offset + std::max<size_t>(hit.length, 1) - 1;
+    if (hit.offset == SEARCH_NO_MATCH || last > INT_MAX) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    GoToByteRange(hwnd, state, static_cast<int>(hit.offset), static_cast<int>(last));
+}
+
+//-------------------------------------------------------------------
+// GoToAnnotation - Select an annotation and scroll it into view
+//-------------------------------------------------------------------
+void GoToAnnotation(HWND hwnd, DocumentWindowState& state, int index) {
+    if (index < 0 || index >= state.annotations.size()) {
+        return;
+    }
+
+    const Annotation& anno = state.annotations[index];
+    GoToByteRange(hwnd, state, anno.startOffset, std::min(anno.endOffset, static_cast<int>(state.fileData.size()) - 1));
+}
+
 //-------------------------------------------------------------------
 // CreateAnnotation - Create a new annotation
 //-------------------------------------------------------------------
@@ -1124,7 +1669,7 @@ void CreateAnnotation(HWND hwnd, DocumentWindowState& state) {
 
         newAnnotation.colorIndex = state.annotations.size() % std::size(annotationColors);
 
-        state.annotations.push_back(newAnnotation);
+        InsertAnnotation(state, static_cast<int>(state.annotations.size()), std::move(newAnnotation));
         state.isAnnotating = false;
 
         InvalidateRect(hwnd, NULL, TRUE);
@@ -1139,22 +1684,250 @@ void EditAnnotation(HWND hwnd, int index, DocumentWindowState& state) {
         return;
     }
 
-    Annotation& anno = state.annotations[index];
+    Annotation anno = state.annotations[index];
 
     char labelBuffer[256] = {};
     char formatBuffer[32] = {};
 
     // Copy existing values to buffers
-    strcpy_s(labelBuffer, sizeof(labelBuffer), anno.label.c_str());
-    strcpy_s(formatBuffer, sizeof(formatBuffer), anno.displayFormat.c_str());
+    strcpy_s(labelBuffer, sizeof(labelBuffer), anno.label.str().c_str());
+    strcpy_s(formatBuffer, sizeof(formatBuffer), anno.displayFormat.str().c_str());
 
     ShowAnnotationInputDialog(hwnd, labelBuffer, sizeof(labelBuffer), formatBuffer, sizeof(formatBuffer));
 
     if (strlen(labelBuffer) > 0) {
-        // Update annotation with new values
+        // Update annotation with new values. Confirming them also settles
+        // any doubt left by a rebase.
         anno.label = labelBuffer;
-        anno.displayFormat = formatBuffer;
+        if (!anno.layout) {
+            anno.displayFormat = formatBuffer;
+        }
+        anno.stale = false;
+        UpdateAnnotation(state, index, std::move(anno));
+
+        InvalidateRect(hwnd, NULL, TRUE);
+    }
+}
+
+//-------------------------------------------------------------------
+// EditAnnotationExpressions - Make an annotation computed from others
+//-------------------------------------------------------------------
+void EditAnnotationExpressions(HWND hwnd, int index, DocumentWindowState& state) {
+    if (index < 0 || index >= state.annotations.size()) {
+        return;
+    }
+
+    Annotation anno = state.annotations[index];
+
+    char startBuffer[256] = {};
+    char lengthBuffer[256] = {};
+    char valueBuffer[256] = {};
+    if (anno.computed) {
+        strcpy_s(startBuffer, sizeof(startBuffer), anno.computed->start.c_str());
+        strcpy_s(lengthBuffer, sizeof(lengthBuffer), anno.computed->length.c_str());
+        strcpy_s(valueBuffer, sizeof(valueBuffer), anno.computed->value.c_str());
+    }
+
+    if (!ShowExpressionDialog(hwnd, startBuffer, lengthBuffer, valueBuffer, sizeof(startBuffer))) {
+        return;
+    }
+
+    try {
+        ComputedFields fields{ startBuffer, lengthBuffer, valueBuffer };
+        for (const std::string* text : { &fields.start, &fields.length, &fields.value }) {
+            if (!text->empty()) {
+                CheckComputedExpression(*text);
+            }
+        }
+
+        if (fields.start.empty() && fields.length.empty() && fields.value.empty()) {
+            anno.computed.reset();
+        }
+        else {
+            anno.computed = std::make_shared<const ComputedFields>(std::move(fields));
+        }
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Edit Expressions", MB_OK | MB_ICONERROR);
+        return;
+    }
+
+    UpdateAnnotation(state, index, std::move(anno));
+    retagEditedAnnotation(state, index);
+    InvalidateRect(hwnd, NULL, TRUE);
+
+    std::string error = ComputedAnnotationError(state, index);
+    if (!error.empty()) {
+        MessageBox(hwnd, error.c_str(), "Edit Expressions", MB_OK | MB_ICONWARNING);
+    }
+}
+
+//-------------------------------------------------------------------
+// EditAnnotationChecksum - Declare an annotation a checksum of another
+//-------------------------------------------------------------------
+void EditAnnotationChecksum(HWND hwnd, int index, DocumentWindowState& state) {
+    if (index < 0 || index >= state.annotations.size()) {
+        return;
+    }
+
+    Annotation anno = state.annotations[index];
+
+    char algorithmBuffer[256] = {};
+    char coveredBuffer[256] = {};
+    bool bigEndian = false;
+    if (anno.checksum) {
+        strcpy_s(algorithmBuffer, sizeof(algorithmBuffer), anno.checksum->algorithm.c_str());
+        strcpy_s(coveredBuffer, sizeof(coveredBuffer), anno.checksum->covered.c_str());
+        bigEndian = anno.checksum->bigEndian;
+    }
+
+    if (!ShowChecksumDialog(hwnd, algorithmBuffer, coveredBuffer, bigEndian, sizeof(coveredBuffer))) {
+        return;
+    }
+
+    // No algorithm makes it an ordinary annotation again
+    if (algorithmBuffer[0] == '\0') {
+        anno.checksum.reset();
+    }
+    else {
+        try {
+            CheckChecksumAlgorithm(algorithmBuffer);
+        }
+        catch (const std::exception& e) {
+            MessageBox(hwnd, e.what(), "Checksum", MB_OK | MB_ICONERROR);
+            return;
+        }
+        if (coveredBuffer[0] == '\0') {
+            MessageBox(hwnd, "Enter the label of the annotation the checksum covers.", "Checksum", MB_OK | MB_ICONERROR);
+            return;
+        }
+        anno.checksum = std::make_shared<const ChecksumField>(ChecksumField{ algorithmBuffer, coveredBuffer, bigEndian });
+    }
+
+    UpdateAnnotation(state, index, std::move(anno));
+    retagEditedAnnotation(state, index);
+    InvalidateRect(hwnd, NULL, TRUE);
+
+    std::string status = ChecksumStatusText(state, index);
+    if (!status.empty()) {
+        MessageBox(hwnd, status.c_str(), "Checksum", MB_OK |
+            (GetChecksumStatus(state, index) == CHECKSUM_MATCH ? MB_ICONINFORMATION : MB_ICONWARNING));
+    }
+}
+
+//-------------------------------------------------------------------
+// ApplyStructTemplateAtCursor - Annotate records described by a template file
+//-------------------------------------------------------------------
+void ApplyStructTemplateAtCursor(HWND hwnd, DocumentWindowState& state) {
+    char fileName[MAX_PATH] = {};
+
+    OPENFILENAME ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "Struct Templates (*.h;*.txt)\0*.h;*.txt\0All Files\0*.*\0";
+    ofn.nFilterIndex = 1;
+    ofn.Flags = OFN_FILEMUSTEXIST;
+
+    if (!GetOpenFileName(&ofn)) {
+        return; // User cancelled
+    }
+
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+        MessageBox(hwnd, "Failed to open template file.", "Apply Struct Template", MB_OK | MB_ICONERROR);
+        return;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    try {
+        StructPlan plan = CompileStructTemplate(text.str());
+
+        int answer = MessageBox(hwnd,
+            "Repeat the template until the end of the file?\n\n"
+            "Yes: annotate consecutive records from the cursor\n"
+            "No: annotate a single record at the cursor",
+            "Apply Struct Template", MB_YESNOCANCEL | MB_ICONQUESTION);
+        if (answer == IDCANCEL) {
+            return;
+        }
+
+        // Fixed-size records can be kept as one record-array annotation
+        // instead of materialising every field of every record
+        if (answer == IDYES && plan.fixedSize > 0 &&
+            MessageBox(hwnd,
+                "The records have a fixed size. Annotate them as a single record array?",
+                "Apply Struct Template", MB_YESNO | MB_ICONQUESTION) == IDYES) {
+            Annotation array;
+            if (!BuildRecordArray(plan, state.fileData, state.cursorPosition, array)) {
+                MessageBox(hwnd, "The template does not fit at the cursor.", "Apply Struct Template", MB_OK | MB_ICONINFORMATION);
+                return;
+            }
+            array.colorIndex = state.annotations.size() % std::size(annotationColors);
+
+            InsertAnnotation(state, static_cast<int>(state.annotations.size()), std::move(array));
+            tagAppendedAnnotations(state, state.annotations.size() - 1);
+            InvalidateRect(hwnd, NULL, TRUE);
+            return;
+        }
+
+        std::vector<Annotation> generated = (answer == IDYES)
+            ? ApplyStructTemplateRepeated(plan, state.fileData, state.cursorPosition)
+            : ApplyStructTemplate(plan, state.fileData, state.cursorPosition);
+
+        if (generated.empty()) {
+            MessageBox(hwnd, "The template does not fit at the cursor.", "Apply Struct Template", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+
+        size_t firstIndex = state.annotations.size();
+        AppendAnnotations(state, std::move(generated));
+        tagAppendedAnnotations(state, firstIndex);
+        InvalidateRect(hwnd, NULL, TRUE);
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Apply Struct Template", MB_OK | MB_ICONERROR);
+    }
+}
+
+//-------------------------------------------------------------------
+// UndoLastEdit / RedoLastEdit - Step through the annotation history
+//-------------------------------------------------------------------
+// Re-tags only what a step changed. The step has moved to the other stack
+// holding its inverse: an Insert there means an annotation was erased, and
+// RemoveTail that annotations were appended.
+static void retagSteppedEdit(DocumentWindowState& state, const AnnotationDelta& inverse) {
+    switch (inverse.kind) {
+    case AnnotationDelta::Update:
+        retagEditedAnnotation(state, inverse.index);
+        break;
+    case AnnotationDelta::Insert:
+        retagErasedAnnotation(state, inverse.index);
+        break;
+    case AnnotationDelta::Erase:
+        retagInsertedAnnotation(state, inverse.index);
+        break;
+    case AnnotationDelta::RemoveTail:
+        tagAppendedAnnotations(state, inverse.index);
+        break;
+    default:
+        tagBytesThatAreAnnotated(state);
+        break;
+    }
+}
+
+void UndoLastEdit(HWND hwnd, DocumentWindowState& state) {
+    if (UndoAnnotationEdit(state)) {
+        retagSteppedEdit(state, state.history.redoStack.back());
+        InvalidateRect(hwnd, NULL, TRUE);
+    }
+}
 
+void RedoLastEdit(HWND hwnd, DocumentWindowState& state) {
+    if (RedoAnnotationEdit(state)) {
+        retagSteppedEdit(state, state.history.undoStack.back());
         InvalidateRect(hwnd, NULL, TRUE);
     }
 }
@@ -0,0 +1,488 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include "LabelIndex.h"
+#include "AnnotationFile.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LABEL_INDEX_PREFETCH
+#endif
+
+// indexOfSlot entry of an erased or replaced label
+const uint32_t DEAD_SLOT = 0xFFFFFFFF;
+
+// Trigrams are three folded bytes, so a direct table covers all of them
+const size_t TRIGRAM_CODES = 1 << 24;
+
+// Labels read by one pool task when a query is too short to use the index,
+// or when checking the candidates the index gives
+const size_t LABELS_PER_SCAN_TASK = 65536;
+
+// Candidates ahead of the one being checked whose annotation, and then whose
+// label, is fetched into cache. Candidates are scattered over the
+// annotations, so checking each one otherwise waits on memory twice.
+const size_t PREFETCH_ANNOTATION_AHEAD = 16;
+const size_t PREFETCH_LABEL_AHEAD = 8;
+
+// Incremental changes carried before the index is rebuilt in bulk
+const size_t MIN_DEAD_SLOTS_FOR_REBUILD = 4096;
+const size_t MIN_RECENT_POSTINGS_FOR_REBUILD = 65536;
+
+static std::runtime_error corruptIndex() {
+    return std::runtime_error("The label index is damaged.");
+}
+
+//-------------------------------------------------------------------
+// Trigrams
+//-------------------------------------------------------------------
+static BYTE foldCase(char c) {
+    BYTE byte = static_cast<BYTE>(c);
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+// Calls visit with every trigram of folded text in order, repeats included.
+// The window starts out as zero bytes, so the first two trigrams are anchored
+// at the start of the text; they are visited only if anchored is set.
+template <typename Visit>
+static void forEachTrigram(std::string_view text, bool anchored, Visit visit) {
+    uint32_t window = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        window = ((window << 8) | foldCase(text[i])) & (TRIGRAM_CODES - 1);
+        if (anchored || i >= 2) {
+            visit(window);
+        }
+    }
+}
+
+// Distinct trigrams of folded text, ascending
+static void collectTrigrams(std::string_view text, bool anchored, std::vector<uint32_t>& out) {
+    out.clear();
+    forEachTrigram(text, anchored, [&](uint32_t code) { out.push_back(code); });
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+static bool equalsFolded(const char* text, std::string_view folded) {
+    for (size_t i = 0; i < folded.size(); ++i) {
+        if (foldCase(text[i]) != static_cast<BYTE>(folded[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool labelMatches(std::string_view label, std::string_view folded, LabelMatch match) {
+    if (label.size() < folded.size()) {
+        return false;
+    }
+    if (match == LabelMatch::Prefix) {
+        return equalsFolded(label.data(), folded);
+    }
+    for (size_t i = 0; i + folded.size() <= label.size(); ++i) {
+        if (equalsFolded(label.data() + i, folded)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-------------------------------------------------------------------
+// Construction
+//-------------------------------------------------------------------
+// Two passes over the labels with a direct table of trigram codes: count the
+// postings of every trigram, then place them. Slots are visited in order, so
+// every list comes out ascending without sorting, and a trigram repeated
+// within a label is recognized by the last slot recorded for it.
+LabelIndex::LabelIndex(const std::vector<Annotation>& annotations) {
+    std::vector<uint32_t> table(TRIGRAM_CODES, 0);
+    std::vector<uint32_t> lastSlot(TRIGRAM_CODES, DEAD_SLOT);
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        uint32_t slot = static_cast<uint32_t>(i);
+        forEachTrigram(annotations[i].label, true, [&](uint32_t code) {
+            if (lastSlot[code] != slot) {
+                lastSlot[code] = slot;
+                ++table[code];
+                ++total;
+            }
+        });
+    }
+    if (total > UINT32_MAX) {
+        throw std::runtime_error("There are too many labels to index.");
+    }
+
+    // The counts become the position of each trigram's next posting
+    starts.push_back(0);
+    uint32_t position = 0;
+    for (uint32_t code = 0; code < TRIGRAM_CODES; ++code) {
+        if (table[code] != 0) {
+            trigrams.push_back(code);
+            uint32_t count = table[code];
+            table[code] = position;
+            position += count;
+            starts.push_back(position);
+        }
+    }
+
+    postings.resize(total);
+    std::fill(lastSlot.begin(), lastSlot.end(), DEAD_SLOT);
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        uint32_t slot = static_cast<uint32_t>(i);
+        forEachTrigram(annotations[i].label, true, [&](uint32_t code) {
+            if (lastSlot[code] != slot) {
+                lastSlot[code] = slot;
+                postings[table[code]++] = slot;
+            }
+        });
+    }
+
+    baseSlots = annotations.size();
+    indexOfSlot.resize(baseSlots);
+    std::iota(indexOfSlot.begin(), indexOfSlot.end(), 0);
+    slotOfIndex = indexOfSlot;
+}
+
+LabelIndex::LabelIndex(const BYTE* data, size_t size, size_t annotationCount) {
+    LabelIndexHeaderV2 header;
+    if (size < sizeof(header)) {
+        throw corruptIndex();
+    }
+    memcpy(&header, data, sizeof(header));
+
+    // Sizes are checked one at a time so none of the sums can overflow
+    size_t remaining = size - sizeof(header);
+    if (header.annotationCount != annotationCount || header.trigramCount > TRIGRAM_CODES ||
+        header.postingCount > UINT32_MAX) {
+        throw corruptIndex();
+    }
+    uint64_t trigramBytes = (header.trigramCount * sizeof(uint32_t) + 7) & ~uint64_t(7);
+    uint64_t startBytes = (header.trigramCount + 1) * sizeof(uint64_t);
+    uint64_t postingBytes = header.postingCount * sizeof(uint32_t);
+    if (trigramBytes > remaining || startBytes > remaining - trigramBytes ||
+        postingBytes > remaining - trigramBytes - startBytes) {
+        throw corruptIndex();
+    }
+
+    const BYTE* p = data + sizeof(header);
+    trigrams.resize(header.trigramCount);
+    memcpy(trigrams.data(), p, trigrams.size() * sizeof(uint32_t));
+    p += trigramBytes;
+    starts.resize(header.trigramCount + 1);
+    memcpy(starts.data(), p, starts.size() * sizeof(uint64_t));
+    p += startBytes;
+    postings.resize(header.postingCount);
+    memcpy(postings.data(), p, postings.size() * sizeof(uint32_t));
+
+    // Queries trust the ordering, so check all of it
+    bool valid = starts.front() == 0 && starts.back() == postings.size();
+    for (size_t i = 0; valid && i < trigrams.size(); ++i) {
+        valid = trigrams[i] < TRIGRAM_CODES && (i == 0 || trigrams[i - 1] < trigrams[i]) &&
+            starts[i] <= starts[i + 1] && starts[i + 1] <= postings.size();
+        for (uint64_t k = starts[i]; valid && k < starts[i + 1]; ++k) {
+            valid = postings[k] < annotationCount && (k == starts[i] || postings[k - 1] < postings[k]);
+        }
+    }
+    if (!valid) {
+        throw corruptIndex();
+    }
+
+    baseSlots = annotationCount;
+    indexOfSlot.resize(baseSlots);
+    std::iota(indexOfSlot.begin(), indexOfSlot.end(), 0);
+    slotOfIndex = indexOfSlot;
+}
+
+void LabelIndex::serialize(std::string& out) const {
+    LabelIndexHeaderV2 header;
+    header.annotationCount = baseSlots;
+    header.trigramCount = trigrams.size();
+    header.postingCount = postings.size();
+
+    const char padding[8] = {};
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(trigrams.data()), trigrams.size() * sizeof(uint32_t));
+    out.append(padding, (trigrams.size() % 2) * sizeof(uint32_t));
+    out.append(reinterpret_cast<const char*>(starts.data()), starts.size() * sizeof(uint64_t));
+    out.append(reinterpret_cast<const char*>(postings.data()), postings.size() * sizeof(uint32_t));
+}
+
+//-------------------------------------------------------------------
+// Incremental changes
+//-------------------------------------------------------------------
+uint32_t LabelIndex::addSlot(std::string_view label, size_t index) {
+    uint32_t slot = static_cast<uint32_t>(indexOfSlot.size());
+    indexOfSlot.push_back(static_cast<uint32_t>(index));
+
+    std::vector<uint32_t> codes;
+    collectTrigrams(label, true, codes);
+    for (uint32_t code : codes) {
+        recent[code].push_back(slot);
+    }
+    recentPostings += codes.size();
+    return slot;
+}
+
+void LabelIndex::inserted(const std::vector<Annotation>& annotations, size_t index) {
+    slotOfIndex.insert(slotOfIndex.begin() + index, addSlot(annotations[index].label, index));
+    for (size_t i = index + 1; i < slotOfIndex.size(); ++i) {
+        indexOfSlot[slotOfIndex[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+void LabelIndex::erased(size_t index) {
+    indexOfSlot[slotOfIndex[index]] = DEAD_SLOT;
+    ++deadSlots;
+    slotOfIndex.erase(slotOfIndex.begin() + index);
+    for (size_t i = index; i < slotOfIndex.size(); ++i) {
+        indexOfSlot[slotOfIndex[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+void LabelIndex::updated(const std::vector<Annotation>& annotations, size_t index) {
+    indexOfSlot[slotOfIndex[index]] = DEAD_SLOT;
+    ++deadSlots;
+    slotOfIndex[index] = addSlot(annotations[index].label, index);
+}
+
+void LabelIndex::appended(const std::vector<Annotation>& annotations, size_t firstIndex) {
+    for (size_t i = firstIndex; i < annotations.size(); ++i) {
+        slotOfIndex.push_back(addSlot(annotations[i].label, i));
+    }
+}
+
+void LabelIndex::removedTail(size_t firstIndex) {
+    for (size_t i = firstIndex; i < slotOfIndex.size(); ++i) {
+        indexOfSlot[slotOfIndex[i]] = DEAD_SLOT;
+        ++deadSlots;
+    }
+    slotOfIndex.resize(firstIndex);
+}
+
+bool LabelIndex::wantsRebuild() const {
+    return deadSlots > std::max(MIN_DEAD_SLOTS_FOR_REBUILD, slotOfIndex.size() / 2) ||
+        recentPostings > std::max(MIN_RECENT_POSTINGS_FOR_REBUILD, postings.size() / 2);
+}
+
+//-------------------------------------------------------------------
+// Queries
+//-------------------------------------------------------------------
+// First position from `from` on whose slot is not below slot: steps of
+// doubling size, then a binary search of the last step, so the cost grows
+// with the distance moved rather than with the list
+static size_t gallop(const uint32_t* slots, size_t count, size_t from, uint32_t slot) {
+    size_t step = 1;
+    size_t low = from;
+    size_t high = from;
+    while (high < count && slots[high] < slot) {
+        low = high + 1;
+        high = from + step;
+        step *= 2;
+    }
+    high = std::min(high, count);
+    return std::lower_bound(slots + low, slots + high, slot) - slots;
+}
+
+bool LabelIndex::PostingList::seek(uint32_t slot) {
+    basePosition = gallop(base, baseCount, basePosition, slot);
+    if (basePosition < baseCount && base[basePosition] == slot) {
+        return true;
+    }
+    if (!recent) {
+        return false;
+    }
+    recentPosition = gallop(recent->data(), recent->size(), recentPosition, slot);
+    return recentPosition < recent->size() && (*recent)[recentPosition] == slot;
+}
+
+LabelIndex::PostingList LabelIndex::postingsOf(uint32_t trigram) const {
+    PostingList list;
+
+    auto it = std::lower_bound(trigrams.begin(), trigrams.end(), trigram);
+    if (it != trigrams.end() && *it == trigram) {
+        size_t i = it - trigrams.begin();
+        list.base = postings.data() + starts[i];
+        list.baseCount = static_cast<size_t>(starts[i + 1] - starts[i]);
+    }
+
+    auto added = recent.find(trigram);
+    if (added != recent.end()) {
+        list.recent = &added->second;
+    }
+    return list;
+}
+
+static void prefetch(const void* address) {
+#ifdef LABEL_INDEX_PREFETCH
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#endif
+}
+
+// Fetches the annotation of a candidate further ahead and, if labels are to
+// be read, the label of a nearer one, whose annotation an earlier call fetched
+void LabelIndex::prefetchCandidate(const std::vector<Annotation>& annotations,
+    const std::vector<uint32_t>& candidates, size_t i, bool labels) const {
+    if (i + PREFETCH_ANNOTATION_AHEAD < candidates.size()) {
+        uint32_t index = indexOfSlot[candidates[i + PREFETCH_ANNOTATION_AHEAD]];
+        if (index != DEAD_SLOT) {
+            prefetch(&annotations[index]);
+        }
+    }
+    if (labels && i + PREFETCH_LABEL_AHEAD < candidates.size()) {
+        uint32_t index = indexOfSlot[candidates[i + PREFETCH_LABEL_AHEAD]];
+        if (index != DEAD_SLOT) {
+            prefetch(annotations[index].label.data());
+        }
+    }
+}
+
+// Runs indexOf(0) .. indexOf(count - 1) across the worker pool and packs
+// each annotation index it returns, other than -1, with the annotation's
+// start offset, in the order given. The key is taken while the annotation is
+// at hand, so sorting by offset afterwards does not touch it again.
+template <typename IndexOf>
+static std::vector<uint64_t> collectMatches(const std::vector<Annotation>& annotations, size_t count, IndexOf indexOf) {
+    size_t taskCount = (count + LABELS_PER_SCAN_TASK - 1) / LABELS_PER_SCAN_TASK;
+    std::vector<std::vector<uint64_t>> partial(taskCount);
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t first = task * LABELS_PER_SCAN_TASK;
+        size_t last = std::min(count, first + LABELS_PER_SCAN_TASK);
+        for (size_t i = first; i < last; ++i) {
+            int index = indexOf(i);
+            if (index >= 0) {
+                partial[task].push_back((static_cast<uint64_t>(static_cast<uint32_t>(annotations[index].startOffset)) << 32) |
+                    static_cast<uint32_t>(index));
+            }
+        }
+    });
+
+    if (partial.size() == 1) {
+        return std::move(partial[0]);
+    }
+    std::vector<uint64_t> keys;
+    for (const auto& part : partial) {
+        keys.insert(keys.end(), part.begin(), part.end());
+    }
+    return keys;
+}
+
+std::vector<int> LabelIndex::find(const std::vector<Annotation>& annotations, std::string_view text,
+    LabelMatch match) const {
+    if (text.empty()) {
+        return {};
+    }
+
+    std::string folded(text.size(), '\0');
+    std::transform(text.begin(), text.end(), folded.begin(), [](char c) { return static_cast<char>(foldCase(c)); });
+
+    std::vector<uint64_t> keys;
+    if (match == LabelMatch::Substring && folded.size() < 3) {
+        // No trigram to look up; read every label instead
+        keys = collectMatches(annotations, annotations.size(), [&](size_t i) {
+            return labelMatches(annotations[i].label, folded, match) ? static_cast<int>(i) : -1;
+        });
+    }
+    else {
+        std::vector<uint32_t> codes;
+        collectTrigrams(folded, match == LabelMatch::Prefix, codes);
+
+        std::vector<PostingList> lists;
+        for (uint32_t code : codes) {
+            lists.push_back(postingsOf(code));
+            if (lists.back().size() == 0) {
+                return {};
+            }
+        }
+        std::sort(lists.begin(), lists.end(),
+            [](const PostingList& a, const PostingList& b) { return a.size() < b.size(); });
+
+        // Every label holding the text is in every list, so the shortest
+        // list bounds the work; the others only filter it. Recent slots all
+        // follow the bulk ones, so the candidates stay ascending and each
+        // list is passed over once.
+        std::vector<uint32_t> candidates(lists[0].base, lists[0].base + lists[0].baseCount);
+        if (lists[0].recent) {
+            candidates.insert(candidates.end(), lists[0].recent->begin(), lists[0].recent->end());
+        }
+        for (size_t k = 1; k < lists.size() && !candidates.empty(); ++k) {
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                [&](uint32_t slot) { return !lists[k].seek(slot); }), candidates.end());
+        }
+
+        // A three-byte substring is its own trigram, so every candidate
+        // holds it and the labels need not be read
+        bool exact = match == LabelMatch::Substring && folded.size() == 3;
+        keys = collectMatches(annotations, candidates.size(), [&](size_t i) {
+            prefetchCandidate(annotations, candidates, i, !exact);
+            uint32_t index = indexOfSlot[candidates[i]];
+            return index != DEAD_SLOT && (exact || labelMatches(annotations[index].label, folded, match))
+                ? static_cast<int>(index) : -1;
+        });
+    }
+
+    // Annotations laid down by a template or scan are usually in offset order
+    // already, and so are the matches then
+    if (!std::is_sorted(keys.begin(), keys.end())) {
+        std::sort(keys.begin(), keys.end());
+    }
+    std::vector<int> found(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        found[i] = static_cast<int>(keys[i] & 0xFFFFFFFF);
+    }
+    return found;
+}
+
+//-------------------------------------------------------------------
+// Document state
+//-------------------------------------------------------------------
+const LabelIndex& LabelIndexFor(DocumentWindowState& state) {
+    if (!state.labelIndex || state.labelIndex->wantsRebuild()) {
+        state.labelIndex = std::make_shared<LabelIndex>(state.annotations);
+    }
+    return *state.labelIndex;
+}
+
+const LabelIndex& CompactLabelIndex(DocumentWindowState& state) {
+    if (!state.labelIndex || !state.labelIndex->isCompact()) {
+        state.labelIndex = std::make_shared<LabelIndex>(state.annotations);
+    }
+    return *state.labelIndex;
+}
+
+void AdoptLabelIndex(DocumentWindowState& state, std::shared_ptr<LabelIndex> index) {
+    state.labelIndex = std::move(index);
+}
+
+void IndexAnnotationChange(DocumentWindowState& state, AnnotationDelta::Kind kind, int index) {
+    // Nothing to maintain until the first search builds the index
+    LabelIndex* labelIndex = state.labelIndex.get();
+    if (!labelIndex) {
+        return;
+    }
+
+    switch (kind) {
+    case AnnotationDelta::Insert:
+        labelIndex->inserted(state.annotations, index);
+        break;
+    case AnnotationDelta::Erase:
+        labelIndex->erased(index);
+        break;
+    case AnnotationDelta::Update:
+        labelIndex->updated(state.annotations, index);
+        break;
+    case AnnotationDelta::ReplaceAll:
+        state.labelIndex.reset();
+        break;
+    case AnnotationDelta::Append:
+        labelIndex->appended(state.annotations, index);
+        break;
+    case AnnotationDelta::RemoveTail:
+        labelIndex->removedTail(index);
+        break;
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "includes.h"
+
+// Trigram index over annotation labels. Each label contributes every
+// three-byte sequence it contains, ASCII case folded, plus two sequences
+// anchored at its start so prefix queries need no scan. A query intersects
+// the posting lists of its own trigrams, shortest first, and only reads the
+// labels that survive.
+//
+// Postings hold slots rather than annotation indices, so inserting or
+// erasing an annotation renumbers a slot table instead of every posting.
+// Labels indexed in bulk live in compact sorted arrays. Labels added later
+// go to a side table, and removed ones leave a dead slot behind until the
+// next rebuild.
+//
+// Over 10M labels (bench/LabelIndexBench), queries with up to a few thousand
+// matches take well under a millisecond. Beyond that the cost follows the
+// number of matches, since each one's label is read to confirm it and its
+// offset to sort it: up to about a microsecond per match on one core, spread
+// across the worker pool. Substring queries of one or two characters read
+// every label.
+
+enum class LabelMatch {
+    Substring,
+    Prefix
+};
+
+class LabelIndex {
+public:
+    // Index every label; slot i is annotation i
+    explicit LabelIndex(const std::vector<Annotation>& annotations);
+
+    // Read the serialized form for annotationCount annotations. Throws
+    // std::runtime_error if it is damaged.
+    LabelIndex(const BYTE* data, size_t size, size_t annotationCount);
+
+    // Mirror a change already made to annotations, see AnnotationDelta
+    void inserted(const std::vector<Annotation>& annotations, size_t index);
+    void erased(size_t index);
+    void updated(const std::vector<Annotation>& annotations, size_t index);
+    void appended(const std::vector<Annotation>& annotations, size_t firstIndex);
+    void removedTail(size_t firstIndex);
+
+    // True once incremental changes have grown enough that a rebuild is
+    // cheaper than carrying them
+    bool wantsRebuild() const;
+
+    // True if nothing changed since the index was built or read, so it can
+    // be serialized as is
+    bool isCompact() const { return recentPostings == 0 && slotCount() == baseSlots && deadSlots == 0; }
+
+    // Indices of the annotations whose label contains text, or starts with
+    // it, ignoring ASCII case; sorted by start offset. Substring queries
+    // shorter than a trigram read every label; empty text matches nothing.
+    std::vector<int> find(const std::vector<Annotation>& annotations, std::string_view text, LabelMatch match) const;
+
+    // Append the serialized form of a compact index
+    void serialize(std::string& out) const;
+
+private:
+    // Postings of one trigram: a run of the bulk arrays, then recent slots
+    struct PostingList {
+        const uint32_t* base = nullptr;
+        size_t baseCount = 0;
+        const std::vector<uint32_t>* recent = nullptr;
+
+        // Where the last seek stopped in each part
+        size_t basePosition = 0;
+        size_t recentPosition = 0;
+
+        size_t size() const { return baseCount + (recent ? recent->size() : 0); }
+
+        // Whether the list holds slot. Slots must be sought in ascending
+        // order; each seek gallops on from where the last one stopped.
+        bool seek(uint32_t slot);
+    };
+
+    size_t slotCount() const { return indexOfSlot.size(); }
+    uint32_t addSlot(std::string_view label, size_t index);
+    PostingList postingsOf(uint32_t trigram) const;
+    void prefetchCandidate(const std::vector<Annotation>& annotations, const std::vector<uint32_t>& candidates,
+        size_t i, bool labels) const;
+
+    // Bulk-indexed labels: postings of trigrams[i] are
+    // postings[starts[i] .. starts[i + 1]), ascending
+    std::vector<uint32_t> trigrams;
+    std::vector<uint64_t> starts;
+    std::vector<uint32_t> postings;
+    size_t baseSlots = 0;
+
+    // Labels indexed since, by trigram; slots only grow, so each list stays
+    // ascending
+    std::unordered_map<uint32_t, std::vector<uint32_t>> recent;
+    size_t recentPostings = 0;
+
+    std::vector<uint32_t> indexOfSlot;      // DEAD_SLOT once erased
+    std::vector<uint32_t> slotOfIndex;
+    size_t deadSlots = 0;
+};
+
+// The index of state.annotations, built on first use and rebuilt when it
+// has drifted too far from its bulk form
+const LabelIndex& LabelIndexFor(DocumentWindowState& state);
+
+// The index in a form that can be serialized with the annotations
+const LabelIndex& CompactLabelIndex(DocumentWindowState& state);
+
+// Use an index read together with the annotations just loaded
+void AdoptLabelIndex(DocumentWindowState& state, std::shared_ptr<LabelIndex> index);
+
+// Called by the undo journal after every change to state.annotations. kind
+// and index describe the change that was just applied.
+void IndexAnnotationChange(DocumentWindowState& state, AnnotationDelta::Kind kind, int index);
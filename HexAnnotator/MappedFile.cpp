@@ -0,0 +1,44 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <cstdint>
+#include <stdexcept>
+#include "MappedFile.h"
+
+MappedFile::MappedFile(const std::string& path) {
+    file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Failed to open file for reading.");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) > SIZE_MAX) {
+        close();
+        throw std::runtime_error("Failed to read " + path + ".");
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Empty files cannot be mapped
+    if (size == 0) {
+        return;
+    }
+
+    mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    view = mapping ? static_cast<const BYTE*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!view) {
+        close();
+        throw std::runtime_error("Failed to map " + path + " into memory.");
+    }
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+void MappedFile::close() {
+    if (view) UnmapViewOfFile(view);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    view = nullptr;
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+}
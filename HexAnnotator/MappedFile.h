@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+
+// Read-only view of a whole file. Pages are read as they are touched, so
+// files far larger than memory can be scanned front to back.
+class MappedFile {
+public:
+    // Throws std::runtime_error if the file cannot be opened or mapped
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const BYTE* data() const { return view; }
+    size_t length() const { return size; }
+
+private:
+    void close();
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+    const BYTE* view = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,46 @@
+#include "SelectionUpdates.h"
+
+bool SelectionUpdates::request(int offset, int length) {
+    selectedOffset = offset;
+    selectedLength = length;
+    if (scheduled) {
+        return false;
+    }
+    scheduled = true;
+    return true;
+}
+
+bool SelectionUpdates::apply(const uint8_t* data, size_t size) {
+    scheduled = false;
+    if (selectedOffset < 0 || static_cast<size_t>(selectedOffset) >= size) {
+        return false;
+    }
+    if (selectedOffset == interpretedOffset) {
+        return false;
+    }
+
+    InterpretData(data + selectedOffset, size - selectedOffset, values);
+    interpretedOffset = selectedOffset;
+    return true;
+}
+
+SelectionRefresh InterpreterGrid::apply(SelectionUpdates& updates, const uint8_t* data, size_t size, bool active) {
+    SelectionRefresh refresh;
+    refresh.recomputed = updates.apply(data, size);
+    if (!active || !updates.hasInterpretation()) {
+        return refresh;
+    }
+
+    if (refresh.recomputed || shown != &updates) {
+        refresh.grid = true;
+        shown = &updates;
+    }
+    refresh.status = true;
+    return refresh;
+}
+
+void InterpreterGrid::forget(const SelectionUpdates& updates) {
+    if (shown == &updates) {
+        shown = nullptr;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "DataInterpreter.h"
+
+// The interpreter grid and status bar of one document. A drag delivers a
+// WM_MOUSEMOVE for every pixel, so changing the selection only records it;
+// the window applies the latest selection from a timer, at most once per
+// frame and after any pending WM_PAINT, which Windows delivers first.
+//
+// The interpretation is kept per document, so activating a window shows its
+// own values again without recomputing them, and a document never shows
+// another's values at the same offset.
+class SelectionUpdates {
+public:
+    // Record the selection. True if no update was scheduled yet, in which
+    // case the caller schedules one.
+    bool request(int offset, int length);
+
+    // Whether an update is scheduled and not yet applied
+    bool pending() const { return scheduled; }
+
+    // Apply the latest selection to data, which has size bytes. True if the
+    // interpretation was recomputed; it is reused while the offset stays.
+    bool apply(const uint8_t* data, size_t size);
+
+    int offset() const { return selectedOffset; }
+    int length() const { return selectedLength; }
+
+    // Valid once apply has succeeded at an offset inside the data
+    bool hasInterpretation() const { return interpretedOffset >= 0; }
+    const DataInterpretation& interpretation() const { return values; }
+
+private:
+    int selectedOffset = -1;
+    int selectedLength = 0;
+    bool scheduled = false;
+
+    int interpretedOffset = -1;
+    DataInterpretation values = {};
+};
+
+// What a window writes after an update has been applied
+struct SelectionRefresh {
+    bool recomputed = false;    // The interpretation was recomputed
+    bool grid = false;          // Rewrite the interpreter grid from the interpretation
+    bool status = false;        // Show the selection in the status bar
+};
+
+// The interpreter grid, which every document window shares. Tracks whose
+// values it shows, so the grid is only rewritten when they changed or belong
+// to another document.
+class InterpreterGrid {
+public:
+    // Apply the latest selection of a document whose data has size bytes.
+    // Only the active document's values are shown.
+    SelectionRefresh apply(SelectionUpdates& updates, const uint8_t* data, size_t size, bool active);
+
+    // Called when the document owning updates closes
+    void forget(const SelectionUpdates& updates);
+
+private:
+    const SelectionUpdates* shown = nullptr;
+};
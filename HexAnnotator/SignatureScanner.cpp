@@ -0,0 +1,406 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <climits>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include "SignatureScanner.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIGNATURE_SSE2
+#endif
+
+// Bytes of the document scanned by one pool task
+const size_t SIGNATURE_CHUNK_SIZE = 4 * 1024 * 1024;
+
+
+static std::runtime_error rulesError(int line, const std::string& message) {
+    return std::runtime_error("Signature rules line " + std::to_string(line) + ": " + message);
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// One pattern byte: "4D", "??", "4?" or "?D"
+static bool parsePatternByte(const std::string& token, BYTE& value, BYTE& mask) {
+    if (token.size() != 2) {
+        return false;
+    }
+
+    value = 0;
+    mask = 0;
+    for (int i = 0; i < 2; ++i) {
+        int shift = i == 0 ? 4 : 0;
+        if (token[i] == '?') {
+            continue;
+        }
+
+        int digit = hexDigit(token[i]);
+        if (digit < 0) {
+            return false;
+        }
+        value |= static_cast<BYTE>(digit << shift);
+        mask |= static_cast<BYTE>(0xF << shift);
+    }
+    return true;
+}
+
+bool ParseMaskedPattern(const std::string& text, MaskedPattern& pattern) {
+    std::istringstream stream(text);
+    std::string token;
+    MaskedPattern parsed;
+
+    while (stream >> token) {
+        BYTE value, mask;
+        if (!parsePatternByte(token, value, mask)) {
+            return false;
+        }
+        parsed.bytes.push_back(value);
+        parsed.mask.push_back(mask);
+    }
+
+    if (parsed.bytes.empty()) {
+        return false;
+    }
+    pattern = std::move(parsed);
+    return true;
+}
+
+// Length column: decimal or 0x-prefixed hex. A leading zero is not octal.
+static bool parseLength(const std::string& token, int& length) {
+    bool hex = token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X');
+    if (token.empty() || !isdigit(static_cast<unsigned char>(token[0]))) {
+        return false;
+    }
+    try {
+        size_t used = 0;
+        long long value = std::stoll(token, &used, hex ? 16 : 10);
+        if (used != token.size() || value <= 0 || value > INT_MAX) {
+            return false;
+        }
+        length = static_cast<int>(value);
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Token of a rules line; quoted tokens keep their spaces and '#'
+struct RuleToken {
+    std::string text;
+    bool quoted;
+};
+
+//-------------------------------------------------------------------
+// ParseSignatureRules - Read a rules file
+//-------------------------------------------------------------------
+// Each line is:  <pattern bytes> <length> <label> [format]
+// e.g.           4D 5A ?? ?? 50 45   0x40   "PE header"   hex
+//                4D 5A   64   "DOS header"
+// The pattern ends at the first token that is not a pattern byte. A decimal
+// length of two digits also reads as a pattern byte, so when no length
+// follows the pattern its last byte is taken as the length if it is written
+// in decimal digits. Labels containing spaces or '#', or that could be read
+// as a pattern byte or length, are written in double quotes.
+std::vector<SignatureRule> ParseSignatureRules(const std::string& text) {
+    std::vector<SignatureRule> rules;
+    std::istringstream lines(text);
+    std::string line;
+    int lineNumber = 0;
+
+    while (std::getline(lines, line)) {
+        ++lineNumber;
+
+        // Split into tokens, keeping quoted labels together. A '#' outside
+        // quotes starts a comment.
+        std::vector<RuleToken> tokens;
+        size_t i = 0;
+        while (i < line.size() && line[i] != '#') {
+            if (isspace(static_cast<unsigned char>(line[i]))) {
+                ++i;
+            }
+            else if (line[i] == '"') {
+                size_t close = line.find('"', i + 1);
+                if (close == std::string::npos) {
+                    throw rulesError(lineNumber, "unterminated quoted label.");
+                }
+                tokens.push_back({ line.substr(i + 1, close - i - 1), true });
+                i = close + 1;
+            }
+            else {
+                size_t start = i;
+                while (i < line.size() && !isspace(static_cast<unsigned char>(line[i])) && line[i] != '#') ++i;
+                tokens.push_back({ line.substr(start, i - start), false });
+            }
+        }
+
+        if (tokens.empty()) {
+            continue;
+        }
+
+        // Quoted tokens are labels, never pattern bytes or lengths
+        SignatureRule rule;
+        size_t next = 0;
+        while (next < tokens.size() && !tokens[next].quoted) {
+            BYTE value, mask;
+            if (!parsePatternByte(tokens[next].text, value, mask)) {
+                break;
+            }
+            rule.pattern.bytes.push_back(value);
+            rule.pattern.mask.push_back(mask);
+            ++next;
+        }
+
+        if (rule.pattern.bytes.empty()) {
+            throw rulesError(lineNumber, "expected pattern bytes, found '" + tokens[0].text + "'.");
+        }
+        const std::string& last = tokens[next - 1].text;
+        if (next < tokens.size() && !tokens[next].quoted && parseLength(tokens[next].text, rule.length)) {
+            ++next;
+        }
+        else if (rule.pattern.bytes.size() > 1 && parseLength(last, rule.length)
+                 && std::all_of(last.begin(), last.end(), [](char c) { return isdigit(static_cast<unsigned char>(c)); })) {
+            rule.pattern.bytes.pop_back();
+            rule.pattern.mask.pop_back();
+        }
+        else {
+            throw rulesError(lineNumber, "expected a positive annotation length after the pattern, such as 64 or 0x40.");
+        }
+        if (std::none_of(rule.pattern.mask.begin(), rule.pattern.mask.end(), [](BYTE m) { return m == 0xFF; })) {
+            throw rulesError(lineNumber, "pattern needs at least one byte without wildcards.");
+        }
+        if (next >= tokens.size() || tokens[next].text.empty()) {
+            throw rulesError(lineNumber, "expected a label after the length.");
+        }
+        rule.label = tokens[next++].text;
+        rule.displayFormat = next < tokens.size() ? tokens[next++].text : "hex";
+
+        if (next < tokens.size()) {
+            throw rulesError(lineNumber, "unexpected '" + tokens[next].text + "' after the format.");
+        }
+
+        rules.push_back(std::move(rule));
+    }
+
+    return rules;
+}
+
+//-------------------------------------------------------------------
+// MultiPatternMatcher
+//-------------------------------------------------------------------
+void MultiPatternMatcher::add(const MaskedPattern& pattern, int id) {
+    // Longest run of fully specified bytes becomes the anchor
+    size_t bestOffset = 0, bestLength = 0;
+    for (size_t i = 0; i < pattern.mask.size();) {
+        if (pattern.mask[i] != 0xFF) {
+            ++i;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < pattern.mask.size() && pattern.mask[i] == 0xFF) ++i;
+        if (i - start > bestLength) {
+            bestOffset = start;
+            bestLength = i - start;
+        }
+    }
+
+    if (bestLength == 0) {
+        throw std::invalid_argument("Pattern needs at least one byte without wildcards.");
+    }
+
+    patterns.push_back({ pattern, id, bestOffset, bestLength });
+    longestPattern = std::max(longestPattern, pattern.bytes.size());
+}
+
+void MultiPatternMatcher::build() {
+    // Trie of anchors; -1 marks a missing edge until the breadth-first pass
+    // below fills it in from the failure state
+    transitions.assign(256, -1);
+    outputHead.assign(1, -1);
+    outputs.clear();
+
+    for (size_t p = 0; p < patterns.size(); ++p) {
+        const Entry& entry = patterns[p];
+        int32_t state = 0;
+
+        for (size_t i = 0; i < entry.anchorLength; ++i) {
+            size_t edge = static_cast<size_t>(state) * 256 + entry.pattern.bytes[entry.anchorOffset + i];
+            if (transitions[edge] < 0) {
+                transitions[edge] = static_cast<int32_t>(outputHead.size());
+                outputHead.push_back(-1);
+                transitions.resize(transitions.size() + 256, -1);
+            }
+            state = transitions[edge];
+        }
+
+        outputs.push_back({ static_cast<int32_t>(p), outputHead[state] });
+        outputHead[state] = static_cast<int32_t>(outputs.size() - 1);
+    }
+
+    // Breadth-first: each state's missing edges copy its failure state's edges,
+    // and its outputs chain on to the failure state's outputs
+    std::vector<int32_t> failure(outputHead.size(), 0);
+    std::vector<int32_t> queue;
+    queue.reserve(outputHead.size());
+
+    for (int b = 0; b < 256; ++b) {
+        int32_t& edge = transitions[b];
+        leavesRoot[b] = edge > 0;
+        if (edge < 0) {
+            edge = 0;
+        }
+        else {
+            queue.push_back(edge);
+        }
+    }
+
+    // Distinct first two bytes of the anchors, repeating the last to fill
+    // every probe
+    std::vector<std::pair<BYTE, BYTE>> starts;
+    useRootProbes = true;
+    for (const Entry& entry : patterns) {
+        const BYTE* anchor = entry.pattern.bytes.data() + entry.anchorOffset;
+        useRootProbes = useRootProbes && entry.anchorLength > 1;
+        starts.push_back({ anchor[0], anchor[1 % entry.anchorLength] });
+    }
+    std::sort(starts.begin(), starts.end());
+    starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+    useRootProbes = useRootProbes && starts.size() <= MAX_ROOT_PROBES;
+    if (useRootProbes) {
+        for (size_t p = 0; p < MAX_ROOT_PROBES; ++p) {
+            const auto& [first, second] = starts[std::min(p, starts.size() - 1)];
+            std::fill(std::begin(rootProbes[p].first), std::end(rootProbes[p].first), first);
+            std::fill(std::begin(rootProbes[p].second), std::end(rootProbes[p].second), second);
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int32_t state = queue[head];
+
+        // Chain outputs: the last own output links to the failure state's list
+        int32_t fallback = outputHead[failure[state]];
+        if (outputHead[state] < 0) {
+            outputHead[state] = fallback;
+        }
+        else {
+            int32_t last = outputHead[state];
+            while (outputs[last].next >= 0) last = outputs[last].next;
+            outputs[last].next = fallback;
+        }
+
+        for (int b = 0; b < 256; ++b) {
+            int32_t& edge = transitions[static_cast<size_t>(state) * 256 + b];
+            int32_t viaFailure = transitions[static_cast<size_t>(failure[state]) * 256 + b];
+            if (edge < 0) {
+                edge = viaFailure;
+            }
+            else {
+                failure[edge] = viaFailure;
+                queue.push_back(edge);
+            }
+        }
+    }
+}
+
+size_t MultiPatternMatcher::nextAnchorStart(const BYTE* data, size_t i, size_t limit) const {
+#ifdef SIGNATURE_SSE2
+    // The second byte of the last of 16 positions is 16 bytes on. The probe
+    // count is fixed so the loop over them unrolls.
+    if (useRootProbes) {
+        for (; i + 16 < limit; i += 16) {
+            __m128i firsts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            __m128i seconds = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+            __m128i found = _mm_setzero_si128();
+            for (size_t p = 0; p < MAX_ROOT_PROBES; ++p) {
+                __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rootProbes[p].first));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rootProbes[p].second));
+                found = _mm_or_si128(found, _mm_and_si128(_mm_cmpeq_epi8(firsts, first), _mm_cmpeq_epi8(seconds, second)));
+            }
+
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found));
+            if (mask) {
+                return i + std::countr_zero(mask);
+            }
+        }
+    }
+#endif
+
+    while (i < limit && !leavesRoot[data[i]]) ++i;
+    return i;
+}
+
+//-------------------------------------------------------------------
+// ScanSignatures - Annotate every rule match in the document
+//-------------------------------------------------------------------
+std::vector<Annotation> ScanSignatures(const std::vector<SignatureRule>& rules, const std::vector<BYTE>& data) {
+    std::vector<Annotation> annotations;
+
+    MultiPatternMatcher matcher;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        matcher.add(rules[i].pattern, static_cast<int>(i));
+    }
+    if (matcher.empty() || data.empty()) {
+        return annotations;
+    }
+    matcher.build();
+
+    // Each chunk reports the matches that start inside it; the matcher reads
+    // past the chunk end as far as needed to complete them
+    struct Match {
+        size_t offset;
+        int rule;
+        bool operator<(const Match& other) const {
+            return offset != other.offset ? offset < other.offset : rule < other.rule;
+        }
+    };
+
+    size_t chunkCount = (data.size() + SIGNATURE_CHUNK_SIZE - 1) / SIGNATURE_CHUNK_SIZE;
+    std::vector<std::vector<Match>> parts(chunkCount);
+
+    WorkerPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        size_t begin = chunk * SIGNATURE_CHUNK_SIZE;
+        size_t end = std::min(begin + SIGNATURE_CHUNK_SIZE, data.size());
+
+        auto& matches = parts[chunk];
+        matcher.scan(data.data(), data.size(), begin, end, [&](int rule, size_t offset) {
+            matches.push_back({ offset, rule });
+        });
+
+        // Matches arrive in order of anchor end, not start
+        std::sort(matches.begin(), matches.end());
+    });
+
+    size_t lastEnd = 0;
+    for (const auto& part : parts) {
+        for (const Match& match : part) {
+            if (match.offset < lastEnd || match.offset > INT_MAX) {
+                continue;
+            }
+
+            const SignatureRule& rule = rules[match.rule];
+            size_t end = std::min(match.offset + rule.length, data.size());
+            lastEnd = end;
+
+            annotations.push_back({
+                static_cast<int>(match.offset),
+                static_cast<int>(end - 1),
+                rule.label,
+                rule.displayFormat,
+                match.rule % static_cast<int>(std::size(annotationColors))
+            });
+        }
+    }
+
+    return annotations;
+}
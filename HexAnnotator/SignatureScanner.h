@@ -0,0 +1,132 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "includes.h"
+
+// Byte pattern where mask bits that are 0 are "don't care"
+struct MaskedPattern {
+    std::vector<BYTE> bytes;
+    std::vector<BYTE> mask;
+
+    bool matches(const BYTE* p) const {
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            if ((p[i] & mask[i]) != bytes[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// "Every occurrence of pattern is a <length>-byte <label> shown as <format>"
+struct SignatureRule {
+    MaskedPattern pattern;
+    int length;
+    std::string label;
+    std::string displayFormat;
+};
+
+// Parse "hex-pattern length label [format]" lines. Pattern bytes are two hex
+// digits where either digit may be '?'. The length is decimal or 0x-prefixed
+// hex; a two-digit decimal length such as 64 is told apart from a pattern
+// byte by the label that must follow it. A quoted label is never read as a
+// pattern byte or length. Blank lines and comments, from a '#' outside quotes,
+// are ignored. Throws std::runtime_error with a line number on malformed input.
+std::vector<SignatureRule> ParseSignatureRules(const std::string& text);
+
+// Parse one hex pattern such as "4D 5A ?? ?? 50 45" or "A? 0F". Returns false
+// if the text is not a pattern.
+bool ParseMaskedPattern(const std::string& text, MaskedPattern& pattern);
+
+//-------------------------------------------------------------------
+// MultiPatternMatcher - one-pass search for many masked patterns
+//-------------------------------------------------------------------
+// Each pattern is indexed by its longest run of fully specified bytes (the
+// anchor). The anchors are compiled into an Aho-Corasick automaton with every
+// transition precomputed, so the scan costs one table lookup per byte; anchor
+// hits are then verified against the full masked pattern. While no anchor has
+// begun, the first two bytes of every anchor are tested against 16 positions
+// at once instead, if there are few enough of them and no anchor is a single
+// byte.
+class MultiPatternMatcher {
+public:
+    // Patterns must contain at least one fully specified byte
+    void add(const MaskedPattern& pattern, int id);
+    void build();
+
+    size_t maxPatternLength() const { return longestPattern; }
+    bool empty() const { return patterns.empty(); }
+
+    // Report (id, start) for every match whose start lies in [begin, end).
+    // Bytes up to data + size may be read to complete matches near end.
+    template <typename OnMatch>
+    void scan(const BYTE* data, size_t size, size_t begin, size_t end, OnMatch onMatch) const {
+        size_t limit = std::min(size, end + longestPattern - 1);
+        int32_t state = 0;
+
+        for (size_t i = begin; i < limit; ++i) {
+            // Nothing can start until the start of an anchor appears
+            if (state == 0) {
+                i = nextAnchorStart(data, i, limit);
+                if (i == limit) break;
+            }
+
+            state = transitions[static_cast<size_t>(state) * 256 + data[i]];
+
+            for (int32_t out = outputHead[state]; out >= 0; out = outputs[out].next) {
+                const Entry& entry = patterns[outputs[out].pattern];
+                size_t anchorEnd = i + 1;
+                if (anchorEnd < entry.anchorOffset + entry.anchorLength) continue;
+
+                size_t start = anchorEnd - entry.anchorOffset - entry.anchorLength;
+                if (start < begin || start >= end || start + entry.pattern.bytes.size() > size) continue;
+
+                if (entry.pattern.matches(data + start)) {
+                    onMatch(entry.id, start);
+                }
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        MaskedPattern pattern;
+        int id;
+        size_t anchorOffset;
+        size_t anchorLength;
+    };
+
+    struct Output {
+        int32_t pattern;
+        int32_t next;
+    };
+
+    // First two bytes of an anchor, each repeated for a 16-byte compare
+    struct RootProbe {
+        BYTE first[16];
+        BYTE second[16];
+    };
+
+    // Distinct anchor starts tested together; with more, the scan steps
+    // through the root state a byte at a time
+    static const size_t MAX_ROOT_PROBES = 8;
+
+    // First position from i on where an anchor may start, or limit
+    size_t nextAnchorStart(const BYTE* data, size_t i, size_t limit) const;
+
+    std::vector<Entry> patterns;
+    std::vector<int32_t> transitions;   // state * 256 + byte -> state
+    std::vector<int32_t> outputHead;    // state -> first Output, or -1
+    std::vector<Output> outputs;
+    bool leavesRoot[256] = {};
+    RootProbe rootProbes[MAX_ROOT_PROBES];
+    bool useRootProbes = false;
+    size_t longestPattern = 0;
+};
+
+// Scan the whole document in parallel chunks and return one annotation per
+// match, ordered by offset. A match that starts inside an earlier match is
+// dropped so the results never overlap each other.
+std::vector<Annotation> ScanSignatures(const std::vector<SignatureRule>& rules, const std::vector<BYTE>& data);
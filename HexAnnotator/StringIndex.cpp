@@ -0,0 +1,476 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include "StringIndex.h"
+#include "WorkerPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define STRING_INDEX_SSE2
+#endif
+
+// Documents are scanned in chunks of this many bytes. Must be even, so every
+// chunk starts at the same UTF-16 phase.
+const size_t STRINGS_CHUNK_SIZE = 1024 * 1024;
+
+// Strings read by one filter task
+const size_t STRINGS_FILTER_SLICE = 64 * 1024;
+
+// Entry layout: offset in the low bits, then length, then encoding
+const int STRINGS_OFFSET_BITS = 40;
+const int STRINGS_LENGTH_BITS = 22;
+const uint64_t STRINGS_OFFSET_MASK = (uint64_t(1) << STRINGS_OFFSET_BITS) - 1;
+
+static const char STRING_INDEX_MAGIC[8] = { 'H', 'V', 'S', 'T', 'R', 'I', 'X', '1' };
+
+static uint64_t packEntry(uint64_t offset, uint64_t length, StringEncoding encoding) {
+    return offset | (length << STRINGS_OFFSET_BITS) | (uint64_t(encoding) << (STRINGS_OFFSET_BITS + STRINGS_LENGTH_BITS));
+}
+
+static uint64_t entryOffset(uint64_t entry) {
+    return entry & STRINGS_OFFSET_MASK;
+}
+
+static uint64_t entryEnd(uint64_t entry) {
+    return entryOffset(entry) + ((entry >> STRINGS_OFFSET_BITS) & STRINGS_MAX_BYTES);
+}
+
+static bool startsBefore(uint64_t a, uint64_t b) {
+    return entryOffset(a) < entryOffset(b);
+}
+
+//-------------------------------------------------------------------
+// Classification
+//-------------------------------------------------------------------
+static inline bool isPrintable(uint8_t byte) {
+    return (byte >= 0x20 && byte <= 0x7E) || byte == '\t';
+}
+
+// Bit i describes byte i of a 64-byte block. Bytes past the end of the data
+// are none of these.
+struct BlockMasks {
+    uint64_t printable;
+    uint64_t zero;
+    uint64_t lead;              // C2..F4, which may start a UTF-8 character
+    uint64_t continuation;      // 80..BF
+};
+
+static inline bool isLead(uint8_t byte) {
+    return byte >= 0xC2 && byte <= 0xF4;
+}
+
+static inline bool isContinuation(uint8_t byte) {
+    return (byte & 0xC0) == 0x80;
+}
+
+static BlockMasks classify(const uint8_t* p, size_t available) {
+    BlockMasks masks = { 0, 0, 0, 0 };
+#ifdef STRING_INDEX_SSE2
+    if (available >= 64) {
+        // Adding 0x60 moves 20..7E to the signed bytes below -33 and nothing
+        // else there
+        const __m128i shift = _mm_set1_epi8(0x60);
+        const __m128i limit = _mm_set1_epi8(-33);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i continuationEnd = _mm_set1_epi8(-64);     // C0
+        const __m128i leadBefore = _mm_set1_epi8(-63);          // C1
+        const __m128i leadEnd = _mm_set1_epi8(-11);             // F5
+        for (int k = 0; k < 4; ++k) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+            __m128i printable = _mm_or_si128(_mm_cmplt_epi8(_mm_add_epi8(v, shift), limit), _mm_cmpeq_epi8(v, tab));
+            __m128i lead = _mm_and_si128(_mm_cmpgt_epi8(v, leadBefore), _mm_cmplt_epi8(v, leadEnd));
+            masks.printable |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(printable))) << (16 * k);
+            masks.zero |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))) << (16 * k);
+            masks.lead |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(lead))) << (16 * k);
+            masks.continuation |= uint64_t(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmplt_epi8(v, continuationEnd)))) << (16 * k);
+        }
+        return masks;
+    }
+#endif
+    const size_t count = std::min<size_t>(available, 64);
+    for (size_t i = 0; i < count; ++i) {
+        masks.printable |= uint64_t(isPrintable(p[i])) << i;
+        masks.zero |= uint64_t(p[i] == 0) << i;
+        masks.lead |= uint64_t(isLead(p[i])) << i;
+        masks.continuation |= uint64_t(isContinuation(p[i])) << i;
+    }
+    return masks;
+}
+
+// Length of the well-formed UTF-8 character at p, or 0 if there is none or
+// it is a C1 control
+static size_t utf8Sequence(const uint8_t* p, size_t available) {
+    const uint8_t lead = p[0];
+    size_t length;
+    uint32_t codePoint;
+    uint32_t smallest;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2, codePoint = lead & 0x1F, smallest = 0xA0;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3, codePoint = lead & 0x0F, smallest = 0x800;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4, codePoint = lead & 0x07, smallest = 0x10000;
+    }
+    else {
+        return 0;
+    }
+
+    if (available < length) {
+        return 0;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (p[i] & 0x3F);
+    }
+    if (codePoint < smallest || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+//-------------------------------------------------------------------
+// Scanning
+//-------------------------------------------------------------------
+// A run being followed through the blocks of a chunk
+struct RunTracker {
+    bool open = false;
+    bool done = false;          // The next run starts in the next chunk
+    size_t start = 0;
+    size_t continuation = 0;    // UTF-8 bytes after the first of a character
+};
+
+// Add a run, split if it is too long for one entry
+static void emitRun(std::vector<uint64_t>& out, const uint8_t* data, uint64_t start, uint64_t end, StringEncoding encoding) {
+    while (end - start > STRINGS_MAX_BYTES) {
+        uint64_t split = start + STRINGS_MAX_BYTES - 1;     // Even, for UTF-16
+        while (encoding == SE_UTF8 && (data[split] & 0xC0) == 0x80) {
+            --split;
+        }
+        out.push_back(packEntry(start, split - start, encoding));
+        start = split;
+    }
+    out.push_back(packEntry(start, end - start, encoding));
+}
+
+// Bits first to last - 1
+static inline uint64_t bitsBetween(size_t first, size_t last) {
+    return (last == 64 ? ~uint64_t(0) : (uint64_t(1) << last) - 1) & ~((uint64_t(1) << first) - 1);
+}
+
+// Follow a run through the bytes of the block at offset i whose bits are set
+// in covered, calling close(start, end) for each run that ends. Runs that
+// would start at or after end belong to the next chunk. Bits set in
+// continuation are counted into the run. Runs of fewer than
+// STRINGS_MIN_LENGTH bytes inside the block are skipped without opening them.
+template <typename Close>
+static void followRuns(RunTracker& run, uint64_t covered, uint64_t continuation, size_t i, size_t end, Close&& close) {
+    static_assert(STRINGS_MIN_LENGTH == 4, "long is four shifts");
+    const uint64_t long4 = covered & ((covered >> 1) | (uint64_t(1) << 63))
+                                   & ((covered >> 2) | (uint64_t(3) << 62))
+                                   & ((covered >> 3) | (uint64_t(7) << 61));
+    size_t position = 0;
+    while (position < 64 && !run.done) {
+        if (run.open) {
+            uint64_t gaps = ~covered >> position;
+            if (gaps == 0) {
+                run.continuation += std::popcount(continuation & bitsBetween(position, 64));
+                return;     // Continues into the next block
+            }
+            const size_t stop = position + std::countr_zero(gaps);
+            run.continuation += std::popcount(continuation & bitsBetween(position, stop));
+            position = stop;
+            close(run.start, i + position);
+            run.open = false;
+        }
+        else {
+            uint64_t starts = long4 >> position;
+            if (starts == 0) {
+                return;
+            }
+            const size_t first = position + std::countr_zero(starts);
+            const uint64_t gaps = ~covered & bitsBetween(position, first);
+            position = gaps != 0 ? 64 - std::countl_zero(gaps) : position;
+            if (i + position >= end) {
+                run.done = true;
+                return;
+            }
+            run.open = true;
+            run.start = i + position;
+            run.continuation = 0;
+        }
+    }
+}
+
+// ASCII and UTF-8 runs starting in [begin, end). A lead byte followed by a
+// continuation byte may start a multibyte character; only those are decoded.
+static void scanText(const uint8_t* data, size_t size, size_t begin, size_t end, std::vector<uint64_t>& out) {
+    RunTracker run;
+    auto close = [&](size_t start, size_t stop) {
+        if (stop - start - run.continuation >= STRINGS_MIN_LENGTH) {
+            emitRun(out, data, start, stop, run.continuation ? SE_UTF8 : SE_ASCII);
+        }
+    };
+
+    uint64_t carry = 0;     // The rest of a character that started in the block before
+    size_t i = begin;
+    for (; i < size && !run.done && (run.open || i < end); i += 64) {
+        BlockMasks masks = classify(data + i, size - i);
+        uint64_t text = masks.printable | carry;
+        uint64_t continuation = carry;
+        carry = 0;
+
+        uint64_t nextContinuation = i + 64 < size ? isContinuation(data[i + 64]) : 0;
+        uint64_t candidates = masks.lead & ((masks.continuation >> 1) | (nextContinuation << 63));
+        for (; candidates != 0; candidates &= candidates - 1) {
+            const size_t j = std::countr_zero(candidates);
+            const size_t length = utf8Sequence(data + i + j, size - i - j);
+            if (length != 0) {
+                const uint64_t tail = ((uint64_t(1) << length) - 2);     // Bytes after the first
+                text |= (uint64_t(1) << j) | (tail << j);
+                continuation |= tail << j;
+                if (j + length > 64) {
+                    carry = tail >> (64 - j);
+                }
+            }
+        }
+
+        followRuns(run, text, continuation, i, end, close);
+    }
+    if (run.open) {
+        close(run.start, std::min(i, size));
+    }
+}
+
+// UTF-16 runs starting in [begin, end), both byte orders and both phases
+static void scanWide(const uint8_t* data, size_t size, size_t begin, size_t end,
+                     std::vector<uint64_t>& little, std::vector<uint64_t>& big) {
+    const uint64_t EVEN = 0x5555555555555555ull;
+    RunTracker runs[4];         // Little endian even and odd, big endian even and odd
+    uint64_t carry[4] = {};     // A character in the last byte pair of a block
+
+    auto closer = [&](int which) {
+        return [&, which](size_t start, size_t stop) {
+            if ((stop - start) / 2 >= STRINGS_MIN_LENGTH) {
+                emitRun(which < 2 ? little : big, data, start, stop, which < 2 ? SE_UTF16LE : SE_UTF16BE);
+            }
+        };
+    };
+
+    size_t i = begin;
+    for (; i < size; i += 64) {
+        bool active = false;
+        for (const RunTracker& run : runs) {
+            active |= run.open || (!run.done && i < end);
+        }
+        if (!active) {
+            break;
+        }
+
+        // A character starts at j if bytes j and j + 1 are a printable byte and
+        // a zero, in the right order
+        BlockMasks masks = classify(data + i, size - i);
+        uint64_t nextPrintable = i + 64 < size ? isPrintable(data[i + 64]) : 0;
+        uint64_t nextZero = i + 64 < size ? data[i + 64] == 0 : 0;
+        uint64_t littleChars = masks.printable & ((masks.zero >> 1) | (nextZero << 63));
+        uint64_t bigChars = masks.zero & ((masks.printable >> 1) | (nextPrintable << 63));
+        const uint64_t chars[4] = { littleChars & EVEN, littleChars & ~EVEN, bigChars & EVEN, bigChars & ~EVEN };
+
+        for (int k = 0; k < 4; ++k) {
+            uint64_t covered = chars[k] | (chars[k] << 1) | carry[k];
+            carry[k] = chars[k] >> 63;
+            followRuns(runs[k], covered, 0, i, end, closer(k));
+        }
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        if (runs[k].open) {
+            closer(k)(runs[k].start, std::min(i, size));
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+// StringIndex
+//-------------------------------------------------------------------
+StringIndex::StringIndex(const uint8_t* data, size_t size) : documentSize(size) {
+    struct ChunkStrings {
+        std::vector<uint64_t> text, little, big;
+    };
+
+    const size_t chunkCount = (size + STRINGS_CHUNK_SIZE - 1) / STRINGS_CHUNK_SIZE;
+    std::vector<ChunkStrings> chunks(chunkCount);
+    WorkerPool::shared().parallelFor(chunkCount, [&](size_t chunk) {
+        const size_t begin = chunk * STRINGS_CHUNK_SIZE;
+        const size_t end = std::min(size, begin + STRINGS_CHUNK_SIZE);
+        ChunkStrings& found = chunks[chunk];
+        scanText(data, size, begin, end, found.text);
+        scanWide(data, size, begin, end, found.little, found.big);
+
+        // The phases close their runs in turn
+        std::sort(found.little.begin(), found.little.end(), startsBefore);
+        std::sort(found.big.begin(), found.big.end(), startsBefore);
+    });
+
+    // A chunk that starts inside a run the chunk before followed to its end
+    // has the rest of it too
+    std::vector<uint64_t> text, little, big;
+    auto join = [](std::vector<uint64_t>& lane, uint64_t& covered, const std::vector<uint64_t>& found) {
+        for (uint64_t entry : found) {
+            if (entryOffset(entry) >= covered) {
+                lane.push_back(entry);
+                covered = std::max(covered, entryEnd(entry));
+            }
+        }
+    };
+    uint64_t textCovered = 0, littleCovered = 0, bigCovered = 0;
+    for (const ChunkStrings& found : chunks) {
+        join(text, textCovered, found.text);
+        join(little, littleCovered, found.little);
+        join(big, bigCovered, found.big);
+    }
+
+    // "\0A\0B\0C\0D" reads as big endian from its first byte and little
+    // endian from its second; little endian is far more common
+    size_t next = 0;
+    auto overlapsLittle = [&](uint64_t entry) {
+        while (next < little.size() && entryEnd(little[next]) <= entryOffset(entry)) {
+            ++next;
+        }
+        return next < little.size() && entryOffset(little[next]) < entryEnd(entry);
+    };
+    big.erase(std::remove_if(big.begin(), big.end(), overlapsLittle), big.end());
+
+    std::vector<uint64_t> wide;
+    wide.reserve(little.size() + big.size());
+    std::merge(little.begin(), little.end(), big.begin(), big.end(), std::back_inserter(wide), startsBefore);
+    entries.reserve(text.size() + wide.size());
+    std::merge(text.begin(), text.end(), wide.begin(), wide.end(), std::back_inserter(entries), startsBefore);
+}
+
+StringIndex::StringIndex(const uint8_t* bytes, size_t size, uint64_t documentSize) : documentSize(documentSize) {
+    const std::runtime_error damaged("The string index is damaged.");
+    const size_t header = sizeof(STRING_INDEX_MAGIC) + 2 * sizeof(uint64_t);
+    if (size < header || memcmp(bytes, STRING_INDEX_MAGIC, sizeof(STRING_INDEX_MAGIC)) != 0) {
+        throw damaged;
+    }
+
+    uint64_t indexedSize, count;
+    memcpy(&indexedSize, bytes + sizeof(STRING_INDEX_MAGIC), sizeof(indexedSize));
+    memcpy(&count, bytes + sizeof(STRING_INDEX_MAGIC) + sizeof(indexedSize), sizeof(count));
+    if (indexedSize != documentSize || count != (size - header) / sizeof(uint64_t) || (size - header) % sizeof(uint64_t) != 0) {
+        throw damaged;
+    }
+
+    entries.resize(static_cast<size_t>(count));
+    memcpy(entries.data(), bytes + header, entries.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entryEnd(entries[i]) > documentSize || (i > 0 && entryOffset(entries[i]) < entryOffset(entries[i - 1]))) {
+            throw damaged;
+        }
+    }
+}
+
+StringRun StringIndex::at(size_t index) const {
+    const uint64_t entry = entries[index];
+    return { entryOffset(entry), static_cast<uint32_t>((entry >> STRINGS_OFFSET_BITS) & STRINGS_MAX_BYTES),
+             static_cast<StringEncoding>(entry >> (STRINGS_OFFSET_BITS + STRINGS_LENGTH_BITS)) };
+}
+
+size_t StringIndex::lowerBound(uint64_t offset) const {
+    return std::partition_point(entries.begin(), entries.end(),
+                                [offset](uint64_t entry) { return entryOffset(entry) < offset; }) - entries.begin();
+}
+
+// The text of a string, ASCII case folded
+static void foldedText(const uint8_t* data, const StringRun& run, std::string& out) {
+    out.clear();
+    const uint8_t* p = data + run.offset;
+    const bool wide = run.encoding == SE_UTF16LE || run.encoding == SE_UTF16BE;
+    const size_t step = wide ? 2 : 1;
+    const size_t first = run.encoding == SE_UTF16BE ? 1 : 0;
+    for (size_t i = first; i < run.length; i += step) {
+        uint8_t byte = p[i];
+        out.push_back(static_cast<char>(byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte));
+    }
+}
+
+std::vector<uint32_t> StringIndex::filter(const uint8_t* data, std::string_view text, size_t minLength) const {
+    std::string needle(text);
+    for (char& c : needle) {
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+    }
+
+    const size_t sliceCount = (entries.size() + STRINGS_FILTER_SLICE - 1) / STRINGS_FILTER_SLICE;
+    std::vector<std::vector<uint32_t>> slices(sliceCount);
+    WorkerPool::shared().parallelFor(sliceCount, [&](size_t slice) {
+        std::string folded;
+        const size_t last = std::min(entries.size(), (slice + 1) * STRINGS_FILTER_SLICE);
+        for (size_t i = slice * STRINGS_FILTER_SLICE; i < last; ++i) {
+            const StringRun run = at(i);
+            if (minLength > STRINGS_MIN_LENGTH && StringCharacters(data, run) < minLength) {
+                continue;
+            }
+            if (!needle.empty()) {
+                foldedText(data, run, folded);
+                if (folded.find(needle) == std::string::npos) {
+                    continue;
+                }
+            }
+            slices[slice].push_back(static_cast<uint32_t>(i));
+        }
+    });
+
+    std::vector<uint32_t> found;
+    for (const std::vector<uint32_t>& slice : slices) {
+        found.insert(found.end(), slice.begin(), slice.end());
+    }
+    return found;
+}
+
+void StringIndex::serialize(std::string& out) const {
+    uint64_t count = entries.size();
+    out.append(STRING_INDEX_MAGIC, sizeof(STRING_INDEX_MAGIC));
+    out.append(reinterpret_cast<const char*>(&documentSize), sizeof(documentSize));
+    out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(uint64_t));
+}
+
+size_t StringCharacters(const uint8_t* data, const StringRun& run) {
+    switch (run.encoding) {
+    case SE_UTF16LE:
+    case SE_UTF16BE:
+        return run.length / 2;
+    case SE_UTF8:
+        return std::count_if(data + run.offset, data + run.end(), [](uint8_t byte) { return (byte & 0xC0) != 0x80; });
+    default:
+        return run.length;
+    }
+}
+
+std::string StringText(const uint8_t* data, const StringRun& run, size_t maxChars) {
+    std::string text;
+    const uint8_t* p = data + run.offset;
+    if (run.encoding == SE_UTF16LE || run.encoding == SE_UTF16BE) {
+        for (size_t i = run.encoding == SE_UTF16BE ? 1 : 0; i < run.length && text.size() < maxChars; i += 2) {
+            text.push_back(static_cast<char>(p[i]));
+        }
+        return text;
+    }
+
+    size_t chars = 0;
+    for (size_t i = 0; i < run.length; ++i) {
+        if ((p[i] & 0xC0) != 0x80 && chars++ == maxChars) {
+            break;
+        }
+        text.push_back(static_cast<char>(p[i]));
+    }
+    return text;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Printable strings in a document, as the strings tool finds them: runs of
+// at least STRINGS_MIN_LENGTH characters that are printable ASCII or tab, in
+// four encodings. UTF-8 runs may also contain well-formed multibyte
+// characters other than C1 controls; UTF-16 runs, like the "unicode"
+// display format, are Basic Latin only.
+enum StringEncoding {
+    SE_ASCII,
+    SE_UTF8,        // A run with at least one multibyte character
+    SE_UTF16LE,
+    SE_UTF16BE
+};
+
+// Shortest string found, in characters. Longer minimums are a filter.
+const size_t STRINGS_MIN_LENGTH = 4;
+
+// Longest string held as one entry, in bytes; longer runs are split
+const size_t STRINGS_MAX_BYTES = (size_t(1) << 22) - 1;
+
+struct StringRun {
+    uint64_t offset;
+    uint32_t length;        // Bytes
+    StringEncoding encoding;
+
+    uint64_t end() const { return offset + length; }
+};
+
+//-------------------------------------------------------------------
+// StringIndex - every string in a document, by offset
+//-------------------------------------------------------------------
+// Each string is one 64-bit entry packing its offset, byte length and
+// encoding, so millions of them take a few megabytes and the index can be
+// filed in the catalog as it is held in memory.
+//
+// The document is scanned in parallel chunks on the shared worker pool, 64
+// bytes at a time: SSE2 compares classify every byte as printable, zero,
+// UTF-8 lead or continuation, and runs are followed through the resulting bit
+// masks without a branch per byte, skipping those too short to keep. Only a
+// lead byte followed by a continuation byte is decoded, to check the
+// character it may start. Each chunk reports the runs that start in it, following
+// the last ones past its end; a run that starts in the chunk before covers
+// the start of the next chunk, which drops its own piece of it. A UTF-16BE
+// run that overlaps a UTF-16LE one is a misreading of the same bytes and is
+// dropped.
+class StringIndex {
+public:
+    // Find the strings of data
+    StringIndex(const uint8_t* data, size_t size);
+
+    // Read the serialized form for a document of documentSize bytes. Throws
+    // std::runtime_error if it is damaged.
+    StringIndex(const uint8_t* bytes, size_t size, uint64_t documentSize);
+
+    size_t count() const { return entries.size(); }
+    StringRun at(size_t index) const;
+
+    // Index of the first string starting at or after offset
+    size_t lowerBound(uint64_t offset) const;
+
+    // Indices of the strings of at least minLength characters whose text
+    // contains text, ignoring ASCII case; every such string if text is
+    // empty. Strings are read from data, in parallel.
+    std::vector<uint32_t> filter(const uint8_t* data, std::string_view text, size_t minLength) const;
+
+    // Append the serialized form
+    void serialize(std::string& out) const;
+
+private:
+    std::vector<uint64_t> entries;
+    uint64_t documentSize = 0;
+};
+
+// Length of a string in characters
+size_t StringCharacters(const uint8_t* data, const StringRun& run);
+
+// Up to maxChars characters of a string as UTF-8
+std::string StringText(const uint8_t* data, const StringRun& run, size_t maxChars);
@@ -0,0 +1,661 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include "StructTemplate.h"
+#include "WorkerPool.h"
+
+// Records handed to one pool task when a template is applied repeatedly
+const size_t RECORDS_PER_TASK = 4096;
+
+//-------------------------------------------------------------------
+// Primitive types understood by the template language
+//-------------------------------------------------------------------
+struct PrimitiveType {
+    const char* name;
+    int size;
+    bool isSigned;
+    bool isInteger;
+    const char* scalarFormat;   // Display format for a single value
+    const char* arrayFormat;    // Display format for an array of values
+};
+
+static const PrimitiveType primitiveTypes[] = {
+    { "char",               1, true,  true,  "ascii",   "ascii" },
+    { "signed char",        1, true,  true,  "int",     "hex" },
+    { "unsigned char",      1, false, true,  "int",     "hex" },
+    { "wchar",              2, false, true,  "unicode", "unicode" },
+    { "wchar_t",            2, false, true,  "unicode", "unicode" },
+    { "int8",               1, true,  true,  "int",     "hex" },
+    { "int8_t",             1, true,  true,  "int",     "hex" },
+    { "uint8",              1, false, true,  "int",     "hex" },
+    { "uint8_t",            1, false, true,  "int",     "hex" },
+    { "byte",               1, false, true,  "int",     "hex" },
+    { "BYTE",               1, false, true,  "int",     "hex" },
+    { "short",              2, true,  true,  "int",     "hex" },
+    { "unsigned short",     2, false, true,  "int",     "hex" },
+    { "int16",              2, true,  true,  "int",     "hex" },
+    { "int16_t",            2, true,  true,  "int",     "hex" },
+    { "uint16",             2, false, true,  "int",     "hex" },
+    { "uint16_t",           2, false, true,  "int",     "hex" },
+    { "WORD",               2, false, true,  "int",     "hex" },
+    { "int",                4, true,  true,  "int",     "hex" },
+    { "unsigned int",       4, false, true,  "int",     "hex" },
+    { "long",               4, true,  true,  "int",     "hex" },
+    { "unsigned long",      4, false, true,  "int",     "hex" },
+    { "int32",              4, true,  true,  "int",     "hex" },
+    { "int32_t",            4, true,  true,  "int",     "hex" },
+    { "uint32",             4, false, true,  "int",     "hex" },
+    { "uint32_t",           4, false, true,  "int",     "hex" },
+    { "DWORD",              4, false, true,  "int",     "hex" },
+    { "long long",          8, true,  true,  "int",     "hex" },
+    { "unsigned long long", 8, false, true,  "int",     "hex" },
+    { "int64",              8, true,  true,  "int",     "hex" },
+    { "int64_t",            8, true,  true,  "int",     "hex" },
+    { "uint64",             8, false, true,  "int",     "hex" },
+    { "uint64_t",           8, false, true,  "int",     "hex" },
+    { "QWORD",              8, false, true,  "int",     "hex" },
+    { "float",              4, true,  false, "float",   "hex" },
+    { "double",             8, true,  false, "double",  "hex" },
+};
+
+static const PrimitiveType* findPrimitive(const std::string& name) {
+    for (const auto& type : primitiveTypes) {
+        if (name == type.name) {
+            return &type;
+        }
+    }
+    return nullptr;
+}
+
+// Words that can combine into a multi-word C type such as "unsigned long long"
+static bool isTypeModifier(const std::string& word) {
+    return word == "unsigned" || word == "signed" || word == "char" ||
+        word == "short" || word == "int" || word == "long";
+}
+
+//-------------------------------------------------------------------
+// Tokenizer
+//-------------------------------------------------------------------
+struct Token {
+    enum Type { Identifier, Number, Punct, End };
+
+    Type type;
+    std::string text;
+    long long value = 0;
+    int line = 0;
+};
+
+static std::runtime_error templateError(int line, const std::string& message) {
+    return std::runtime_error("Struct template line " + std::to_string(line) + ": " + message);
+}
+
+static std::vector<Token> tokenize(const std::string& text) {
+    std::vector<Token> tokens;
+    int line = 1;
+    size_t i = 0;
+
+    while (i < text.size()) {
+        char c = text[i];
+
+        if (c == '\n') {
+            ++line;
+            ++i;
+        }
+        else if (isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        }
+        else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+            while (i < text.size() && text[i] != '\n') ++i;
+        }
+        else if (c == '/' && i + 1 < text.size() && text[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < text.size() && !(text[i] == '*' && text[i + 1] == '/')) {
+                if (text[i] == '\n') ++line;
+                ++i;
+            }
+            i += 2;
+        }
+        else if (isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = i;
+            while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) ++i;
+            tokens.push_back({ Token::Identifier, text.substr(start, i - start), 0, line });
+        }
+        else if (isdigit(static_cast<unsigned char>(c))) {
+            size_t start = i;
+            while (i < text.size() && isalnum(static_cast<unsigned char>(text[i]))) ++i;
+            std::string digits = text.substr(start, i - start);
+
+            long long value = 0;
+            int base = 10;
+            const char* first = digits.data();
+            if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+                base = 16;
+                first += 2;
+            }
+            auto result = std::from_chars(first, digits.data() + digits.size(), value, base);
+            if (result.ec != std::errc() || result.ptr != digits.data() + digits.size()) {
+                throw templateError(line, "invalid number '" + digits + "'");
+            }
+            tokens.push_back({ Token::Number, digits, value, line });
+        }
+        else if (strchr("{}[];", c)) {
+            tokens.push_back({ Token::Punct, std::string(1, c), 0, line });
+            ++i;
+        }
+        else {
+            throw templateError(line, std::string("unexpected character '") + c + "'");
+        }
+    }
+
+    tokens.push_back({ Token::End, "", 0, line });
+    return tokens;
+}
+
+//-------------------------------------------------------------------
+// Parser - builds struct declarations from tokens
+//-------------------------------------------------------------------
+struct FieldDecl {
+    std::string typeName;
+    std::string name;
+    bool isArray = false;
+    long long count = 1;
+    std::string countField;     // Non-empty when the length comes from a field
+    int line = 0;
+};
+
+struct StructDecl {
+    std::string name;
+    std::vector<FieldDecl> fields;
+    int line = 0;
+};
+
+class TemplateParser {
+public:
+    explicit TemplateParser(std::vector<Token> tokens) : tokens(std::move(tokens)) {}
+
+    std::vector<StructDecl> parse() {
+        std::vector<StructDecl> structs;
+        while (peek().type != Token::End) {
+            structs.push_back(parseStruct());
+        }
+        return structs;
+    }
+
+private:
+    const Token& peek() const { return tokens[pos]; }
+    const Token& next() {
+        const Token& token = tokens[pos];
+        if (token.type != Token::End) {
+            ++pos;
+        }
+        return token;
+    }
+
+    bool acceptPunct(char c) {
+        if (peek().type == Token::Punct && peek().text[0] == c) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expectPunct(char c) {
+        if (!acceptPunct(c)) {
+            throw templateError(peek().line, std::string("expected '") + c + "'");
+        }
+    }
+
+    std::string expectIdentifier(const char* what) {
+        if (peek().type != Token::Identifier) {
+            throw templateError(peek().line, std::string("expected ") + what);
+        }
+        return next().text;
+    }
+
+    StructDecl parseStruct() {
+        StructDecl decl;
+        decl.line = peek().line;
+
+        if (expectIdentifier("'struct'") != "struct") {
+            throw templateError(decl.line, "expected 'struct'");
+        }
+        decl.name = expectIdentifier("struct name");
+        expectPunct('{');
+
+        while (!acceptPunct('}')) {
+            decl.fields.push_back(parseField());
+        }
+        acceptPunct(';');
+
+        if (decl.fields.empty()) {
+            throw templateError(decl.line, "struct '" + decl.name + "' has no fields");
+        }
+        return decl;
+    }
+
+    FieldDecl parseField() {
+        FieldDecl field;
+        field.line = peek().line;
+
+        // Type name, possibly several words ("unsigned long long") or "struct X"
+        std::string typeName = expectIdentifier("field type");
+        if (typeName == "struct") {
+            typeName = expectIdentifier("struct name");
+        }
+        else if (isTypeModifier(typeName)) {
+            while (peek().type == Token::Identifier && isTypeModifier(peek().text)) {
+                typeName += " " + next().text;
+            }
+        }
+        field.typeName = typeName;
+        field.name = expectIdentifier("field name");
+
+        if (acceptPunct('[')) {
+            field.isArray = true;
+            if (peek().type == Token::Number) {
+                field.count = next().value;
+            }
+            else if (peek().type == Token::Identifier) {
+                field.countField = next().text;
+            }
+            else {
+                throw templateError(peek().line, "expected array length");
+            }
+            expectPunct(']');
+        }
+        expectPunct(';');
+        return field;
+    }
+
+    std::vector<Token> tokens;
+    size_t pos = 0;
+};
+
+//-------------------------------------------------------------------
+// Compiler - flattens the declarations into a StructPlan
+//-------------------------------------------------------------------
+class TemplateCompiler {
+public:
+    explicit TemplateCompiler(const std::vector<StructDecl>& structs) : structs(structs) {
+        for (size_t i = 0; i < structs.size(); ++i) {
+            if (!structIndex.emplace(structs[i].name, static_cast<int>(i)).second) {
+                throw templateError(structs[i].line, "struct '" + structs[i].name + "' is declared twice");
+            }
+        }
+    }
+
+    StructPlan compile() {
+        if (structs.empty()) {
+            throw std::runtime_error("Struct template contains no structs.");
+        }
+
+        int root = static_cast<int>(structs.size()) - 1;
+        plan.rootName = structs[root].name;
+        long long size = emitStruct(root);
+        plan.fixedSize = (size >= 0 && size <= INT_MAX) ? static_cast<int>(size) : -1;
+        return std::move(plan);
+    }
+
+private:
+    // Emits ops for one struct and returns its size, or -1 if it depends on data
+    long long emitStruct(int index) {
+        const StructDecl& decl = structs[index];
+
+        if (std::find(activeStructs.begin(), activeStructs.end(), index) != activeStructs.end()) {
+            throw templateError(decl.line, "struct '" + decl.name + "' contains itself");
+        }
+        activeStructs.push_back(index);
+        scopes.emplace_back();
+
+        long long size = 0;
+        for (const auto& field : decl.fields) {
+            PlanOp op;
+            op.name = field.name;
+            op.indexed = field.isArray;
+            if (field.count < 0 || field.count > INT_MAX) {
+                throw templateError(field.line, "array length out of range");
+            }
+            op.count = static_cast<int>(field.count);
+            if (!field.countField.empty()) {
+                op.countSlot = slotForField(field.countField, field.line);
+            }
+
+            long long fieldSize;
+            if (const PrimitiveType* type = findPrimitive(field.typeName)) {
+                op.kind = PlanOp::Field;
+                op.elementSize = type->size;
+                op.isSigned = type->isSigned;
+                op.displayFormat = field.isArray ? type->arrayFormat : type->scalarFormat;
+                op.colorIndex = fieldCounter++ % static_cast<int>(std::size(annotationColors));
+
+                // Only integer scalars can be used as lengths later on
+                if (!field.isArray && type->isInteger) {
+                    scopes.back()[field.name] = static_cast<int>(plan.ops.size());
+                }
+                plan.ops.push_back(op);
+
+                fieldSize = type->size;
+            }
+            else {
+                auto it = structIndex.find(field.typeName);
+                if (it == structIndex.end()) {
+                    throw templateError(field.line, "unknown type '" + field.typeName + "'");
+                }
+
+                op.kind = PlanOp::BeginGroup;
+                int begin = static_cast<int>(plan.ops.size());
+                plan.ops.push_back(op);
+
+                fieldSize = emitStruct(it->second);
+
+                PlanOp end;
+                end.kind = PlanOp::EndGroup;
+                end.jump = begin;
+                plan.ops[begin].jump = static_cast<int>(plan.ops.size());
+                plan.ops.push_back(end);
+            }
+
+            if (size < 0 || fieldSize < 0 || op.countSlot >= 0) {
+                size = -1;
+            }
+            else {
+                size += fieldSize * op.count;
+                if (size > INT_MAX) {
+                    size = -1;
+                }
+            }
+        }
+
+        scopes.pop_back();
+        activeStructs.pop_back();
+        return size;
+    }
+
+    // Length references resolve to the nearest earlier scalar of that name,
+    // searching the current struct first and then the structs enclosing it.
+    int slotForField(const std::string& name, int line) {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) {
+                PlanOp& source = plan.ops[it->second];
+                if (source.valueSlot < 0) {
+                    source.valueSlot = plan.slotCount++;
+                }
+                return source.valueSlot;
+            }
+        }
+        throw templateError(line, "length field '" + name + "' is not an earlier integer field");
+    }
+
+    const std::vector<StructDecl>& structs;
+    std::map<std::string, int> structIndex;
+    std::vector<std::map<std::string, int>> scopes;
+    std::vector<int> activeStructs;
+    int fieldCounter = 0;
+    StructPlan plan;
+};
+
+StructPlan CompileStructTemplate(const std::string& text) {
+    TemplateParser parser(tokenize(text));
+    std::vector<StructDecl> structs = parser.parse();
+    return TemplateCompiler(structs).compile();
+}
+
+//-------------------------------------------------------------------
+// Plan execution
+//-------------------------------------------------------------------
+static long long readInteger(const BYTE* p, int size, bool isSigned) {
+    unsigned long long value = 0;
+    for (int i = 0; i < size; ++i) {
+        value |= static_cast<unsigned long long>(p[i]) << (i * 8);
+    }
+    if (isSigned && size < 8 && (value >> (size * 8 - 1)) & 1) {
+        value |= ~0ull << (size * 8);
+    }
+    return static_cast<long long>(value);
+}
+
+static void appendIndex(std::string& label, long long index) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), index);
+    label += '[';
+    label.append(digits, result.ptr);
+    label += ']';
+}
+
+static void appendGroupLabel(std::string& label, const PlanOp& op, long long index) {
+    label += op.name;
+    if (op.indexed) {
+        appendIndex(label, index);
+    }
+    label += '.';
+}
+
+// Walks the plan once from offset. Returns the offset just past the record, or
+// -1 if the record does not fit in the data. When out is null only the extent
+// is computed and no labels are built.
+static long long runPlan(const StructPlan& plan, const std::vector<BYTE>& data, size_t offset,
+    std::string& label, std::vector<long long>& slots, std::vector<Annotation>* out) {
+
+    struct GroupFrame {
+        size_t beginPc;
+        long long count;
+        long long index;
+        size_t labelLength;
+    };
+
+    GroupFrame frames[64];
+    int depth = 0;
+    const size_t size = data.size();
+    size_t pc = 0;
+
+    while (pc < plan.ops.size()) {
+        const PlanOp& op = plan.ops[pc];
+
+        switch (op.kind) {
+        case PlanOp::Field:
+        {
+            long long count = op.countSlot >= 0 ? slots[op.countSlot] : op.count;
+            if (count < 0 || static_cast<unsigned long long>(count) > (size - offset) / op.elementSize) {
+                return -1;
+            }
+
+            size_t bytes = static_cast<size_t>(count) * op.elementSize;
+            if (op.valueSlot >= 0) {
+                slots[op.valueSlot] = readInteger(&data[offset], op.elementSize, op.isSigned);
+            }
+            if (out && bytes > 0) {
+                Annotation anno;
+                anno.startOffset = static_cast<int>(offset);
+                anno.endOffset = static_cast<int>(offset + bytes - 1);
+                anno.label = label + op.name;
+                anno.displayFormat = op.displayFormat;
+                anno.colorIndex = op.colorIndex;
+                out->push_back(std::move(anno));
+            }
+            offset += bytes;
+            ++pc;
+            break;
+        }
+
+        case PlanOp::BeginGroup:
+        {
+            long long count = op.countSlot >= 0 ? slots[op.countSlot] : op.count;
+
+            // Every element needs at least a byte, which bounds bogus lengths
+            if (count < 0 || static_cast<unsigned long long>(count) > size - offset || depth == static_cast<int>(std::size(frames))) {
+                return -1;
+            }
+            if (count == 0) {
+                pc = op.jump + 1;
+                break;
+            }
+
+            frames[depth++] = { pc, count, 0, label.size() };
+            if (out) {
+                appendGroupLabel(label, op, 0);
+            }
+            ++pc;
+            break;
+        }
+
+        case PlanOp::EndGroup:
+        {
+            GroupFrame& frame = frames[depth - 1];
+            if (out) {
+                label.resize(frame.labelLength);
+            }
+
+            if (++frame.index < frame.count) {
+                if (out) {
+                    appendGroupLabel(label, plan.ops[frame.beginPc], frame.index);
+                }
+                pc = frame.beginPc + 1;
+            }
+            else {
+                --depth;
+                ++pc;
+            }
+            break;
+        }
+        }
+    }
+
+    return static_cast<long long>(offset);
+}
+
+//-------------------------------------------------------------------
+// ApplyStructTemplate - Annotate a single record
+//-------------------------------------------------------------------
+std::vector<Annotation> ApplyStructTemplate(const StructPlan& plan, const std::vector<BYTE>& data, int offset) {
+    std::vector<Annotation> annotations;
+    if (offset < 0 || offset >= static_cast<int>(data.size())) {
+        return annotations;
+    }
+
+    // Prefixed like the repeated and record-array forms, so applying the
+    // template twice does not produce colliding labels
+    std::string label = plan.rootName + '.';
+    std::vector<long long> slots(plan.slotCount);
+    runPlan(plan, data, offset, label, slots, &annotations);
+    return annotations;
+}
+
+//-------------------------------------------------------------------
+// ApplyStructTemplateRepeated - Annotate back-to-back records
+//-------------------------------------------------------------------
+std::vector<Annotation> ApplyStructTemplateRepeated(const StructPlan& plan, const std::vector<BYTE>& data, int offset) {
+    std::vector<Annotation> annotations;
+    if (offset < 0 || offset >= static_cast<int>(data.size()) || plan.fixedSize == 0) {
+        return annotations;
+    }
+
+    // Record starts are implied for fixed-size plans. Otherwise walk the
+    // records once without labels to find where each one begins.
+    size_t recordCount = 0;
+    std::vector<size_t> starts;
+
+    if (plan.fixedSize > 0) {
+        recordCount = (data.size() - offset) / plan.fixedSize;
+    }
+    else {
+        std::string label;
+        std::vector<long long> slots(plan.slotCount);
+        size_t position = offset;
+
+        while (position < data.size()) {
+            long long end = runPlan(plan, data, position, label, slots, nullptr);
+            if (end < 0 || static_cast<size_t>(end) == position) {
+                break;
+            }
+            starts.push_back(position);
+            position = static_cast<size_t>(end);
+        }
+        recordCount = starts.size();
+    }
+
+    // Each task annotates its own slice of records into its own vector
+    size_t taskCount = (recordCount + RECORDS_PER_TASK - 1) / RECORDS_PER_TASK;
+    std::vector<std::vector<Annotation>> parts(taskCount);
+
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        std::string label;
+        std::vector<long long> slots(plan.slotCount);
+
+        size_t first = task * RECORDS_PER_TASK;
+        size_t last = std::min(first + RECORDS_PER_TASK, recordCount);
+
+        for (size_t record = first; record < last; ++record) {
+            size_t start = plan.fixedSize > 0 ? offset + record * plan.fixedSize : starts[record];
+
+            label = plan.rootName;
+            appendIndex(label, static_cast<long long>(record));
+            label += '.';
+
+            runPlan(plan, data, start, label, slots, &parts[task]);
+        }
+    });
+
+    size_t total = 0;
+    for (const auto& part : parts) {
+        total += part.size();
+    }
+
+    annotations.reserve(total);
+    for (auto& part : parts) {
+        std::move(part.begin(), part.end(), std::back_inserter(annotations));
+    }
+    return annotations;
+}
+
+//-------------------------------------------------------------------
+// BuildRecordArray - Fixed-size records as one record-array annotation
+//-------------------------------------------------------------------
+bool BuildRecordArray(const StructPlan& plan, const std::vector<BYTE>& data, int offset, Annotation& array) {
+    if (plan.fixedSize <= 0 || offset < 0 || offset >= static_cast<int>(data.size())) {
+        return false;
+    }
+
+    long long count = (static_cast<long long>(data.size()) - offset) / plan.fixedSize;
+    if (count == 0 || count > INT_MAX) {
+        return false;
+    }
+
+    // Field positions do not depend on the data in a fixed-size plan, so one
+    // pass over a blank record yields the element layout. Field names stay
+    // unprefixed; element labels add the array's own name.
+    std::vector<BYTE> blank(plan.fixedSize);
+    std::vector<Annotation> fields;
+    std::string label;
+    std::vector<long long> slots(plan.slotCount);
+    runPlan(plan, blank, 0, label, slots, &fields);
+
+    auto layout = std::make_shared<RecordLayout>();
+    layout->stride = plan.fixedSize;
+    layout->count = static_cast<int>(count);
+    layout->fields.reserve(fields.size());
+    for (auto& field : fields) {
+        layout->fields.push_back(RecordField{
+            field.label.str(),
+            field.startOffset,
+            field.endOffset - field.startOffset + 1,
+            field.displayFormat.str(),
+            field.colorIndex
+        });
+    }
+
+    array.startOffset = offset;
+    array.endOffset = static_cast<int>(offset + count * plan.fixedSize - 1);
+    array.label = plan.rootName;
+    array.displayFormat = RECORD_ARRAY_FORMAT;
+    array.colorIndex = 0;
+    array.layout = std::move(layout);
+    return true;
+}
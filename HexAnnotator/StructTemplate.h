@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "includes.h"
+
+// One step of a compiled structure template. Nested structs and struct arrays
+// are flattened into BeginGroup/EndGroup pairs, so applying a template is a
+// single loop over this array with no recursion or name lookups.
+struct PlanOp {
+    enum Kind {
+        Field,      // Primitive or primitive array; becomes one annotation
+        BeginGroup, // Start of a nested struct or struct array
+        EndGroup    // Jumps back to the matching BeginGroup while elements remain
+    };
+
+    Kind kind = Field;
+    std::string name;           // Label segment
+    std::string displayFormat;  // Field only
+    int elementSize = 0;        // Field only: bytes per element
+    bool isSigned = false;      // Field only
+    int count = 1;              // Constant element count (when countSlot < 0)
+    int countSlot = -1;         // Slot holding a previously decoded length field
+    int valueSlot = -1;         // Field only: slot that receives the decoded value
+    bool indexed = false;       // Label elements as name[i] rather than name
+    int jump = -1;              // Index of the matching BeginGroup/EndGroup
+    int colorIndex = 0;
+};
+
+// A structure template compiled down to a flat parse plan
+struct StructPlan {
+    std::string rootName;
+    std::vector<PlanOp> ops;
+    int slotCount = 0;
+    int fixedSize = -1;         // Record size, or -1 if any length comes from data
+};
+
+// Parse C-like struct declarations. The last struct in the text is the root.
+// Throws std::runtime_error with a line number on malformed input.
+StructPlan CompileStructTemplate(const std::string& text);
+
+// Annotate one instance of the root struct at offset, labelled Root.field.
+// Fields that run past the end of the data are dropped.
+std::vector<Annotation> ApplyStructTemplate(const StructPlan& plan, const std::vector<BYTE>& data, int offset);
+
+// Annotate consecutive instances of the root struct from offset until the data
+// runs out. Records are annotated in parallel on the shared worker pool.
+std::vector<Annotation> ApplyStructTemplateRepeated(const StructPlan& plan, const std::vector<BYTE>& data, int offset);
+
+// Describe the same records as a single record-array annotation. Only valid for
+// fixed-size plans; returns false if not even one record fits at offset.
+bool BuildRecordArray(const StructPlan& plan, const std::vector<BYTE>& data, int offset, Annotation& array);
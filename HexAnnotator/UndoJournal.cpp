@@ -0,0 +1,228 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include "includes.h"
+#include "AutosaveJournal.h"
+#include "ComputedAnnotations.h"
+#include "LabelIndex.h"
+
+// Edits of the same annotation closer together than this collapse into one undo step
+const std::chrono::milliseconds UNDO_COALESCE_WINDOW(750);
+
+// Limits for the undo history of a single document. The newest step is always
+// kept, so a bulk replace larger than the budget can still be undone.
+const size_t UNDO_MEMORY_BUDGET = 256 * 1024 * 1024;
+const size_t UNDO_MAX_STEPS = 1000;
+
+//-------------------------------------------------------------------
+// Memory accounting
+//-------------------------------------------------------------------
+static size_t annotationCost(const Annotation& anno) {
+    return sizeof(Annotation) + anno.label.size() + anno.displayFormat.size();
+}
+
+// Bulk collections are costed by capacity only; walking millions of labels on
+// every undo would cost more than the swap itself.
+static size_t deltaCost(const AnnotationDelta& delta) {
+    return sizeof(AnnotationDelta) + annotationCost(delta.annotation) +
+        delta.collection.capacity() * sizeof(Annotation);
+}
+
+static void clearStack(UndoJournal& journal, std::deque<AnnotationDelta>& stack) {
+    for (const auto& delta : stack) {
+        journal.memoryUsed -= delta.cost;
+    }
+    stack.clear();
+}
+
+static void trimHistory(UndoJournal& journal) {
+    while (journal.undoStack.size() > 1 &&
+        (journal.memoryUsed > UNDO_MEMORY_BUDGET || journal.undoStack.size() > UNDO_MAX_STEPS)) {
+        journal.memoryUsed -= journal.undoStack.front().cost;
+        journal.undoStack.pop_front();
+    }
+}
+
+//-------------------------------------------------------------------
+// applyDelta - Swap the delta's payload with the document
+// and tell the computed-annotation graph, autosave and label index what
+// changed
+//-------------------------------------------------------------------
+static void applyDelta(DocumentWindowState& state, AnnotationDelta& delta) {
+    auto& annotations = state.annotations;
+
+    switch (delta.kind) {
+    case AnnotationDelta::Insert:
+        annotations.insert(annotations.begin() + delta.index, std::move(delta.annotation));
+        delta.annotation = Annotation{};
+        delta.kind = AnnotationDelta::Erase;
+
+        if (delta.index + 1 == static_cast<int>(annotations.size()))
+            NoteAnnotationsAppended(state, delta.index);
+        else
+            NoteAnnotationInserted(state, delta.index);
+        JournalAnnotationChange(state, AnnotationDelta::Insert, delta.index);
+        IndexAnnotationChange(state, AnnotationDelta::Insert, delta.index);
+        break;
+
+    case AnnotationDelta::Erase:
+        delta.annotation = std::move(annotations[delta.index]);
+        annotations.erase(annotations.begin() + delta.index);
+        delta.kind = AnnotationDelta::Insert;
+        NoteAnnotationErased(state, delta.index, delta.annotation);
+        JournalAnnotationChange(state, AnnotationDelta::Erase, delta.index);
+        IndexAnnotationChange(state, AnnotationDelta::Erase, delta.index);
+        break;
+
+    case AnnotationDelta::Update:
+        std::swap(annotations[delta.index], delta.annotation);
+        NoteAnnotationUpdated(state, delta.index, delta.annotation);
+        JournalAnnotationChange(state, AnnotationDelta::Update, delta.index);
+        IndexAnnotationChange(state, AnnotationDelta::Update, delta.index);
+        break;
+
+    case AnnotationDelta::ReplaceAll:
+        annotations.swap(delta.collection);
+        NoteAnnotationsReordered(state);
+        JournalAnnotationChange(state, AnnotationDelta::ReplaceAll, 0);
+        IndexAnnotationChange(state, AnnotationDelta::ReplaceAll, 0);
+        break;
+
+    case AnnotationDelta::Append:
+        delta.index = static_cast<int>(annotations.size());
+        annotations.insert(annotations.end(),
+            std::make_move_iterator(delta.collection.begin()),
+            std::make_move_iterator(delta.collection.end()));
+        std::vector<Annotation>().swap(delta.collection);
+        delta.kind = AnnotationDelta::RemoveTail;
+        NoteAnnotationsAppended(state, delta.index);
+        JournalAnnotationChange(state, AnnotationDelta::Append, delta.index);
+        IndexAnnotationChange(state, AnnotationDelta::Append, delta.index);
+        break;
+
+    case AnnotationDelta::RemoveTail:
+        delta.collection.assign(
+            std::make_move_iterator(annotations.begin() + delta.index),
+            std::make_move_iterator(annotations.end()));
+        annotations.erase(annotations.begin() + delta.index, annotations.end());
+        delta.kind = AnnotationDelta::Append;
+        NoteAnnotationsReordered(state);
+        JournalAnnotationChange(state, AnnotationDelta::RemoveTail, delta.index);
+        IndexAnnotationChange(state, AnnotationDelta::RemoveTail, delta.index);
+        break;
+    }
+}
+
+//-------------------------------------------------------------------
+// recordDelta - Apply a new change and push it onto the undo stack
+//-------------------------------------------------------------------
+static void recordDelta(DocumentWindowState& state, AnnotationDelta delta) {
+    UndoJournal& journal = state.history;
+    delta.when = std::chrono::steady_clock::now();
+
+    // A new change invalidates everything that was undone before it
+    clearStack(journal, journal.redoStack);
+
+    // Repeated edits of the same annotation: the step on top of the stack
+    // already holds the version from before the first edit, so only the
+    // document needs to change.
+    if (delta.kind == AnnotationDelta::Update && !journal.undoStack.empty()) {
+        AnnotationDelta& top = journal.undoStack.back();
+        if (top.kind == AnnotationDelta::Update && top.index == delta.index &&
+            delta.when - top.when < UNDO_COALESCE_WINDOW) {
+            std::swap(state.annotations[delta.index], delta.annotation);
+            NoteAnnotationUpdated(state, delta.index, delta.annotation);
+            JournalAnnotationChange(state, AnnotationDelta::Update, delta.index);
+            IndexAnnotationChange(state, AnnotationDelta::Update, delta.index);
+            top.when = delta.when;
+            return;
+        }
+    }
+
+    applyDelta(state, delta);
+
+    delta.cost = deltaCost(delta);
+    journal.memoryUsed += delta.cost;
+    journal.undoStack.push_back(std::move(delta));
+    trimHistory(journal);
+}
+
+//-------------------------------------------------------------------
+// Recorded annotation edits
+//-------------------------------------------------------------------
+void InsertAnnotation(DocumentWindowState& state, int index, Annotation annotation) {
+    AnnotationDelta delta;
+    delta.kind = AnnotationDelta::Insert;
+    delta.index = index;
+    delta.annotation = std::move(annotation);
+    recordDelta(state, std::move(delta));
+}
+
+void UpdateAnnotation(DocumentWindowState& state, int index, Annotation annotation) {
+    AnnotationDelta delta;
+    delta.kind = AnnotationDelta::Update;
+    delta.index = index;
+    delta.annotation = std::move(annotation);
+    recordDelta(state, std::move(delta));
+}
+
+void EraseAnnotation(DocumentWindowState& state, int index) {
+    AnnotationDelta delta;
+    delta.kind = AnnotationDelta::Erase;
+    delta.index = index;
+    recordDelta(state, std::move(delta));
+}
+
+// The previous collection is moved into the journal, not copied, so undoing a
+// bulk load is a single vector swap regardless of its size.
+void ReplaceAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations) {
+    AnnotationDelta delta;
+    delta.kind = AnnotationDelta::ReplaceAll;
+    delta.collection = std::move(annotations);
+    recordDelta(state, std::move(delta));
+}
+
+// Bulk additions only move the new annotations, so existing ones are neither
+// copied when recording nor when undoing.
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations) {
+    AnnotationDelta delta;
+    delta.kind = AnnotationDelta::Append;
+    delta.collection = std::move(annotations);
+    recordDelta(state, std::move(delta));
+}
+
+//-------------------------------------------------------------------
+// Undo / Redo
+//-------------------------------------------------------------------
+static bool stepHistory(DocumentWindowState& state, std::deque<AnnotationDelta>& from, std::deque<AnnotationDelta>& to) {
+    if (from.empty()) {
+        return false;
+    }
+
+    AnnotationDelta delta = std::move(from.back());
+    from.pop_back();
+
+    applyDelta(state, delta);
+
+    // The payload changed sides, so the footprint may have changed too
+    state.history.memoryUsed -= delta.cost;
+    delta.cost = deltaCost(delta);
+    state.history.memoryUsed += delta.cost;
+
+    // A redone step must not merge with the next edit
+    delta.when = std::chrono::steady_clock::time_point();
+    to.push_back(std::move(delta));
+    return true;
+}
+
+bool UndoAnnotationEdit(DocumentWindowState& state) {
+    return stepHistory(state, state.history.undoStack, state.history.redoStack);
+}
+
+bool RedoAnnotationEdit(DocumentWindowState& state) {
+    bool changed = stepHistory(state, state.history.redoStack, state.history.undoStack);
+    trimHistory(state.history);
+    return changed;
+}
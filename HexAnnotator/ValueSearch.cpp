@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "ValueSearch.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VALUE_SEARCH_SSE2
+#endif
+
+static const SearchHit NO_HIT = { SEARCH_NO_MATCH, 0 };
+
+static const char* const SYNTAX_HINT =
+    "Write a type and a value or range, such as \"i32 1000..2000\" or \"f32 3.14159 +- 0.00001\".";
+
+const int64_t SECONDS_PER_DAY = 86400;
+
+//-------------------------------------------------------------------
+// Parsing
+//-------------------------------------------------------------------
+enum ValueKind { VK_SIGNED, VK_UNSIGNED, VK_FLOAT, VK_TIME };
+
+struct ValueTypeName {
+    const char* name;
+    DataType type;
+    size_t width;
+    ValueKind kind;
+};
+
+static const ValueTypeName VALUE_TYPES[] = {
+    { "i8", DT_BYTE, 1, VK_SIGNED },
+    { "u8", DT_UBYTE, 1, VK_UNSIGNED },
+    { "i16", DT_SHORT, 2, VK_SIGNED },
+    { "u16", DT_USHORT, 2, VK_UNSIGNED },
+    { "i32", DT_INT, 4, VK_SIGNED },
+    { "u32", DT_UINT, 4, VK_UNSIGNED },
+    { "i64", DT_INT64, 8, VK_SIGNED },
+    { "u64", DT_UINT64, 8, VK_UNSIGNED },
+    { "f32", DT_FLOAT, 4, VK_FLOAT },
+    { "f64", DT_DOUBLE, 8, VK_FLOAT },
+    { "time32", DT_TIME_T, 4, VK_TIME },
+    { "time64", DT_TIME64_T, 8, VK_TIME },
+};
+
+static int64_t signedMax(size_t width) {
+    return width == 8 ? INT64_MAX : (int64_t(1) << (8 * width - 1)) - 1;
+}
+
+static int64_t signedMin(size_t width) {
+    return -signedMax(width) - 1;
+}
+
+static uint64_t unsignedMax(size_t width) {
+    return width == 8 ? UINT64_MAX : (uint64_t(1) << (8 * width)) - 1;
+}
+
+// A decimal or 0x-prefixed hex integer with an optional sign
+static bool parseInteger(const std::string& text, bool& negative, uint64_t& magnitude) {
+    size_t i = 0;
+    negative = false;
+    if (i < text.size() && (text[i] == '-' || text[i] == '+')) {
+        negative = text[i++] == '-';
+    }
+    int base = 10;
+    if (text.size() > i + 2 && text[i] == '0' && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+        base = 16;
+        i += 2;
+    }
+    const char* first = text.data() + i;
+    const char* last = text.data() + text.size();
+    auto [end, error] = std::from_chars(first, last, magnitude, base);
+    return first != last && end == last && error == std::errc();
+}
+
+static int64_t parseSigned(const std::string& text, size_t width, const char* typeName) {
+    bool negative;
+    uint64_t magnitude;
+    if (!parseInteger(text, negative, magnitude)) {
+        throw std::runtime_error("'" + text + "' is not a whole number.");
+    }
+    const uint64_t limit = negative ? uint64_t(signedMax(width)) + 1 : uint64_t(signedMax(width));
+    if (magnitude > limit) {
+        throw std::runtime_error("'" + text + "' does not fit in " + typeName + ".");
+    }
+    return negative ? int64_t(0 - magnitude) : int64_t(magnitude);
+}
+
+static uint64_t parseUnsigned(const std::string& text, size_t width, const char* typeName) {
+    bool negative;
+    uint64_t magnitude;
+    if (!parseInteger(text, negative, magnitude)) {
+        throw std::runtime_error("'" + text + "' is not a whole number.");
+    }
+    if ((negative && magnitude != 0) || magnitude > unsignedMax(width)) {
+        throw std::runtime_error("'" + text + "' does not fit in " + typeName + ".");
+    }
+    return magnitude;
+}
+
+static double parseFloat(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0') {
+        throw std::runtime_error("'" + text + "' is not a number.");
+    }
+    return value;
+}
+
+// Days from 1970-01-01 to a date in the proleptic Gregorian calendar; the
+// inverse of civilFromDays in DataInterpreter.cpp
+static int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2 ? 1 : 0;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+// Reads exactly count digits at text[i]
+static bool readDigits(const std::string& text, size_t& i, size_t count, unsigned& value) {
+    value = 0;
+    for (size_t end = i + count; i < end; ++i) {
+        if (i >= text.size() || !isdigit(static_cast<unsigned char>(text[i]))) {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Seconds since 1970 UTC of "YYYY-MM-DD" or "YYYY-MM-DDThh:mm[:ss]". A date
+// alone as an upper bound means the last second of the day.
+static int64_t parseDateTime(const std::string& text, bool upper) {
+    const std::runtime_error invalid("'" + text + "' is not a date; write YYYY-MM-DD or YYYY-MM-DDThh:mm:ss.");
+
+    size_t i = 0;
+    unsigned year, month, day, hour = 0, minute = 0, second = 0;
+    if (!readDigits(text, i, 4, year) || i >= text.size() || text[i++] != '-' ||
+        !readDigits(text, i, 2, month) || i >= text.size() || text[i++] != '-' ||
+        !readDigits(text, i, 2, day)) {
+        throw invalid;
+    }
+
+    bool hasTime = i < text.size();
+    if (hasTime) {
+        if ((text[i] != 'T' && text[i] != 't') || !readDigits(text, ++i, 2, hour) ||
+            i >= text.size() || text[i++] != ':' || !readDigits(text, i, 2, minute)) {
+            throw invalid;
+        }
+        if (i < text.size() && (text[i++] != ':' || !readDigits(text, i, 2, second) || i != text.size())) {
+            throw invalid;
+        }
+    }
+
+    static const unsigned DAYS_IN_MONTH[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    if (month < 1 || month > 12 || day < 1 || day > DAYS_IN_MONTH[month - 1] ||
+        (month == 2 && day == 29 && (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0))) ||
+        hour > 23 || minute > 59 || second > 59) {
+        throw invalid;
+    }
+
+    int64_t seconds = daysFromCivil(year, month, day) * SECONDS_PER_DAY + hour * 3600 + minute * 60 + second;
+    return hasTime || !upper ? seconds : seconds + SECONDS_PER_DAY - 1;
+}
+
+// A time is a date, or seconds since 1970
+static int64_t parseTime(const std::string& text, size_t width, const char* typeName, bool upper) {
+    bool isDate = text.find('-', 1) != std::string::npos;
+    int64_t seconds = isDate ? parseDateTime(text, upper) : parseSigned(text, width, typeName);
+    if (seconds < signedMin(width) || seconds > signedMax(width)) {
+        throw std::runtime_error("'" + text + "' does not fit in " + typeName + ".");
+    }
+    return seconds;
+}
+
+ValuePattern::ValuePattern(const std::string& text) {
+    std::vector<std::string> tokens;
+    for (size_t i = 0; i < text.size();) {
+        if (isspace(static_cast<unsigned char>(text[i]))) {
+            ++i;
+            continue;
+        }
+        size_t end = i;
+        while (end < text.size() && !isspace(static_cast<unsigned char>(text[end]))) {
+            ++end;
+        }
+        tokens.push_back(text.substr(i, end - i));
+        i = end;
+    }
+    if (tokens.empty()) {
+        throw std::runtime_error(SYNTAX_HINT);
+    }
+
+    std::string typeName = tokens[0];
+    std::transform(typeName.begin(), typeName.end(), typeName.begin(),
+                   [](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+    const ValueTypeName* named = nullptr;
+    for (const ValueTypeName& candidate : VALUE_TYPES) {
+        if (typeName == candidate.name) {
+            named = &candidate;
+        }
+    }
+    if (!named) {
+        throw std::runtime_error("'" + tokens[0] + "' is not a type. " + SYNTAX_HINT);
+    }
+    valueType = named->type;
+    valueWidth = named->width;
+
+    // Options, then the range with any spaces removed
+    std::string range;
+    for (size_t i = 1; i < tokens.size(); ++i) {
+        if (tokens[i] == "le") {
+            order = BO_LITTLE_ENDIAN;
+        }
+        else if (tokens[i] == "be") {
+            order = valueWidth > 1 ? BO_BIG_ENDIAN : BO_LITTLE_ENDIAN;
+        }
+        else if (tokens[i] == "aligned") {
+            aligned = true;
+        }
+        else {
+            range += tokens[i];
+        }
+    }
+    if (range.empty()) {
+        throw std::runtime_error(SYNTAX_HINT);
+    }
+
+    std::string lowText = range, highText = range, tolerance;
+    size_t split = range.find("..");
+    if (split != std::string::npos) {
+        lowText = range.substr(0, split);
+        highText = range.substr(split + 2);
+    }
+    else if ((split = range.find("+-")) != std::string::npos) {
+        lowText = highText = range.substr(0, split);
+        tolerance = range.substr(split + 2);
+    }
+
+    bool empty = false;
+    switch (named->kind) {
+    case VK_SIGNED:
+    case VK_TIME: {
+        auto parse = [&](const std::string& part, bool upper) {
+            return named->kind == VK_TIME ? parseTime(part, valueWidth, named->name, upper)
+                                          : parseSigned(part, valueWidth, named->name);
+        };
+        signedLow = parse(lowText, false);
+        signedHigh = parse(highText, true);
+        if (!tolerance.empty()) {
+            uint64_t spread = parseUnsigned(tolerance, 8, "a tolerance");
+            const int64_t center = signedLow;
+            signedLow = spread > uint64_t(center - signedMin(valueWidth)) ? signedMin(valueWidth) : int64_t(center - spread);
+            signedHigh = spread > uint64_t(signedMax(valueWidth) - center) ? signedMax(valueWidth) : int64_t(center + spread);
+        }
+        empty = signedLow > signedHigh;
+        break;
+    }
+    case VK_UNSIGNED:
+        unsignedLow = parseUnsigned(lowText, valueWidth, named->name);
+        unsignedHigh = parseUnsigned(highText, valueWidth, named->name);
+        if (!tolerance.empty()) {
+            uint64_t spread = parseUnsigned(tolerance, 8, "a tolerance");
+            const uint64_t center = unsignedLow;
+            unsignedLow = spread > center ? 0 : center - spread;
+            unsignedHigh = spread > unsignedMax(valueWidth) - center ? unsignedMax(valueWidth) : center + spread;
+        }
+        empty = unsignedLow > unsignedHigh;
+        break;
+
+    case VK_FLOAT:
+        floatLow = parseFloat(lowText);
+        floatHigh = parseFloat(highText);
+        if (!tolerance.empty()) {
+            double spread = std::fabs(parseFloat(tolerance));
+            floatLow -= spread;
+            floatHigh += spread;
+        }
+        empty = !(floatLow <= floatHigh);
+        break;
+    }
+    if (empty) {
+        throw std::runtime_error("The range is empty; write the smaller value first.");
+    }
+}
+
+//-------------------------------------------------------------------
+// Decoding
+//-------------------------------------------------------------------
+template <size_t Width> struct BitsOf;
+template <> struct BitsOf<1> { typedef uint8_t type; };
+template <> struct BitsOf<2> { typedef uint16_t type; };
+template <> struct BitsOf<4> { typedef uint32_t type; };
+template <> struct BitsOf<8> { typedef uint64_t type; };
+
+template <typename Bits>
+static inline Bits swapBytes(Bits value) {
+    Bits swapped = 0;
+    for (size_t i = 0; i < sizeof(Bits); ++i) {
+        swapped = static_cast<Bits>((swapped << 8) | (value & 0xFF));
+        value = static_cast<Bits>(value >> 8);
+    }
+    return swapped;
+}
+
+template <typename T, ByteOrder Order>
+static inline T loadValue(const uint8_t* p) {
+    typename BitsOf<sizeof(T)>::type bits;
+    memcpy(&bits, p, sizeof(T));
+    if constexpr (Order == BO_BIG_ENDIAN) {
+        bits = swapBytes(bits);
+    }
+    return std::bit_cast<T>(bits);
+}
+
+// The narrowest float range inside [low, high]
+static float floatBound(double value, bool upper) {
+    if (value > FLT_MAX) {
+        return upper && value != INFINITY ? FLT_MAX : INFINITY;
+    }
+    if (value < -FLT_MAX) {
+        return !upper && value != -INFINITY ? -FLT_MAX : -INFINITY;
+    }
+    float bound = static_cast<float>(value);
+    if (upper && bound > value) {
+        bound = std::nextafter(bound, -INFINITY);
+    }
+    else if (!upper && bound < value) {
+        bound = std::nextafter(bound, INFINITY);
+    }
+    return bound;
+}
+
+template <typename T>
+void ValuePattern::bounds(T& low, T& high) const {
+    if constexpr (std::is_same_v<T, float>) {
+        low = floatBound(floatLow, false);
+        high = floatBound(floatHigh, true);
+    }
+    else if constexpr (std::is_same_v<T, double>) {
+        low = floatLow;
+        high = floatHigh;
+    }
+    else if constexpr (std::is_signed_v<T>) {
+        low = static_cast<T>(signedLow);
+        high = static_cast<T>(signedHigh);
+    }
+    else {
+        low = static_cast<T>(unsignedLow);
+        high = static_cast<T>(unsignedHigh);
+    }
+}
+
+#ifdef VALUE_SEARCH_SSE2
+//-------------------------------------------------------------------
+// SSE2 kernels
+//-------------------------------------------------------------------
+// Reverses the bytes of each Width-byte lane: bytes within 16-bit lanes,
+// then 16-bit halves within 32-bit lanes, then 32-bit halves
+template <size_t Width>
+static inline __m128i swapLanes(__m128i v) {
+    if constexpr (Width == 1) {
+        return v;
+    }
+    else {
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        if constexpr (Width >= 4) {
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        if constexpr (Width == 8) {
+            v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        return v;
+    }
+}
+
+// Tests every lane of a vector against [low, high]. inRange sets bit i if
+// byte i belongs to a lane in range, as _mm_movemask_epi8 does.
+template <typename T>
+class LaneRange {
+public:
+    // Unsigned lanes are offset by the sign bit so signed compares order them
+    LaneRange(T low, T high)
+        : bias(splat(std::is_signed_v<T> ? 0 : uint32_t(1) << (8 * sizeof(T) - 1))),
+          low(_mm_xor_si128(splat(static_cast<uint32_t>(low)), bias)),
+          high(_mm_xor_si128(splat(static_cast<uint32_t>(high)), bias)) {}
+
+    unsigned inRange(__m128i v) const {
+        v = _mm_xor_si128(v, bias);
+        __m128i outside = _mm_or_si128(greater(low, v), greater(v, high));
+        return ~static_cast<unsigned>(_mm_movemask_epi8(outside)) & 0xFFFF;
+    }
+
+private:
+    static __m128i splat(uint32_t bits) {
+        if constexpr (sizeof(T) == 1) return _mm_set1_epi8(static_cast<char>(bits));
+        else if constexpr (sizeof(T) == 2) return _mm_set1_epi16(static_cast<short>(bits));
+        else return _mm_set1_epi32(static_cast<int>(bits));
+    }
+
+    static __m128i greater(__m128i a, __m128i b) {
+        if constexpr (sizeof(T) == 1) return _mm_cmpgt_epi8(a, b);
+        else if constexpr (sizeof(T) == 2) return _mm_cmpgt_epi16(a, b);
+        else return _mm_cmpgt_epi32(a, b);
+    }
+
+    __m128i bias;
+    __m128i low;
+    __m128i high;
+};
+
+// NaN lanes compare false, so they are never in range
+template <>
+class LaneRange<float> {
+public:
+    LaneRange(float low, float high) : low(_mm_set1_ps(low)), high(_mm_set1_ps(high)) {}
+
+    unsigned inRange(__m128i v) const {
+        __m128 f = _mm_castsi128_ps(v);
+        __m128 inside = _mm_and_ps(_mm_cmpge_ps(f, low), _mm_cmple_ps(f, high));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_castps_si128(inside)));
+    }
+
+private:
+    __m128 low;
+    __m128 high;
+};
+
+template <>
+class LaneRange<double> {
+public:
+    LaneRange(double low, double high) : low(_mm_set1_pd(low)), high(_mm_set1_pd(high)) {}
+
+    unsigned inRange(__m128i v) const {
+        __m128d f = _mm_castsi128_pd(v);
+        __m128d inside = _mm_and_pd(_mm_cmpge_pd(f, low), _mm_cmple_pd(f, high));
+        return static_cast<unsigned>(_mm_movemask_epi8(_mm_castpd_si128(inside)));
+    }
+
+private:
+    __m128d low;
+    __m128d high;
+};
+
+// Bits of a movemask that stand for the first byte of each lane
+template <size_t Width>
+constexpr unsigned laneStarts() {
+    unsigned bits = 0;
+    for (size_t i = 0; i < 16; i += Width) {
+        bits |= 1u << i;
+    }
+    return bits;
+}
+#endif
+
+//-------------------------------------------------------------------
+// ValuePattern
+//-------------------------------------------------------------------
+template <typename T, ByteOrder Order>
+void ValuePattern::scanOrdered(const uint8_t* data, size_t size, size_t begin, size_t limit,
+                               const std::function<bool(const SearchHit&)>& onMatch) const {
+    constexpr size_t WIDTH = sizeof(T);
+    T low, high;
+    bounds(low, high);
+
+    size_t i = begin;
+#ifdef VALUE_SEARCH_SSE2
+    {
+        // SSE2 cannot compare 64-bit integers, so their upper halves are
+        // compared as 32-bit lanes and each candidate is confirmed
+        constexpr bool HALVES = std::is_integral_v<T> && WIDTH == 8;
+        typedef std::conditional_t<HALVES, std::conditional_t<std::is_signed_v<T>, int32_t, uint32_t>, T> Lane;
+        const LaneRange<Lane> range = [&] {
+            if constexpr (HALVES) {
+                return LaneRange<Lane>(static_cast<Lane>(low >> 32), static_cast<Lane>(high >> 32));
+            }
+            else {
+                return LaneRange<Lane>(low, high);
+            }
+        }();
+
+        // Bit j of hits is set if the value at i + j is in range. The load at
+        // i + phase covers the offsets i + phase + k * WIDTH.
+        for (; i < limit && i + 15 + WIDTH <= size; i += 16) {
+            unsigned hits = 0;
+            for (size_t phase = 0; phase < WIDTH; ++phase) {
+                if (aligned && (i + phase) % WIDTH != 0) {
+                    continue;
+                }
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + phase));
+                if constexpr (Order == BO_BIG_ENDIAN) {
+                    v = swapLanes<WIDTH>(v);
+                }
+                unsigned inRange = range.inRange(v);
+                if constexpr (HALVES) {
+                    inRange >>= 4;
+                }
+                hits |= (inRange & laneStarts<WIDTH>()) << phase;
+            }
+            if (limit - i < 16) {
+                hits &= (1u << (limit - i)) - 1;
+            }
+
+            for (; hits != 0; hits &= hits - 1) {
+                const size_t offset = i + std::countr_zero(hits);
+                if constexpr (HALVES) {
+                    T value = loadValue<T, Order>(data + offset);
+                    if (value < low || value > high) {
+                        continue;
+                    }
+                }
+                if (!onMatch({ offset, WIDTH })) {
+                    return;
+                }
+            }
+        }
+    }
+#endif
+
+    limit = std::min(limit, size >= WIDTH ? size - WIDTH + 1 : 0);
+    for (; i < limit; ++i) {
+        if (aligned && i % WIDTH != 0) {
+            continue;
+        }
+        T value = loadValue<T, Order>(data + i);
+        if (value >= low && value <= high && !onMatch({ i, WIDTH })) {
+            return;
+        }
+    }
+}
+
+template <typename T>
+void ValuePattern::scan(const uint8_t* data, size_t size, size_t begin, size_t limit,
+                        const std::function<bool(const SearchHit&)>& onMatch) const {
+    if (order == BO_BIG_ENDIAN) {
+        scanOrdered<T, BO_BIG_ENDIAN>(data, size, begin, limit, onMatch);
+    }
+    else {
+        scanOrdered<T, BO_LITTLE_ENDIAN>(data, size, begin, limit, onMatch);
+    }
+}
+
+void ValuePattern::findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                           const std::function<bool(const SearchHit&)>& onMatch) const {
+    const size_t limit = std::min(end, size);
+    switch (valueType) {
+    case DT_BYTE:       scan<int8_t>(data, size, begin, limit, onMatch); break;
+    case DT_UBYTE:      scan<uint8_t>(data, size, begin, limit, onMatch); break;
+    case DT_SHORT:      scan<int16_t>(data, size, begin, limit, onMatch); break;
+    case DT_USHORT:     scan<uint16_t>(data, size, begin, limit, onMatch); break;
+    case DT_INT:
+    case DT_TIME_T:     scan<int32_t>(data, size, begin, limit, onMatch); break;
+    case DT_UINT:       scan<uint32_t>(data, size, begin, limit, onMatch); break;
+    case DT_INT64:
+    case DT_TIME64_T:   scan<int64_t>(data, size, begin, limit, onMatch); break;
+    case DT_UINT64:     scan<uint64_t>(data, size, begin, limit, onMatch); break;
+    case DT_FLOAT:      scan<float>(data, size, begin, limit, onMatch); break;
+    case DT_DOUBLE:     scan<double>(data, size, begin, limit, onMatch); break;
+    default:            break;
+    }
+}
+
+SearchHit ValuePattern::find(const uint8_t* data, size_t size, size_t begin, size_t end) const {
+    SearchHit first = NO_HIT;
+    findAll(data, size, begin, end, [&first](const SearchHit& hit) {
+        first = hit;
+        return false;
+    });
+    return first;
+}
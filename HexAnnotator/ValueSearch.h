@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "ByteSearch.h"
+#include "DataInterpreter.h"
+
+//-------------------------------------------------------------------
+// ValuePattern - offsets whose bytes decode to a value in a range
+//-------------------------------------------------------------------
+// The inverse of the data interpreter. Written as a type, options and a
+// value or range:
+//   i32 1000..2000             u16 be 0x1234            i64 -5
+//   f32 3.14159 +- 0.00001     time32 2020-01-01..2020-12-31T12:00
+// Types are i8 u8 i16 u16 i32 u32 i64 u64 f32 f64 time32 time64, the times
+// being seconds since 1970 UTC. "le" or "be" picks the byte order, little
+// endian by default, and "aligned" only tries offsets that are a multiple of
+// the width. A date without a time as the upper bound includes its whole day.
+// Each match is one value wide, and matches may overlap.
+//
+// With SSE2, 16 offsets are tested per step: one unaligned load per byte of
+// the width covers every offset with the same phase, byte order is reversed
+// with shifts and shuffles, and lanes are range checked with two compares.
+// 64-bit integers, which SSE2 cannot compare, are filtered by their upper
+// halves and confirmed one at a time, as are the last few offsets.
+class ValuePattern : public SearchPattern {
+public:
+    // Throws std::runtime_error describing the first problem
+    explicit ValuePattern(const std::string& text);
+
+    SearchHit find(const uint8_t* data, size_t size, size_t begin, size_t end) const override;
+    void findAll(const uint8_t* data, size_t size, size_t begin, size_t end,
+                 const std::function<bool(const SearchHit&)>& onMatch) const override;
+
+    // How InterpretData shows a match
+    DataType type() const { return valueType; }
+    ByteOrder byteOrder() const { return order; }
+    size_t width() const { return valueWidth; }
+
+private:
+    template <typename T>
+    void scan(const uint8_t* data, size_t size, size_t begin, size_t limit,
+              const std::function<bool(const SearchHit&)>& onMatch) const;
+    template <typename T, ByteOrder Order>
+    void scanOrdered(const uint8_t* data, size_t size, size_t begin, size_t limit,
+                     const std::function<bool(const SearchHit&)>& onMatch) const;
+    template <typename T>
+    void bounds(T& low, T& high) const;
+
+    DataType valueType = DT_INT;
+    ByteOrder order = BO_LITTLE_ENDIAN;
+    size_t valueWidth = 4;
+    bool aligned = false;
+
+    // Inclusive; only the set matching the type is used
+    int64_t signedLow = 0, signedHigh = 0;
+    uint64_t unsignedLow = 0, unsignedHigh = 0;
+    double floatLow = 0, floatHigh = 0;
+};
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <exception>
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    threads.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+WorkerPool& WorkerPool::shared() {
+    static WorkerPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void WorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    wake.notify_one();
+}
+
+void WorkerPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+            if (stopping && tasks.empty()) {
+                return;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+//-------------------------------------------------------------------
+// parallelFor
+//-------------------------------------------------------------------
+// Helpers only claim indices; the caller waits for indices to complete rather
+// than for helpers to start, so a parallelFor issued from inside a worker task
+// cannot deadlock on a busy pool. A throw from fn is caught where it happens,
+// the indices not yet run are skipped but still counted as done, and the first
+// exception is rethrown on the caller once no thread can still be inside fn.
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t index)>& fn) {
+    if (count == 0) {
+        return;
+    }
+
+    struct Job {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        size_t count = 0;
+        const std::function<void(size_t)>* fn = nullptr;
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+
+        void run() {
+            for (size_t i = next++; i < count; i = next++) {
+                if (!failed) {
+                    try {
+                        (*fn)(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        failed = true;
+                    }
+                }
+                if (++done == count) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+            }
+        }
+    };
+
+    auto job = std::make_shared<Job>();
+    job->count = count;
+    job->fn = &fn;
+
+    size_t helpers = std::min<size_t>(size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        submit([job] { job->run(); });
+    }
+
+    job->run();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&] { return job->done == count; });
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
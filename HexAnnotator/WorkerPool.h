@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads shared by every document window
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Pool sized to the machine, created on first use
+    static WorkerPool& shared();
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    // Queue a task to run on some worker
+    void submit(std::function<void()> task);
+
+    // Run fn(0) .. fn(count - 1) across the workers and the calling thread and
+    // return once every index has completed. Indices are claimed in ascending
+    // order, so work near the start of a range finishes first. If fn throws,
+    // the remaining indices are skipped and the first exception is rethrown
+    // here after every thread has left fn.
+    void parallelFor(size_t count, const std::function<void(size_t index)>& fn);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
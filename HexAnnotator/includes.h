@@ -1,6 +1,11 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include "AnnotationText.h"
 
 static const COLORREF annotationColors[] = {
     RGB(255, 0, 0),    // Red
@@ -11,13 +16,96 @@ static const COLORREF annotationColors[] = {
     RGB(0, 128, 128)   // Teal
 };
 
+// Outline and label of a checksum field that does not match the bytes it covers
+static const COLORREF checksumMismatchColor = RGB(255, 0, 255);    // Magenta
+
+// One field of a record-array element, relative to the start of the element
+struct RecordField {
+    std::string name;
+    int offset;
+    int length;
+    std::string displayFormat;
+    int colorIndex;
+};
+
+// Layout shared by every element of a record-array annotation
+struct RecordLayout {
+    int stride;
+    int count;
+    std::vector<RecordField> fields;   // Sorted by offset, non-overlapping
+};
+
+// Expressions that derive an annotation's extent or displayed value from
+// other annotations, e.g. start = "{Header.size}.end". Empty expressions
+// leave that part as entered.
+struct ComputedFields {
+    std::string start;
+    std::string length;
+    std::string value;
+};
+
+// Declares that an annotation holds a checksum or hash of another
+// annotation's bytes, e.g. the CRC-32 of a PNG chunk's type and data. See
+// ChecksumFields.h for the algorithms.
+struct ChecksumField {
+    std::string algorithm;
+    std::string covered;        // Label of the annotation checked
+    bool bigEndian = false;     // Byte order of integer checksums
+};
+
 // Structure to store annotation information
 struct Annotation {
     int startOffset;
     int endOffset;
-    std::string label;
-    std::string displayFormat; // "hex", "int", "float", "ascii", etc.
+    AnnotationText label;
+    AnnotationText displayFormat; // "hex", "int", "float", "ascii", etc.
     int colorIndex;
+
+    // Set for record arrays: count elements of stride bytes from startOffset.
+    // Element ranges, labels and values are derived on demand, so the cost
+    // does not grow with count.
+    std::shared_ptr<const RecordLayout> layout;
+
+    // Set for computed annotations; see ComputedAnnotations.h
+    std::shared_ptr<const ComputedFields> computed;
+
+    // Set for checksum fields; see ChecksumFields.h
+    std::shared_ptr<const ChecksumField> checksum;
+
+    // The bytes under the annotation changed when it was rebased onto a new
+    // version of the document; cleared by editing the annotation
+    bool stale = false;
+};
+
+// Display format of record-array annotations; FormatData has no output for it
+const char* const RECORD_ARRAY_FORMAT = "array";
+
+// One reversible change to DocumentWindowState::annotations. A delta only holds
+// the side of the change that is not currently in the document, so applying it
+// swaps that side in and the other side out; undo and redo are the same operation.
+struct AnnotationDelta {
+    enum Kind {
+        Insert,     // annotation lives in the delta while undone
+        Erase,      // annotation lives in the delta while applied
+        Update,     // delta holds the other version of annotations[index]
+        ReplaceAll, // delta holds the other collection (bulk load/import)
+        Append,     // appended annotations live in the delta while undone
+        RemoveTail  // annotations from index onward live in the delta while applied
+    };
+
+    Kind kind = Insert;
+    int index = -1;
+    Annotation annotation{};
+    std::vector<Annotation> collection;
+    std::chrono::steady_clock::time_point when;
+    size_t cost = 0;        // Approximate heap footprint, for the memory budget
+};
+
+// Undo/redo history for a document
+struct UndoJournal {
+    std::deque<AnnotationDelta> undoStack;
+    std::deque<AnnotationDelta> redoStack;
+    size_t memoryUsed = 0;
 };
 
 struct AnnotationInfo {
@@ -46,6 +134,7 @@ struct ByteRange {
     int start;
     int end;
     AnnotationInfo info;
+    std::shared_ptr<const RecordLayout> layout;
 
     bool operator<(const ByteRange& other) const {
         return start < other.start ||
@@ -70,18 +159,61 @@ struct ByteMap {
         --it;
 
         if (byteOffset <= it->end)
-            return &it->info;
+            return it->layout ? elementAt(*it, byteOffset) : &it->info;
 
         return nullptr;
     }
 
+    // Resolves a byte inside a record array to the field it belongs to. The
+    // returned info is only valid until the next lookup.
+    const AnnotationInfo* elementAt(const ByteRange& range, size_t byteOffset) const;
+
     std::vector<ByteRange> ranges;
+    const std::vector<BYTE>* data = nullptr;
+
+    // Last record-array field that was resolved
+    mutable AnnotationInfo elementInfo;
+    mutable long long elementKey[3] = { -1, -1, -1 };  // annotation, element, field
 };
 
+// Identity of a document's contents, see ContentFingerprint.h
+struct ContentFingerprint {
+    uint64_t size = 0;
+    uint64_t hash = 0;
+
+    bool known() const { return size != 0 || hash != 0; }
+    bool operator==(const ContentFingerprint& other) const = default;
+};
+
+// Dependency graph of computed annotations, private to ComputedAnnotations.cpp
+struct ComputedGraph;
+
+// Verification results of checksum fields, private to ChecksumFields.cpp
+struct ChecksumTable;
+
+// Background writer for the document's autosave files, see AutosaveJournal.h
+class AutosaveJournal;
+
+// Trigram index over annotation labels, see LabelIndex.h
+class LabelIndex;
+
+// Coalesced interpreter and status bar updates, see SelectionUpdates.h
+class SelectionUpdates;
+
+// Printable strings of the document, see StringIndex.h
+class StringIndex;
+
+// Find next and find previous, see ByteSearch.h
+class SearchCursor;
+
+// Entropy of the document's blocks, see EntropyIndex.h
+class EntropyBuild;
+
 // Structure to represent the application state
 struct DocumentWindowState {
     std::vector<BYTE> fileData;
     std::string fileName;
+    ContentFingerprint fingerprint;
     int scrollPosition = 0;
     int bytesPerPage = 0;
     int totalRows = 0;
@@ -93,6 +225,15 @@ struct DocumentWindowState {
     bool isAnnotating = false;
     std::string tempAnnotationLabel;
     std::string currentDisplayFormat = "hex";
+    UndoJournal history;
+    std::shared_ptr<ComputedGraph> computedGraph;  // Created on first use
+    std::shared_ptr<ChecksumTable> checksumTable;  // Created on first use
+    std::shared_ptr<AutosaveJournal> autosave;     // Null if autosave could not start
+    std::shared_ptr<LabelIndex> labelIndex;        // Created on first search
+    std::shared_ptr<SelectionUpdates> selectionUpdates;  // Created on first selection
+    std::shared_ptr<StringIndex> stringIndex;      // Created on first use, see DocumentStrings
+    std::shared_ptr<SearchCursor> searchCursor;    // The last Find Bytes search
+    std::shared_ptr<EntropyBuild> entropyBuild;    // Started on first use, see DocumentEntropy
 
     ByteMap annotationMap;
     struct {
@@ -101,24 +242,7 @@ struct DocumentWindowState {
         HBRUSH selectionBrush;
         HPEN grayPen;
         HPEN annotationPen[6];
+        HPEN mismatchPen;
     } gdi;
 
 };
-
-// Grid data types
-enum DataType {
-    DT_BYTE,
-    DT_UBYTE,
-    DT_SHORT,
-    DT_USHORT,
-    DT_INT,
-    DT_UINT,
-    DT_FLOAT,
-    DT_DOUBLE,
-    DT_STRING,
-    DT_UNICODE_STRING,
-    DT_TIME_T,
-    DT_TIME64_T,
-    DT_OLETIME,
-    DT_COUNT  // Total number of data types
-};
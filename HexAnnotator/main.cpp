@@ -8,12 +8,20 @@
 #include <vector>
 #include <fstream>
 #include <sstream>
-#include <iomanip>
 #include <algorithm>
+#include <climits>
 #include <unordered_map>
-#include <ctime>
-#include <Ole2.h>
 #include "includes.h"
+#include "AnnotationExchange.h"
+#include "AnnotationFile.h"
+#include "AnnotationRebase.h"
+#include "AutosaveJournal.h"
+#include "ContentFingerprint.h"
+#include "DataInterpreter.h"
+#include "EmbeddedFiles.h"
+#include "LabelIndex.h"
+#include "MappedFile.h"
+#include "SignatureScanner.h"
 
 // Ensure common controls are initialized
 #pragma comment(lib, "comctl32.lib")
@@ -34,17 +42,28 @@
 #define IDM_WINDOW_ARRANGE   2012
 #define IDM_FILE_SAVE_ANNOTATIONS   2020
 #define IDM_FILE_LOAD_ANNOTATIONS   2021
-
-// Version number for annotation file format
-const int ANNOTATION_FILE_VERSION = 1;
-
-// Annotation file header
-struct AnnotationFileHeader {
-    char signature[4];        // "HVA\0" (Hex Viewer Annotations)
-    int version;              // File format version
-    int annotationCount;      // Number of annotations
-    int reserved[4];          // Reserved for future use
-};
+#define IDM_FILE_APPLY_SIGNATURES   2022
+#define IDM_FILE_REBASE_ANNOTATIONS 2023
+#define IDM_FILE_EXPORT_ANNOTATIONS 2024
+#define IDM_FILE_IMPORT_ANNOTATIONS 2025
+#define IDM_EDIT_UNDO        2030
+#define IDM_EDIT_REDO        2031
+#define IDM_EDIT_FIND_ANNOTATIONS 2032
+#define IDM_EDIT_FIND_BYTES  2033
+#define IDM_EDIT_STRINGS     2034
+#define IDM_EDIT_FIND_NEXT   2035
+#define IDM_EDIT_FIND_PREVIOUS 2036
+#define IDM_VIEW_ENTROPY_OFF 2037
+#define IDM_VIEW_ENTROPY_256 2038
+#define IDM_VIEW_ENTROPY_1K  2039
+#define IDM_VIEW_ENTROPY_4K  2040
+#define IDM_VIEW_ENTROPY_64K 2041
+#define IDM_VIEW_ENTROPY_1M  2042
+#define IDM_EDIT_HASH_SELECTION 2043
+#define IDM_EDIT_EMBEDDED_FILES 2044
+
+// Entropy margin block size of each IDM_VIEW_ENTROPY item, 0 for hidden
+const size_t ENTROPY_MENU_BLOCK_SIZES[] = { 0, 256, 1024, 4096, 65536, 1024 * 1024 };
 
 // Global variables
 HINSTANCE g_hInstance;
@@ -54,7 +73,8 @@ HWND g_hDockWindow;
 HWND g_hGridView;
 HWND g_hStatusbar;
 HWND g_hActiveHexViewer = NULL;
-int g_dockWidth = 250;
+size_t g_entropyBlockSize = 0;     // Hidden
+int g_dockWidth = 380;
 
 // Forward declarations
 LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -64,13 +84,28 @@ HWND CreateHexViewerWindow(HWND hMDIClient, const char* fileName);
 HWND CreateDockWindow(HWND hParent);
 HWND CreateGridView(HWND hParent);
 void OpenFileInNewWindow(HWND hWnd);
-void UpdateGridView(HWND hGridView, int offset, const std::vector<BYTE>& data);
-const char* GetDataTypeName(DataType type);
-std::string FormatDataAtOffset(const std::vector<BYTE>& data, int offset, DataType type);
+void UpdateGridView(HWND hGridView, const DataInterpretation& values);
 void tagBytesThatAreAnnotated(DocumentWindowState& state);
 
 bool SaveAnnotationsToFile(HWND hwnd, DocumentWindowState& state);
 bool LoadAnnotationsFromFile(HWND hwnd, DocumentWindowState& state);
+bool ApplySignatureRulesFromFile(HWND hwnd, DocumentWindowState& state);
+bool AnnotateEmbeddedFiles(HWND hwnd, DocumentWindowState& state);
+bool RebaseAnnotationsFromFile(HWND hwnd, DocumentWindowState& state);
+bool ExportAnnotationsToFile(HWND hwnd, DocumentWindowState& state);
+bool ImportAnnotationsFromFile(HWND hwnd, DocumentWindowState& state);
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+void tagAppendedAnnotations(DocumentWindowState& state, size_t firstIndex);
+void ReplaceAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+void UndoLastEdit(HWND hwnd, DocumentWindowState& state);
+void RedoLastEdit(HWND hwnd, DocumentWindowState& state);
+void ShowFindAnnotationsDialog(HWND hwnd, DocumentWindowState& state);
+void ShowFindBytesDialog(HWND hwnd, DocumentWindowState& state);
+void ShowStringsDialog(HWND hwnd, DocumentWindowState& state);
+void ShowHashDialog(HWND hwnd, DocumentWindowState& state);
+void ShowEmbeddedFilesDialog(HWND hwnd, DocumentWindowState& state, const std::vector<EmbeddedFile>& files, size_t firstIndex);
+void FindNextMatch(HWND hwnd, DocumentWindowState& state, bool forward);
+void SelectionChanged(HWND hwnd, DocumentWindowState& state);
 
 
 // Each window has its own state
@@ -160,6 +195,9 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         // Create menus
         HMENU hMenu = CreateMenu();
         HMENU hFileMenu = CreatePopupMenu();
+        HMENU hEditMenu = CreatePopupMenu();
+        HMENU hViewMenu = CreatePopupMenu();
+        HMENU hEntropyMenu = CreatePopupMenu();
         HMENU hWindowMenu = CreatePopupMenu();
 
         //AppendMenu(hFileMenu, MF_STRING, IDM_FILE_NEW, "New");
@@ -167,15 +205,42 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
         AppendMenu(hFileMenu, MF_STRING, IDM_FILE_SAVE_ANNOTATIONS, "Save Annotations...");
         AppendMenu(hFileMenu, MF_STRING, IDM_FILE_LOAD_ANNOTATIONS, "Load Annotations...");
+        AppendMenu(hFileMenu, MF_STRING, IDM_FILE_APPLY_SIGNATURES, "Apply Signature Rules...");
+        AppendMenu(hFileMenu, MF_STRING, IDM_FILE_REBASE_ANNOTATIONS, "Rebase Annotations...");
+        AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXPORT_ANNOTATIONS, "Export Annotations...");
+        AppendMenu(hFileMenu, MF_STRING, IDM_FILE_IMPORT_ANNOTATIONS, "Import Annotations...");
         
         AppendMenu(hFileMenu, MF_SEPARATOR, 0, NULL);
         AppendMenu(hFileMenu, MF_STRING, IDM_FILE_EXIT, "Exit");
 
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_UNDO, "Undo\tCtrl+Z");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_REDO, "Redo\tCtrl+Y");
+        AppendMenu(hEditMenu, MF_SEPARATOR, 0, NULL);
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_FIND_BYTES, "Find Bytes...\tCtrl+F");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_FIND_NEXT, "Find Next\tF3");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_FIND_PREVIOUS, "Find Previous\tShift+F3");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_STRINGS, "Strings...");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_HASH_SELECTION, "Hash Selection...");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_EMBEDDED_FILES, "Find Embedded Files...");
+        AppendMenu(hEditMenu, MF_STRING, IDM_EDIT_FIND_ANNOTATIONS, "Find Annotations...\tCtrl+Shift+F");
+
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_OFF, "Off");
+        AppendMenu(hEntropyMenu, MF_SEPARATOR, 0, NULL);
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_256, "256 Byte Blocks");
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_1K, "1 KB Blocks");
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_4K, "4 KB Blocks");
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_64K, "64 KB Blocks");
+        AppendMenu(hEntropyMenu, MF_STRING, IDM_VIEW_ENTROPY_1M, "1 MB Blocks");
+        CheckMenuRadioItem(hEntropyMenu, IDM_VIEW_ENTROPY_OFF, IDM_VIEW_ENTROPY_1M, IDM_VIEW_ENTROPY_OFF, MF_BYCOMMAND);
+        AppendMenu(hViewMenu, MF_POPUP, (UINT_PTR)hEntropyMenu, "Entropy");
+
         AppendMenu(hWindowMenu, MF_STRING, IDM_WINDOW_CASCADE, "Cascade");
         AppendMenu(hWindowMenu, MF_STRING, IDM_WINDOW_TILE, "Tile");
         AppendMenu(hWindowMenu, MF_STRING, IDM_WINDOW_ARRANGE, "Arrange Icons");
 
         AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hFileMenu, "File");
+        AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hEditMenu, "Edit");
+        AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hViewMenu, "View");
         AppendMenu(hMenu, MF_POPUP, (UINT_PTR)hWindowMenu, "Window");
 
         SetMenu(hwnd, hMenu);
@@ -202,7 +267,7 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
         // Create MDI Client
         CLIENTCREATESTRUCT ccs;
-        ccs.hWindowMenu = GetSubMenu(hMenu, 1); // Window menu is at index 1
+        ccs.hWindowMenu = GetSubMenu(hMenu, 3); // Window menu is at index 3, after View
         ccs.idFirstChild = 1000; // First child window ID
 
         RECT clientRect;
@@ -287,6 +352,194 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         break;
 
+        case IDM_FILE_APPLY_SIGNATURES:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ApplySignatureRulesFromFile(hwnd, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Apply Signature Rules", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_FILE_REBASE_ANNOTATIONS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    RebaseAnnotationsFromFile(hwnd, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Rebase Annotations", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_FILE_EXPORT_ANNOTATIONS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ExportAnnotationsToFile(hwnd, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Export Annotations", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_FILE_IMPORT_ANNOTATIONS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ImportAnnotationsFromFile(hwnd, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Import Annotations", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_EDIT_UNDO:
+        case IDM_EDIT_REDO:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    if (LOWORD(wParam) == IDM_EDIT_UNDO)
+                        UndoLastEdit(hActiveChild, *it->second);
+                    else
+                        RedoLastEdit(hActiveChild, *it->second);
+                }
+            }
+        }
+        break;
+
+        case IDM_EDIT_FIND_ANNOTATIONS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ShowFindAnnotationsDialog(hActiveChild, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Find Annotations", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_EDIT_FIND_BYTES:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ShowFindBytesDialog(hActiveChild, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Find Bytes", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_EDIT_FIND_NEXT:
+        case IDM_EDIT_FIND_PREVIOUS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    FindNextMatch(hActiveChild, *it->second, LOWORD(wParam) == IDM_EDIT_FIND_NEXT);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Find Next", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_VIEW_ENTROPY_OFF:
+        case IDM_VIEW_ENTROPY_256:
+        case IDM_VIEW_ENTROPY_1K:
+        case IDM_VIEW_ENTROPY_4K:
+        case IDM_VIEW_ENTROPY_64K:
+        case IDM_VIEW_ENTROPY_1M:
+        {
+            // Every document shows the margin at the same block size
+            g_entropyBlockSize = ENTROPY_MENU_BLOCK_SIZES[LOWORD(wParam) - IDM_VIEW_ENTROPY_OFF];
+            CheckMenuRadioItem(GetMenu(hwnd), IDM_VIEW_ENTROPY_OFF, IDM_VIEW_ENTROPY_1M, LOWORD(wParam), MF_BYCOMMAND);
+            for (auto& [hViewer, state] : windowStates) {
+                InvalidateRect(hViewer, NULL, TRUE);
+            }
+
+            auto it = windowStates.find(g_hActiveHexViewer);
+            if (it != windowStates.end() && it->second->selectionStart >= 0) {
+                SelectionChanged(g_hActiveHexViewer, *it->second);
+            }
+        }
+        break;
+
+        case IDM_EDIT_STRINGS:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ShowStringsDialog(hActiveChild, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Strings", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_EDIT_HASH_SELECTION:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    ShowHashDialog(hActiveChild, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Hash Selection", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
+        case IDM_EDIT_EMBEDDED_FILES:
+        {
+            HWND hActiveChild = (HWND)SendMessage(g_hMDIClient, WM_MDIGETACTIVE, 0, 0);
+            if (hActiveChild && g_hActiveHexViewer == hActiveChild) {
+                auto it = windowStates.find(hActiveChild);
+                if (it != windowStates.end()) {
+                    AnnotateEmbeddedFiles(hActiveChild, *it->second);
+                }
+            }
+            else {
+                MessageBox(hwnd, "Please activate a hex viewer window first.", "Find Embedded Files", MB_OK | MB_ICONINFORMATION);
+            }
+        }
+        break;
+
         case IDM_FILE_EXIT:
             PostMessage(hwnd, WM_CLOSE, 0, 0);
             break;
@@ -315,12 +568,13 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return DefFrameProc(hwnd, g_hMDIClient, msg, wParam, lParam);
 }
 
-void UpdateStatusbar(int offset, int length) {
+void UpdateStatusbar(int offset, int length, const char* summary) {
     char buffer[32];
     sprintf_s(buffer, "Offset: %d", offset);
     SendMessage(g_hStatusbar, SB_SETTEXT, 0, (LPARAM)buffer);
     sprintf_s(buffer, "Length: %d", length);
     SendMessage(g_hStatusbar, SB_SETTEXT, 1, (LPARAM)buffer);
+    SendMessage(g_hStatusbar, SB_SETTEXT, 2, (LPARAM)summary);
 }
 
 
@@ -452,12 +706,17 @@ HWND CreateGridView(HWND hParent) {
     lvc.pszText = (LPSTR)"Type";
     ListView_InsertColumn(hListView, 0, &lvc);
 
-    // Value column
+    // Value columns, one per byte order
     lvc.iSubItem = 1;
-    lvc.cx = 150;
-    lvc.pszText = (LPSTR)"Value";
+    lvc.cx = 130;
+    lvc.pszText = (LPSTR)"Little Endian";
     ListView_InsertColumn(hListView, 1, &lvc);
 
+    lvc.iSubItem = 2;
+    lvc.cx = 130;
+    lvc.pszText = (LPSTR)"Big Endian";
+    ListView_InsertColumn(hListView, 2, &lvc);
+
     // Add rows for each data type
     LVITEM lvi;
     lvi.mask = LVIF_TEXT;
@@ -496,234 +755,22 @@ void OpenFileInNewWindow(HWND hWnd) {
 //-------------------------------------------------------------------
 // Update Grid View with data from current selection
 //-------------------------------------------------------------------
-void UpdateGridView(HWND hGridView, int offset, const std::vector<BYTE>& data) {
-    static int lastOffset = -1;
-    if (!hGridView || offset < 0 || offset >= data.size())
+void UpdateGridView(HWND hGridView, const DataInterpretation& values) {
+    if (!hGridView)
         return;
-    
-    if (offset == lastOffset)
-        return;
-
-    lastOffset = offset;
 
     SendMessage(hGridView, WM_SETREDRAW, FALSE, 0);
-    // Update each row with the interpreted value
+    // Update each row with the interpreted values
     for (int i = 0; i < DT_COUNT; i++) {
-        std::string value = FormatDataAtOffset(data, offset, (DataType)i);
-        ListView_SetItemText(hGridView, i, 1, (LPSTR)value.c_str());
+        for (int order = 0; order < BO_COUNT; order++) {
+            ListView_SetItemText(hGridView, i, 1 + order, (LPSTR)values.text[i][order]);
+        }
     }
     SendMessage(hGridView, WM_SETREDRAW, TRUE, 0);
     InvalidateRect(hGridView, NULL, TRUE);
     
 }
 
-//-------------------------------------------------------------------
-// Get Data Type Name
-//-------------------------------------------------------------------
-const char* GetDataTypeName(DataType type) {
-    switch (type) {
-    case DT_BYTE: return "Byte (8-bit)";
-    case DT_UBYTE: return "Unsigned Byte";
-    case DT_SHORT: return "Short (16-bit)";
-    case DT_USHORT: return "Unsigned Short";
-    case DT_INT: return "Int (32-bit)";
-    case DT_UINT: return "Unsigned Int";
-    case DT_FLOAT: return "Float";
-    case DT_DOUBLE: return "Double";
-    case DT_STRING: return "ASCII String";
-    case DT_UNICODE_STRING: return "Unicode String";
-    case DT_TIME_T: return "time_t";
-    case DT_TIME64_T: return "time64_t";
-    case DT_OLETIME: return "OLE Time";
-    default: return "Unknown";
-    }
-}
-
-//-------------------------------------------------------------------
-// Format Data At Offset for a specific type
-//-------------------------------------------------------------------
-std::string FormatDataAtOffset(const std::vector<BYTE>& data, int offset, DataType type) {
-    std::stringstream ss;
-    size_t remainingBytes = data.size() - offset;
-
-    try {
-        switch (type) {
-        case DT_BYTE:
-        {
-            if (remainingBytes >= 1) {
-                int8_t value = static_cast<int8_t>(data[offset]);
-                ss << static_cast<int>(value) << " (0x" << std::hex << static_cast<int>(static_cast<uint8_t>(value)) << ")";
-            }
-            break;
-        }
-        case DT_UBYTE:
-        {
-            if (remainingBytes >= 1) {
-                uint8_t value = data[offset];
-                ss << static_cast<int>(value) << " (0x" << std::hex << static_cast<int>(value) << ")";
-            }
-            break;
-        }
-        case DT_SHORT:
-        {
-            if (remainingBytes >= 2) {
-                int16_t value;
-                memcpy(&value, &data[offset], sizeof(int16_t));
-                ss << value << " (0x" << std::hex << static_cast<int>(value) << ")";
-            }
-            break;
-        }
-        case DT_USHORT:
-        {
-            if (remainingBytes >= 2) {
-                uint16_t value;
-                memcpy(&value, &data[offset], sizeof(uint16_t));
-                ss << value << " (0x" << std::hex << value << ")";
-            }
-            break;
-        }
-        case DT_INT:
-        {
-            if (remainingBytes >= 4) {
-                int32_t value;
-                memcpy(&value, &data[offset], sizeof(int32_t));
-                ss << value << " (0x" << std::hex << value << ")";
-            }
-            break;
-        }
-        case DT_UINT:
-        {
-            if (remainingBytes >= 4) {
-                uint32_t value;
-                memcpy(&value, &data[offset], sizeof(uint32_t));
-                ss << value << " (0x" << std::hex << value << ")";
-            }
-            break;
-        }
-        case DT_FLOAT:
-        {
-            if (remainingBytes >= 4) {
-                float value;
-                memcpy(&value, &data[offset], sizeof(float));
-                ss << std::fixed << std::setprecision(6) << value;
-            }
-            break;
-        }
-        case DT_DOUBLE:
-        {
-            if (remainingBytes >= 8) {
-                double value;
-                memcpy(&value, &data[offset], sizeof(double));
-                ss << std::fixed << std::setprecision(10) << value;
-            }
-            break;
-        }
-        case DT_STRING:
-        {
-            // Display up to 32 chars of ASCII string
-            const int MAX_STRING_LENGTH = 32;
-            std::string result;
-            for (size_t i = 0; i < MAX_STRING_LENGTH && (offset + i) < data.size(); i++) {
-                uint8_t ch = data[offset + i];
-                if (ch == 0) break; // Stop at null terminator
-                if (ch >= 32 && ch <= 126) { // Printable ASCII
-                    result += static_cast<char>(ch);
-                }
-                else {
-                    result += '.'; // Non-printable
-                }
-            }
-            ss << result;
-            break;
-        }
-        case DT_UNICODE_STRING:
-        {
-            // Display up to 16 wide chars of Unicode string
-            const int MAX_WSTRING_LENGTH = 16;
-            std::string result;
-            for (size_t i = 0; i < MAX_WSTRING_LENGTH && (offset + i * 2 + 1) < data.size(); i++) {
-                wchar_t ch;
-                memcpy(&ch, &data[offset + i * 2], sizeof(wchar_t));
-                if (ch == 0) break; // Stop at null terminator
-                if (ch >= 32 && ch <= 126) { // Basic Latin Unicode
-                    result += static_cast<char>(ch);
-                }
-                else {
-                    result += '.'; // Non-printable
-                }
-            }
-            ss << result;
-            break;
-        }
-        case DT_TIME_T:
-        {
-            if (remainingBytes >= 4) {
-                time_t value;
-                memcpy(&value, &data[offset], sizeof(time_t));
-                char buffer[100];
-                struct tm timeinfo;
-                gmtime_s(&timeinfo, &value);
-
-                sprintf_s(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-                    timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                    timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-
-                ss << buffer;
-            }
-            break;
-        }
-        case DT_TIME64_T:
-        {
-            if (remainingBytes >= 8) {
-                __time64_t value;
-                memcpy(&value, &data[offset], sizeof(__time64_t));
-                char buffer[100];
-                struct tm timeinfo;
-                _gmtime64_s(&timeinfo, &value);
-
-                sprintf_s(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-                    timeinfo.tm_year+1900, timeinfo.tm_mon+1, timeinfo.tm_mday,
-                    timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-
-                ss << buffer;
-            }
-            break;
-        }
-        case DT_OLETIME:
-        {
-            if (remainingBytes >= 8) {
-                double value;
-                memcpy(&value, &data[offset], sizeof(double));
-
-                // OLE automation date (days since December 30, 1899)
-                SYSTEMTIME sysTime;
-                VariantTimeToSystemTime(value, &sysTime);
-
-                char buffer[100];
-                sprintf_s(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-                    sysTime.wYear, sysTime.wMonth, sysTime.wDay,
-                    sysTime.wHour, sysTime.wMinute, sysTime.wSecond);
-                ss << buffer;
-            }
-            break;
-        }
-        default:
-            ss << "Unknown type";
-        }
-    }
-    catch (const std::exception& e) {
-        ss << "Error: " << e.what();
-    }
-
-    // If no value could be formatted
-    if (ss.str().empty()) {
-        return "Not enough data";
-    }
-
-    return ss.str();
-}
-
-
 bool SaveAnnotationsToFile(HWND hwnd, DocumentWindowState& state) {
     if (state.annotations.empty()) {
         MessageBox(hwnd, "No annotations to save.", "Save Annotations", MB_OK | MB_ICONINFORMATION);
@@ -747,55 +794,15 @@ bool SaveAnnotationsToFile(HWND hwnd, DocumentWindowState& state) {
         return false; // User cancelled
     }
 
-    // Open the file for writing
-    std::ofstream file(fileName, std::ios::binary);
-    if (!file) {
-        MessageBox(hwnd, "Failed to open file for writing.", "Save Annotations", MB_OK | MB_ICONERROR);
-        return false;
-    }
-
     try {
-        // Write file header
-        AnnotationFileHeader header;
-        memset(&header, 0, sizeof(header));
-
-        // Set signature "HVA\0"
-        header.signature[0] = 'H';
-        header.signature[1] = 'V';
-        header.signature[2] = 'A';
-        header.signature[3] = '\0';
-
-        header.version = ANNOTATION_FILE_VERSION;
-        header.annotationCount = static_cast<int>(state.annotations.size());
-
-        file.write(reinterpret_cast<char*>(&header), sizeof(header));
-
-        // Write the filename that these annotations belong to
-        int fileNameLength = static_cast<int>(state.fileName.length());
-        file.write(reinterpret_cast<char*>(&fileNameLength), sizeof(fileNameLength));
-        file.write(state.fileName.c_str(), fileNameLength);
-
-        // Write each annotation
-        for (const auto& anno : state.annotations) {
-            // Write offsets
-            file.write(reinterpret_cast<const char*>(&anno.startOffset), sizeof(anno.startOffset));
-            file.write(reinterpret_cast<const char*>(&anno.endOffset), sizeof(anno.endOffset));
-
-            // Write color
-            file.write(reinterpret_cast<const char*>(&anno.colorIndex), sizeof(anno.colorIndex));
-
-            // Write label string
-            int labelLength = static_cast<int>(anno.label.length());
-            file.write(reinterpret_cast<char*>(&labelLength), sizeof(labelLength));
-            file.write(anno.label.c_str(), labelLength);
-
-            // Write format string
-            int formatLength = static_cast<int>(anno.displayFormat.length());
-            file.write(reinterpret_cast<char*>(&formatLength), sizeof(formatLength));
-            file.write(anno.displayFormat.c_str(), formatLength);
-        }
+        // The label index goes with the annotations so it need not be
+        // rebuilt when they are loaded
+        WriteAnnotationFile(fileName, state.fileName, state.fingerprint, state.annotations, 0,
+            &CompactLabelIndex(state));
 
-        file.close();
+        // Best effort: without a catalog the saved file still works as before
+        AddToCatalog(fileName, state.fingerprint);
+        AutosaveSaved(state);
 
         MessageBox(hwnd, "Annotations saved successfully.", "Save Annotations", MB_OK | MB_ICONINFORMATION);
         return true;
@@ -826,108 +833,304 @@ bool LoadAnnotationsFromFile(HWND hwnd, DocumentWindowState& state) {
         return false; // User cancelled
     }
 
-    // Open the file for reading
-    std::ifstream file(fileName, std::ios::binary);
-    if (!file) {
-        MessageBox(hwnd, "Failed to open file for reading.", "Load Annotations", MB_OK | MB_ICONERROR);
-        return false;
-    }
-
     try {
-        // Read and verify file header
-        AnnotationFileHeader header;
-        file.read(reinterpret_cast<char*>(&header), sizeof(header));
-
-        // Check signature
-        if (header.signature[0] != 'H' || header.signature[1] != 'V' ||
-            header.signature[2] != 'A' || header.signature[3] != '\0') {
-            MessageBox(hwnd, "Invalid annotation file format.", "Load Annotations", MB_OK | MB_ICONERROR);
-            return false;
-        }
+        AnnotationFileContents contents = ReadAnnotationFile(fileName, state.fileData.size());
 
         // Check version
-        if (header.version > ANNOTATION_FILE_VERSION) {
+        if (contents.version > ANNOTATION_FILE_VERSION) {
             MessageBox(hwnd, "Annotation file was created with a newer version of this application.",
                 "Load Annotations", MB_OK | MB_ICONWARNING);
             // Continue anyway, we'll read what we can understand
         }
 
-        // Read the filename that these annotations belong to
-        int fileNameLength;
-        file.read(reinterpret_cast<char*>(&fileNameLength), sizeof(fileNameLength));
-
-        std::vector<char> fileNameBuffer(fileNameLength + 1, 0);
-        file.read(fileNameBuffer.data(), fileNameLength);
-        std::string storedFileName(fileNameBuffer.data(), fileNameLength);
-
-        // Check if the annotations match the current file
-        if (storedFileName != state.fileName) {
-            // Ask user if they want to continue even though filenames don't match
-            if (MessageBox(hwnd,
-                "The annotations were saved for a different file. Load anyway?",
-                "Load Annotations",
-                MB_YESNO | MB_ICONQUESTION) == IDNO) {
+        // Check if the annotations match the current contents. Files saved
+        // without a fingerprint can only be matched by name.
+        if (contents.fingerprint.known() ? contents.fingerprint != state.fingerprint
+            : contents.documentName != state.fileName) {
+            std::string message = "The annotations were saved for different file contents (" +
+                contents.documentName + "). Load anyway?";
+            if (MessageBox(hwnd, message.c_str(), "Load Annotations", MB_YESNO | MB_ICONQUESTION) == IDNO) {
                 return false;
             }
         }
 
-        // Clear existing annotations if successful
-        std::vector<Annotation> newAnnotations;
+        // If we got here without exceptions, update the state
+        ReplaceAnnotations(state, std::move(contents.annotations));
+        AdoptLabelIndex(state, std::move(contents.labelIndex));
+        tagBytesThatAreAnnotated(state);
+
+        // Redraw to show the loaded annotations
+        if (g_hActiveHexViewer) {
+            InvalidateRect(g_hActiveHexViewer, NULL, TRUE);
+        }
+
+        MessageBox(hwnd, "Annotations loaded successfully.", "Load Annotations", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Error Loading Annotations", MB_OK | MB_ICONERROR);
+        return false;
+    }
+}
 
-        // Read each annotation
-        for (int i = 0; i < header.annotationCount; i++) {
-            Annotation anno;
+//-------------------------------------------------------------------
+// Annotate every match of a signature rules file
+//-------------------------------------------------------------------
+bool ApplySignatureRulesFromFile(HWND hwnd, DocumentWindowState& state) {
+    char fileName[MAX_PATH] = {};
 
-            // Read offsets
-            file.read(reinterpret_cast<char*>(&anno.startOffset), sizeof(anno.startOffset));
-            file.read(reinterpret_cast<char*>(&anno.endOffset), sizeof(anno.endOffset));
+    OPENFILENAME ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "Signature Rules (*.txt)\0*.txt\0All Files\0*.*\0";
+    ofn.nFilterIndex = 1;
+    ofn.Flags = OFN_FILEMUSTEXIST;
 
-            // Check if offsets are valid for this file
-            if (anno.startOffset < 0 || anno.endOffset < 0 ||
-                anno.startOffset >= state.fileData.size() ||
-                anno.endOffset >= state.fileData.size() ||
-                anno.startOffset > anno.endOffset) {
-                // Skip this annotation
-                continue;
-            }
+    if (!GetOpenFileName(&ofn)) {
+        return false; // User cancelled
+    }
 
-            // Read color
-            file.read(reinterpret_cast<char*>(&anno.colorIndex), sizeof(anno.colorIndex));
+    std::ifstream file(fileName);
+    if (!file) {
+        MessageBox(hwnd, "Failed to open file for reading.", "Apply Signature Rules", MB_OK | MB_ICONERROR);
+        return false;
+    }
 
-            // Read label string
-            int labelLength;
-            file.read(reinterpret_cast<char*>(&labelLength), sizeof(labelLength));
+    try {
+        std::stringstream text;
+        text << file.rdbuf();
 
-            std::vector<char> labelBuffer(labelLength + 1, 0);
-            file.read(labelBuffer.data(), labelLength);
-            anno.label = std::string(labelBuffer.data(), labelLength);
+        std::vector<SignatureRule> rules = ParseSignatureRules(text.str());
+        std::vector<Annotation> found = ScanSignatures(rules, state.fileData);
 
-            // Read format string
-            int formatLength;
-            file.read(reinterpret_cast<char*>(&formatLength), sizeof(formatLength));
+        if (found.empty()) {
+            MessageBox(hwnd, "No signatures were found.", "Apply Signature Rules", MB_OK | MB_ICONINFORMATION);
+            return true;
+        }
 
-            std::vector<char> formatBuffer(formatLength + 1, 0);
-            file.read(formatBuffer.data(), formatLength);
-            anno.displayFormat = std::string(formatBuffer.data(), formatLength);
+        // One undo step and one merge into the byte map for the whole scan
+        size_t firstIndex = state.annotations.size();
+        size_t count = found.size();
+        AppendAnnotations(state, std::move(found));
+        tagAppendedAnnotations(state, firstIndex);
 
-            // Add the annotation to our new list
-            newAnnotations.push_back(anno);
+        if (g_hActiveHexViewer) {
+            InvalidateRect(g_hActiveHexViewer, NULL, TRUE);
         }
 
-        // If we got here without exceptions, update the state
-        state.annotations = newAnnotations;
+        std::string message = "Added " + std::to_string(count) + " annotations.";
+        MessageBox(hwnd, message.c_str(), "Apply Signature Rules", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Error Applying Signature Rules", MB_OK | MB_ICONERROR);
+        return false;
+    }
+}
+
+//-------------------------------------------------------------------
+// Annotate the files embedded in the document and list them
+//-------------------------------------------------------------------
+bool AnnotateEmbeddedFiles(HWND hwnd, DocumentWindowState& state) {
+    HCURSOR oldCursor = SetCursor(LoadCursor(NULL, IDC_WAIT));
+    std::vector<EmbeddedFile> files = FindEmbeddedFiles(state.fileData);
+    SetCursor(oldCursor);
+
+    // Annotation offsets are ints
+    files.erase(std::remove_if(files.begin(), files.end(), [](const EmbeddedFile& file) {
+        return file.offset + file.size - 1 > INT_MAX;
+    }), files.end());
+
+    if (files.empty()) {
+        MessageBox(hwnd, "No embedded files were found.", "Find Embedded Files", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
+
+    std::vector<Annotation> found;
+    found.reserve(files.size());
+    for (const EmbeddedFile& file : files) {
+        found.push_back({
+            static_cast<int>(file.offset),
+            static_cast<int>(file.offset + file.size - 1),
+            file.format,
+            "hex",
+            file.formatIndex % static_cast<int>(std::size(annotationColors))
+        });
+    }
+
+    // One undo step and one merge into the byte map for the whole scan
+    size_t firstIndex = state.annotations.size();
+    AppendAnnotations(state, std::move(found));
+    tagAppendedAnnotations(state, firstIndex);
+    InvalidateRect(hwnd, NULL, TRUE);
+
+    ShowEmbeddedFilesDialog(hwnd, state, files, firstIndex);
+    return true;
+}
+
+//-------------------------------------------------------------------
+// Move the annotations onto this document from the version they were
+// made for
+//-------------------------------------------------------------------
+bool RebaseAnnotationsFromFile(HWND hwnd, DocumentWindowState& state) {
+    if (state.annotations.empty()) {
+        MessageBox(hwnd, "No annotations to rebase.", "Rebase Annotations", MB_OK | MB_ICONINFORMATION);
+        return false;
+    }
+
+    char fileName[MAX_PATH] = {};
+
+    OPENFILENAME ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "All Files\0*.*\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrTitle = "Select the File the Annotations Were Made For";
+    ofn.Flags = OFN_FILEMUSTEXIST;
+
+    if (!GetOpenFileName(&ofn)) {
+        return false; // User cancelled
+    }
+
+    try {
+        // The old version is mapped, not loaded, so it may be as large as
+        // the document itself
+        MappedFile oldFile(fileName);
+        std::vector<RebaseMatch> matches = MatchContents(oldFile.data(), oldFile.length(),
+            state.fileData.data(), state.fileData.size());
+        RebaseResult result = RebaseAnnotations(state.annotations, matches, state.fileData.size());
+
+        ReplaceAnnotations(state, std::move(result.annotations));
         tagBytesThatAreAnnotated(state);
 
-        // Redraw to show the loaded annotations
         if (g_hActiveHexViewer) {
             InvalidateRect(g_hActiveHexViewer, NULL, TRUE);
         }
 
-        MessageBox(hwnd, "Annotations loaded successfully.", "Load Annotations", MB_OK | MB_ICONINFORMATION);
+        std::string message = std::to_string(result.moved) + " annotations moved unchanged.\n" +
+            std::to_string(result.stale) + " annotations cover changed bytes and are marked [stale].\n" +
+            std::to_string(result.dropped) + " annotations were removed with their bytes.";
+        MessageBox(hwnd, message.c_str(), "Rebase Annotations", MB_OK | MB_ICONINFORMATION);
         return true;
     }
     catch (const std::exception& e) {
-        MessageBox(hwnd, e.what(), "Error Loading Annotations", MB_OK | MB_ICONERROR);
+        MessageBox(hwnd, e.what(), "Error Rebasing Annotations", MB_OK | MB_ICONERROR);
+        return false;
+    }
+}
+
+//-------------------------------------------------------------------
+// Export annotations as JSON or CSV
+//-------------------------------------------------------------------
+bool ExportAnnotationsToFile(HWND hwnd, DocumentWindowState& state) {
+    if (state.annotations.empty()) {
+        MessageBox(hwnd, "No annotations to export.", "Export Annotations", MB_OK | MB_ICONINFORMATION);
         return false;
     }
-}
\ No newline at end of file
+
+    char fileName[MAX_PATH] = {};
+
+    OPENFILENAME ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "JSON (*.json)\0*.json\0CSV (*.csv)\0*.csv\0";
+    ofn.nFilterIndex = 1;
+    ofn.lpstrDefExt = "json";
+    ofn.Flags = OFN_OVERWRITEPROMPT | OFN_PATHMUSTEXIST;
+
+    if (!GetSaveFileName(&ofn)) {
+        return false; // User cancelled
+    }
+
+    bool includeValues = MessageBox(hwnd, "Include the decoded value of each annotation?", "Export Annotations",
+        MB_YESNO | MB_ICONQUESTION) == IDYES;
+
+    try {
+        ExportAnnotations(fileName, ofn.nFilterIndex == 2 ? ExchangeFormat::Csv : ExchangeFormatForPath(fileName),
+            state, includeValues);
+
+        std::string message = "Exported " + std::to_string(state.annotations.size()) + " annotations.";
+        MessageBox(hwnd, message.c_str(), "Export Annotations", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Error Exporting Annotations", MB_OK | MB_ICONERROR);
+        return false;
+    }
+}
+
+//-------------------------------------------------------------------
+// Import annotations from JSON or CSV
+//-------------------------------------------------------------------
+bool ImportAnnotationsFromFile(HWND hwnd, DocumentWindowState& state) {
+    char fileName[MAX_PATH] = {};
+
+    OPENFILENAME ofn = {};
+    ofn.lStructSize = sizeof(ofn);
+    ofn.hwndOwner = hwnd;
+    ofn.lpstrFile = fileName;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.lpstrFilter = "JSON or CSV (*.json;*.csv)\0*.json;*.csv\0All Files\0*.*\0";
+    ofn.nFilterIndex = 1;
+    ofn.Flags = OFN_FILEMUSTEXIST;
+
+    if (!GetOpenFileName(&ofn)) {
+        return false; // User cancelled
+    }
+
+    try {
+        ImportedAnnotations imported = ImportAnnotations(fileName, ExchangeFormatForPath(fileName), state.fileData.size());
+
+        // Only JSON exports carry a fingerprint to check
+        if (imported.fingerprint.known() && imported.fingerprint != state.fingerprint) {
+            std::string message = "The annotations were exported for different file contents (" +
+                imported.documentName + "). Import anyway?";
+            if (MessageBox(hwnd, message.c_str(), "Import Annotations", MB_YESNO | MB_ICONQUESTION) == IDNO) {
+                return false;
+            }
+        }
+
+        bool replace = true;
+        if (!state.annotations.empty()) {
+            int choice = MessageBox(hwnd, "Replace the current annotations?\n\nChoose No to add the imported ones to them.",
+                "Import Annotations", MB_YESNOCANCEL | MB_ICONQUESTION);
+            if (choice == IDCANCEL) {
+                return false;
+            }
+            replace = choice == IDYES;
+        }
+
+        // One undo step and one build of the byte map for the whole file
+        size_t count = imported.annotations.size();
+        if (replace) {
+            ReplaceAnnotations(state, std::move(imported.annotations));
+            tagBytesThatAreAnnotated(state);
+        }
+        else {
+            size_t firstIndex = state.annotations.size();
+            AppendAnnotations(state, std::move(imported.annotations));
+            tagAppendedAnnotations(state, firstIndex);
+        }
+
+        if (g_hActiveHexViewer) {
+            InvalidateRect(g_hActiveHexViewer, NULL, TRUE);
+        }
+
+        std::string message = "Imported " + std::to_string(count) + " annotations.";
+        if (imported.skipped > 0) {
+            message += "\n" + std::to_string(imported.skipped) + " annotations outside the file were skipped.";
+        }
+        MessageBox(hwnd, message.c_str(), "Import Annotations", MB_OK | MB_ICONINFORMATION);
+        return true;
+    }
+    catch (const std::exception& e) {
+        MessageBox(hwnd, e.what(), "Error Importing Annotations", MB_OK | MB_ICONERROR);
+        return false;
+    }
+}
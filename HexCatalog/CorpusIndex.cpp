@@ -0,0 +1,736 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include "CorpusIndex.h"
+#include "AnnotationFile.h"
+#include "MappedFile.h"
+#include "WorkerPool.h"
+
+// The index is read in place, which only works on a little-endian host
+static_assert(std::endian::native == std::endian::little, "corpus index files are little-endian");
+
+// Rows checked by one pool task when an index is opened
+const size_t ROWS_PER_CHECK_TASK = 1 << 20;
+
+// Labels compared by one pool task for a substring query
+const size_t LABELS_PER_SCAN_TASK = 65536;
+
+// Row ids are 32-bit, with one value kept free
+const uint64_t MAX_CORPUS_ROWS = UINT32_MAX;
+
+static std::runtime_error corruptIndex() {
+    return std::runtime_error("The corpus index is damaged or truncated.");
+}
+
+static uint64_t alignTo8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+static bool sectionFits(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize) {
+    return offset % 8 == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+//-------------------------------------------------------------------
+// Dictionary order
+//-------------------------------------------------------------------
+static BYTE foldCase(char c) {
+    BYTE byte = static_cast<BYTE>(c);
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+static int compareFolded(std::string_view a, std::string_view b) {
+    size_t common = std::min(a.size(), b.size());
+    for (size_t i = 0; i < common; ++i) {
+        BYTE x = foldCase(a[i]);
+        BYTE y = foldCase(b[i]);
+        if (x != y) {
+            return x < y ? -1 : 1;
+        }
+    }
+    return a.size() == b.size() ? 0 : a.size() < b.size() ? -1 : 1;
+}
+
+// Ignoring case first keeps entries that differ only in case next to each
+// other; the bytes then give them a fixed order
+static bool dictionaryLess(std::string_view a, std::string_view b) {
+    int order = compareFolded(a, b);
+    return order != 0 ? order < 0 : a < b;
+}
+
+static bool containsFolded(std::string_view text, std::string_view folded) {
+    for (size_t i = 0; i + folded.size() <= text.size(); ++i) {
+        size_t k = 0;
+        while (k < folded.size() && foldCase(text[i + k]) == static_cast<BYTE>(folded[k])) {
+            ++k;
+        }
+        if (k == folded.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//-------------------------------------------------------------------
+// Reading
+//-------------------------------------------------------------------
+CorpusIndex::CorpusIndex(const std::string& path) : mapped(std::make_unique<MappedFile>(path)) {
+    const BYTE* data = mapped->data();
+    size_t size = mapped->length();
+
+    if (size < sizeof(header)) {
+        throw corruptIndex();
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.signature, "HVC", 4) != 0) {
+        throw std::runtime_error(path + " is not a corpus index.");
+    }
+    if (header.version != CORPUS_INDEX_VERSION) {
+        throw std::runtime_error("The corpus index has an unsupported version.");
+    }
+
+    if (header.headerSize != sizeof(header) || header.blockRows != CORPUS_BLOCK_ROWS ||
+        header.rowCount > MAX_CORPUS_ROWS || header.fileCount > UINT32_MAX ||
+        header.labelCount > UINT32_MAX || header.formatCount > UINT32_MAX) {
+        throw corruptIndex();
+    }
+
+    uint64_t stringCount = header.fileCount + header.labelCount + header.formatCount;
+    uint64_t blockCount = (header.rowCount + CORPUS_BLOCK_ROWS - 1) / CORPUS_BLOCK_ROWS;
+    bool fits =
+        sectionFits(header.filesOffset, header.fileCount, sizeof(CorpusFileRecord), size) &&
+        sectionFits(header.stringStartsOffset, stringCount + 1, sizeof(uint64_t), size) &&
+        header.stringDataOffset <= size && header.stringDataSize <= size - header.stringDataOffset &&
+        sectionFits(header.blockMaxEndOffset, blockCount, sizeof(uint32_t), size) &&
+        sectionFits(header.labelRowStartsOffset, header.labelCount + 1, sizeof(uint64_t), size) &&
+        sectionFits(header.labelRowsOffset, header.rowCount, sizeof(uint32_t), size);
+    for (int which = 0; which < CORPUS_COLUMN_COUNT; ++which) {
+        fits = fits && sectionFits(header.columnOffsets[which], header.rowCount, sizeof(uint32_t), size);
+    }
+    if (!fits) {
+        throw corruptIndex();
+    }
+
+    files = reinterpret_cast<const CorpusFileRecord*>(data + header.filesOffset);
+    stringStarts = reinterpret_cast<const uint64_t*>(data + header.stringStartsOffset);
+    stringData = reinterpret_cast<const char*>(data + header.stringDataOffset);
+    for (int which = 0; which < CORPUS_COLUMN_COUNT; ++which) {
+        columns[which] = reinterpret_cast<const uint32_t*>(data + header.columnOffsets[which]);
+    }
+    blockMaxEnd = reinterpret_cast<const uint32_t*>(data + header.blockMaxEndOffset);
+    labelRowStarts = reinterpret_cast<const uint64_t*>(data + header.labelRowStartsOffset);
+    labelRows = reinterpret_cast<const uint32_t*>(data + header.labelRowsOffset);
+
+    if (stringStarts[0] != 0 || stringStarts[stringCount] > header.stringDataSize ||
+        labelRowStarts[0] != 0 || labelRowStarts[header.labelCount] != header.rowCount) {
+        throw corruptIndex();
+    }
+    for (uint64_t i = 0; i < stringCount; ++i) {
+        if (stringStarts[i] > stringStarts[i + 1]) {
+            throw corruptIndex();
+        }
+    }
+    for (uint64_t i = 0; i < header.labelCount; ++i) {
+        if (labelRowStarts[i] > labelRowStarts[i + 1]) {
+            throw corruptIndex();
+        }
+    }
+
+    // Every id must name an entry; offsets are plain values
+    std::atomic<bool> damaged = false;
+    size_t taskCount = (rowCount() + ROWS_PER_CHECK_TASK - 1) / ROWS_PER_CHECK_TASK;
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t first = task * ROWS_PER_CHECK_TASK;
+        size_t last = std::min(rowCount(), first + ROWS_PER_CHECK_TASK);
+        bool ok = true;
+        for (size_t row = first; row < last; ++row) {
+            ok &= columns[CORPUS_COLUMN_FILE][row] < header.fileCount;
+            ok &= columns[CORPUS_COLUMN_LABEL][row] < header.labelCount;
+            ok &= columns[CORPUS_COLUMN_FORMAT][row] < header.formatCount;
+            ok &= labelRows[row] < header.rowCount;
+        }
+        if (!ok) {
+            damaged = true;
+        }
+    });
+    if (damaged) {
+        throw corruptIndex();
+    }
+}
+
+CorpusIndex::~CorpusIndex() = default;
+
+//-------------------------------------------------------------------
+// Queries
+//-------------------------------------------------------------------
+std::pair<uint32_t, uint32_t> CorpusIndex::dictionaryRange(uint64_t firstString, uint64_t count,
+    std::string_view text, bool prefix) const {
+    // Cutting entries to the length of text keeps them in order, so a prefix
+    // match is a run just like an exact one
+    auto entry = [&](uint64_t id) {
+        std::string_view value = string(firstString + id);
+        return prefix ? value.substr(0, text.size()) : value;
+    };
+    auto firstWhere = [&](auto predicate) {
+        uint64_t low = 0;
+        uint64_t high = count;
+        while (low < high) {
+            uint64_t middle = low + (high - low) / 2;
+            if (predicate(middle)) {
+                high = middle;
+            }
+            else {
+                low = middle + 1;
+            }
+        }
+        return static_cast<uint32_t>(low);
+    };
+
+    uint32_t first = firstWhere([&](uint64_t id) { return compareFolded(entry(id), text) >= 0; });
+    uint32_t last = firstWhere([&](uint64_t id) { return compareFolded(entry(id), text) > 0; });
+    return { first, last };
+}
+
+std::vector<uint32_t> CorpusIndex::labelIds(const CorpusQuery& query) const {
+    std::vector<uint32_t> ids;
+
+    if (query.labelMatch != CorpusLabelMatch::Substring) {
+        auto [first, last] = dictionaryRange(header.fileCount, header.labelCount, query.label,
+            query.labelMatch == CorpusLabelMatch::Prefix);
+        for (uint32_t id = first; id < last; ++id) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
+
+    // The dictionary is far smaller than the rows, so it is simply scanned
+    std::string folded(query.label.size(), '\0');
+    std::transform(query.label.begin(), query.label.end(), folded.begin(),
+        [](char c) { return static_cast<char>(foldCase(c)); });
+
+    size_t taskCount = (labelCount() + LABELS_PER_SCAN_TASK - 1) / LABELS_PER_SCAN_TASK;
+    std::vector<std::vector<uint32_t>> partial(taskCount);
+    WorkerPool::shared().parallelFor(taskCount, [&](size_t task) {
+        size_t first = task * LABELS_PER_SCAN_TASK;
+        size_t last = std::min(labelCount(), first + LABELS_PER_SCAN_TASK);
+        for (size_t id = first; id < last; ++id) {
+            if (containsFolded(label(static_cast<uint32_t>(id)), folded)) {
+                partial[task].push_back(static_cast<uint32_t>(id));
+            }
+        }
+    });
+    for (const auto& part : partial) {
+        ids.insert(ids.end(), part.begin(), part.end());
+    }
+    return ids;
+}
+
+std::vector<uint32_t> CorpusIndex::find(const CorpusQuery& query) const {
+    std::vector<uint32_t> rows;
+
+    uint32_t firstFormat = 0;
+    uint32_t lastFormat = static_cast<uint32_t>(header.formatCount);
+    if (!query.format.empty()) {
+        std::tie(firstFormat, lastFormat) = dictionaryRange(header.fileCount + header.labelCount,
+            header.formatCount, query.format, false);
+        if (firstFormat == lastFormat) {
+            return rows;
+        }
+    }
+
+    const uint32_t* starts = columns[CORPUS_COLUMN_START];
+    const uint32_t* ends = columns[CORPUS_COLUMN_END];
+    const uint32_t* formats = columns[CORPUS_COLUMN_FORMAT];
+    auto matches = [&](uint32_t row) {
+        if (query.hasRange && (starts[row] > query.last || ends[row] < query.first)) {
+            return false;
+        }
+        return formats[row] >= firstFormat && formats[row] < lastFormat;
+    };
+
+    if (!query.label.empty()) {
+        for (uint32_t id : labelIds(query)) {
+            // A label's rows are in start order too, so those starting past
+            // the range are cut off by a binary search
+            const uint32_t* first = labelRows + labelRowStarts[id];
+            const uint32_t* last = labelRows + labelRowStarts[id + 1];
+            if (query.hasRange) {
+                last = std::upper_bound(first, last, query.last,
+                    [&](uint32_t offset, uint32_t row) { return offset < starts[row]; });
+            }
+            for (const uint32_t* row = first; row != last; ++row) {
+                if (matches(*row)) {
+                    rows.push_back(*row);
+                }
+            }
+        }
+    }
+    else {
+        // Rows are in start order, so none past the range can overlap it,
+        // and blocks that end before the range are skipped whole
+        size_t rowLimit = rowCount();
+        if (query.hasRange) {
+            rowLimit = std::upper_bound(starts, starts + rowCount(), query.last) - starts;
+        }
+
+        size_t blockCount = (rowLimit + CORPUS_BLOCK_ROWS - 1) / CORPUS_BLOCK_ROWS;
+        std::vector<std::vector<uint32_t>> partial(blockCount);
+        WorkerPool::shared().parallelFor(blockCount, [&](size_t block) {
+            if (query.hasRange && blockMaxEnd[block] < query.first) {
+                return;
+            }
+            size_t first = block * CORPUS_BLOCK_ROWS;
+            size_t last = std::min(rowLimit, first + CORPUS_BLOCK_ROWS);
+            for (size_t row = first; row < last; ++row) {
+                if (matches(static_cast<uint32_t>(row))) {
+                    partial[block].push_back(static_cast<uint32_t>(row));
+                }
+            }
+        });
+        for (const auto& part : partial) {
+            rows.insert(rows.end(), part.begin(), part.end());
+        }
+    }
+
+    // Within a file, row order is start offset order
+    std::vector<uint64_t> keys(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        keys[i] = (static_cast<uint64_t>(columns[CORPUS_COLUMN_FILE][rows[i]]) << 32) | rows[i];
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = static_cast<uint32_t>(keys[i]);
+    }
+    return rows;
+}
+
+//-------------------------------------------------------------------
+// Ingest
+//-------------------------------------------------------------------
+// Strings numbered in the order first seen, then renumbered in dictionary
+// order once all are known. Entries refer to strings that outlive the
+// builder.
+class DictionaryBuilder {
+public:
+    uint32_t add(std::string_view text) {
+        auto [it, inserted] = ids.try_emplace(text, static_cast<uint32_t>(names.size()));
+        if (inserted) {
+            names.push_back(text);
+        }
+        return it->second;
+    }
+
+    // Sort the entries and return the final id of each provisional one
+    std::vector<uint32_t> sort() {
+        std::vector<uint32_t> order(names.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dictionaryLess(names[a], names[b]); });
+
+        std::vector<uint32_t> finalId(names.size());
+        std::vector<std::string_view> sorted(names.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            finalId[order[i]] = i;
+            sorted[i] = names[order[i]];
+        }
+        names = std::move(sorted);
+        return finalId;
+    }
+
+    std::vector<std::string_view> names;
+
+private:
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+// One annotation file read for ingest, with labels and formats numbered
+// locally so files can be read in parallel without sharing a dictionary
+struct FileRows {
+    std::string path;
+    CorpusFileRecord record = {};
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> ends;
+    std::vector<uint32_t> labels;
+    std::vector<uint32_t> formats;
+    std::vector<std::string> labelNames;
+    std::vector<std::string> formatNames;
+    std::string error;
+};
+
+static uint32_t localId(std::unordered_map<std::string_view, uint32_t>& ids, std::vector<std::string>& names,
+    std::string_view text) {
+    auto [it, inserted] = ids.try_emplace(text, static_cast<uint32_t>(names.size()));
+    if (inserted) {
+        names.emplace_back(text);
+    }
+    return it->second;
+}
+
+static void readFileRows(FileRows& rows) {
+    try {
+        // There is no document to check the offsets against
+        AnnotationFileContents contents = ReadAnnotationFile(rows.path, SIZE_MAX);
+
+        rows.record.documentSize = contents.fingerprint.size;
+        rows.record.documentHash = contents.fingerprint.hash;
+        rows.record.annotationCount = contents.annotations.size();
+
+        // Keyed by the strings in contents, which outlive the maps
+        std::unordered_map<std::string_view, uint32_t> labelIds;
+        std::unordered_map<std::string_view, uint32_t> formatIds;
+        size_t count = contents.annotations.size();
+        rows.starts.reserve(count);
+        rows.ends.reserve(count);
+        rows.labels.reserve(count);
+        rows.formats.reserve(count);
+        for (const auto& anno : contents.annotations) {
+            rows.starts.push_back(static_cast<uint32_t>(anno.startOffset));
+            rows.ends.push_back(static_cast<uint32_t>(anno.endOffset));
+            rows.labels.push_back(localId(labelIds, rows.labelNames, anno.label));
+            rows.formats.push_back(localId(formatIds, rows.formatNames, anno.displayFormat));
+        }
+    }
+    catch (const std::exception& e) {
+        rows.error = e.what();
+    }
+}
+
+static bool hasAnnotationExtension(const std::string& name) {
+    return name.size() >= 4 && compareFolded(std::string_view(name).substr(name.size() - 4), ".hva") == 0;
+}
+
+static std::string fullPath(const std::string& path) {
+    char buffer[MAX_PATH];
+    DWORD length = GetFullPathName(path.c_str(), MAX_PATH, buffer, NULL);
+    return length > 0 && length < MAX_PATH ? std::string(buffer, length) : path;
+}
+
+// Files named directly are taken whatever their extension; directories
+// contribute their .hva files, recursively
+static void collectSources(const std::string& path, std::vector<std::string>& out) {
+    DWORD attributes = GetFileAttributes(path.c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        throw std::runtime_error("Cannot find " + path + ".");
+    }
+    if (!(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        out.push_back(path);
+        return;
+    }
+
+    WIN32_FIND_DATA found;
+    HANDLE search = FindFirstFile((path + "\\*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    do {
+        std::string name = found.cFileName;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            collectSources(path + "\\" + name, out);
+        }
+        else if (hasAnnotationExtension(name)) {
+            out.push_back(path + "\\" + name);
+        }
+    } while (FindNextFile(search, &found));
+    FindClose(search);
+}
+
+// Size and last write time, or false if path is not a readable file
+static bool sourceAttributes(const std::string& path, CorpusFileRecord& record) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributes) ||
+        (attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        return false;
+    }
+    record.sourceSize = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    record.sourceWriteTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+        attributes.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+// Where the rows of one file of the new index come from
+struct IngestEntry {
+    std::string_view path;
+    CorpusFileRecord record;
+    size_t oldFile;             // Index in the existing index, if carried over
+    FileRows* read;             // Otherwise the rows just read
+};
+
+CorpusIngestResult IngestAnnotationFiles(const std::string& indexPath, const std::vector<std::string>& sources) {
+    CorpusIngestResult result;
+
+    std::vector<std::string> paths;
+    for (const auto& source : sources) {
+        collectSources(fullPath(source), paths);
+    }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    std::unique_ptr<CorpusIndex> existing;
+    if (GetFileAttributes(indexPath.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        existing = std::make_unique<CorpusIndex>(indexPath);
+    }
+
+    // Files indexed before are kept if unchanged, read again if changed
+    // and dropped if gone; named files not indexed yet are read
+    std::vector<IngestEntry> entries;
+    std::vector<std::string> toRead;
+    std::unordered_map<std::string_view, size_t> indexed;
+    if (existing) {
+        for (size_t i = 0; i < existing->fileCount(); ++i) {
+            std::string path(existing->filePath(i));
+            CorpusFileRecord current = {};
+            if (!sourceAttributes(path, current)) {
+                ++result.filesDropped;
+                continue;
+            }
+            indexed.emplace(existing->filePath(i), i);
+            if (current.sourceSize == existing->file(i).sourceSize &&
+                current.sourceWriteTime == existing->file(i).sourceWriteTime) {
+                entries.push_back({ existing->filePath(i), existing->file(i), i, nullptr });
+            }
+            else {
+                toRead.push_back(std::move(path));
+            }
+        }
+    }
+    for (const auto& path : paths) {
+        if (indexed.find(path) == indexed.end()) {
+            toRead.push_back(path);
+        }
+    }
+    result.filesUnchanged = entries.size();
+
+    std::vector<FileRows> read(toRead.size());
+    WorkerPool::shared().parallelFor(read.size(), [&](size_t i) {
+        read[i].path = std::move(toRead[i]);
+        if (!sourceAttributes(read[i].path, read[i].record)) {
+            read[i].error = "The file cannot be opened.";
+            return;
+        }
+        readFileRows(read[i]);
+    });
+    for (auto& rows : read) {
+        if (!rows.error.empty()) {
+            result.failures.push_back(rows.path + ": " + rows.error);
+            continue;
+        }
+        entries.push_back({ rows.path, rows.record, 0, &rows });
+        ++result.filesRead;
+    }
+
+    std::sort(entries.begin(), entries.end(),
+        [](const IngestEntry& a, const IngestEntry& b) { return a.path < b.path; });
+
+    // Gather the rows with provisional label and format ids
+    const size_t NOT_CARRIED = SIZE_MAX;
+    std::vector<size_t> carriedAs(existing ? existing->fileCount() : 0, NOT_CARRIED);
+    uint64_t totalRows = 0;
+    for (size_t file = 0; file < entries.size(); ++file) {
+        if (entries[file].read) {
+            totalRows += entries[file].read->starts.size();
+        }
+        else {
+            carriedAs[entries[file].oldFile] = file;
+            totalRows += entries[file].record.annotationCount;
+        }
+    }
+    if (totalRows > MAX_CORPUS_ROWS) {
+        throw std::runtime_error("There are too many annotations for one corpus index.");
+    }
+
+    std::vector<uint32_t> columns[CORPUS_COLUMN_COUNT];
+    for (auto& column : columns) {
+        column.reserve(static_cast<size_t>(totalRows));
+    }
+    DictionaryBuilder labels;
+    DictionaryBuilder formats;
+
+    if (existing) {
+        std::vector<uint32_t> labelOf(existing->labelCount(), UINT32_MAX);
+        std::vector<uint32_t> formatOf;
+        for (size_t row = 0; row < existing->rowCount(); ++row) {
+            size_t file = carriedAs[existing->column(CORPUS_COLUMN_FILE, row)];
+            if (file == NOT_CARRIED) {
+                continue;
+            }
+            uint32_t label = existing->column(CORPUS_COLUMN_LABEL, row);
+            if (labelOf[label] == UINT32_MAX) {
+                labelOf[label] = labels.add(existing->label(label));
+            }
+            uint32_t format = existing->column(CORPUS_COLUMN_FORMAT, row);
+            if (format >= formatOf.size()) {
+                formatOf.resize(format + 1, UINT32_MAX);
+            }
+            if (formatOf[format] == UINT32_MAX) {
+                formatOf[format] = formats.add(existing->format(format));
+            }
+            columns[CORPUS_COLUMN_START].push_back(existing->column(CORPUS_COLUMN_START, row));
+            columns[CORPUS_COLUMN_END].push_back(existing->column(CORPUS_COLUMN_END, row));
+            columns[CORPUS_COLUMN_FILE].push_back(static_cast<uint32_t>(file));
+            columns[CORPUS_COLUMN_LABEL].push_back(labelOf[label]);
+            columns[CORPUS_COLUMN_FORMAT].push_back(formatOf[format]);
+        }
+    }
+
+    for (size_t file = 0; file < entries.size(); ++file) {
+        const FileRows* rows = entries[file].read;
+        if (!rows) {
+            continue;
+        }
+        std::vector<uint32_t> labelOf(rows->labelNames.size());
+        for (size_t i = 0; i < labelOf.size(); ++i) {
+            labelOf[i] = labels.add(rows->labelNames[i]);
+        }
+        std::vector<uint32_t> formatOf(rows->formatNames.size());
+        for (size_t i = 0; i < formatOf.size(); ++i) {
+            formatOf[i] = formats.add(rows->formatNames[i]);
+        }
+        for (size_t i = 0; i < rows->starts.size(); ++i) {
+            columns[CORPUS_COLUMN_START].push_back(rows->starts[i]);
+            columns[CORPUS_COLUMN_END].push_back(rows->ends[i]);
+            columns[CORPUS_COLUMN_FILE].push_back(static_cast<uint32_t>(file));
+            columns[CORPUS_COLUMN_LABEL].push_back(labelOf[rows->labels[i]]);
+            columns[CORPUS_COLUMN_FORMAT].push_back(formatOf[rows->formats[i]]);
+        }
+    }
+
+    // Final ids in dictionary order, rows in start order
+    std::vector<uint32_t> labelId = labels.sort();
+    std::vector<uint32_t> formatId = formats.sort();
+
+    size_t rowCount = columns[CORPUS_COLUMN_START].size();
+    std::vector<uint64_t> keys(rowCount);
+    for (size_t row = 0; row < rowCount; ++row) {
+        keys[row] = (static_cast<uint64_t>(columns[CORPUS_COLUMN_START][row]) << 32) | row;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    WorkerPool::shared().parallelFor(CORPUS_COLUMN_COUNT, [&](size_t which) {
+        std::vector<uint32_t> sorted(rowCount);
+        for (size_t row = 0; row < rowCount; ++row) {
+            uint32_t value = columns[which][static_cast<uint32_t>(keys[row])];
+            sorted[row] = which == CORPUS_COLUMN_LABEL ? labelId[value] :
+                which == CORPUS_COLUMN_FORMAT ? formatId[value] : value;
+        }
+        columns[which] = std::move(sorted);
+    });
+    keys = std::vector<uint64_t>();
+
+    std::vector<uint32_t> blockMaxEnd((rowCount + CORPUS_BLOCK_ROWS - 1) / CORPUS_BLOCK_ROWS, 0);
+    for (size_t row = 0; row < rowCount; ++row) {
+        uint32_t& maxEnd = blockMaxEnd[row / CORPUS_BLOCK_ROWS];
+        maxEnd = std::max(maxEnd, columns[CORPUS_COLUMN_END][row]);
+    }
+
+    // Rows of each label, in row order
+    std::vector<uint64_t> labelRowStarts(labels.names.size() + 1, 0);
+    for (uint32_t label : columns[CORPUS_COLUMN_LABEL]) {
+        ++labelRowStarts[label + 1];
+    }
+    std::partial_sum(labelRowStarts.begin(), labelRowStarts.end(), labelRowStarts.begin());
+    std::vector<uint32_t> labelRows(rowCount);
+    {
+        std::vector<uint64_t> next(labelRowStarts.begin(), labelRowStarts.end() - 1);
+        for (size_t row = 0; row < rowCount; ++row) {
+            labelRows[next[columns[CORPUS_COLUMN_LABEL][row]]++] = static_cast<uint32_t>(row);
+        }
+    }
+
+    // Paths, labels and formats in one string table
+    std::vector<uint64_t> stringStarts;
+    std::string stringData;
+    stringStarts.reserve(entries.size() + labels.names.size() + formats.names.size() + 1);
+    stringStarts.push_back(0);
+    auto addString = [&](std::string_view text) {
+        stringData.append(text);
+        stringStarts.push_back(stringData.size());
+    };
+    std::vector<CorpusFileRecord> records;
+    records.reserve(entries.size());
+    for (const auto& entry : entries) {
+        addString(entry.path);
+        records.push_back(entry.record);
+    }
+    for (std::string_view label : labels.names) {
+        addString(label);
+    }
+    for (std::string_view format : formats.names) {
+        addString(format);
+    }
+
+    CorpusIndexHeader header = {};
+    memcpy(header.signature, "HVC", 4);
+    header.version = CORPUS_INDEX_VERSION;
+    header.headerSize = sizeof(CorpusIndexHeader);
+    header.blockRows = static_cast<uint32_t>(CORPUS_BLOCK_ROWS);
+    header.fileCount = records.size();
+    header.rowCount = rowCount;
+    header.labelCount = labels.names.size();
+    header.formatCount = formats.names.size();
+    header.filesOffset = alignTo8(sizeof(header));
+    header.stringStartsOffset = alignTo8(header.filesOffset + records.size() * sizeof(CorpusFileRecord));
+    header.stringDataOffset = alignTo8(header.stringStartsOffset + stringStarts.size() * sizeof(uint64_t));
+    header.stringDataSize = stringData.size();
+    uint64_t offset = header.stringDataOffset + stringData.size();
+    for (int which = 0; which < CORPUS_COLUMN_COUNT; ++which) {
+        header.columnOffsets[which] = alignTo8(offset);
+        offset = header.columnOffsets[which] + rowCount * sizeof(uint32_t);
+    }
+    header.blockMaxEndOffset = alignTo8(offset);
+    header.labelRowStartsOffset = alignTo8(header.blockMaxEndOffset + blockMaxEnd.size() * sizeof(uint32_t));
+    header.labelRowsOffset = alignTo8(header.labelRowStartsOffset + labelRowStarts.size() * sizeof(uint64_t));
+
+    // Written beside the index and moved over it, so a failed ingest leaves
+    // the previous index intact
+    std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + temporaryPath + " for writing.");
+        }
+
+        const char padding[8] = {};
+        auto writeAt = [&](uint64_t position, const void* bytes, size_t length) {
+            uint64_t current = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<std::streamsize>(position - current));
+            file.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(length));
+        };
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeAt(header.filesOffset, records.data(), records.size() * sizeof(CorpusFileRecord));
+        writeAt(header.stringStartsOffset, stringStarts.data(), stringStarts.size() * sizeof(uint64_t));
+        writeAt(header.stringDataOffset, stringData.data(), stringData.size());
+        for (int which = 0; which < CORPUS_COLUMN_COUNT; ++which) {
+            writeAt(header.columnOffsets[which], columns[which].data(), rowCount * sizeof(uint32_t));
+        }
+        writeAt(header.blockMaxEndOffset, blockMaxEnd.data(), blockMaxEnd.size() * sizeof(uint32_t));
+        writeAt(header.labelRowStartsOffset, labelRowStarts.data(), labelRowStarts.size() * sizeof(uint64_t));
+        writeAt(header.labelRowsOffset, labelRows.data(), labelRows.size() * sizeof(uint32_t));
+
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Failed to write " + temporaryPath + ".");
+        }
+    }
+
+    // Carried strings point into the old index, which is no longer needed
+    entries.clear();
+    labels.names.clear();
+    formats.names.clear();
+    existing.reset();
+    if (!MoveFileEx(temporaryPath.c_str(), indexPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        throw std::runtime_error("Failed to replace " + indexPath + ".");
+    }
+
+    result.rowCount = rowCount;
+    return result;
+}
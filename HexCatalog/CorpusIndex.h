@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "includes.h"
+
+class MappedFile;
+
+// The annotations of many .hva files in one column store, so questions such
+// as "which samples label offset 0x40 'Entry point'" are answered without
+// opening every file.
+//
+// There is one row per annotation. The rows of all files are sorted by start
+// offset and stored a column at a time. Labels and formats are dictionary
+// coded, with the dictionaries sorted ignoring ASCII case so exact and prefix
+// label queries resolve to a run of ids. Every label id lists its rows, so a
+// label query reads only those, and every block of CORPUS_BLOCK_ROWS rows
+// records its largest end offset, so an offset query skips the blocks that
+// end before the range.
+//
+// Little-endian throughout, every section 8-byte aligned:
+//
+//   CorpusIndexHeader
+//   CorpusFileRecord[fileCount]
+//   uint64_t stringStarts[stringCount + 1]   paths, then labels, then formats
+//   string data (not terminated)
+//   uint32_t column[rowCount]                one per CorpusColumn
+//   uint32_t blockMaxEnd[blockCount]
+//   uint64_t labelRowStarts[labelCount + 1]  into labelRows
+//   uint32_t labelRows[rowCount]             ascending per label
+const uint32_t CORPUS_INDEX_VERSION = 1;
+
+// Rows summarized by one blockMaxEnd entry
+const size_t CORPUS_BLOCK_ROWS = 4096;
+
+enum CorpusColumn {
+    CORPUS_COLUMN_START,
+    CORPUS_COLUMN_END,          // Inclusive, as in Annotation
+    CORPUS_COLUMN_FILE,         // Index into the file records
+    CORPUS_COLUMN_LABEL,        // Label id
+    CORPUS_COLUMN_FORMAT,       // Format id
+    CORPUS_COLUMN_COUNT
+};
+
+struct CorpusIndexHeader {
+    char signature[4];          // "HVC\0" (Hex Viewer Corpus)
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(CorpusIndexHeader)
+    uint32_t blockRows;         // CORPUS_BLOCK_ROWS
+    uint64_t fileCount;
+    uint64_t rowCount;
+    uint64_t labelCount;
+    uint64_t formatCount;
+    uint64_t filesOffset;
+    uint64_t stringStartsOffset;
+    uint64_t stringDataOffset;
+    uint64_t stringDataSize;
+    uint64_t columnOffsets[CORPUS_COLUMN_COUNT];
+    uint64_t blockMaxEndOffset;
+    uint64_t labelRowStartsOffset;
+    uint64_t labelRowsOffset;
+};
+
+struct CorpusFileRecord {
+    uint64_t documentSize;      // Fingerprint stored in the .hva file,
+    uint64_t documentHash;      // zero if it has none
+    uint64_t sourceSize;        // Size and last write time of the .hva file
+    uint64_t sourceWriteTime;   // when it was read, to skip it if unchanged
+    uint64_t annotationCount;
+};
+
+static_assert(sizeof(CorpusIndexHeader) == 144, "header layout is part of the file format");
+static_assert(sizeof(CorpusFileRecord) == 40, "file record layout is part of the file format");
+
+enum class CorpusLabelMatch {
+    Exact,
+    Prefix,
+    Substring
+};
+
+// Rows matching every criterion that is set. Labels and formats are
+// compared ignoring ASCII case.
+struct CorpusQuery {
+    std::string label;          // Any label if empty
+    CorpusLabelMatch labelMatch = CorpusLabelMatch::Exact;
+    bool hasRange = false;      // Rows overlapping [first, last]
+    uint32_t first = 0;
+    uint32_t last = 0;
+    std::string format;         // Any format if empty
+};
+
+// A mapped, validated index file. Damage that would lead reads outside the
+// file is detected when it is opened; the sort orders are trusted.
+class CorpusIndex {
+public:
+    // Throws std::runtime_error if the file cannot be read or is damaged
+    explicit CorpusIndex(const std::string& path);
+    ~CorpusIndex();
+
+    CorpusIndex(const CorpusIndex&) = delete;
+    CorpusIndex& operator=(const CorpusIndex&) = delete;
+
+    size_t fileCount() const { return static_cast<size_t>(header.fileCount); }
+    size_t rowCount() const { return static_cast<size_t>(header.rowCount); }
+    size_t labelCount() const { return static_cast<size_t>(header.labelCount); }
+
+    const CorpusFileRecord& file(size_t index) const { return files[index]; }
+    std::string_view filePath(size_t index) const { return string(index); }
+
+    uint32_t column(CorpusColumn which, size_t row) const { return columns[which][row]; }
+    std::string_view label(uint32_t id) const { return string(header.fileCount + id); }
+    std::string_view format(uint32_t id) const { return string(header.fileCount + header.labelCount + id); }
+
+    // Matching rows ordered by file, then start offset
+    std::vector<uint32_t> find(const CorpusQuery& query) const;
+
+private:
+    std::string_view string(uint64_t index) const {
+        return std::string_view(stringData + stringStarts[index], stringStarts[index + 1] - stringStarts[index]);
+    }
+
+    // Ids [first, last) of dictionary entries from firstString equal to, or
+    // starting with, text
+    std::pair<uint32_t, uint32_t> dictionaryRange(uint64_t firstString, uint64_t count, std::string_view text,
+        bool prefix) const;
+    std::vector<uint32_t> labelIds(const CorpusQuery& query) const;
+
+    std::unique_ptr<MappedFile> mapped;
+    CorpusIndexHeader header = {};
+    const CorpusFileRecord* files = nullptr;
+    const uint64_t* stringStarts = nullptr;
+    const char* stringData = nullptr;
+    const uint32_t* columns[CORPUS_COLUMN_COUNT] = {};
+    const uint32_t* blockMaxEnd = nullptr;
+    const uint64_t* labelRowStarts = nullptr;
+    const uint32_t* labelRows = nullptr;
+};
+
+struct CorpusIngestResult {
+    size_t filesRead = 0;       // New or changed since the last ingest
+    size_t filesUnchanged = 0;  // Carried over from the existing index
+    size_t filesDropped = 0;    // Indexed before but no longer there
+    size_t rowCount = 0;
+    std::vector<std::string> failures;  // "<path>: <reason>"
+};
+
+// Add the .hva files named by sources to the index at indexPath, creating it
+// if there is none. A source is a file or a directory searched recursively.
+// Files already indexed are read again only if their size or write time
+// changed, and dropped if they are gone. New files are read in parallel.
+// Throws std::runtime_error if the index cannot be read or written; files
+// that cannot be read are listed in the result instead.
+CorpusIngestResult IngestAnnotationFiles(const std::string& indexPath, const std::vector<std::string>& sources);
@@ -0,0 +1,287 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "CorpusIndex.h"
+#include "AnnotationFile.h"
+#include "WorkerPool.h"
+
+// Command-line front end for corpus indexes, see CorpusIndex.h
+
+// Rows printed by a query unless --limit says otherwise
+const size_t DEFAULT_QUERY_LIMIT = 100;
+
+// Defaults of the benchmark command
+const size_t BENCHMARK_FILES = 10000;
+const size_t BENCHMARK_ANNOTATIONS_PER_FILE = 200;
+const size_t BENCHMARK_DOCUMENT_SIZE = 1024 * 1024;
+
+static void printUsage() {
+    fprintf(stderr,
+        "Usage:\n"
+        "  HexCatalog ingest <index> <file or directory>...\n"
+        "  HexCatalog query <index> [--label TEXT | --label-prefix TEXT | --label-contains TEXT]\n"
+        "                           [--offset N | --offset FIRST-LAST] [--format NAME] [--limit N]\n"
+        "  HexCatalog benchmark <directory> [files] [annotations per file]\n"
+        "\n"
+        "Directories are searched recursively for .hva files. A query lists the\n"
+        "annotations matching every option given, by file and offset; offsets are\n"
+        "decimal or 0x-prefixed hex, and labels and formats ignore case.\n");
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint64_t parseNumber(const std::string& text, uint64_t limit) {
+    char* end = nullptr;
+    unsigned long long value = strtoull(text.c_str(), &end, 0);
+    if (text.empty() || *end != '\0' || value > limit) {
+        throw std::runtime_error("Invalid number: " + text);
+    }
+    return value;
+}
+
+static uint64_t fileSize(const std::string& path) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &attributes)) {
+        return 0;
+    }
+    return (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+}
+
+//-------------------------------------------------------------------
+// Commands
+//-------------------------------------------------------------------
+static CorpusIngestResult ingest(const std::string& indexPath, const std::vector<std::string>& sources) {
+    auto start = std::chrono::steady_clock::now();
+    CorpusIngestResult result = IngestAnnotationFiles(indexPath, sources);
+    double seconds = secondsSince(start);
+
+    for (const auto& failure : result.failures) {
+        fprintf(stderr, "Skipped %s\n", failure.c_str());
+    }
+    printf("Indexed %zu files (%zu read, %zu unchanged, %zu dropped, %zu failed), %zu annotations in %.2f s\n",
+        result.filesRead + result.filesUnchanged, result.filesRead, result.filesUnchanged, result.filesDropped,
+        result.failures.size(), result.rowCount, seconds);
+    return result;
+}
+
+static int ingestCommand(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        printUsage();
+        return 2;
+    }
+    ingest(args[0], std::vector<std::string>(args.begin() + 1, args.end()));
+    return 0;
+}
+
+static void printRows(const CorpusIndex& index, const std::vector<uint32_t>& rows, size_t limit) {
+    for (size_t i = 0; i < rows.size() && i < limit; ++i) {
+        uint32_t row = rows[i];
+        std::string path(index.filePath(index.column(CORPUS_COLUMN_FILE, row)));
+        std::string format(index.format(index.column(CORPUS_COLUMN_FORMAT, row)));
+        std::string label(index.label(index.column(CORPUS_COLUMN_LABEL, row)));
+        printf("%s\t0x%08X-0x%08X\t%s\t%s\n", path.c_str(), index.column(CORPUS_COLUMN_START, row),
+            index.column(CORPUS_COLUMN_END, row), format.c_str(), label.c_str());
+    }
+}
+
+static size_t distinctFiles(const CorpusIndex& index, const std::vector<uint32_t>& rows) {
+    // Rows come ordered by file
+    size_t count = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (i == 0 || index.column(CORPUS_COLUMN_FILE, rows[i]) != index.column(CORPUS_COLUMN_FILE, rows[i - 1])) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static int queryCommand(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        printUsage();
+        return 2;
+    }
+
+    CorpusQuery query;
+    size_t limit = DEFAULT_QUERY_LIMIT;
+    for (size_t i = 1; i < args.size(); i += 2) {
+        if (i + 1 >= args.size()) {
+            throw std::runtime_error("Missing value for " + args[i] + ".");
+        }
+        const std::string& option = args[i];
+        const std::string& value = args[i + 1];
+
+        if (option == "--label" || option == "--label-prefix" || option == "--label-contains") {
+            query.label = value;
+            query.labelMatch = option == "--label" ? CorpusLabelMatch::Exact :
+                option == "--label-prefix" ? CorpusLabelMatch::Prefix : CorpusLabelMatch::Substring;
+        }
+        else if (option == "--offset") {
+            size_t dash = value.find('-', 1);
+            query.hasRange = true;
+            query.first = static_cast<uint32_t>(parseNumber(value.substr(0, dash), UINT32_MAX));
+            query.last = dash == std::string::npos ? query.first :
+                static_cast<uint32_t>(parseNumber(value.substr(dash + 1), UINT32_MAX));
+            if (query.last < query.first) {
+                throw std::runtime_error("The offset range " + value + " is empty.");
+            }
+        }
+        else if (option == "--format") {
+            query.format = value;
+        }
+        else if (option == "--limit") {
+            limit = static_cast<size_t>(parseNumber(value, SIZE_MAX));
+        }
+        else {
+            throw std::runtime_error("Unknown option " + option + ".");
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    CorpusIndex index(args[0]);
+    double openSeconds = secondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> rows = index.find(query);
+    double querySeconds = secondsSince(start);
+
+    printRows(index, rows, limit);
+    fprintf(stderr, "%zu annotations in %zu files%s (opened in %.1f ms, searched in %.1f ms)\n", rows.size(),
+        distinctFiles(index, rows), rows.size() > limit ? ", first shown" : "", openSeconds * 1000, querySeconds * 1000);
+    return 0;
+}
+
+//-------------------------------------------------------------------
+// Benchmark
+//-------------------------------------------------------------------
+// Labels typical of binary formats; the numbered ones make the dictionary
+// large, as in a real corpus
+static const char* const BENCHMARK_LABELS[] = {
+    "Signature", "Header size", "Entry point", "Section table", "Import directory", "Export directory",
+    "Resource directory", "Checksum", "Timestamp", "Magic", "Version", "Flags", "String table", "Padding",
+};
+static const char* const BENCHMARK_FORMATS[] = { "hex", "int", "ascii", "float" };
+
+static void writeBenchmarkFile(const std::string& path, size_t seed, size_t annotationCount) {
+    std::mt19937 rng(static_cast<unsigned>(seed));
+    std::vector<Annotation> annotations(annotationCount);
+    for (auto& anno : annotations) {
+        anno.startOffset = static_cast<int>(rng() % (BENCHMARK_DOCUMENT_SIZE - 64));
+        anno.endOffset = anno.startOffset + static_cast<int>(rng() % 64);
+        anno.label = rng() % 4 == 0 ? "Field " + std::to_string(rng() % 100000)
+            : BENCHMARK_LABELS[rng() % std::size(BENCHMARK_LABELS)];
+        anno.displayFormat = BENCHMARK_FORMATS[rng() % std::size(BENCHMARK_FORMATS)];
+        anno.colorIndex = static_cast<int>(rng() % std::size(annotationColors));
+    }
+
+    ContentFingerprint fingerprint = { BENCHMARK_DOCUMENT_SIZE, 0x9E3779B97F4A7C15ull * (seed + 1) };
+    WriteAnnotationFile(path, "sample" + std::to_string(seed) + ".bin", fingerprint, annotations);
+}
+
+static void timeQuery(const CorpusIndex& index, const char* name, const CorpusQuery& query) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> rows = index.find(query);
+    double seconds = secondsSince(start);
+    printf("  %-40s %9zu rows %6zu files %9.3f ms\n", name, rows.size(), distinctFiles(index, rows), seconds * 1000);
+}
+
+static int benchmarkCommand(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        printUsage();
+        return 2;
+    }
+    std::string directory = args[0];
+    size_t fileCount = args.size() > 1 ? static_cast<size_t>(parseNumber(args[1], UINT32_MAX)) : BENCHMARK_FILES;
+    size_t perFile = args.size() > 2 ? static_cast<size_t>(parseNumber(args[2], INT32_MAX)) : BENCHMARK_ANNOTATIONS_PER_FILE;
+
+    CreateDirectory(directory.c_str(), NULL);
+    std::string samples = directory + "\\samples";
+    CreateDirectory(samples.c_str(), NULL);
+    std::string indexPath = directory + "\\corpus.hvc";
+    DeleteFile(indexPath.c_str());
+
+    printf("Writing %zu annotation files of %zu annotations...\n", fileCount, perFile);
+    auto start = std::chrono::steady_clock::now();
+    WorkerPool::shared().parallelFor(fileCount, [&](size_t i) {
+        char name[32];
+        sprintf_s(name, sizeof(name), "\\sample%06zu.hva", i);
+        writeBenchmarkFile(samples + name, i, perFile);
+    });
+    printf("  written in %.2f s\n", secondsSince(start));
+
+    printf("Ingest into an empty index:\n  ");
+    start = std::chrono::steady_clock::now();
+    CorpusIngestResult result = ingest(indexPath, { samples });
+    double seconds = secondsSince(start);
+    printf("  %.0f files/s, %.2f M annotations/s, index %.1f MB\n", result.filesRead / seconds,
+        result.rowCount / seconds / 1e6, fileSize(indexPath) / 1e6);
+
+    printf("Ingest again with nothing changed:\n  ");
+    ingest(indexPath, { samples });
+
+    start = std::chrono::steady_clock::now();
+    CorpusIndex index(indexPath);
+    printf("Queries (index opened in %.1f ms):\n", secondsSince(start) * 1000);
+
+    CorpusQuery query;
+    query.label = "Entry point";
+    timeQuery(index, "label \"Entry point\"", query);
+    query.hasRange = true;
+    query.first = 0x1000;
+    query.last = 0x1000;
+    timeQuery(index, "label \"Entry point\" at 0x1000", query);
+    query.label = "field 4242";
+    query.hasRange = false;
+    timeQuery(index, "label \"field 4242\"", query);
+    query.label = "Field 4";
+    query.labelMatch = CorpusLabelMatch::Prefix;
+    timeQuery(index, "label starting \"Field 4\"", query);
+    query.label = "table";
+    query.labelMatch = CorpusLabelMatch::Substring;
+    timeQuery(index, "label containing \"table\"", query);
+    query = CorpusQuery();
+    query.hasRange = true;
+    query.first = 0x80000;
+    query.last = 0x8000F;
+    timeQuery(index, "offsets 0x80000-0x8000F", query);
+    query.format = "float";
+    timeQuery(index, "float at offsets 0x80000-0x8000F", query);
+    query.hasRange = false;
+    timeQuery(index, "float anywhere", query);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 2;
+    }
+
+    std::string command = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+    try {
+        if (command == "ingest") {
+            return ingestCommand(args);
+        }
+        if (command == "query") {
+            return queryCommand(args);
+        }
+        if (command == "benchmark") {
+            return benchmarkCommand(args);
+        }
+        printUsage();
+        return 2;
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,125 @@
+//-------------------------------------------------------------------
+// AnnotationExchangeBench - JSON and CSV export and import
+//-------------------------------------------------------------------
+// Exports 1M annotations, some with record layouts, stale marks and labels
+// that need quoting, as JSON and as CSV, with and without values, then
+// imports each file and checks the round trip. Rates are in megabytes of
+// exchange file per second.
+//
+// FormatData lives in HexViewerWindow.cpp with the user interface, so the
+// hex and int formats are reproduced below the same way; the figures with
+// values are only as good as that stand-in.
+//
+// Usage: AnnotationExchangeBench [annotations]     (default 1000000)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "Bench.h"
+#include "AnnotationExchange.h"
+#include "AnnotationFile.h"
+
+std::string FormatData(const std::vector<BYTE>& data, int offset, int length, std::string_view format) {
+    std::stringstream ss;
+    if (offset + length > data.size()) {
+        length = data.size() - offset;
+    }
+    if (format == "hex") {
+        for (int i = 0; i < length; ++i) {
+            ss << std::uppercase << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(data[offset + i]) << " ";
+        }
+    }
+    else if (format == "int" && length >= 4) {
+        int32_t value;
+        memcpy(&value, &data[offset], sizeof(value));
+        ss << value;
+    }
+    return ss.str();
+}
+
+static bool sameAnnotations(const std::vector<Annotation>& expected, const std::vector<Annotation>& imported) {
+    if (expected.size() != imported.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const Annotation& a = expected[i];
+        const Annotation& b = imported[i];
+        if (a.startOffset != b.startOffset || a.endOffset != b.endOffset || a.label != b.label ||
+            a.displayFormat != b.displayFormat || a.colorIndex != b.colorIndex || a.stale != b.stale ||
+            AnnotationAuxText(a) != AnnotationAuxText(b)) {
+            printf("annotation %zu differs after the round trip\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    DocumentWindowState state;
+    state.fileData = RandomBytes(64 << 20);
+    state.fileName = "C:\\data\\\"quoted\" file.bin";
+    state.fingerprint = ContentFingerprint{ state.fileData.size(), 0xfedcba9876543210ull };
+
+    std::mt19937_64 random(1);
+    auto layout = std::make_shared<RecordLayout>(RecordLayout{ 8, 4, { { "a", 0, 4, "int", 1 }, { "b b", 4, 4, "hex", 2 } } });
+    for (size_t i = 0; i < count; ++i) {
+        Annotation anno;
+        anno.startOffset = static_cast<int>(random() % (state.fileData.size() - 64));
+        anno.endOffset = anno.startOffset + static_cast<int>(random() % 32);
+        std::string label = "Field " + std::to_string(i);
+        if (i % 7 == 0) {
+            label += ", \"quoted\"\n\tline";
+        }
+        anno.label = label;
+        anno.displayFormat = i % 3 ? "hex" : "int";
+        anno.colorIndex = static_cast<int>(i % 6);
+        if (i % 11 == 0) {
+            anno.layout = layout;
+            anno.displayFormat = RECORD_ARRAY_FORMAT;
+            anno.endOffset = anno.startOffset + 31;
+        }
+        anno.stale = i % 13 == 0;
+        state.annotations.push_back(std::move(anno));
+    }
+
+    char directory[] = "/tmp/AnnotationExchangeBench.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    bool ok = true;
+    for (ExchangeFormat format : { ExchangeFormat::Json, ExchangeFormat::Csv }) {
+        const bool json = format == ExchangeFormat::Json;
+        const std::string path = std::string(directory) + (json ? "/annotations.json" : "/annotations.csv");
+        for (bool values : { false, true }) {
+            double exporting = BestOf(3, [&] { ExportAnnotations(path, format, state, values); });
+            double megabytes = std::filesystem::file_size(path) / 1e6;
+
+            ImportedAnnotations imported;
+            double importing = BestOf(3, [&] {
+                imported = ImportedAnnotations();
+                imported = ImportAnnotations(path, format, state.fileData.size());
+            });
+
+            bool roundTrip = sameAnnotations(state.annotations, imported.annotations);
+            if (json) {
+                roundTrip = roundTrip && imported.fingerprint == state.fingerprint && imported.documentName == state.fileName;
+            }
+            ok = ok && roundTrip;
+            printf("%s%s: %zu annotations, %.0f MB, export %.0f MB/s, import %.0f MB/s, round trip %s\n",
+                json ? "JSON" : "CSV", values ? " with values" : "", count, megabytes,
+                megabytes / exporting, megabytes / importing, roundTrip ? "exact" : "FAILED");
+        }
+    }
+
+    std::filesystem::remove_all(directory);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+//-------------------------------------------------------------------
+// AnnotationFileBench - saving and loading .hva files
+//-------------------------------------------------------------------
+// Writes N annotations labelled like Record[N].fK as version 1 and version
+// 2 files, then loads them three ways: with the ifstream loader that read
+// version 1 before the mapped reader, copied below, and with
+// ReadAnnotationFile for each version.
+//
+// Usage: AnnotationFileBench [entries...]     (default 1000000)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include "Bench.h"
+#include "AnnotationFile.h"
+
+const size_t DOCUMENT_SIZE = size_t(1) << 30;
+
+static void writeVersion1(const std::string& path, const std::string& documentName, const std::vector<Annotation>& annotations) {
+    std::ofstream file(path, std::ios::binary);
+    AnnotationFileHeader header = {};
+    memcpy(header.signature, "HVA", 4);
+    header.version = 1;
+    header.annotationCount = static_cast<int>(annotations.size());
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    auto writeString = [&](std::string_view text) {
+        int length = static_cast<int>(text.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(text.data(), length);
+    };
+    writeString(documentName);
+    for (const Annotation& anno : annotations) {
+        file.write(reinterpret_cast<const char*>(&anno.startOffset), sizeof(anno.startOffset));
+        file.write(reinterpret_cast<const char*>(&anno.endOffset), sizeof(anno.endOffset));
+        file.write(reinterpret_cast<const char*>(&anno.colorIndex), sizeof(anno.colorIndex));
+        writeString(anno.label);
+        writeString(anno.displayFormat);
+    }
+}
+
+// The version 1 loader as it was in main.cpp: an ifstream read field by field
+static std::vector<Annotation> loadPrevious(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    AnnotationFileHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    int fileNameLength;
+    file.read(reinterpret_cast<char*>(&fileNameLength), sizeof(fileNameLength));
+    std::vector<char> fileName(fileNameLength + 1, 0);
+    file.read(fileName.data(), fileNameLength);
+
+    std::vector<Annotation> annotations;
+    for (int i = 0; i < header.annotationCount; i++) {
+        Annotation anno;
+        file.read(reinterpret_cast<char*>(&anno.startOffset), sizeof(int));
+        file.read(reinterpret_cast<char*>(&anno.endOffset), sizeof(int));
+        file.read(reinterpret_cast<char*>(&anno.colorIndex), sizeof(int));
+
+        int labelLength;
+        file.read(reinterpret_cast<char*>(&labelLength), sizeof(int));
+        std::vector<char> labelBuffer(labelLength + 1, 0);
+        file.read(labelBuffer.data(), labelLength);
+        anno.label = std::string(labelBuffer.data(), labelLength);
+
+        int formatLength;
+        file.read(reinterpret_cast<char*>(&formatLength), sizeof(int));
+        std::vector<char> formatBuffer(formatLength + 1, 0);
+        file.read(formatBuffer.data(), formatLength);
+        anno.displayFormat = std::string(formatBuffer.data(), formatLength);
+
+        annotations.push_back(anno);
+    }
+    return annotations;
+}
+
+// Best of two loads, leaving out freeing what the previous one loaded
+template <typename Load, typename Result>
+static double timeLoad(Load&& load, Result& result) {
+    double best = 1e300;
+    for (int run = 0; run < 2; ++run) {
+        result = Result();
+        auto start = std::chrono::steady_clock::now();
+        Result loaded = load();
+        best = std::min(best, SecondsSince(start));
+        result = std::move(loaded);
+    }
+    return best;
+}
+
+static double fileMegabytes(const std::string& path) {
+    return std::filesystem::file_size(path) / double(1 << 20);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> counts;
+    for (int i = 1; i < argc; ++i) {
+        counts.push_back(strtoull(argv[i], nullptr, 10));
+    }
+    if (counts.empty()) {
+        counts.push_back(1000000);
+    }
+
+    char directory[] = "/tmp/AnnotationFileBench.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    const std::string version1 = std::string(directory) + "/v1.hva";
+    const std::string version2 = std::string(directory) + "/v2.hva";
+
+    bool ok = true;
+    for (size_t count : counts) {
+        double save1, save2;
+        {
+            std::vector<Annotation> annotations;
+            annotations.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                annotations.push_back(Annotation{ static_cast<int>(i * 8), static_cast<int>(i * 8 + 3),
+                    "Record[" + std::to_string(i / 4) + "].f" + std::to_string(i % 4), i % 3 ? "hex" : "int", static_cast<int>(i % 6) });
+            }
+            save1 = BestOf(1, [&] { writeVersion1(version1, "document.bin", annotations); });
+            save2 = BestOf(1, [&] { WriteAnnotationFile(version2, "document.bin", ContentFingerprint{}, annotations); });
+        }
+
+        // Each load is timed with the file in the page cache
+        std::vector<Annotation> annotations;
+        double previous = timeLoad([&] { return loadPrevious(version1); }, annotations);
+        ok = ok && annotations.size() == count;
+        AnnotationFileContents contents;
+        double load1 = timeLoad([&] { return ReadAnnotationFile(version1, DOCUMENT_SIZE); }, contents);
+        ok = ok && contents.annotations.size() == count;
+        double load2 = timeLoad([&] { return ReadAnnotationFile(version2, DOCUMENT_SIZE); }, contents);
+        ok = ok && contents.annotations.size() == count && contents.annotations.back().label ==
+            "Record[" + std::to_string((count - 1) / 4) + "].f" + std::to_string((count - 1) % 4);
+
+        printf("%zu entries: previous v1 loader %.2f s | v1 %.0f MB, save %.2f s, load %.2f s | v2 %.0f MB, save %.2f s, load %.2f s\n",
+            count, previous, fileMegabytes(version1), save1, load1, fileMegabytes(version2), save2, load2);
+    }
+
+    std::filesystem::remove_all(directory);
+    if (!ok) {
+        printf("loaded annotations do not match\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+//-------------------------------------------------------------------
+// AnnotationRebaseBench - matching two versions and moving annotations
+//-------------------------------------------------------------------
+// A random document with a few runs of padding is edited at random: each
+// edit inserts, deletes or overwrites 1 to 300 bytes. The benchmark times
+// MatchContents on the two versions and RebaseAnnotations for 200k short
+// annotations, and reports how much of the old version was matched. Every
+// match and every moved annotation is checked against the bytes.
+//
+// Usage: AnnotationRebaseBench [megabytes [edits...]]    (default 1024 1000 100000)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "Bench.h"
+#include "AnnotationRebase.h"
+
+const size_t ANNOTATIONS = 200000;
+
+// The old version with `edits` random edits applied
+static std::vector<BYTE> editContents(const std::vector<BYTE>& old, int edits, std::mt19937_64& random) {
+    struct Edit {
+        size_t offset;
+        int kind;   // 0 insert, 1 delete, 2 overwrite
+    };
+    std::vector<Edit> plan;
+    for (int e = 0; e < edits; ++e) {
+        plan.push_back(Edit{ random() % old.size(), static_cast<int>(random() % 3) });
+    }
+    std::sort(plan.begin(), plan.end(), [](const Edit& a, const Edit& b) { return a.offset < b.offset; });
+
+    std::vector<BYTE> edited;
+    edited.reserve(old.size() + edits * 300);
+    size_t copied = 0;
+    for (const Edit& edit : plan) {
+        if (edit.offset < copied) {
+            continue;
+        }
+        edited.insert(edited.end(), old.begin() + copied, old.begin() + edit.offset);
+        size_t length = 1 + random() % 300;
+        size_t end = std::min(old.size(), edit.offset + length);
+        copied = edit.offset;
+        if (edit.kind == 0) {
+            for (size_t i = 0; i < length; ++i) {
+                edited.push_back(static_cast<BYTE>(random()));
+            }
+        }
+        else if (edit.kind == 1) {
+            copied = end;
+        }
+        else {
+            for (size_t i = edit.offset; i < end; ++i) {
+                edited.push_back(old[i] ^ 0x5A);
+            }
+            copied = end;
+        }
+    }
+    edited.insert(edited.end(), old.begin() + copied, old.end());
+    return edited;
+}
+
+int main(int argc, char** argv) {
+    const size_t size = (argc > 1 ? strtoull(argv[1], nullptr, 10) : 1024) << 20;
+    std::vector<int> editCounts;
+    for (int i = 2; i < argc; ++i) {
+        editCounts.push_back(atoi(argv[i]));
+    }
+    if (editCounts.empty()) {
+        editCounts = { 1000, 100000 };
+    }
+
+    std::mt19937_64 random(7);
+    std::vector<BYTE> old = RandomBytes(size, 7);
+    for (int run = 0; run < 20; ++run) {
+        size_t start = random() % size;
+        std::fill(old.begin() + start, old.begin() + std::min(size, start + random() % 100000), 0xFF);
+    }
+
+    std::vector<Annotation> annotations(ANNOTATIONS);
+    for (Annotation& anno : annotations) {
+        anno.startOffset = static_cast<int>(random() % (size - 64));
+        anno.endOffset = anno.startOffset + static_cast<int>(random() % 64);
+        anno.label = "x";
+        anno.displayFormat = "hex";
+    }
+
+    bool ok = true;
+    for (int edits : editCounts) {
+        std::vector<BYTE> edited = editContents(old, edits, random);
+
+        std::vector<RebaseMatch> matches;
+        double matching = BestOf(1, [&] {
+            matches = MatchContents(old.data(), old.size(), edited.data(), edited.size());
+        });
+        RebaseResult result;
+        double mapping = BestOf(3, [&] {
+            result = RebaseAnnotations(annotations, matches, edited.size());
+        });
+
+        uint64_t matched = 0;
+        for (const RebaseMatch& match : matches) {
+            matched += match.length;
+            ok = ok && memcmp(&old[match.oldOffset], &edited[match.newOffset], match.length) == 0;
+        }
+
+        // Order is preserved with the dropped ones left out, so the annotations
+        // inside a run and the moved results pair up in turn
+        size_t next = 0, inside = 0;
+        for (const Annotation& anno : annotations) {
+            const int length = anno.endOffset - anno.startOffset + 1;
+            auto run = std::upper_bound(matches.begin(), matches.end(), static_cast<uint64_t>(anno.startOffset),
+                [](uint64_t offset, const RebaseMatch& match) { return offset < match.oldOffset; });
+            if (run == matches.begin() || static_cast<uint64_t>(anno.endOffset) >= run[-1].oldOffset + run[-1].length) {
+                continue;
+            }
+            ++inside;
+            while (next < result.annotations.size() && result.annotations[next].stale) {
+                ++next;
+            }
+            ok = ok && next < result.annotations.size() &&
+                memcmp(&old[anno.startOffset], &edited[result.annotations[next].startOffset], length) == 0;
+            ++next;
+        }
+        ok = ok && inside == result.moved;
+
+        printf("%zu MB, %d edits: match %.2f s, %.2f%% of old bytes in %zu runs; "
+            "%zu annotations mapped in %.3f s, %zu moved, %zu stale, %zu dropped\n",
+            size >> 20, edits, matching, 100.0 * matched / size, matches.size(),
+            annotations.size(), mapping, result.moved, result.stale, result.dropped);
+    }
+
+    if (!ok) {
+        printf("a match or a moved annotation does not cover the same bytes\n");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Timing and inputs shared by the benchmarks. Each figure is the best of a
+// few runs, which is steadier than the mean on a busy machine.
+
+inline double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best time in seconds of `runs` calls of `work`
+template <typename Work>
+double BestOf(int runs, Work&& work) {
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double elapsed = SecondsSince(start);
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+inline std::vector<uint8_t> RandomBytes(size_t size, uint64_t seed = 1) {
+    std::vector<uint8_t> bytes(size);
+    std::mt19937_64 random(seed);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = random();
+        for (int k = 0; k < 8; ++k) {
+            bytes[i + k] = static_cast<uint8_t>(word >> (8 * k));
+        }
+    }
+    for (; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(random());
+    }
+    return bytes;
+}
+
+// Keeps a result alive so the work producing it is not optimized away
+inline volatile size_t benchSink;
+inline void Consume(size_t value) {
+    benchSink = benchSink + value;
+}
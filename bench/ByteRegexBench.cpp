@@ -0,0 +1,78 @@
+//-------------------------------------------------------------------
+// ByteRegexBench - throughput of regex searches
+//-------------------------------------------------------------------
+// Searches 256 MB inputs with patterns that take each path through
+// RegexPattern: a literal prefix, a prefix-free pattern marked by the
+// reversed DFA, patterns that are exponential for a backtracking matcher,
+// and one whose DFA outgrows its cache. The exact engine is timed on the
+// literal for reference. A search still running after 60 s is cancelled.
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "Bench.h"
+#include "ByteRegex.h"
+
+struct RegexBench {
+    const char* name;
+    const char* pattern;        // Null for the exact engine
+    const std::vector<uint8_t>* data;
+};
+
+int main() {
+    const size_t size = size_t(256) << 20;
+    std::vector<uint8_t> random = RandomBytes(size, 88172645463325252ull);
+    std::vector<uint8_t> zeros(size, 0), as(size, 'a'), ab(size), text(size);
+    for (size_t i = 0; i < size; ++i) {
+        ab[i] = (random[i] & 1) ? 'a' : 'b';
+        text[i] = random[i] % 7 == 0 ? random[i] : ' ' + random[i] % 90;
+    }
+    for (size_t k = 1; k < 50; ++k) {
+        memcpy(&random[k * (size / 50)], "MZ\x90\x00\x03\x00", 6);
+    }
+
+    const RegexBench benches[] = {
+        { "literal MZ\\x90\\x00, random", "MZ\\x90\\x00", &random },
+        { "exact engine, same bytes", nullptr, &random },
+        { "TLV \\x01[\\x04-\\x40][\\x20-\\x7E]{4,}, random", "\\x01[\\x04-\\x40][\\x20-\\x7E]{4,}", &random },
+        { "strings [\\x20-\\x7E]{8,}, random", "[\\x20-\\x7E]{8,}", &random },
+        { "strings [\\x20-\\x7E]{8,}, mostly text", "[\\x20-\\x7E]{8,}", &text },
+        { "(a|aa)*b, all 'a'", "(a|aa)*b", &as },
+        { "(a+a+)+b, all 'a'", "(a+a+)+b", &as },
+        { "\\x00[^\\x01]*\\x01, all zero", "\\x00[^\\x01]*\\x01", &zeros },
+        { ".*.*=.*, all zero", ".*.*=.*", &zeros },
+        { "(a|b)*a(a|b){12}, random ab", "(a|b)*a(a|b){12}", &ab },
+        { "a(a|b){12}b, random ab", "a(a|b){12}b", &ab },
+    };
+
+    printf("256 MB, %u hardware threads:\n", std::thread::hardware_concurrency());
+    for (const RegexBench& bench : benches) {
+        std::shared_ptr<const SearchPattern> pattern;
+        if (bench.pattern) {
+            pattern = std::make_shared<RegexPattern>(bench.pattern);
+        }
+        else {
+            pattern = std::make_shared<BytePattern>(std::vector<uint8_t>{ 'M', 'Z', 0x90, 0 });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        DocumentSearch search(pattern, bench.data->data(), size);
+        search.start([] {});
+        while (!search.finished() && SecondsSince(start) < 60) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        bool gaveUp = !search.finished();
+        search.cancel();
+        search.wait();
+        double seconds = SecondsSince(start);
+
+        if (gaveUp) {
+            printf("  %-46s  over 60 s, %zu MB searched\n", bench.name, search.searchedBytes() >> 20);
+        }
+        else {
+            printf("  %-46s %7.3f GB/s  %zu matches%s\n", bench.name, search.searchedBytes() / seconds / 1e9,
+                search.matchCount(), search.truncated() ? ", stopped at the limit" : "");
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
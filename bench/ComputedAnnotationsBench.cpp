@@ -0,0 +1,70 @@
+//-------------------------------------------------------------------
+// ComputedAnnotationsBench - re-evaluating a long chain after an edit
+//-------------------------------------------------------------------
+// The chain of tests/ComputedAnnotationsTest: 100k records laid end to end,
+// each taking its length from a one-byte size field and starting where the
+// one before ends. Times the first evaluation and edits of a size field at
+// several depths, which re-evaluate the records from the edited one to the
+// end of the chain.
+#include <Windows.h>
+#include <algorithm>
+#include <string>
+#include "Bench.h"
+#include "includes.h"
+#include "ComputedAnnotations.h"
+
+void UpdateAnnotation(DocumentWindowState& state, int index, Annotation annotation);
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+
+const int RECORDS = 100000;
+const int SIZE_FIELDS_AT = 500000;
+
+static Annotation computedAnnotation(const std::string& label, std::string start, std::string length, std::string value) {
+    Annotation anno{ 0, 0, label, "hex", 0 };
+    anno.computed = std::make_shared<const ComputedFields>(ComputedFields{ std::move(start), std::move(length), std::move(value) });
+    return anno;
+}
+
+int main() {
+    DocumentWindowState state;
+    state.fileData.resize(SIZE_FIELDS_AT + RECORDS + 16);
+    for (int k = 0; k < RECORDS + 16; ++k) {
+        state.fileData[SIZE_FIELDS_AT + k] = static_cast<BYTE>(1 + k % 4);
+    }
+
+    std::vector<Annotation> annotations;
+    for (int k = 0; k < RECORDS; ++k) {
+        annotations.push_back(Annotation{ SIZE_FIELDS_AT + k, SIZE_FIELDS_AT + k, "size" + std::to_string(k), "hex", 0 });
+    }
+    for (int k = 0; k < RECORDS; ++k) {
+        std::string previous = "{record" + std::to_string(k - 1) + "}";
+        annotations.push_back(computedAnnotation("record" + std::to_string(k),
+            k ? previous + ".end" : "0", "{size" + std::to_string(k) + "}", k ? previous + " + 1" : "1"));
+    }
+    AppendAnnotations(state, std::move(annotations));
+
+    std::vector<int> changed;
+    auto start = std::chrono::steady_clock::now();
+    EvaluateComputedAnnotations(state, changed);
+    printf("first evaluation of %d records: %.1f ms\n", RECORDS, SecondsSince(start) * 1e3);
+
+    // Each run moves the field back and forth between two bytes of different
+    // value, so every run changes the whole tail of the chain
+    for (int edited : { 0, 50000, 99000, 99990 }) {
+        int positions[2] = { SIZE_FIELDS_AT + edited + 1, SIZE_FIELDS_AT + edited };
+        int run = 0;
+        size_t evaluated = 0;
+        double seconds = BestOf(5, [&] {
+            Annotation field = state.annotations[edited];
+            field.startOffset = field.endOffset = positions[run++ % 2];
+            UpdateAnnotation(state, edited, field);
+
+            changed.clear();
+            size_t before = ComputedEvaluationCount(state);
+            EvaluateComputedAnnotations(state, changed);
+            evaluated = ComputedEvaluationCount(state) - before;
+        });
+        printf("edit of size%d: %zu records re-evaluated in %.3f ms\n", edited, evaluated, seconds * 1e3);
+    }
+    return 0;
+}
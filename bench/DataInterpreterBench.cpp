@@ -0,0 +1,153 @@
+//-------------------------------------------------------------------
+// DataInterpreterBench - cost of one full grid update
+//-------------------------------------------------------------------
+// Moves the cursor across 200k offsets of random data and formats the whole
+// grid at each, once with InterpretData and once with the stringstream
+// formatter it replaced, copied below with the Windows date calls swapped for
+// gmtime_r. The old formatter covers only the rows the grid had then, in one
+// byte order; InterpretData does every row in both.
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include "Bench.h"
+#include "DataInterpreter.h"
+
+const int OFFSETS = 200000;
+
+static std::string formatTime(time_t value) {
+    struct tm parts;
+    gmtime_r(&value, &parts);
+    char buffer[100];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d", parts.tm_year + 1900, parts.tm_mon + 1,
+        parts.tm_mday, parts.tm_hour, parts.tm_min, parts.tm_sec);
+    return buffer;
+}
+
+// FormatDataAtOffset as it was before the grid moved to DataInterpreter.cpp
+static std::string previousFormat(const std::vector<uint8_t>& data, int offset, DataType type) {
+    std::stringstream ss;
+    size_t remainingBytes = data.size() - offset;
+    switch (type) {
+    case DT_BYTE:
+        ss << static_cast<int>(static_cast<int8_t>(data[offset])) << " (0x" << std::hex << static_cast<int>(data[offset]) << ")";
+        break;
+    case DT_UBYTE:
+        ss << static_cast<int>(data[offset]) << " (0x" << std::hex << static_cast<int>(data[offset]) << ")";
+        break;
+    case DT_SHORT:
+    case DT_USHORT:
+        if (remainingBytes >= 2) {
+            uint16_t value;
+            memcpy(&value, &data[offset], sizeof(value));
+            if (type == DT_SHORT) {
+                ss << static_cast<int16_t>(value) << " (0x" << std::hex << static_cast<int>(static_cast<int16_t>(value)) << ")";
+            }
+            else {
+                ss << value << " (0x" << std::hex << value << ")";
+            }
+        }
+        break;
+    case DT_INT:
+    case DT_UINT:
+        if (remainingBytes >= 4) {
+            uint32_t value;
+            memcpy(&value, &data[offset], sizeof(value));
+            if (type == DT_INT) {
+                ss << static_cast<int32_t>(value) << " (0x" << std::hex << static_cast<int32_t>(value) << ")";
+            }
+            else {
+                ss << value << " (0x" << std::hex << value << ")";
+            }
+        }
+        break;
+    case DT_FLOAT:
+        if (remainingBytes >= 4) {
+            float value;
+            memcpy(&value, &data[offset], sizeof(value));
+            ss << std::fixed << std::setprecision(6) << value;
+        }
+        break;
+    case DT_DOUBLE:
+        if (remainingBytes >= 8) {
+            double value;
+            memcpy(&value, &data[offset], sizeof(value));
+            ss << std::fixed << std::setprecision(10) << value;
+        }
+        break;
+    case DT_STRING:
+    {
+        std::string result;
+        for (size_t i = 0; i < 32 && offset + i < data.size() && data[offset + i]; i++) {
+            uint8_t ch = data[offset + i];
+            result += ch >= 32 && ch <= 126 ? static_cast<char>(ch) : '.';
+        }
+        ss << result;
+        break;
+    }
+    case DT_UNICODE_STRING:
+    {
+        std::string result;
+        for (size_t i = 0; i < 16 && offset + i * 2 + 1 < data.size(); i++) {
+            uint16_t ch;
+            memcpy(&ch, &data[offset + i * 2], sizeof(ch));
+            if (ch == 0) {
+                break;
+            }
+            result += ch >= 32 && ch <= 126 ? static_cast<char>(ch) : '.';
+        }
+        ss << result;
+        break;
+    }
+    case DT_TIME_T:
+    case DT_TIME64_T:
+        if (remainingBytes >= 8) {
+            int64_t value;
+            memcpy(&value, &data[offset], sizeof(value));
+            ss << formatTime(static_cast<time_t>(value));
+        }
+        break;
+    case DT_OLETIME:
+        if (remainingBytes >= 8) {
+            double days;
+            memcpy(&days, &data[offset], sizeof(days));
+            ss << formatTime(static_cast<time_t>((days - 25569) * 86400));
+        }
+        break;
+    default:
+        break;
+    }
+    if (ss.str().empty()) {
+        return "Not enough data";
+    }
+    return ss.str();
+}
+
+int main() {
+    const std::vector<uint8_t> data = RandomBytes(1 << 20);
+    const DataType previousRows[] = { DT_BYTE, DT_UBYTE, DT_SHORT, DT_USHORT, DT_INT, DT_UINT, DT_FLOAT,
+        DT_DOUBLE, DT_STRING, DT_UNICODE_STRING, DT_TIME_T, DT_TIME64_T, DT_OLETIME };
+
+    double previous = BestOf(3, [&] {
+        for (int offset = 0; offset < OFFSETS; ++offset) {
+            for (DataType type : previousRows) {
+                Consume(previousFormat(data, offset, type).size());
+            }
+        }
+    });
+
+    double current = BestOf(3, [&] {
+        DataInterpretation interpretation;
+        for (int offset = 0; offset < OFFSETS; ++offset) {
+            InterpretData(data.data() + offset, data.size() - offset, interpretation);
+            Consume(interpretation.text[DT_OLETIME][BO_LITTLE_ENDIAN][0]);
+        }
+    });
+
+    printf("grid update: stringstream %.2f us (%zu rows), InterpretData %.2f us (%d rows x 2 orders), %.1fx\n",
+        previous / OFFSETS * 1e6, std::size(previousRows), current / OFFSETS * 1e6, static_cast<int>(DT_COUNT),
+        previous / current);
+    return 0;
+}
@@ -0,0 +1,408 @@
+//-------------------------------------------------------------------
+// EmbeddedFilesBench - carving embedded files out of a document
+//-------------------------------------------------------------------
+// Builds a corpus of one small file of each format, separated by random
+// filler, and checks that FindEmbeddedFiles reports exactly those files.
+// The corpus repeated to 512 MB is then scanned for throughput, along with
+// random bytes, zeros and a shared library repeated, which are the common
+// cases of a document with few or no embedded files.
+//
+// The files are generated here rather than read from disk. Deflate data is
+// written with fixed Huffman codes, literals and back-references, or as
+// stored blocks, so the gzip walker sees every block type except dynamic
+// codes. The ELF file is this program.
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include "Bench.h"
+#include "EmbeddedFiles.h"
+#include "Hashing.h"
+
+typedef std::vector<BYTE> Bytes;
+
+static void put16(Bytes& out, uint32_t value) {
+    out.push_back(static_cast<BYTE>(value));
+    out.push_back(static_cast<BYTE>(value >> 8));
+}
+
+static void put32(Bytes& out, uint32_t value) {
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+static void putBig32(Bytes& out, uint32_t value) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<BYTE>(value >> shift));
+    }
+}
+
+static void append(Bytes& out, const Bytes& bytes) {
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static void append(Bytes& out, const char* text) {
+    out.insert(out.end(), text, text + strlen(text));
+}
+
+static Bytes randomBytes(std::mt19937& random, size_t size, int limit = 256) {
+    Bytes bytes(size);
+    for (BYTE& byte : bytes) {
+        byte = static_cast<BYTE>(random() % limit);
+    }
+    return bytes;
+}
+
+//-------------------------------------------------------------------
+// Deflate
+//-------------------------------------------------------------------
+// Bits least significant first, as deflate packs them
+struct BitWriter {
+    Bytes bytes;
+    int used = 8;
+
+    void bits(uint32_t value, int count) {
+        for (int i = 0; i < count; ++i) {
+            if (used == 8) {
+                bytes.push_back(0);
+                used = 0;
+            }
+            bytes.back() |= ((value >> i) & 1) << used++;
+        }
+    }
+
+    // Huffman codes go most significant bit first
+    void code(uint32_t value, int length) {
+        for (int i = length - 1; i >= 0; --i) {
+            bits(value >> i, 1);
+        }
+    }
+
+    void fixedLiteral(BYTE literal) {
+        if (literal < 144) {
+            code(0x30 + literal, 8);
+        }
+        else {
+            code(0x190 + literal - 144, 9);
+        }
+    }
+};
+
+// One fixed-code block: literal bytes, then `repeats` copies of length 258
+// at distance 12, which repeat the last 12 of them
+static Bytes deflateFixed(const Bytes& literals, int repeats, Bytes& inflated) {
+    BitWriter out;
+    out.bits(1, 1);     // Final
+    out.bits(1, 2);     // Fixed codes
+    for (BYTE literal : literals) {
+        out.fixedLiteral(literal);
+    }
+    inflated = literals;
+    for (int r = 0; r < repeats; ++r) {
+        out.code(0xC5, 8);      // Length symbol 285: 258 bytes
+        out.code(6, 5);         // Distance symbol 6: 9-12, two extra bits
+        out.bits(3, 2);
+        for (int i = 0; i < 258; ++i) {
+            inflated.push_back(inflated[inflated.size() - 12]);
+        }
+    }
+    out.code(0, 7);     // End of block
+    return out.bytes;
+}
+
+static Bytes deflateStored(const Bytes& data) {
+    Bytes out;
+    size_t pos = 0;
+    do {
+        size_t length = std::min<size_t>(data.size() - pos, 65535);
+        out.push_back(pos + length == data.size() ? 1 : 0);
+        put16(out, static_cast<uint32_t>(length));
+        put16(out, static_cast<uint32_t>(~length & 0xFFFF));
+        out.insert(out.end(), data.begin() + pos, data.begin() + pos + length);
+        pos += length;
+    } while (pos < data.size());
+    return out;
+}
+
+static Bytes gzip(const Bytes& deflated, const Bytes& inflated) {
+    Bytes out = { 0x1F, 0x8B, 0x08, 0x08, 0, 0, 0, 0, 0, 0xFF };
+    append(out, "data.bin");
+    out.push_back(0);
+    append(out, deflated);
+    put32(out, Crc32(inflated.data(), inflated.size()));
+    put32(out, static_cast<uint32_t>(inflated.size()));
+    return out;
+}
+
+//-------------------------------------------------------------------
+// Formats
+//-------------------------------------------------------------------
+static void pngChunk(Bytes& out, const char* type, const Bytes& data) {
+    putBig32(out, static_cast<uint32_t>(data.size()));
+    Bytes typed(type, type + 4);
+    append(typed, data);
+    append(out, typed);
+    putBig32(out, Crc32(typed.data(), typed.size()));
+}
+
+static Bytes png(std::mt19937& random, uint32_t width, uint32_t height) {
+    Bytes out = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+    Bytes header;
+    putBig32(header, width);
+    putBig32(header, height);
+    append(header, Bytes{ 8, 2, 0, 0, 0 });
+    pngChunk(out, "IHDR", header);
+    pngChunk(out, "tEXt", Bytes{ 'a', 0, 'b' });
+
+    Bytes pixels;
+    for (uint32_t row = 0; row < height; ++row) {
+        pixels.push_back(0);
+        append(pixels, randomBytes(random, width * 3));
+    }
+    Bytes image = { 0x78, 0x01 };
+    append(image, deflateStored(pixels));
+    putBig32(image, Adler32(pixels.data(), pixels.size()));
+    pngChunk(out, "IDAT", image);
+    pngChunk(out, "IEND", Bytes());
+    return out;
+}
+
+static void jpegSegment(Bytes& out, BYTE marker, const Bytes& data) {
+    append(out, Bytes{ 0xFF, marker, static_cast<BYTE>((data.size() + 2) >> 8), static_cast<BYTE>(data.size() + 2) });
+    append(out, data);
+}
+
+static Bytes jpeg(std::mt19937& random) {
+    Bytes out = { 0xFF, 0xD8 };
+    jpegSegment(out, 0xE0, Bytes{ 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0 });
+    jpegSegment(out, 0xDB, Bytes(65));
+    jpegSegment(out, 0xC0, Bytes(15));
+    jpegSegment(out, 0xC4, Bytes(30));
+    jpegSegment(out, 0xDA, Bytes(10));
+
+    // Entropy-coded data with stuffed zeros, a restart marker, and more
+    for (int i = 0; i < 3000; ++i) {
+        BYTE byte = static_cast<BYTE>(random());
+        out.push_back(byte);
+        if (byte == 0xFF) {
+            out.push_back(0);
+        }
+    }
+    append(out, Bytes{ 0xFF, 0xD0 });
+    append(out, randomBytes(random, 100, 255));
+    append(out, Bytes{ 0xFF, 0xD9 });
+    return out;
+}
+
+static Bytes gif() {
+    const char* hex = "47494638396101000100800000000000ffffff21f90401000000002c00000000010001000002024401003b";
+    Bytes out;
+    for (const char* p = hex; *p; p += 2) {
+        out.push_back(static_cast<BYTE>(std::stoi(std::string(p, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+// Stored entries; with descriptors the sizes follow the data, so only the
+// end of central directory record gives the archive's length
+static Bytes zip(std::mt19937& random, bool descriptors) {
+    Bytes out, directory;
+    for (int entry = 0; entry < 5; ++entry) {
+        std::string name = "f" + std::to_string(entry) + ".txt";
+        Bytes data = randomBytes(random, 1000);
+        data.insert(data.end(), 5000, 'x');
+        uint32_t crc = Crc32(data.data(), data.size());
+        uint32_t size = static_cast<uint32_t>(data.size());
+        uint32_t headerOffset = static_cast<uint32_t>(out.size());
+
+        put32(out, 0x04034B50);
+        put16(out, 20);
+        put16(out, descriptors ? 8 : 0);
+        put16(out, 0);                      // Stored
+        put32(out, 0);                      // Time and date
+        put32(out, descriptors ? 0 : crc);
+        put32(out, descriptors ? 0 : size);
+        put32(out, descriptors ? 0 : size);
+        put16(out, static_cast<uint32_t>(name.size()));
+        put16(out, 0);
+        append(out, name.c_str());
+        append(out, data);
+        if (descriptors) {
+            put32(out, 0x08074B50);
+            put32(out, crc);
+            put32(out, size);
+            put32(out, size);
+        }
+
+        put32(directory, 0x02014B50);
+        put16(directory, 20);
+        put16(directory, 20);
+        put16(directory, descriptors ? 8 : 0);
+        put16(directory, 0);
+        put32(directory, 0);
+        put32(directory, crc);
+        put32(directory, size);
+        put32(directory, size);
+        put16(directory, static_cast<uint32_t>(name.size()));
+        put32(directory, 0);                // Extra and comment lengths
+        put32(directory, 0);                // Disk, internal attributes
+        put32(directory, 0);                // External attributes
+        put32(directory, headerOffset);
+        append(directory, name.c_str());
+    }
+
+    uint32_t directoryOffset = static_cast<uint32_t>(out.size());
+    append(out, directory);
+    put32(out, 0x06054B50);
+    put32(out, 0);
+    put16(out, 5);
+    put16(out, 5);
+    put32(out, static_cast<uint32_t>(directory.size()));
+    put32(out, directoryOffset);
+    put16(out, 0);
+    return out;
+}
+
+static Bytes squashfs(std::mt19937& random) {
+    const uint32_t bytesUsed = 5000;
+    Bytes out;
+    put32(out, 0x73717368);
+    put32(out, 10);                         // Inodes
+    put32(out, 0);                          // Modification time
+    put32(out, 131072);                     // Block size
+    put32(out, 1);                          // Fragments
+    put16(out, 1);                          // Compression: gzip
+    put16(out, 17);                         // Block log
+    put16(out, 0);                          // Flags
+    put16(out, 1);                          // Ids
+    put16(out, 4);                          // Version 4.0
+    put16(out, 0);
+    out.resize(40);
+    put32(out, bytesUsed);
+    put32(out, 0);
+    out.resize(96);
+    append(out, randomBytes(random, bytesUsed - out.size()));
+    return out;
+}
+
+// PE32+ with one section and no certificates
+static Bytes pe(std::mt19937& random) {
+    Bytes out(0x40);
+    out[0] = 'M';
+    out[1] = 'Z';
+    out[0x3C] = 0x40;
+    put32(out, 0x00004550);
+    put16(out, 0x8664);                     // Machine
+    put16(out, 1);                          // Sections
+    out.resize(out.size() + 12);
+    put16(out, 240);                        // Optional header size
+    put16(out, 0x22);                       // Characteristics
+
+    size_t optional = out.size();
+    out.resize(optional + 240);
+    out[optional] = 0x0B;                   // PE32+ magic
+    out[optional + 1] = 0x02;
+    out[optional + 60] = 0x00;              // SizeOfHeaders 0x200
+    out[optional + 61] = 0x02;
+    out[optional + 108] = 16;               // Data directories
+
+    Bytes section(40);
+    memcpy(section.data(), ".text", 5);
+    section[17] = 0x02;                     // Raw size 0x200
+    section[21] = 0x02;                     // Raw offset 0x200
+    append(out, section);
+    out.resize(0x200);
+    append(out, randomBytes(random, 0x200));
+    return out;
+}
+
+static Bytes readFile(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return Bytes(std::istreambuf_iterator<char>(file), {});
+}
+
+//-------------------------------------------------------------------
+// Benchmark
+//-------------------------------------------------------------------
+typedef std::tuple<size_t, size_t, std::string> Found;
+
+static double scan(const char* name, const Bytes& data) {
+    std::vector<EmbeddedFile> files;
+    double seconds = BestOf(3, [&] { files = FindEmbeddedFiles(data); });
+    printf("  %-36s %4zu MB  %5.2f GB/s  %zu files\n", name, data.size() >> 20, data.size() / seconds / 1e9, files.size());
+    return seconds;
+}
+
+static Bytes repeatTo(const Bytes& piece, size_t size) {
+    Bytes out;
+    out.reserve(size + piece.size());
+    while (out.size() < size) {
+        append(out, piece);
+    }
+    return out;
+}
+
+int main() {
+    std::mt19937 random(5);
+
+    std::vector<std::pair<const char*, Bytes>> items;
+    items.push_back({ "PNG image", png(random, 40, 30) });
+    items.push_back({ "JPEG image", jpeg(random) });
+    items.push_back({ "GIF image", gif() });
+    {
+        Bytes inflated;
+        Bytes deflated = deflateFixed(randomBytes(random, 2000), 300, inflated);
+        items.push_back({ "gzip stream", gzip(deflated, inflated) });
+        Bytes stored = randomBytes(random, 70000);
+        items.push_back({ "gzip stream", gzip(deflateStored(stored), stored) });
+        items.push_back({ "gzip stream", gzip(deflateFixed(Bytes(), 0, inflated), inflated) });
+    }
+    items.push_back({ "ZIP archive", zip(random, false) });
+    items.push_back({ "ZIP archive", zip(random, true) });
+    items.push_back({ "SquashFS image", squashfs(random) });
+    items.push_back({ "PE executable", pe(random) });
+    items.push_back({ "ELF executable", readFile("/proc/self/exe") });
+
+    Bytes corpus;
+    std::vector<Found> expected;
+    for (int round = 0; round < 20; ++round) {
+        for (const auto& [format, bytes] : items) {
+            append(corpus, randomBytes(random, 100 + random() % 2900));
+            expected.emplace_back(corpus.size(), bytes.size(), format);
+            append(corpus, bytes);
+        }
+    }
+
+    std::vector<Found> found;
+    for (const EmbeddedFile& file : FindEmbeddedFiles(corpus)) {
+        found.emplace_back(file.offset, file.size, file.format);
+    }
+    bool exact = found == expected;
+    printf("corpus of %zu files in %zu KB: %s\n", expected.size(), corpus.size() >> 10,
+        exact ? "all found exactly" : "MISMATCH");
+    if (!exact) {
+        for (const Found& file : expected) {
+            if (std::find(found.begin(), found.end(), file) == found.end()) {
+                printf("  missing %s at %zu, %zu bytes\n", std::get<2>(file).c_str(), std::get<0>(file), std::get<1>(file));
+            }
+        }
+        for (const Found& file : found) {
+            if (std::find(expected.begin(), expected.end(), file) == expected.end()) {
+                printf("  extra %s at %zu, %zu bytes\n", std::get<2>(file).c_str(), std::get<0>(file), std::get<1>(file));
+            }
+        }
+    }
+
+    const size_t size = size_t(512) << 20;
+    scan("mixed corpus, repeated", repeatTo(corpus, size));
+    scan("random bytes", RandomBytes(size, 1));
+    scan("zeros", Bytes(size, 0));
+    Bytes library = readFile("/usr/lib/x86_64-linux-gnu/libc.so.6");
+    if (!library.empty()) {
+        scan("libc.so.6, repeated", repeatTo(library, size));
+    }
+    return exact ? 0 : 1;
+}
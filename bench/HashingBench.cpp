@@ -0,0 +1,111 @@
+//-------------------------------------------------------------------
+// HashingBench - throughput of each hash and checksum
+//-------------------------------------------------------------------
+// Feeds 256 MB of random bytes to each Hasher in HASH_BLOCK_SIZE pieces, as
+// HashJob does, on one thread: once with the accelerated paths this CPU has,
+// printed first, and once with SetHashAcceleration(false) for the portable
+// slicing-by-8 tables and reference rounds. zlib and OpenSSL hash the same
+// buffer in the same pieces as references, and their digests must match.
+// Last, a HashJob runs every algorithm at once.
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <openssl/evp.h>
+#include <zlib.h>
+#include "Bench.h"
+#include "Hashing.h"
+
+static std::vector<uint8_t> bigEndian(uint32_t value) {
+    return { uint8_t(value >> 24), uint8_t(value >> 16), uint8_t(value >> 8), uint8_t(value) };
+}
+
+static std::vector<uint8_t> zlibDigest(HashAlgorithm algorithm, const std::vector<uint8_t>& data) {
+    bool crc = algorithm == HASH_CRC32;
+    uLong value = crc ? crc32(0, Z_NULL, 0) : adler32(0, Z_NULL, 0);
+    for (size_t offset = 0; offset < data.size(); offset += HASH_BLOCK_SIZE) {
+        uInt length = static_cast<uInt>(std::min(HASH_BLOCK_SIZE, data.size() - offset));
+        value = crc ? crc32(value, data.data() + offset, length) : adler32(value, data.data() + offset, length);
+    }
+    return bigEndian(static_cast<uint32_t>(value));
+}
+
+static std::vector<uint8_t> opensslDigest(const EVP_MD* md, const std::vector<uint8_t>& data) {
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(context, md, nullptr);
+    for (size_t offset = 0; offset < data.size(); offset += HASH_BLOCK_SIZE) {
+        EVP_DigestUpdate(context, data.data() + offset, std::min(HASH_BLOCK_SIZE, data.size() - offset));
+    }
+    std::vector<uint8_t> digest(EVP_MAX_MD_SIZE);
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(context, digest.data(), &length);
+    EVP_MD_CTX_free(context);
+    digest.resize(length);
+    return digest;
+}
+
+// zlib or OpenSSL for the algorithm, or nullptr if neither has it
+static std::function<std::vector<uint8_t>(const std::vector<uint8_t>&)> referenceFor(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HASH_CRC32:
+    case HASH_ADLER32: return [algorithm](const std::vector<uint8_t>& data) { return zlibDigest(algorithm, data); };
+    case HASH_MD5:     return [](const std::vector<uint8_t>& data) { return opensslDigest(EVP_md5(), data); };
+    case HASH_SHA1:    return [](const std::vector<uint8_t>& data) { return opensslDigest(EVP_sha1(), data); };
+    case HASH_SHA256:  return [](const std::vector<uint8_t>& data) { return opensslDigest(EVP_sha256(), data); };
+    default:           return nullptr;
+    }
+}
+
+static double gigabytesPerSecond(const std::vector<uint8_t>& data, double seconds) {
+    return data.size() / seconds / 1e9;
+}
+
+int main() {
+    const std::vector<uint8_t> data = RandomBytes(size_t(256) << 20);
+    printf("accelerations: %s\n", HashAccelerations().c_str());
+    printf("  %-9s %12s %9s %9s\n", "GB/s", "accelerated", "portable", "zlib/SSL");
+
+    bool ok = true;
+    for (int index = 0; index < HASH_ALGORITHM_COUNT; ++index) {
+        const HashAlgorithm algorithm = static_cast<HashAlgorithm>(index);
+
+        double seconds[2];
+        std::vector<uint8_t> digests[2];
+        for (int portable = 0; portable < 2; ++portable) {
+            SetHashAcceleration(!portable);
+            seconds[portable] = BestOf(3, [&] {
+                std::unique_ptr<Hasher> hasher = CreateHasher(algorithm);
+                for (size_t offset = 0; offset < data.size(); offset += HASH_BLOCK_SIZE) {
+                    hasher->update(data.data() + offset, std::min(HASH_BLOCK_SIZE, data.size() - offset));
+                }
+                digests[portable] = hasher->finish();
+            });
+        }
+        SetHashAcceleration(true);
+
+        printf("  %-9s %12.2f %9.2f", HashName(algorithm),
+            gigabytesPerSecond(data, seconds[0]), gigabytesPerSecond(data, seconds[1]));
+
+        bool matches = digests[0] == digests[1];
+        if (auto reference = referenceFor(algorithm)) {
+            std::vector<uint8_t> expected;
+            double referenceSeconds = BestOf(3, [&] { expected = reference(data); });
+            printf(" %9.2f", gigabytesPerSecond(data, referenceSeconds));
+            matches &= digests[0] == expected;
+        }
+        else {
+            printf(" %9s", "-");
+        }
+        printf("  %s%s\n", DigestText(digests[0]).c_str(), matches ? "" : "  MISMATCH");
+        ok &= matches;
+    }
+
+    double seconds = BestOf(1, [&] {
+        HashJob job(data.data(), data.size());
+        job.start([] {});
+        while (!job.finished()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    printf("HashJob, every algorithm, %u hardware threads: %.2f s\n", std::thread::hardware_concurrency(), seconds);
+    return ok ? 0 : 1;
+}
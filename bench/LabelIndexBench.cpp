@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------
+// LabelIndexBench - label queries over many annotations
+//-------------------------------------------------------------------
+// Labels as a struct template or signature scan writes them, such as
+// "Entry[48213].crc" or "PNG chunk 4821 IHDR", with field names drawn from a
+// skewed vocabulary, so some words are in most labels and some in a few.
+// Times the bulk build, queries from one hit to hundreds of thousands, a
+// serialized round trip, and queries after incremental edits. Every query
+// result is compared with a scan of the labels.
+//
+// Usage: LabelIndexBench [labels]     (default 10000000)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "Bench.h"
+#include "LabelIndex.h"
+
+const char* const STRUCTS[] = { "Entry", "Record", "Header", "Chunk", "Section", "Node", "Block", "Frame" };
+const char* const FIELDS[] = {
+    "size", "offset", "type", "flags", "crc", "name", "count", "length", "id", "data",
+    "magic", "version", "reserved", "padding", "checksum", "timestamp", "parent", "next",
+    "previous", "attributes", "compressedSize", "uncompressedSize", "nameLength", "extraLength",
+};
+const char* const CHUNKS[] = { "IHDR", "PLTE", "IDAT", "IEND", "tEXt", "zTXt", "gAMA", "pHYs" };
+
+static std::vector<Annotation> makeAnnotations(size_t count) {
+    std::mt19937_64 random(11);
+    std::vector<Annotation> annotations(count);
+    char label[64];
+    for (size_t i = 0; i < count; ++i) {
+        // Field names are skewed: the first few are in most labels
+        size_t field = std::min<size_t>(std::size(FIELDS) - 1, random() % 8 + random() % 8 * (random() % 4 == 0) * 3);
+        if (i % 64 == 63) {
+            snprintf(label, sizeof(label), "PNG chunk %zu %s", i / 64, CHUNKS[random() % std::size(CHUNKS)]);
+        }
+        else {
+            snprintf(label, sizeof(label), "%s[%zu].%s", STRUCTS[i / 4096 % std::size(STRUCTS)], i / 8, FIELDS[field]);
+        }
+        annotations[i] = Annotation{ static_cast<int>(i * 4), static_cast<int>(i * 4 + 3), label, "hex", 0 };
+    }
+    return annotations;
+}
+
+// Every label, read the slow way
+static std::vector<int> scan(const std::vector<Annotation>& annotations, std::string_view text, LabelMatch match) {
+    auto fold = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; };
+    std::string folded(text);
+    std::transform(folded.begin(), folded.end(), folded.begin(), fold);
+
+    std::vector<int> found;
+    std::string label;
+    for (size_t i = 0; i < annotations.size(); ++i) {
+        label.assign(annotations[i].label.view());
+        std::transform(label.begin(), label.end(), label.begin(), fold);
+        size_t at = label.find(folded);
+        if (!text.empty() && (match == LabelMatch::Prefix ? at == 0 : at != std::string::npos)) {
+            found.push_back(static_cast<int>(i));
+        }
+    }
+    std::sort(found.begin(), found.end(), [&](int a, int b) {
+        return std::make_pair(annotations[a].startOffset, a) < std::make_pair(annotations[b].startOffset, b);
+    });
+    return found;
+}
+
+struct Query {
+    const char* text;
+    LabelMatch match;
+};
+
+const Query QUERIES[] = {
+    { "Entry[4821].crc", LabelMatch::Substring },
+    { "chunk 48213 ", LabelMatch::Substring },
+    { "[48213]", LabelMatch::Substring },
+    { "record[1234", LabelMatch::Prefix },
+    { "uncompressedsize", LabelMatch::Substring },
+    { "IHDR", LabelMatch::Substring },
+    { "Section[", LabelMatch::Prefix },
+    { "checksum", LabelMatch::Substring },
+    { "crc", LabelMatch::Substring },
+    { "ze", LabelMatch::Substring },
+};
+
+static bool runQueries(const LabelIndex& index, const std::vector<Annotation>& annotations, const char* title) {
+    bool ok = true;
+    printf("%s\n", title);
+    for (const Query& query : QUERIES) {
+        std::vector<int> found;
+        double seconds = BestOf(3, [&] { found = index.find(annotations, query.text, query.match); });
+        printf("  %-9s %-20s %8zu hits  %8.3f ms\n", query.match == LabelMatch::Prefix ? "prefix" : "substring",
+            query.text, found.size(), seconds * 1e3);
+        if (found != scan(annotations, query.text, query.match)) {
+            printf("FAILED: results differ from a scan\n");
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    const size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000000;
+    std::vector<Annotation> annotations = makeAnnotations(count);
+
+    std::unique_ptr<LabelIndex> index;
+    double seconds = BestOf(1, [&] { index = std::make_unique<LabelIndex>(annotations); });
+    printf("%zu labels: bulk build %.2f s\n", count, seconds);
+    bool ok = runQueries(*index, annotations, "built");
+
+    std::string serialized;
+    index->serialize(serialized);
+    seconds = BestOf(1, [&] {
+        index = std::make_unique<LabelIndex>(reinterpret_cast<const BYTE*>(serialized.data()), serialized.size(), count);
+    });
+    printf("serialized %.0f MB, read back in %.2f s\n", serialized.size() / 1e6, seconds);
+    ok &= runQueries(*index, annotations, "read back");
+
+    // Edits as the undo journal reports them, short of forcing a rebuild
+    std::mt19937_64 random(5);
+    for (int edit = 0; edit < 3000; ++edit) {
+        size_t at = random() % annotations.size();
+        switch (edit % 3) {
+        case 0:
+            annotations[at].label = "Inserted[" + std::to_string(edit) + "].crc";
+            index->updated(annotations, at);
+            break;
+        case 1:
+            annotations.insert(annotations.begin() + at, Annotation{ annotations[at].startOffset, annotations[at].startOffset, "PNG chunk 48213 IHDR", "hex", 0 });
+            index->inserted(annotations, at);
+            break;
+        case 2:
+            annotations.erase(annotations.begin() + at);
+            index->erased(at);
+            break;
+        }
+    }
+    ok &= runQueries(*index, annotations, "after 3000 edits");
+    return ok ? 0 : 1;
+}
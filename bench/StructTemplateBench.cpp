@@ -0,0 +1,51 @@
+//-------------------------------------------------------------------
+// StructTemplateBench - applying templates to the whole file
+//-------------------------------------------------------------------
+// A fixed-size three-field record repeated a million times, which computes
+// each record start directly, and a variable-size record with a counted
+// name and a nested struct array, which has to be walked to find the starts.
+#include <Windows.h>
+#include <algorithm>
+#include <thread>
+#include "Bench.h"
+#include "StructTemplate.h"
+
+const int RECORDS = 1000000;
+
+int main() {
+    printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    StructPlan fixed = CompileStructTemplate("struct Record { uint32 a; float b; uint8 c[8]; };");
+    std::vector<BYTE> data = RandomBytes(static_cast<size_t>(fixed.fixedSize) * RECORDS);
+    std::vector<Annotation> annotations;
+    double seconds = BestOf(3, [&] {
+        annotations = ApplyStructTemplateRepeated(fixed, data, 0);
+    });
+    printf("fixed: %d records, %zu annotations in %.3f s (%.1f M annotations/s)\n",
+        RECORDS, annotations.size(), seconds, annotations.size() / seconds / 1e6);
+
+    Annotation array;
+    seconds = BestOf(3, [&] {
+        BuildRecordArray(fixed, data, 0, array);
+    });
+    printf("fixed as one record array: %.1f us\n", seconds * 1e6);
+
+    // Names of 0 to 15 bytes, so records are 15 to 30 bytes long
+    StructPlan variable = CompileStructTemplate(R"(
+        struct Point { int16 x; int16 y; };
+        struct Entry { uint16 id; uint8 nameLength; char name[nameLength]; Point points[3]; };
+    )");
+    data.clear();
+    std::mt19937 random(1);
+    for (int k = 0; k < RECORDS; ++k) {
+        uint8_t nameLength = static_cast<uint8_t>(random() % 16);
+        data.insert(data.end(), { static_cast<BYTE>(k), static_cast<BYTE>(k >> 8), nameLength });
+        data.insert(data.end(), nameLength + 12, 'x');
+    }
+    seconds = BestOf(3, [&] {
+        annotations = ApplyStructTemplateRepeated(variable, data, 0);
+    });
+    printf("variable: %d records, %zu annotations in %.3f s (%.1f M annotations/s)\n",
+        RECORDS, annotations.size(), seconds, annotations.size() / seconds / 1e6);
+    return 0;
+}
@@ -0,0 +1,318 @@
+//-------------------------------------------------------------------
+// AutosaveKillTest - durability of the autosave journal across kills
+//-------------------------------------------------------------------
+// Each round forks a child that opens the journal for a scratch document
+// and applies random annotation changes, reporting a hash of the set after
+// each one and "ack" whenever waitUntilCommitted returns. The parent kills
+// it with SIGKILL at a random moment, sometimes appends garbage to the
+// journal as a torn write would, then restores the autosave itself. The
+// restored set must be one the child reported, no older than the last
+// acknowledged one.
+//
+// Before the rounds it checks when the files are created and removed.
+//
+// Usage: AutosaveKillTest [rounds]     (default 50)
+#include <Windows.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "includes.h"
+#include "AutosaveJournal.h"
+
+const size_t DOCUMENT_SIZE = 1 << 20;
+
+static uint64_t hashAnnotations(const std::vector<Annotation>& annotations) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<const unsigned char*>(data)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    size_t count = annotations.size();
+    mix(&count, sizeof(count));
+    for (const Annotation& anno : annotations) {
+        mix(&anno.startOffset, sizeof(anno.startOffset));
+        mix(&anno.endOffset, sizeof(anno.endOffset));
+        mix(&anno.colorIndex, sizeof(anno.colorIndex));
+        mix(anno.label.data(), anno.label.size());
+        hash ^= 0xFF;
+        mix(anno.displayFormat.data(), anno.displayFormat.size());
+        hash ^= 0xFE;
+        if (anno.layout) {
+            mix(&anno.layout->stride, sizeof(anno.layout->stride));
+            mix(&anno.layout->count, sizeof(anno.layout->count));
+        }
+    }
+    return hash;
+}
+
+static Annotation randomAnnotation(std::mt19937& random) {
+    Annotation anno;
+    anno.startOffset = static_cast<int>(random() % (DOCUMENT_SIZE - 100));
+    anno.endOffset = anno.startOffset + static_cast<int>(random() % 64);
+    anno.colorIndex = static_cast<int>(random() % 6);
+    anno.label = "L" + std::to_string(random() % 100000);
+    anno.displayFormat = (random() & 1) ? "hex" : "int";
+
+    // Some record arrays, so layouts go through the string table too
+    if (random() % 10 == 0) {
+        auto layout = std::make_shared<RecordLayout>();
+        layout->stride = 8;
+        layout->count = 3;
+        layout->fields.push_back(RecordField{ "x y", 0, 4, "int", 1 });
+        anno.layout = layout;
+        anno.endOffset = anno.startOffset + layout->stride * layout->count - 1;
+    }
+    return anno;
+}
+
+// Apply random changes until killed, writing progress to the pipe
+[[noreturn]] static void runChild(int pipe, const std::string& path, unsigned seed) {
+    DocumentWindowState state;
+    state.fileName = path;
+    state.fileData.resize(DOCUMENT_SIZE);
+    if (!OpenAutosave(NULL, state)) {
+        StartAutosave(state);
+    }
+    if (!state.autosave) {
+        dprintf(pipe, "autosave did not start\n");
+        _exit(3);
+    }
+    dprintf(pipe, "state %llx\n", static_cast<unsigned long long>(hashAnnotations(state.annotations)));
+
+    std::mt19937 random(seed);
+    std::vector<Annotation>& annotations = state.annotations;
+    while (true) {
+        unsigned choice = random() % 20;
+        AnnotationDelta::Kind kind;
+        int index;
+        if (choice < 6 || annotations.empty()) {
+            kind = AnnotationDelta::Insert;
+            index = static_cast<int>(random() % (annotations.size() + 1));
+            annotations.insert(annotations.begin() + index, randomAnnotation(random));
+        }
+        else if (choice < 9) {
+            kind = AnnotationDelta::Erase;
+            index = static_cast<int>(random() % annotations.size());
+            annotations.erase(annotations.begin() + index);
+        }
+        else if (choice < 15) {
+            kind = AnnotationDelta::Update;
+            index = static_cast<int>(random() % annotations.size());
+            annotations[index] = randomAnnotation(random);
+        }
+        else if (choice < 16) {
+            kind = AnnotationDelta::ReplaceAll;
+            index = 0;
+            annotations.resize(random() % 200);
+            for (Annotation& anno : annotations) {
+                anno = randomAnnotation(random);
+            }
+        }
+        else if (choice < 18) {
+            kind = AnnotationDelta::Append;
+            index = static_cast<int>(annotations.size());
+            for (unsigned count = random() % 100; count > 0; --count) {
+                annotations.push_back(randomAnnotation(random));
+            }
+        }
+        else {
+            kind = AnnotationDelta::RemoveTail;
+            index = static_cast<int>(random() % (annotations.size() + 1));
+            annotations.erase(annotations.begin() + index, annotations.end());
+        }
+
+        dprintf(pipe, "state %llx\n", static_cast<unsigned long long>(hashAnnotations(annotations)));
+        JournalAnnotationChange(state, kind, index);
+
+        if (random() % 50 == 0) {
+            state.autosave->compact();
+        }
+        if (random() % 8 == 0) {
+            state.autosave->waitUntilCommitted();
+            dprintf(pipe, "ack\n");
+        }
+
+        std::string error = state.autosave->takeError();
+        if (!error.empty()) {
+            dprintf(pipe, "error %s\n", error.c_str());
+            _exit(4);
+        }
+    }
+}
+
+static bool exists(const std::string& path) {
+    return std::filesystem::exists(path);
+}
+
+// The journal appears with the first change, and both files go once the set
+// is empty or saved. Returns the number of failures.
+static int checkFileLifecycle(const std::string& path) {
+    const std::string snapshot = path + ".autosave.hva";
+    const std::string journal = path + ".autosave.hvj";
+    std::mt19937 random(7);
+    int failures = 0;
+    auto expect = [&](bool condition, const char* what) {
+        if (!condition) {
+            printf("lifecycle: FAIL, %s\n", what);
+            ++failures;
+        }
+    };
+
+    DocumentWindowState state;
+    state.fileName = path;
+    state.fileData.resize(DOCUMENT_SIZE);
+    expect(!OpenAutosave(NULL, state), "nothing to restore");
+    StartAutosave(state);
+    state.autosave->waitUntilCommitted();
+    expect(!exists(snapshot) && !exists(journal), "no files before the first change");
+
+    state.annotations.push_back(randomAnnotation(random));
+    JournalAnnotationChange(state, AnnotationDelta::Insert, 0);
+    state.autosave->waitUntilCommitted();
+    expect(!exists(snapshot) && exists(journal), "journal created by the first change");
+
+    state.annotations.clear();
+    JournalAnnotationChange(state, AnnotationDelta::RemoveTail, 0);
+    state.autosave->waitUntilCommitted();
+    expect(!exists(snapshot) && !exists(journal), "files removed once the set is empty");
+
+    state.annotations.push_back(randomAnnotation(random));
+    JournalAnnotationChange(state, AnnotationDelta::Insert, 0);
+    state.annotations.push_back(randomAnnotation(random));
+    JournalAnnotationChange(state, AnnotationDelta::Insert, 1);
+    state.autosave->compact();
+    state.autosave->waitUntilCommitted();
+    expect(exists(snapshot), "snapshot written by compaction");
+
+    AutosaveSaved(state);
+    state.autosave->waitUntilCommitted();
+    expect(!exists(snapshot) && !exists(journal), "files removed after saving");
+
+    // The saved set is no base to journal against, so the next change is a snapshot
+    state.annotations[0] = randomAnnotation(random);
+    JournalAnnotationChange(state, AnnotationDelta::Update, 0);
+    state.autosave->waitUntilCommitted();
+    expect(state.autosave->takeError().empty(), "no autosave error");
+    uint64_t expected = hashAnnotations(state.annotations);
+    state.autosave.reset();
+
+    DocumentWindowState restored;
+    restored.fileName = path;
+    restored.fileData.resize(DOCUMENT_SIZE);
+    expect(OpenAutosave(NULL, restored), "snapshot restored after saving");
+    expect(hashAnnotations(restored.annotations) == expected, "restored set matches");
+
+    restored.annotations.clear();
+    JournalAnnotationChange(restored, AnnotationDelta::ReplaceAll, 0);
+    restored.autosave.reset();
+    expect(!exists(snapshot) && !exists(journal), "files removed by an empty replacement");
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    const int rounds = argc > 1 ? atoi(argv[1]) : 50;
+
+    char directory[] = "/tmp/AutosaveKillTest.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    const std::string path = std::string(directory) + "/document.bin";
+    {
+        std::ofstream document(path, std::ios::binary);
+        document << std::string(DOCUMENT_SIZE, 'x');
+    }
+
+    std::mt19937 random(12345);
+    int failures = checkFileLifecycle(path);
+    size_t changes = 0, tornWrites = 0;
+
+    for (int round = 0; round < rounds; ++round) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            return 2;
+        }
+        const unsigned seed = random() ^ round;
+        pid_t child = fork();
+        if (child == 0) {
+            close(fds[0]);
+            runChild(fds[1], path, seed);
+        }
+        close(fds[1]);
+
+        usleep(20000 + random() % 300000);
+        kill(child, SIGKILL);
+        waitpid(child, NULL, 0);
+
+        std::string output;
+        char buffer[65536];
+        ssize_t count;
+        while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            output.append(buffer, count);
+        }
+        close(fds[0]);
+
+        // States in the order they were reached; the last line may be cut off
+        std::vector<std::string> states;
+        size_t acknowledged = 0;
+        size_t lineStart = 0, lineEnd;
+        while ((lineEnd = output.find('\n', lineStart)) != std::string::npos) {
+            std::string line = output.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+            if (line.rfind("state ", 0) == 0) {
+                states.push_back(line.substr(6));
+            }
+            else if (line == "ack") {
+                acknowledged = states.size() - 1;
+            }
+            else {
+                printf("round %d: child reported '%s'\n", round, line.c_str());
+                ++failures;
+            }
+        }
+        changes += states.size();
+
+        if (random() % 3 == 0) {
+            std::ofstream journal(path + ".autosave.hvj", std::ios::binary | std::ios::app);
+            for (unsigned bytes = random() % 40; bytes > 0; --bytes) {
+                journal.put(static_cast<char>(random()));
+            }
+            ++tornWrites;
+        }
+
+        DocumentWindowState state;
+        state.fileName = path;
+        state.fileData.resize(DOCUMENT_SIZE);
+        OpenAutosave(NULL, state);
+
+        char restored[32];
+        snprintf(restored, sizeof(restored), "%llx", static_cast<unsigned long long>(hashAnnotations(state.annotations)));
+        // The latest match, as a state may recur
+        auto found = std::find(states.rbegin(), states.rend(), std::string(restored));
+        size_t position = states.rend() - found - 1;
+        if (found == states.rend() || position < acknowledged) {
+            printf("round %d: FAIL, restored state %zu of %zu, last acknowledged %zu\n",
+                round, position, states.size(), acknowledged);
+            ++failures;
+        }
+        state.autosave.reset();
+    }
+
+    std::filesystem::remove_all(directory);
+
+    printf("AutosaveKillTest: %d rounds, %zu changes, %zu torn writes, %d failures\n",
+        rounds, changes, tornWrites, failures);
+    return failures != 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdio>
+
+// Checks for the tests. A failed check is reported with its line and the
+// test carries on; main returns CheckResult() so the run fails at the end.
+inline int checkFailures = 0;
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);  \
+            ++checkFailures;                                                    \
+        }                                                                       \
+    } while (0)
+
+inline int CheckResult(const char* test) {
+    printf("%s: %s\n", test, checkFailures ? "FAILED" : "ok");
+    return checkFailures != 0;
+}
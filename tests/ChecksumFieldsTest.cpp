@@ -0,0 +1,140 @@
+//-------------------------------------------------------------------
+// ChecksumFieldsTest - verification of checksum fields
+//-------------------------------------------------------------------
+// Matching and mismatched fields in each kind of algorithm, the errors shown
+// instead of a result, and re-verification after the covered annotation or
+// the field is resized, moved or relabelled.
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include "Check.h"
+#include "ChecksumFields.h"
+#include "Hashing.h"
+
+// The hashers themselves are checked against known answers in HashingTest
+static std::vector<uint8_t> digestOf(HashAlgorithm algorithm, const std::vector<BYTE>& data, int start, int end) {
+    std::unique_ptr<Hasher> hasher = CreateHasher(algorithm);
+    hasher->update(data.data() + start, static_cast<size_t>(end - start) + 1);
+    return hasher->finish();
+}
+
+static Annotation checksumField(int start, int end, const char* algorithm, const char* covered, bool bigEndian = false) {
+    Annotation field{ start, end, std::string("check of ") + covered, "hex", 0 };
+    field.checksum = std::make_shared<const ChecksumField>(ChecksumField{ algorithm, covered, bigEndian });
+    return field;
+}
+
+// Bytes 0..99 are covered; the fields follow from 100
+static DocumentWindowState makeDocument() {
+    DocumentWindowState state;
+    state.fileData.resize(256);
+    for (size_t i = 0; i < state.fileData.size(); ++i) {
+        state.fileData[i] = static_cast<BYTE>(i * 7 + 3);
+    }
+    state.annotations.push_back(Annotation{ 0, 99, "body", "hex", 0 });
+    return state;
+}
+
+static void checkStatuses() {
+    DocumentWindowState state = makeDocument();
+    std::vector<BYTE>& data = state.fileData;
+
+    // CRC-32, little-endian
+    std::vector<uint8_t> crc = digestOf(HASH_CRC32, data, 0, 99);
+    std::reverse(crc.begin(), crc.end());
+    memcpy(&data[100], crc.data(), 4);
+    state.annotations.push_back(checksumField(100, 103, "crc32", "body"));
+
+    // The same bytes read big-endian do not match
+    memcpy(&data[104], crc.data(), 4);
+    state.annotations.push_back(checksumField(104, 107, "crc32", "body", true));
+
+    // A two-byte big-endian byte sum
+    unsigned sum = 0;
+    for (int i = 0; i < 100; ++i) sum += data[i];
+    data[108] = static_cast<BYTE>(sum >> 8);
+    data[109] = static_cast<BYTE>(sum);
+    state.annotations.push_back(checksumField(108, 109, "sum", "body", true));
+
+    // A SHA-256 digest, as written
+    std::vector<uint8_t> sha = digestOf(HASH_SHA256, data, 0, 99);
+    memcpy(&data[110], sha.data(), sha.size());
+    state.annotations.push_back(checksumField(110, 141, "sha256", "body"));
+
+    // Errors: no such label, wrong width, unknown algorithm
+    state.annotations.push_back(checksumField(142, 145, "crc32", "nothing"));
+    state.annotations.push_back(checksumField(146, 148, "crc32", "body"));
+    state.annotations.push_back(checksumField(149, 152, "crc33", "body"));
+
+    VerifyAllChecksums(state);
+    CHECK(GetChecksumStatus(state, 0) == CHECKSUM_NONE);
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MATCH);
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MISMATCH);
+    CHECK(GetChecksumStatus(state, 3) == CHECKSUM_MATCH);
+    CHECK(GetChecksumStatus(state, 4) == CHECKSUM_MATCH);
+    for (size_t i = 5; i < 8; ++i) {
+        CHECK(GetChecksumStatus(state, i) == CHECKSUM_ERROR);
+        CHECK(!ChecksumStatusText(state, i).empty());
+    }
+
+    // A mismatch shows the value expected, in the field's byte order
+    std::vector<uint8_t> expected(crc.rbegin(), crc.rend());
+    CHECK(ChecksumStatusText(state, 2).find(DigestText(expected)) != std::string::npos);
+    CHECK(ChecksumStatusText(state, 0).empty());
+}
+
+static void checkEdits() {
+    DocumentWindowState state = makeDocument();
+    std::vector<BYTE>& data = state.fileData;
+    std::vector<uint8_t> crc = digestOf(HASH_CRC32, data, 0, 99);
+    std::reverse(crc.begin(), crc.end());
+    memcpy(&data[100], crc.data(), 4);
+    memcpy(&data[200], crc.data(), 4);
+    state.annotations.push_back(checksumField(100, 103, "crc32", "body"));
+    state.annotations.push_back(checksumField(100, 103, "crc32", "body"));
+    VerifyAllChecksums(state);
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MATCH);
+
+    // Resizing the covered annotation re-verifies both fields over it
+    state.annotations[0].endOffset = 98;
+    VerifyEditedChecksums(state, { 0 });
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MISMATCH);
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MISMATCH);
+    state.annotations[0].endOffset = 99;
+    VerifyEditedChecksums(state, { 0 });
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MATCH);
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MATCH);
+
+    // Moving a field re-verifies only that field
+    state.annotations[2].startOffset = 104;
+    state.annotations[2].endOffset = 107;
+    VerifyEditedChecksums(state, { 2 });
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MATCH);
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MISMATCH);
+    state.annotations[2].startOffset = 200;
+    state.annotations[2].endOffset = 203;
+    VerifyEditedChecksums(state, { 2 });
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MATCH);
+
+    // Relabelling the covered annotation leaves the fields without one, and
+    // a later annotation taking the label is covered instead
+    state.annotations[0].label = "renamed";
+    VerifyEditedChecksums(state, { 0 });
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_ERROR);
+    state.annotations.push_back(Annotation{ 0, 99, "body", "hex", 0 });
+    VerifyAppendedChecksums(state, 3);
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MATCH);
+
+    // Changing a declaration re-verifies with the new one
+    state.annotations[1].checksum = std::make_shared<const ChecksumField>(ChecksumField{ "adler32", "body", false });
+    VerifyEditedChecksums(state, { 1 });
+    CHECK(GetChecksumStatus(state, 1) == CHECKSUM_MISMATCH);
+    CHECK(GetChecksumStatus(state, 2) == CHECKSUM_MATCH);
+}
+
+int main() {
+    checkStatuses();
+    checkEdits();
+    return CheckResult("ChecksumFieldsTest");
+}
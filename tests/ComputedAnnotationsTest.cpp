@@ -0,0 +1,249 @@
+//-------------------------------------------------------------------
+// ComputedAnnotationsTest - incremental re-evaluation of a long chain
+//-------------------------------------------------------------------
+// 100k records laid end to end: each starts where the one before ends, takes
+// its length from a one-byte size field elsewhere in the document, and counts
+// one more than the one before. Editing a size field must re-evaluate only
+// the records from it to the end of the chain, which the test counts with
+// ComputedEvaluationCount. Erasing an annotation and undoing the erase must
+// likewise evaluate only what reads its label, and agree with a rebuild.
+#include <Windows.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "includes.h"
+#include "ComputedAnnotations.h"
+
+void InsertAnnotation(DocumentWindowState& state, int index, Annotation annotation);
+void UpdateAnnotation(DocumentWindowState& state, int index, Annotation annotation);
+void EraseAnnotation(DocumentWindowState& state, int index);
+void AppendAnnotations(DocumentWindowState& state, std::vector<Annotation>&& annotations);
+bool UndoAnnotationEdit(DocumentWindowState& state);
+bool RedoAnnotationEdit(DocumentWindowState& state);
+
+const int RECORDS = 100000;
+
+// Size fields are annotations 0 .. RECORDS - 1 over these bytes; the records
+// follow them
+const int SIZE_FIELDS_AT = 500000;
+
+static Annotation computedAnnotation(const std::string& label, std::string start, std::string length, std::string value) {
+    Annotation anno{ 0, 0, label, "hex", 0 };
+    anno.computed = std::make_shared<const ComputedFields>(ComputedFields{ std::move(start), std::move(length), std::move(value) });
+    return anno;
+}
+
+// Whether the records are contiguous from 0 with the lengths of their fields
+static bool chainIsLaidOut(const DocumentWindowState& state) {
+    int position = 0;
+    for (int k = 0; k < RECORDS; ++k) {
+        const Annotation& record = state.annotations[RECORDS + k];
+        int length = state.fileData[state.annotations[k].startOffset];
+        if (record.startOffset != position || record.endOffset != position + length - 1) {
+            printf("record %d is at %d..%d, expected %d..%d\n", k, record.startOffset, record.endOffset, position, position + length - 1);
+            return false;
+        }
+        position += length;
+    }
+    return true;
+}
+
+// Whether a graph built from scratch over the same annotations agrees with
+// the one kept up to date incrementally
+static bool matchesRebuild(const DocumentWindowState& state) {
+    DocumentWindowState fresh;
+    fresh.fileData = state.fileData;
+    fresh.annotations = state.annotations;
+    std::vector<int> changed;
+    EvaluateComputedAnnotations(fresh, changed);
+
+    for (size_t i = 0; i < state.annotations.size(); ++i) {
+        const Annotation& ours = state.annotations[i];
+        const Annotation& theirs = fresh.annotations[i];
+        std::string ourText, theirText;
+        bool ourValue = GetComputedValueText(state, i, ourText);
+        bool theirValue = GetComputedValueText(fresh, i, theirText);
+        if (ours.startOffset != theirs.startOffset || ours.endOffset != theirs.endOffset ||
+            ourValue != theirValue || ourText != theirText) {
+            printf("annotation %zu is %d..%d '%s', rebuilt %d..%d '%s'\n", i, ours.startOffset, ours.endOffset,
+                ourText.c_str(), theirs.startOffset, theirs.endOffset, theirText.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluates the changes noted since the last call; the work it did, or
+// SIZE_MAX if it had to rebuild
+static size_t evaluationsFor(DocumentWindowState& state, std::vector<int>& changed) {
+    changed.clear();
+    size_t before = ComputedEvaluationCount(state);
+    if (!EvaluateComputedAnnotations(state, changed)) {
+        return SIZE_MAX;
+    }
+    return ComputedEvaluationCount(state) - before;
+}
+
+int main() {
+    DocumentWindowState state;
+    state.fileData.resize(SIZE_FIELDS_AT + RECORDS + 16);
+    for (int k = 0; k < RECORDS + 16; ++k) {
+        state.fileData[SIZE_FIELDS_AT + k] = static_cast<BYTE>(1 + k % 4);
+    }
+
+    std::vector<Annotation> annotations;
+    for (int k = 0; k < RECORDS; ++k) {
+        annotations.push_back(Annotation{ SIZE_FIELDS_AT + k, SIZE_FIELDS_AT + k, "size" + std::to_string(k), "hex", 0 });
+    }
+    for (int k = 0; k < RECORDS; ++k) {
+        std::string previous = "{record" + std::to_string(k - 1) + "}";
+        annotations.push_back(computedAnnotation("record" + std::to_string(k),
+            k ? previous + ".end" : "0", "{size" + std::to_string(k) + "}", k ? previous + " + 1" : "1"));
+    }
+    AppendAnnotations(state, std::move(annotations));
+
+    std::vector<int> changed;
+    EvaluateComputedAnnotations(state, changed);
+    CHECK(ComputedEvaluationCount(state) == RECORDS);
+    CHECK(chainIsLaidOut(state));
+
+    std::string text;
+    CHECK(GetComputedValueText(state, 2 * RECORDS - 1, text));
+    CHECK(text.find(std::to_string(RECORDS)) != std::string::npos);
+
+    // Moving a size field to a byte of the same value re-evaluates its record,
+    // which comes out unchanged, so the rest of the chain is not woken
+    {
+        Annotation field = state.annotations[10];
+        field.startOffset = field.endOffset = SIZE_FIELDS_AT + 14;
+        UpdateAnnotation(state, 10, field);
+
+        changed.clear();
+        size_t before = ComputedEvaluationCount(state);
+        CHECK(EvaluateComputedAnnotations(state, changed));
+        CHECK(ComputedEvaluationCount(state) - before == 1);
+        CHECK(changed.empty());
+    }
+
+    // Each edit moves every record from the edited one to the end, and no
+    // other, so a tail edit evaluates a handful of records however long the
+    // chain is. Nothing is rebuilt. bench/ComputedAnnotationsBench times this.
+    for (int edited : { 0, 50000, 99000, 99990 }) {
+        Annotation field = state.annotations[edited];
+        field.startOffset = field.endOffset = SIZE_FIELDS_AT + edited + 1;
+        UpdateAnnotation(state, edited, field);
+
+        changed.clear();
+        size_t before = ComputedEvaluationCount(state);
+        bool incremental = EvaluateComputedAnnotations(state, changed);
+        size_t evaluated = ComputedEvaluationCount(state) - before;
+
+        printf("edit of size%d: %zu records re-evaluated\n", edited, evaluated);
+        CHECK(incremental);
+        CHECK(evaluated == static_cast<size_t>(RECORDS - edited));
+        CHECK(changed.size() == static_cast<size_t>(RECORDS - edited));
+        CHECK(chainIsLaidOut(state));
+    }
+
+    changed.clear();
+    CHECK(UndoAnnotationEdit(state));
+    size_t beforeUndo = ComputedEvaluationCount(state);
+    CHECK(EvaluateComputedAnnotations(state, changed));
+    CHECK(ComputedEvaluationCount(state) - beforeUndo == 10);
+    CHECK(changed.size() == 10);
+    CHECK(chainIsLaidOut(state));
+
+    // Removing and restoring an annotation shifts the graph instead of
+    // rebuilding it. A spare field labelled like size99990, on a byte of
+    // another value, stands in for it while it is gone, so only the records
+    // from 99990 on move.
+    const int erased = RECORDS - 10;
+    const int spare = 2 * RECORDS;
+    InsertAnnotation(state, spare, Annotation{ SIZE_FIELDS_AT + erased + 1, SIZE_FIELDS_AT + erased + 1,
+        "size" + std::to_string(erased), "hex", 0 });
+    CHECK(evaluationsFor(state, changed) == 0);
+
+    EraseAnnotation(state, erased);
+    size_t evaluated = evaluationsFor(state, changed);
+    printf("erase of size%d: %zu records re-evaluated\n", erased, evaluated);
+    CHECK(evaluated == 10);
+    CHECK(changed.size() == 10);
+    CHECK(state.annotations[RECORDS - 1 + erased].endOffset - state.annotations[RECORDS - 1 + erased].startOffset + 1 ==
+        state.fileData[SIZE_FIELDS_AT + erased + 1]);
+    CHECK(matchesRebuild(state));
+
+    CHECK(UndoAnnotationEdit(state));
+    evaluated = evaluationsFor(state, changed);
+    printf("undo of the erase: %zu records re-evaluated\n", evaluated);
+    CHECK(evaluated == 10);
+    CHECK(changed.size() == 10);
+    CHECK(chainIsLaidOut(state));
+    CHECK(matchesRebuild(state));
+
+    CHECK(RedoAnnotationEdit(state));
+    CHECK(evaluationsFor(state, changed) == 10);
+    CHECK(matchesRebuild(state));
+    CHECK(UndoAnnotationEdit(state));
+    CHECK(evaluationsFor(state, changed) == 10);
+    CHECK(chainIsLaidOut(state));
+
+    // Nothing reads the spare, so erasing it evaluates nothing
+    EraseAnnotation(state, spare);
+    CHECK(evaluationsFor(state, changed) == 0);
+    CHECK(changed.empty());
+
+    // With no stand-in the record reading the field breaks, and the records
+    // after it fail with it without their expressions being rebuilt
+    EraseAnnotation(state, erased);
+    CHECK(evaluationsFor(state, changed) == 9);
+    CHECK(changed.size() == 10);
+    CHECK(GetComputedValueText(state, RECORDS - 1 + erased, text) && text == "#REF");
+    CHECK(GetComputedValueText(state, 2 * RECORDS - 2, text) && text == "#INPUT");
+    CHECK(matchesRebuild(state));
+
+    // Restoring a label that something failed to find needs a rebuild
+    CHECK(UndoAnnotationEdit(state));
+    CHECK(evaluationsFor(state, changed) == SIZE_MAX);
+    CHECK(chainIsLaidOut(state));
+
+    // Erasing a record takes its node out of the graph
+    EraseAnnotation(state, RECORDS + erased);
+    CHECK(evaluationsFor(state, changed) == 8);
+    CHECK(matchesRebuild(state));
+    CHECK(UndoAnnotationEdit(state));
+    CHECK(evaluationsFor(state, changed) == SIZE_MAX);
+    CHECK(chainIsLaidOut(state));
+
+    // Errors show in place of the value
+    size_t first = state.annotations.size();
+    InsertAnnotation(state, static_cast<int>(first), computedAnnotation("cycle1", "", "", "{cycle2} + 1"));
+    InsertAnnotation(state, static_cast<int>(first + 1), computedAnnotation("cycle2", "", "", "{cycle1} + 1"));
+    InsertAnnotation(state, static_cast<int>(first + 2), computedAnnotation("missing", "", "", "{nothing}"));
+    InsertAnnotation(state, static_cast<int>(first + 3), computedAnnotation("divide", "", "", "{size1} / ({size0} - {size0})"));
+    InsertAnnotation(state, static_cast<int>(first + 4), computedAnnotation("arithmetic", "", "", "-(3 << 4 | 1) ^ ~0 + 17 % 5"));
+    changed.clear();
+    EvaluateComputedAnnotations(state, changed);
+    for (size_t i = first; i < first + 4; ++i) {
+        CHECK(!ComputedAnnotationError(state, i).empty());
+    }
+    CHECK(ComputedAnnotationError(state, first + 4).empty());
+    CHECK(GetComputedValueText(state, first + 4, text));
+    CHECK(text.find(std::to_string(-(3 << 4 | 1) ^ (~0 + 17 % 5))) != std::string::npos);
+
+    for (const char* invalid : { "1+", "{a", "{a}.foo", "((1)", "0x", "12ab", "1 2" }) {
+        bool rejected = false;
+        try {
+            CheckComputedExpression(invalid);
+        }
+        catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        CHECK(rejected);
+    }
+
+    return CheckResult("ComputedAnnotationsTest");
+}
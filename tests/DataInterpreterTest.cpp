@@ -0,0 +1,255 @@
+//-------------------------------------------------------------------
+// DataInterpreterTest - golden values and cross-checks of the grid
+//-------------------------------------------------------------------
+// Every row in both byte orders against values worked out by hand, then
+// random inputs against the C library: gmtime for the dates, printf for the
+// floats and integers, and an independent encoder for the varints.
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "DataInterpreter.h"
+
+template <typename T>
+static std::vector<uint8_t> littleEndian(T value) {
+    std::vector<uint8_t> bytes(sizeof(T));
+    memcpy(bytes.data(), &value, sizeof(T));
+    return bytes;
+}
+
+static std::string interpret(const std::vector<uint8_t>& bytes, DataType type, ByteOrder order = BO_LITTLE_ENDIAN) {
+    DataInterpretation interpretation;
+    InterpretData(bytes.data(), bytes.size(), interpretation);
+    return interpretation.text[type][order];
+}
+
+// Reports the first few mismatches of a bulk check in full
+static void expectText(const char* what, const std::string& got, const std::string& expected) {
+    if (got != expected) {
+        if (checkFailures < 10) {
+            printf("%s: got '%s', expected '%s'\n", what, got.c_str(), expected.c_str());
+        }
+        ++checkFailures;
+    }
+}
+
+static void checkGoldenValues() {
+    CHECK(interpret({ 0xFF }, DT_BYTE) == "-1 (0xff)");
+    CHECK(interpret({ 0xFF }, DT_UBYTE) == "255 (0xff)");
+    CHECK(interpret({ 0x80 }, DT_BYTE) == "-128 (0x80)");
+    CHECK(interpret({ 0x7F }, DT_BYTE, BO_BIG_ENDIAN) == "");
+    CHECK(interpret(littleEndian<int16_t>(-2), DT_SHORT) == "-2 (0xfffe)");
+    CHECK(interpret(littleEndian<int16_t>(-2), DT_USHORT) == "65534 (0xfffe)");
+    CHECK(interpret({ 0x12, 0x34 }, DT_SHORT, BO_BIG_ENDIAN) == "4660 (0x1234)");
+    CHECK(interpret({ 0xFF, 0xFE }, DT_SHORT, BO_BIG_ENDIAN) == "-2 (0xfffe)");
+    CHECK(interpret({ 1, 2, 3 }, DT_SHORT) == "513 (0x201)");
+
+    CHECK(interpret({ 0xFE, 0xFF, 0xFF }, DT_INT24) == "-2 (0xfffffe)");
+    CHECK(interpret({ 0xFE, 0xFF, 0xFF }, DT_UINT24) == "16777214 (0xfffffe)");
+    CHECK(interpret({ 0x01, 0x02, 0x03 }, DT_INT24, BO_BIG_ENDIAN) == "66051 (0x10203)");
+    CHECK(interpret({ 0x80, 0, 0 }, DT_INT24, BO_BIG_ENDIAN) == "-8388608 (0x800000)");
+    CHECK(interpret({ 1, 2 }, DT_INT24, BO_BIG_ENDIAN) == "Not enough data");
+
+    CHECK(interpret(littleEndian<int32_t>(0x12345678), DT_INT) == "305419896 (0x12345678)");
+    CHECK(interpret(littleEndian<int32_t>(-1), DT_INT) == "-1 (0xffffffff)");
+    CHECK(interpret(littleEndian<uint32_t>(4000000000u), DT_UINT) == "4000000000 (0xee6b2800)");
+    CHECK(interpret({ 1, 2, 3, 4 }, DT_INT, BO_BIG_ENDIAN) == "16909060 (0x1020304)");
+    CHECK(interpret({ 1, 2, 3 }, DT_INT) == "Not enough data");
+    CHECK(interpret(littleEndian<int64_t>(INT64_MIN), DT_INT64) == "-9223372036854775808 (0x8000000000000000)");
+    CHECK(interpret(littleEndian<uint64_t>(UINT64_MAX), DT_UINT64) == "18446744073709551615 (0xffffffffffffffff)");
+    CHECK(interpret({ 0, 0, 0, 0, 0, 0, 1, 0 }, DT_UINT64, BO_BIG_ENDIAN) == "256 (0x100)");
+
+    CHECK(interpret({ 0x00, 0x3C }, DT_HALF) == "1");
+    CHECK(interpret({ 0x3C, 0x00 }, DT_HALF, BO_BIG_ENDIAN) == "1");
+    CHECK(interpret({ 0x00, 0xC0 }, DT_HALF) == "-2");
+    CHECK(interpret({ 0xFF, 0x7B }, DT_HALF) == "65504");
+    CHECK(interpret({ 0x01, 0x00 }, DT_HALF) == "0.000000059604645");
+    CHECK(interpret({ 0x55, 0x35 }, DT_HALF) == "0.33325195");
+    CHECK(interpret({ 0x00, 0x7C }, DT_HALF) == "inf");
+    CHECK(interpret({ 0x00, 0xFC }, DT_HALF) == "-inf");
+    CHECK(interpret({ 0x01, 0x7E }, DT_HALF) == "nan");
+    CHECK(interpret({ 0x80, 0x3F }, DT_BFLOAT16) == "1");
+    CHECK(interpret({ 0x3F, 0x80 }, DT_BFLOAT16, BO_BIG_ENDIAN) == "1");
+    CHECK(interpret({ 0x49, 0x40 }, DT_BFLOAT16) == "3.140625");
+    CHECK(interpret(littleEndian<float>(1.5f), DT_FLOAT) == "1.500000");
+    CHECK(interpret(littleEndian<float>(-0.1f), DT_FLOAT) == "-0.100000");
+    CHECK(interpret({ 0x40, 0x49, 0x0F, 0xDB }, DT_FLOAT, BO_BIG_ENDIAN) == "3.141593");
+    CHECK(interpret(littleEndian<double>(3.14159265358979), DT_DOUBLE) == "3.1415926536");
+    CHECK(interpret(littleEndian<double>(NAN), DT_DOUBLE) == "nan");
+    CHECK(interpret(littleEndian<double>(-INFINITY), DT_DOUBLE) == "-inf");
+    CHECK(interpret({ 1, 2, 3, 4, 5, 6, 7 }, DT_DOUBLE) == "Not enough data");
+    {
+        char expected[400];
+        snprintf(expected, sizeof(expected), "%.10f", 1e300);
+        CHECK(interpret(littleEndian<double>(1e300), DT_DOUBLE) == expected);
+    }
+
+    CHECK(interpret({ 0x80, 0xFF }, DT_FIXED_8_8) == "-0.5");
+    CHECK(interpret({ 0x01, 0x80 }, DT_FIXED_8_8, BO_BIG_ENDIAN) == "1.5");
+    CHECK(interpret({ 0x01, 0x00, 0x00, 0x00 }, DT_FIXED_16_16) == "0.0000152587890625");
+    CHECK(interpret({ 0x00, 0x01, 0x80, 0x00 }, DT_FIXED_16_16, BO_BIG_ENDIAN) == "1.5");
+    CHECK(interpret({ 0x00, 0x00, 0x00, 0x80 }, DT_FIXED_16_16) == "-32768");
+
+    CHECK(interpret({ 0x00 }, DT_ULEB128) == "0 (1 byte)");
+    CHECK(interpret({ 0xE5, 0x8E, 0x26 }, DT_ULEB128) == "624485 (3 bytes)");
+    CHECK(interpret({ 0xE5, 0x8E, 0x26 }, DT_ULEB128, BO_BIG_ENDIAN) == "");
+    CHECK(interpret({ 0xC0, 0xBB, 0x78 }, DT_SLEB128) == "-123456 (3 bytes)");
+    CHECK(interpret({ 0x7F }, DT_SLEB128) == "-1 (1 byte)");
+    CHECK(interpret({ 0x3F }, DT_SLEB128) == "63 (1 byte)");
+    CHECK(interpret({ 0x80, 0x80 }, DT_ULEB128) == "Not enough data");
+    CHECK(interpret({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 }, DT_ULEB128) == "18446744073709551615 (10 bytes)");
+    CHECK(interpret({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x02 }, DT_ULEB128) == "Out of range");
+    CHECK(interpret({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x81 }, DT_ULEB128) == "Out of range");
+    CHECK(interpret({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x80, 0x00 }, DT_ULEB128) == "Out of range");
+    CHECK(interpret({ 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7F }, DT_SLEB128) == "-9223372036854775808 (10 bytes)");
+    CHECK(interpret({ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 }, DT_SLEB128) == "9223372036854775807 (10 bytes)");
+
+    CHECK(interpret({ 'H', 'e', 'l', 'l', 'o', 0, 'x' }, DT_STRING) == "Hello");
+    CHECK(interpret({ 'A', 1, 'B' }, DT_STRING) == "A.B");
+    CHECK(interpret({ 0, 'A' }, DT_STRING) == "");
+    CHECK(interpret({ 'A' }, DT_STRING, BO_BIG_ENDIAN) == "");
+    CHECK(interpret({ 'H', 0, 'i', 0, 0, 0 }, DT_UNICODE_STRING) == "Hi");
+    CHECK(interpret({ 'H', 0, 0x3A, 0x26 }, DT_UNICODE_STRING) == "H.");
+    CHECK(interpret({ 0, 'H', 0, 'i', 0, 0 }, DT_UNICODE_STRING) == "..");
+    CHECK(interpret({ 0, 'H', 0, 'i', 0, 0 }, DT_UNICODE_STRING, BO_BIG_ENDIAN) == "Hi");
+    CHECK(interpret({ 'A' }, DT_UNICODE_STRING, BO_BIG_ENDIAN) == "Not enough data");
+
+    CHECK(interpret(littleEndian<int32_t>(0), DT_TIME_T) == "1970-01-01 00:00:00");
+    CHECK(interpret(littleEndian<int32_t>(INT32_MAX), DT_TIME_T) == "2038-01-19 03:14:07");
+    CHECK(interpret(littleEndian<int32_t>(-1), DT_TIME_T) == "1969-12-31 23:59:59");
+    CHECK(interpret(littleEndian<int32_t>(INT32_MIN), DT_TIME_T) == "1901-12-13 20:45:52");
+    CHECK(interpret({ 0x7F, 0xFF, 0xFF, 0xFF }, DT_TIME_T, BO_BIG_ENDIAN) == "2038-01-19 03:14:07");
+    CHECK(interpret(littleEndian<int64_t>(951782400), DT_TIME64_T) == "2000-02-29 00:00:00");
+    CHECK(interpret(littleEndian<int64_t>(253402300799), DT_TIME64_T) == "9999-12-31 23:59:59");
+    CHECK(interpret(littleEndian<int64_t>(253402300800), DT_TIME64_T) == "Out of range");
+    CHECK(interpret(littleEndian<int64_t>(-62135596800), DT_TIME64_T) == "0001-01-01 00:00:00");
+    CHECK(interpret(littleEndian<int64_t>(-62135596801), DT_TIME64_T) == "Out of range");
+    CHECK(interpret(littleEndian<int64_t>(INT64_MIN), DT_TIME64_T) == "Out of range");
+    CHECK(interpret(littleEndian<int64_t>(INT64_MAX), DT_TIME64_T) == "Out of range");
+
+    CHECK(interpret(littleEndian<double>(0.0), DT_OLETIME) == "1899-12-30 00:00:00");
+    CHECK(interpret(littleEndian<double>(2.5), DT_OLETIME) == "1900-01-01 12:00:00");
+    CHECK(interpret(littleEndian<double>(-1.25), DT_OLETIME) == "1899-12-29 06:00:00");
+    CHECK(interpret(littleEndian<double>(45000.75), DT_OLETIME) == "2023-03-15 18:00:00");
+    CHECK(interpret({ 0x40, 0xE5, 0xF9, 0x18, 0, 0, 0, 0 }, DT_OLETIME, BO_BIG_ENDIAN) == "2023-03-15 18:00:00");
+    CHECK(interpret(littleEndian<double>(36526.99998), DT_OLETIME) == "2000-01-01 23:59:58");
+    CHECK(interpret(littleEndian<double>(36526.9999999), DT_OLETIME) == "2000-01-02 00:00:00");
+    CHECK(interpret(littleEndian<double>(NAN), DT_OLETIME) == "Out of range");
+    CHECK(interpret(littleEndian<double>(1e7), DT_OLETIME) == "Out of range");
+}
+
+// Every half, decoded here by its definition, in shortest form
+static void checkAllHalves() {
+    for (uint32_t bits = 0; bits < 65536; ++bits) {
+        int exponent = (bits >> 10) & 0x1F;
+        int mantissa = bits & 0x3FF;
+        float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24)
+            : exponent == 31 ? (mantissa ? NAN : INFINITY)
+            : std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+        if (bits & 0x8000) {
+            value = -value;
+        }
+
+        char expected[64];
+        *std::to_chars(expected, expected + sizeof(expected), value, std::chars_format::fixed).ptr = '\0';
+        char what[32];
+        snprintf(what, sizeof(what), "half %04x", bits);
+        expectText(what, interpret({ static_cast<uint8_t>(bits), static_cast<uint8_t>(bits >> 8) }, DT_HALF), expected);
+    }
+}
+
+static void checkRandomVarints(std::mt19937_64& random) {
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t value = random() >> (random() % 64);
+        int64_t signedValue = static_cast<int64_t>(value) * ((i & 1) ? -1 : 1);
+
+        std::vector<uint8_t> encoded;
+        uint64_t rest = value;
+        do {
+            uint8_t byte = rest & 0x7F;
+            rest >>= 7;
+            encoded.push_back(rest ? byte | 0x80 : byte);
+        } while (rest);
+
+        std::vector<uint8_t> signedEncoded;
+        int64_t signedRest = signedValue;
+        while (true) {
+            uint8_t byte = signedRest & 0x7F;
+            signedRest >>= 7;
+            bool last = (signedRest == 0 && !(byte & 0x40)) || (signedRest == -1 && (byte & 0x40));
+            signedEncoded.push_back(last ? byte : byte | 0x80);
+            if (last) {
+                break;
+            }
+        }
+
+        char expected[64];
+        snprintf(expected, sizeof(expected), "%llu (%zu byte%s)", static_cast<unsigned long long>(value),
+            encoded.size(), encoded.size() == 1 ? "" : "s");
+        expectText("ULEB128", interpret(encoded, DT_ULEB128), expected);
+        snprintf(expected, sizeof(expected), "%lld (%zu byte%s)", static_cast<long long>(signedValue),
+            signedEncoded.size(), signedEncoded.size() == 1 ? "" : "s");
+        expectText("SLEB128", interpret(signedEncoded, DT_SLEB128), expected);
+    }
+}
+
+static std::string formatTime(time_t time) {
+    struct tm parts;
+    if (!gmtime_r(&time, &parts) || parts.tm_year + 1900 < 1 || parts.tm_year + 1900 > 9999) {
+        return "Out of range";
+    }
+    char text[64];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d:%02d", parts.tm_year + 1900, parts.tm_mon + 1,
+        parts.tm_mday, parts.tm_hour, parts.tm_min, parts.tm_sec);
+    return text;
+}
+
+// Random 8-byte values, half of them seconds within a few thousand years
+// of 1970 so the dates are mostly in range
+static void checkAgainstCLibrary(std::mt19937_64& random) {
+    for (int i = 0; i < 2000000; ++i) {
+        uint64_t bits = random();
+        if (i & 1) {
+            bits = static_cast<uint64_t>(static_cast<int64_t>(bits % 500000000000ull) - 62000000000ll);
+        }
+        DataInterpretation interpretation;
+        InterpretData(reinterpret_cast<const uint8_t*>(&bits), sizeof(bits), interpretation);
+        auto text = [&](DataType type) { return std::string(interpretation.text[type][BO_LITTLE_ENDIAN]); };
+
+        expectText("time64_t", text(DT_TIME64_T), formatTime(static_cast<time_t>(static_cast<int64_t>(bits))));
+        expectText("time_t", text(DT_TIME_T), formatTime(static_cast<int32_t>(bits)));
+
+        char expected[400];
+        float single;
+        memcpy(&single, &bits, sizeof(single));
+        snprintf(expected, sizeof(expected), "%.6f", single);
+        expectText("float", text(DT_FLOAT), expected);
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        snprintf(expected, sizeof(expected), "%.10f", value);
+        expectText("double", text(DT_DOUBLE), expected);
+
+        snprintf(expected, sizeof(expected), "%d (0x%x)", static_cast<int8_t>(bits), static_cast<uint8_t>(bits));
+        expectText("byte", text(DT_BYTE), expected);
+        snprintf(expected, sizeof(expected), "%d (0x%x)", static_cast<int16_t>(bits), static_cast<uint16_t>(bits));
+        expectText("short", text(DT_SHORT), expected);
+        snprintf(expected, sizeof(expected), "%d (0x%x)", static_cast<int32_t>(bits), static_cast<uint32_t>(bits));
+        expectText("int", text(DT_INT), expected);
+        snprintf(expected, sizeof(expected), "%lld (0x%llx)", static_cast<long long>(bits), static_cast<unsigned long long>(bits));
+        expectText("int64", text(DT_INT64), expected);
+    }
+}
+
+int main() {
+    checkGoldenValues();
+    checkAllHalves();
+    std::mt19937_64 random(3);
+    checkRandomVarints(random);
+    checkAgainstCLibrary(random);
+    return CheckResult("DataInterpreterTest");
+}
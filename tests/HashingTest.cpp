@@ -0,0 +1,128 @@
+//-------------------------------------------------------------------
+// HashingTest - known answers for every hash and checksum
+//-------------------------------------------------------------------
+// Each algorithm hashes the standard check input "123456789", the empty
+// input, a million 'a's and a patterned buffer, with the accelerated paths
+// and then the portable ones. Every input is hashed whole and then fed in
+// random pieces, so blocks and carries split across update calls are
+// covered. The expected digests come from zlib, hashlib and the published
+// check values, not from this code.
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "Hashing.h"
+
+struct KnownAnswers {
+    const char* name;
+    std::vector<uint8_t> input;
+    const char* digests[HASH_ALGORITHM_COUNT];    // In HashAlgorithm order
+};
+
+static std::vector<uint8_t> bytesOf(const std::string& text) {
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+static std::vector<uint8_t> pattern(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = static_cast<uint8_t>(i * i + 7 * i + 3);
+    }
+    return bytes;
+}
+
+static std::string digestOf(HashAlgorithm algorithm, const std::vector<uint8_t>& input,
+    const std::vector<size_t>& pieces) {
+    std::unique_ptr<Hasher> hasher = CreateHasher(algorithm);
+    size_t offset = 0;
+    for (size_t piece : pieces) {
+        hasher->update(input.data() + offset, piece);
+        offset += piece;
+    }
+    hasher->update(input.data() + offset, input.size() - offset);
+    return DigestText(hasher->finish());
+}
+
+// Piece sizes summing to at most size, mostly short so that every
+// alignment and partial block turns up, with the odd long one
+static std::vector<size_t> randomPieces(size_t size, std::mt19937& generator) {
+    std::vector<size_t> pieces;
+    size_t used = 0;
+    while (used < size) {
+        size_t limit = generator() % 8 == 0 ? 100000 : 200;
+        size_t piece = std::min<size_t>(generator() % limit, size - used);
+        pieces.push_back(piece);
+        used += piece;
+    }
+    return pieces;
+}
+
+int main() {
+    const KnownAnswers cases[] = {
+        { "check input", bytesOf("123456789"), {
+            "cbf43926", "e3069283", "091e01de",
+            "25f9e794323b453885f5181f1b624d0b",
+            "f7c3bc1d808e04732adf679965ccc34ca7ae3441",
+            "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225",
+            "8cb841db40e6ae83" } },
+        { "empty", {}, {
+            "00000000", "00000000", "00000001",
+            "d41d8cd98f00b204e9800998ecf8427e",
+            "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+            "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+            "ef46db3751d8e999" } },
+        { "a million a's", std::vector<uint8_t>(1000000, 'a'), {
+            "dc25bfbc", "436fe240", "15d870f9",
+            "7707d6ae4e027c70eea2a935c2296f21",
+            "34aa973cd4c4daa4f61eeb2bdbad27316534016f",
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+            "dc483aaa9b4fdc40" } },
+        { "pattern", pattern(100003), {
+            "af9f86f2", "8d07454d", "87635c91",
+            "8ddd3f23d1881dfa832d371b70cecb0a",
+            "be8ce22323e5c8e12d0e5df7934a662b5126479f",
+            "34fd458174eb161f9024406b43fd5eafac8cec551c663538ad1965518347006e",
+            "16b02912ebd21644" } },
+    };
+
+    std::mt19937 generator(2024);
+    for (bool accelerated : { true, false }) {
+        SetHashAcceleration(accelerated);
+        printf("%s: %s\n", accelerated ? "accelerated" : "portable", HashAccelerations().c_str());
+
+        for (const KnownAnswers& known : cases) {
+            for (int index = 0; index < HASH_ALGORITHM_COUNT; ++index) {
+                const HashAlgorithm algorithm = static_cast<HashAlgorithm>(index);
+                std::string whole = digestOf(algorithm, known.input, {});
+                if (whole != known.digests[index]) {
+                    printf("  %s of %s: %s, expected %s\n", HashName(algorithm), known.name,
+                        whole.c_str(), known.digests[index]);
+                }
+                CHECK(whole == known.digests[index]);
+
+                for (int split = 0; split < 20; ++split) {
+                    std::vector<size_t> pieces = randomPieces(known.input.size(), generator);
+                    CHECK(digestOf(algorithm, known.input, pieces) == known.digests[index]);
+                }
+            }
+        }
+    }
+    SetHashAcceleration(true);
+
+    // The running checksum functions continue across calls like the hashers
+    std::vector<uint8_t> input = pattern(100003);
+    uint32_t crc = 0, crcc = 0, adler = 1;
+    for (size_t offset = 0, piece = 1; offset < input.size(); offset += piece, piece = piece * 3 + 1) {
+        size_t length = std::min(piece, input.size() - offset);
+        crc = Crc32(input.data() + offset, length, crc);
+        crcc = Crc32c(input.data() + offset, length, crcc);
+        adler = Adler32(input.data() + offset, length, adler);
+    }
+    CHECK(crc == 0xaf9f86f2);
+    CHECK(crcc == 0x8d07454d);
+    CHECK(adler == 0x87635c91);
+    CHECK(Xxh64(input.data(), input.size(), 0) == 0x16b02912ebd21644ull);
+
+    return CheckResult("HashingTest");
+}
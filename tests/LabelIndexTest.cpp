@@ -0,0 +1,175 @@
+//-------------------------------------------------------------------
+// LabelIndexTest - label queries against a scan of the labels
+//-------------------------------------------------------------------
+// Random labels over a small alphabet, so trigrams are shared widely and the
+// index returns many candidates that are not matches. Every substring and
+// prefix query is compared with a scan: on the bulk index, under random
+// inserts, erases, updates, appends and tail removals, and after the index
+// has been saved with the annotations and read back.
+#include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include "Check.h"
+#include "AnnotationFile.h"
+#include "LabelIndex.h"
+
+static std::mt19937 generator(3);
+
+static std::string randomText(size_t minLength, size_t maxLength) {
+    static const char alphabet[] = "abcABC[]0.";
+    std::string text(minLength + generator() % (maxLength - minLength + 1), ' ');
+    for (char& c : text) {
+        c = alphabet[generator() % (sizeof(alphabet) - 1)];
+    }
+    return text;
+}
+
+static Annotation randomAnnotation() {
+    int start = static_cast<int>(generator() % 100000);
+    return Annotation{ start, start + static_cast<int>(generator() % 16), randomText(0, 12), "hex", 0 };
+}
+
+static std::vector<int> scan(const std::vector<Annotation>& annotations, std::string_view text, LabelMatch match) {
+    auto fold = [](char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : c; };
+    std::string folded(text);
+    std::transform(folded.begin(), folded.end(), folded.begin(), fold);
+
+    std::vector<int> found;
+    for (size_t i = 0; i < annotations.size() && !text.empty(); ++i) {
+        std::string label = annotations[i].label.str();
+        std::transform(label.begin(), label.end(), label.begin(), fold);
+        size_t at = label.find(folded);
+        if (match == LabelMatch::Prefix ? at == 0 : at != std::string::npos) {
+            found.push_back(static_cast<int>(i));
+        }
+    }
+    std::sort(found.begin(), found.end(), [&](int a, int b) {
+        return std::make_pair(annotations[a].startOffset, a) < std::make_pair(annotations[b].startOffset, b);
+    });
+    return found;
+}
+
+// Queries taken from the labels, so most have matches, and random ones
+static bool queriesMatchScan(const LabelIndex& index, const std::vector<Annotation>& annotations) {
+    for (int q = 0; q < 100; ++q) {
+        std::string text;
+        if (q % 2 == 0 && !annotations.empty()) {
+            std::string label = annotations[generator() % annotations.size()].label.str();
+            size_t at = label.empty() ? 0 : generator() % label.size();
+            text = label.substr(at, 1 + generator() % 6);
+        }
+        else {
+            text = randomText(1, 5);
+        }
+        for (LabelMatch match : { LabelMatch::Substring, LabelMatch::Prefix }) {
+            if (index.find(annotations, text, match) != scan(annotations, text, match)) {
+                printf("results differ from a scan for %s \"%s\"\n", match == LabelMatch::Prefix ? "prefix" : "substring", text.c_str());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void checkBulk(const std::vector<Annotation>& annotations) {
+    LabelIndex index(annotations);
+    CHECK(index.isCompact());
+    CHECK(queriesMatchScan(index, annotations));
+    CHECK(index.find(annotations, "", LabelMatch::Substring).empty());
+}
+
+static void checkIncremental(std::vector<Annotation> annotations) {
+    LabelIndex index(annotations);
+    for (int round = 0; round < 10; ++round) {
+        for (int edit = 0; edit < 200; ++edit) {
+            size_t at = annotations.empty() ? 0 : generator() % annotations.size();
+            int kind = annotations.empty() ? 0 : generator() % 5;
+            switch (kind) {
+            case 0:
+                annotations.insert(annotations.begin() + at, randomAnnotation());
+                index.inserted(annotations, at);
+                break;
+            case 1:
+                annotations.erase(annotations.begin() + at);
+                index.erased(at);
+                break;
+            case 2:
+                annotations[at].label = randomText(0, 12);
+                index.updated(annotations, at);
+                break;
+            case 3: {
+                size_t first = annotations.size();
+                for (int i = 0; i < 3; ++i) annotations.push_back(randomAnnotation());
+                index.appended(annotations, first);
+                break;
+            }
+            case 4:
+                at = annotations.size() - std::min<size_t>(annotations.size(), 2);
+                annotations.resize(at);
+                index.removedTail(at);
+                break;
+            }
+        }
+        CHECK(!index.isCompact());
+        CHECK(queriesMatchScan(index, annotations));
+    }
+}
+
+static void checkRoundTrip(const std::vector<Annotation>& annotations) {
+    char directory[] = "/tmp/LabelIndexTest.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        ++checkFailures;
+        return;
+    }
+    const std::string path = std::string(directory) + "/annotations.hva";
+
+    LabelIndex index(annotations);
+    WriteAnnotationFile(path, "document.bin", ContentFingerprint(), annotations, 0, &index);
+
+    std::string bytes;
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        char buffer[65536];
+        for (size_t read; (read = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+            bytes.append(buffer, read);
+        }
+        fclose(file);
+    }
+    AnnotationFileContents contents = ParseAnnotationFile(reinterpret_cast<const BYTE*>(bytes.data()), bytes.size(), 1 << 20);
+    CHECK(contents.annotations.size() == annotations.size());
+    CHECK(contents.labelIndex != nullptr);
+    if (contents.labelIndex) {
+        CHECK(contents.labelIndex->isCompact());
+        CHECK(queriesMatchScan(*contents.labelIndex, contents.annotations));
+    }
+
+    // A damaged index is dropped rather than trusted
+    AnnotationFileHeaderV2 header;
+    memcpy(&header, bytes.data(), sizeof(header));
+    size_t lastPosting = header.labelIndexOffset + header.labelIndexSize - sizeof(uint32_t);
+    uint32_t outOfRange = static_cast<uint32_t>(annotations.size());
+    memcpy(&bytes[lastPosting], &outOfRange, sizeof(outOfRange));
+    contents = ParseAnnotationFile(reinterpret_cast<const BYTE*>(bytes.data()), bytes.size(), 1 << 20);
+    CHECK(contents.annotations.size() == annotations.size());
+    CHECK(contents.labelIndex == nullptr);
+
+    unlink(path.c_str());
+    rmdir(directory);
+}
+
+int main() {
+    std::vector<Annotation> annotations;
+    for (int i = 0; i < 10000; ++i) {
+        annotations.push_back(randomAnnotation());
+    }
+
+    checkBulk(annotations);
+    checkIncremental(annotations);
+    checkRoundTrip(annotations);
+    return CheckResult("LabelIndexTest");
+}
@@ -0,0 +1,173 @@
+//-------------------------------------------------------------------
+// SelectionUpdatesTest - coalescing of selection updates
+//-------------------------------------------------------------------
+// Drives SelectionUpdates and InterpreterGrid the way a viewer window does,
+// headless: synthetic mouse moves request updates, and a virtual 16 ms timer
+// applies them. The grid and status bar are counters, written whenever
+// InterpreterGrid::apply asks for them.
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "SelectionUpdates.h"
+
+// SELECTION_UPDATE_INTERVAL_MS in HexViewerWindow.cpp
+const long FRAME_MS = 16;
+
+struct Document {
+    std::vector<uint8_t> data;
+    SelectionUpdates updates;
+    long timerDue = -1;     // Virtual time the timer fires, -1 if not running
+    int recomputations = 0;
+    int gridWrites = 0;
+    int statusWrites = 0;
+};
+
+// The shared interpreter grid, and the text it shows
+static InterpreterGrid grid;
+static std::string gridText;
+
+// WM_MOUSEMOVE and friends: record the selection, start the timer if idle
+static void selectionChanged(Document& doc, long now, int start, int end) {
+    if (doc.updates.request(std::min(start, end), std::abs(end - start) + 1)) {
+        doc.timerDue = now + FRAME_MS;
+    }
+}
+
+// WM_TIMER, or activating the window
+static void applyUpdate(Document& doc, bool active = true) {
+    doc.timerDue = -1;
+    SelectionRefresh refresh = grid.apply(doc.updates, doc.data.data(), doc.data.size(), active);
+    doc.recomputations += refresh.recomputed;
+    if (refresh.grid) {
+        gridText = doc.updates.interpretation().text[DT_INT][BO_LITTLE_ENDIAN];
+        ++doc.gridWrites;
+    }
+    doc.statusWrites += refresh.status;
+}
+
+static void advanceTo(Document& doc, long now, bool active = true) {
+    if (doc.timerDue >= 0 && now >= doc.timerDue) {
+        applyUpdate(doc, active);
+    }
+}
+
+int main() {
+    std::mt19937 random(1);
+
+    // A 2 s drag with a mouse move every millisecond. The start stays put, so
+    // only the first update interprets anything; the status bar follows
+    // every frame.
+    {
+        Document doc;
+        doc.data.resize(1 << 20);
+        for (uint8_t& byte : doc.data) {
+            byte = static_cast<uint8_t>(random());
+        }
+        for (long now = 0; now < 2000; ++now) {
+            selectionChanged(doc, now, 100, 100 + static_cast<int>(now) * 3);
+            advanceTo(doc, now);
+        }
+        advanceTo(doc, 2100);
+
+        printf("forward drag: 2000 moves, %d recomputations, %d status writes\n", doc.recomputations, doc.statusWrites);
+        CHECK(doc.recomputations == 1);
+        CHECK(doc.statusWrites >= 2000 / (FRAME_MS + 1) && doc.statusWrites <= 2000 / FRAME_MS + 1);
+        CHECK(doc.updates.length() == 1999 * 3 + 1);
+        CHECK(!doc.updates.pending());
+    }
+
+    // Dragging backwards moves the first byte with every move, so there is
+    // one recomputation per frame rather than per move
+    {
+        Document doc;
+        doc.data.resize(1 << 20);
+        for (long now = 0; now < 2000; ++now) {
+            selectionChanged(doc, now, 500000, 500000 - static_cast<int>(now));
+            advanceTo(doc, now);
+        }
+        advanceTo(doc, 2100);
+
+        printf("backward drag: 2000 moves, %d recomputations\n", doc.recomputations);
+        CHECK(doc.recomputations >= 2000 / (FRAME_MS + 1) && doc.recomputations <= 2000 / FRAME_MS + 1);
+        CHECK(doc.updates.offset() == 500000 - 1999);
+    }
+
+    // Bursts of 5000 moves within one frame cost one recomputation each
+    {
+        Document doc;
+        doc.data.resize(4096);
+        for (int burst = 0; burst < 10; ++burst) {
+            long now = burst * 100;
+            for (int i = 0; i < 5000; ++i) {
+                selectionChanged(doc, now, static_cast<int>(random() % 4096), static_cast<int>(random() % 4096));
+            }
+            advanceTo(doc, now + FRAME_MS);
+        }
+
+        printf("bursts: 50000 moves, %d recomputations\n", doc.recomputations);
+        CHECK(doc.recomputations <= 10);
+    }
+
+    // Two documents at the same offset show their own values
+    {
+        Document a, b;
+        a.data = { 1, 0, 0, 0 };
+        b.data = { 2, 0, 0, 0 };
+        selectionChanged(a, 0, 0, 0);
+        advanceTo(a, FRAME_MS);
+        CHECK(gridText == "1 (0x1)");
+        selectionChanged(b, 20, 0, 0);
+        advanceTo(b, 20 + FRAME_MS);
+        CHECK(gridText == "2 (0x2)");
+
+        // Activating a again rewrites the grid from its cache
+        applyUpdate(a);
+        CHECK(gridText == "1 (0x1)");
+        CHECK(a.recomputations == 1 && a.gridWrites == 2);
+
+        // With nothing changed the grid is left alone
+        applyUpdate(a);
+        CHECK(a.gridWrites == 2);
+    }
+
+    // A document in the background keeps its values current without
+    // touching the grid, and shows them once it is activated
+    {
+        Document a, b;
+        a.data = { 3, 0, 0, 0 };
+        b.data = { 4, 0, 0, 0 };
+        selectionChanged(a, 0, 0, 0);
+        advanceTo(a, FRAME_MS);
+        CHECK(gridText == "3 (0x3)");
+
+        selectionChanged(b, 20, 0, 0);
+        advanceTo(b, 20 + FRAME_MS, false);
+        CHECK(b.recomputations == 1);
+        CHECK(b.gridWrites == 0 && b.statusWrites == 0);
+        CHECK(gridText == "3 (0x3)");
+
+        applyUpdate(b);
+        CHECK(gridText == "4 (0x4)");
+        CHECK(b.recomputations == 1 && b.gridWrites == 1 && b.statusWrites == 1);
+
+        // After forget, the grid no longer counts as showing b
+        grid.forget(b.updates);
+        applyUpdate(b);
+        CHECK(b.gridWrites == 2);
+    }
+
+    // A selection past the end of the data interprets nothing
+    {
+        Document doc;
+        doc.data = { 1, 2 };
+        selectionChanged(doc, 0, 5, 5);
+        advanceTo(doc, FRAME_MS);
+        CHECK(doc.recomputations == 0);
+        CHECK(!doc.updates.hasInterpretation());
+    }
+
+    return CheckResult("SelectionUpdatesTest");
+}
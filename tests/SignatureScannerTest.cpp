@@ -0,0 +1,122 @@
+//-------------------------------------------------------------------
+// SignatureScannerTest - parsing of signature rules files
+//-------------------------------------------------------------------
+// Lengths in each notation, quoted labels that contain '#' or look like
+// pattern bytes, comments, and the malformed lines that must be rejected.
+#include <Windows.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Check.h"
+#include "SignatureScanner.h"
+
+static std::vector<SignatureRule> parse(const std::string& text) {
+    try {
+        return ParseSignatureRules(text);
+    }
+    catch (const std::exception& e) {
+        printf("unexpected error: %s\n", e.what());
+        ++checkFailures;
+        return {};
+    }
+}
+
+static bool rejects(const std::string& text) {
+    try {
+        ParseSignatureRules(text);
+        return false;
+    }
+    catch (const std::runtime_error&) {
+        return true;
+    }
+}
+
+static bool hasPattern(const SignatureRule& rule, std::vector<BYTE> bytes, std::vector<BYTE> mask) {
+    return rule.pattern.bytes == bytes && rule.pattern.mask == mask;
+}
+
+static void checkLengths() {
+    std::vector<SignatureRule> rules = parse(
+        "4D 5A ?? ?? 50 45   0x40   \"PE header\"   hex\n"
+        "4D 5A   64   \"DOS header\"\n"
+        "A? 0F 08 label int\n"
+        "1F 8B 010 gzip\n");
+    CHECK(rules.size() == 4);
+    if (rules.size() != 4) return;
+
+    CHECK(hasPattern(rules[0], { 0x4D, 0x5A, 0, 0, 0x50, 0x45 }, { 0xFF, 0xFF, 0, 0, 0xFF, 0xFF }));
+    CHECK(rules[0].length == 0x40);
+    CHECK(rules[0].label == "PE header");
+    CHECK(rules[0].displayFormat == "hex");
+
+    // Two-digit decimal lengths also read as pattern bytes
+    CHECK(hasPattern(rules[1], { 0x4D, 0x5A }, { 0xFF, 0xFF }));
+    CHECK(rules[1].length == 64);
+    CHECK(rules[1].label == "DOS header");
+    CHECK(rules[2].length == 8);
+    CHECK(hasPattern(rules[2], { 0xA0, 0x0F }, { 0xF0, 0xFF }));
+    CHECK(rules[2].displayFormat == "int");
+
+    // A leading zero is not octal
+    CHECK(rules[3].length == 10);
+}
+
+static void checkQuotedLabels() {
+    std::vector<SignatureRule> rules = parse(
+        "89 50 4E 47  8  \"Chunk #1\"  # the first chunk\n"
+        "4D 5A 64 \"CA\"\n"
+        "4D 5A 0x20 \"FF\" \"#\"\n"
+        "CA FE 16 \"64\"\n");
+    CHECK(rules.size() == 4);
+    if (rules.size() != 4) return;
+
+    CHECK(rules[0].label == "Chunk #1");
+    CHECK(rules[0].length == 8);
+    CHECK(rules[0].displayFormat == "hex");
+
+    // A quoted label that reads as a pattern byte or a length stays a label
+    CHECK(hasPattern(rules[1], { 0x4D, 0x5A }, { 0xFF, 0xFF }));
+    CHECK(rules[1].length == 64);
+    CHECK(rules[1].label == "CA");
+    CHECK(rules[2].label == "FF");
+    CHECK(rules[2].displayFormat == "#");
+    CHECK(hasPattern(rules[3], { 0xCA, 0xFE }, { 0xFF, 0xFF }));
+    CHECK(rules[3].length == 16);
+    CHECK(rules[3].label == "64");
+}
+
+static void checkComments() {
+    std::vector<SignatureRule> rules = parse(
+        "# rules for tests\n"
+        "\n"
+        "   \n"
+        "7F 45 4C 46 0x34 ELF# header\n"
+        "50 4B 03 04 30 zip # local header\n");
+    CHECK(rules.size() == 2);
+    if (rules.size() != 2) return;
+    CHECK(rules[0].label == "ELF");
+    CHECK(rules[0].displayFormat == "hex");
+    CHECK(rules[1].length == 30);
+    CHECK(rules[1].label == "zip");
+}
+
+static void checkErrors() {
+    CHECK(rejects("label 4D 5A 10 x\n"));
+    CHECK(rejects("\"4D\" 5A 10 x\n"));         // Quoted tokens are not pattern bytes
+    CHECK(rejects("4D 5A \"16\" x\n"));         // nor lengths
+    CHECK(rejects("4D 5A 0x10\n"));
+    CHECK(rejects("4D 5A 0x10 \"\"\n"));
+    CHECK(rejects("4D 5A 0 x\n"));
+    CHECK(rejects("?? ?? 0x10 x\n"));
+    CHECK(rejects("4D 5A 0x10 \"open label\n"));
+    CHECK(rejects("4D 5A 0x10 x hex extra\n"));
+    CHECK(rejects("4D 5A 0x10 \"x # y\" hex # ok\n4D\n"));
+}
+
+int main() {
+    checkLengths();
+    checkQuotedLabels();
+    checkComments();
+    checkErrors();
+    return CheckResult("SignatureScannerTest");
+}
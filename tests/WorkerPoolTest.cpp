@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------
+// WorkerPoolTest - exceptions thrown from parallelFor bodies
+//-------------------------------------------------------------------
+// A throw on the calling thread or on a worker must reach the caller of
+// parallelFor, only after every other index has left fn, and leave the pool
+// usable for the next job.
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include "Check.h"
+#include "WorkerPool.h"
+
+// Throws from the index that lands on whichever thread claims it; the other
+// indices sleep briefly so a dangling fn would be visible as a late call.
+static void checkThrowIsRethrown(WorkerPool& pool, size_t throwingIndex) {
+    std::atomic<int> inside{ 0 };
+    std::atomic<int> callsAfterReturn{ 0 };
+    std::atomic<bool> returned{ false };
+    bool caught = false;
+
+    try {
+        pool.parallelFor(64, [&](size_t index) {
+            if (returned) {
+                ++callsAfterReturn;
+            }
+            ++inside;
+            if (index == throwingIndex) {
+                --inside;
+                throw std::runtime_error("index failed");
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            --inside;
+        });
+    }
+    catch (const std::runtime_error&) {
+        caught = true;
+    }
+    returned = true;
+
+    CHECK(caught);
+    CHECK(inside == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(callsAfterReturn == 0);
+}
+
+static void checkFirstExceptionWins(WorkerPool& pool) {
+    int caught = 0;
+    try {
+        pool.parallelFor(1000, [](size_t) { throw std::bad_alloc(); });
+    }
+    catch (const std::bad_alloc&) {
+        ++caught;
+    }
+    CHECK(caught == 1);
+}
+
+static void checkPoolStillWorks(WorkerPool& pool) {
+    std::atomic<size_t> sum{ 0 };
+    pool.parallelFor(1000, [&](size_t index) { sum += index; });
+    CHECK(sum == 1000 * 999 / 2);
+}
+
+int main() {
+    WorkerPool pool(4);
+    checkThrowIsRethrown(pool, 0);      // Claimed by the calling thread first
+    checkThrowIsRethrown(pool, 37);
+    checkThrowIsRethrown(pool, 63);
+    checkFirstExceptionWins(pool);
+    checkPoolStillWorks(pool);
+    return CheckResult("WorkerPoolTest");
+}
@@ -0,0 +1,257 @@
+#include <Windows.h>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <map>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//-------------------------------------------------------------------
+// Handles
+//-------------------------------------------------------------------
+// A handle is a file descriptor plus one, so that descriptor 0 is not NULL
+static int descriptorOf(HANDLE handle) {
+    return static_cast<int>(reinterpret_cast<intptr_t>(handle)) - 1;
+}
+
+static HANDLE handleOf(int descriptor) {
+    return reinterpret_cast<HANDLE>(static_cast<intptr_t>(descriptor) + 1);
+}
+
+HANDLE CreateFile(LPCSTR path, DWORD access, DWORD, void*, DWORD disposition, DWORD, HANDLE) {
+    int flags = (access & GENERIC_WRITE) ? ((access & GENERIC_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    switch (disposition) {
+    case CREATE_NEW: flags |= O_CREAT | O_EXCL; break;
+    case CREATE_ALWAYS: flags |= O_CREAT | O_TRUNC; break;
+    case OPEN_ALWAYS: flags |= O_CREAT; break;
+    }
+
+    int descriptor = open(path, flags | O_CLOEXEC, 0644);
+    return descriptor < 0 ? INVALID_HANDLE_VALUE : handleOf(descriptor);
+}
+
+BOOL CloseHandle(HANDLE handle) {
+    return close(descriptorOf(handle)) == 0;
+}
+
+BOOL ReadFile(HANDLE file, void* buffer, DWORD size, DWORD* read, void*) {
+    ssize_t count = ::read(descriptorOf(file), buffer, size);
+    if (count < 0) {
+        return FALSE;
+    }
+    *read = static_cast<DWORD>(count);
+    return TRUE;
+}
+
+BOOL WriteFile(HANDLE file, const void* data, DWORD size, DWORD* written, void*) {
+    ssize_t count = write(descriptorOf(file), data, size);
+    if (count < 0) {
+        return FALSE;
+    }
+    *written = static_cast<DWORD>(count);
+    return TRUE;
+}
+
+BOOL FlushFileBuffers(HANDLE file) {
+    return fsync(descriptorOf(file)) == 0;
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size) {
+    struct stat status;
+    if (fstat(descriptorOf(file), &status) != 0) {
+        return FALSE;
+    }
+    size->QuadPart = status.st_size;
+    return TRUE;
+}
+
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, LARGE_INTEGER* position, DWORD method) {
+    int whence = method == FILE_END ? SEEK_END : method == FILE_CURRENT ? SEEK_CUR : SEEK_SET;
+    off_t offset = lseek(descriptorOf(file), distance.QuadPart, whence);
+    if (offset < 0) {
+        return FALSE;
+    }
+    if (position) {
+        position->QuadPart = offset;
+    }
+    return TRUE;
+}
+
+BOOL SetEndOfFile(HANDLE file) {
+    off_t offset = lseek(descriptorOf(file), 0, SEEK_CUR);
+    return offset >= 0 && ftruncate(descriptorOf(file), offset) == 0;
+}
+
+//-------------------------------------------------------------------
+// Mappings
+//-------------------------------------------------------------------
+// munmap needs the length of each view
+static std::mutex viewMutex;
+static std::map<const void*, size_t> viewSizes;
+
+HANDLE CreateFileMapping(HANDLE file, void*, DWORD, DWORD, DWORD, LPCSTR) {
+    int descriptor = dup(descriptorOf(file));
+    return descriptor < 0 ? NULL : handleOf(descriptor);
+}
+
+void* MapViewOfFile(HANDLE mapping, DWORD, DWORD, DWORD, size_t) {
+    struct stat status;
+    if (fstat(descriptorOf(mapping), &status) != 0 || status.st_size == 0) {
+        return NULL;
+    }
+
+    void* view = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptorOf(mapping), 0);
+    if (view == MAP_FAILED) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(viewMutex);
+    viewSizes[view] = status.st_size;
+    return view;
+}
+
+BOOL UnmapViewOfFile(const void* view) {
+    std::lock_guard<std::mutex> lock(viewMutex);
+    auto it = viewSizes.find(view);
+    if (it == viewSizes.end()) {
+        return FALSE;
+    }
+    munmap(const_cast<void*>(view), it->second);
+    viewSizes.erase(it);
+    return TRUE;
+}
+
+//-------------------------------------------------------------------
+// Paths
+//-------------------------------------------------------------------
+DWORD GetFileAttributes(LPCSTR path) {
+    struct stat status;
+    if (stat(path, &status) != 0) {
+        return INVALID_FILE_ATTRIBUTES;
+    }
+    return S_ISDIR(status.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+}
+
+BOOL GetFileAttributesEx(LPCSTR path, GET_FILEEX_INFO_LEVELS, void* information) {
+    struct stat status;
+    if (stat(path, &status) != 0) {
+        return FALSE;
+    }
+
+    // FILETIME counts 100 ns intervals from 1601
+    const uint64_t EPOCH_DIFFERENCE = 116444736000000000ull;
+    uint64_t writeTime = EPOCH_DIFFERENCE + static_cast<uint64_t>(status.st_mtim.tv_sec) * 10000000 + status.st_mtim.tv_nsec / 100;
+
+    auto* data = static_cast<WIN32_FILE_ATTRIBUTE_DATA*>(information);
+    memset(data, 0, sizeof(*data));
+    data->dwFileAttributes = S_ISDIR(status.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+    data->ftLastWriteTime.dwLowDateTime = static_cast<DWORD>(writeTime);
+    data->ftLastWriteTime.dwHighDateTime = static_cast<DWORD>(writeTime >> 32);
+    data->nFileSizeLow = static_cast<DWORD>(status.st_size);
+    data->nFileSizeHigh = static_cast<DWORD>(static_cast<uint64_t>(status.st_size) >> 32);
+    return TRUE;
+}
+
+BOOL MoveFileEx(LPCSTR from, LPCSTR to, DWORD flags) {
+    if (!(flags & MOVEFILE_REPLACE_EXISTING) && access(to, F_OK) == 0) {
+        return FALSE;
+    }
+    return rename(from, to) == 0;
+}
+
+BOOL CopyFile(LPCSTR from, LPCSTR to, BOOL failIfExists) {
+    int source = open(from, O_RDONLY | O_CLOEXEC);
+    if (source < 0) {
+        return FALSE;
+    }
+    int target = open(to, O_WRONLY | O_CREAT | O_CLOEXEC | (failIfExists ? O_EXCL : O_TRUNC), 0644);
+    if (target < 0) {
+        close(source);
+        return FALSE;
+    }
+
+    char buffer[65536];
+    ssize_t count;
+    bool ok = true;
+    while (ok && (count = read(source, buffer, sizeof(buffer))) > 0) {
+        ok = write(target, buffer, count) == count;
+    }
+    ok = ok && count == 0;
+    close(source);
+    return close(target) == 0 && ok;
+}
+
+BOOL DeleteFile(LPCSTR path) {
+    return unlink(path) == 0;
+}
+
+BOOL CreateDirectory(LPCSTR path, void*) {
+    return mkdir(path, 0755) == 0;
+}
+
+//-------------------------------------------------------------------
+// Code pages
+//-------------------------------------------------------------------
+// Both code pages are UTF-8 here, and wchar_t holds a whole code point. A
+// length of -1 includes the terminating NUL, as on Windows.
+int MultiByteToWideChar(UINT, DWORD, LPCSTR text, int length, LPWSTR wide, int wideLength) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text);
+    const unsigned char* end = p + (length < 0 ? strlen(text) + 1 : static_cast<size_t>(length));
+    int count = 0;
+    while (p < end) {
+        uint32_t c = *p++;
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        if (extra) {
+            c &= 0x3F >> extra;
+        }
+        for (; extra > 0 && p < end; --extra) {
+            c = (c << 6) | (*p++ & 0x3F);
+        }
+        if (wide && count < wideLength) {
+            wide[count] = static_cast<wchar_t>(c);
+        }
+        ++count;
+    }
+    return count;
+}
+
+int WideCharToMultiByte(UINT, DWORD, LPCWSTR wide, int wideLength, LPSTR text, int length, LPCSTR, BOOL*) {
+    size_t end = wideLength < 0 ? wcslen(wide) + 1 : static_cast<size_t>(wideLength);
+    std::string encoded;
+    for (size_t i = 0; i < end; ++i) {
+        uint32_t c = static_cast<uint32_t>(wide[i]);
+        if (c < 0x80) {
+            encoded += static_cast<char>(c);
+        }
+        else if (c < 0x800) {
+            encoded += static_cast<char>(0xC0 | (c >> 6));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            encoded += static_cast<char>(0xE0 | (c >> 12));
+            encoded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else {
+            encoded += static_cast<char>(0xF0 | (c >> 18));
+            encoded += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            encoded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    if (text) {
+        memcpy(text, encoded.data(), std::min(encoded.size(), static_cast<size_t>(length)));
+    }
+    return static_cast<int>(encoded.size());
+}
+
+//-------------------------------------------------------------------
+// User interface
+//-------------------------------------------------------------------
+int MessageBox(HWND, LPCSTR text, LPCSTR caption, UINT) {
+    fprintf(stderr, "%s: %s\n", caption, text);
+    return 1;
+}
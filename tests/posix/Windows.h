@@ -0,0 +1,136 @@
+#pragma once
+//-------------------------------------------------------------------
+// Windows.h - POSIX shims for building the document modules on Linux
+//-------------------------------------------------------------------
+// Declares the part of the Win32 API that the modules without a user
+// interface use: file handles, mappings and attributes, the code page
+// conversions, MessageBox and a few CRT extensions. The definitions in
+// Posix.cpp map them onto POSIX calls closely enough for the tests and
+// benchmarks; they are not a general emulation. Only the ANSI (A) forms
+// exist, and every code page is taken to be UTF-8.
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef DWORD COLORREF;
+typedef char CHAR;
+typedef const char* LPCSTR;
+typedef char* LPSTR;
+typedef wchar_t* LPWSTR;
+typedef const wchar_t* LPCWSTR;
+typedef void* HANDLE;
+
+struct HWND__;
+typedef HWND__* HWND;
+typedef void* HFONT;
+typedef void* HBRUSH;
+typedef void* HPEN;
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+
+#define RGB(r, g, b) ((COLORREF)(((BYTE)(r) | ((WORD)((BYTE)(g)) << 8)) | (((DWORD)(BYTE)(b)) << 16)))
+
+union LARGE_INTEGER {
+    struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+};
+
+struct FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+};
+
+struct WIN32_FILE_ATTRIBUTE_DATA {
+    DWORD dwFileAttributes;
+    FILETIME ftCreationTime;
+    FILETIME ftLastAccessTime;
+    FILETIME ftLastWriteTime;
+    DWORD nFileSizeHigh;
+    DWORD nFileSizeLow;
+};
+
+enum GET_FILEEX_INFO_LEVELS { GetFileExInfoStandard };
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define INVALID_FILE_ATTRIBUTES ((DWORD)-1)
+
+#define GENERIC_READ 0x80000000u
+#define GENERIC_WRITE 0x40000000u
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define PAGE_READONLY 0x02
+#define FILE_MAP_READ 0x0004
+#define MOVEFILE_REPLACE_EXISTING 0x00000001
+#define MOVEFILE_WRITE_THROUGH 0x00000008
+
+#define CP_ACP 0
+#define CP_UTF8 65001
+
+#define MB_OK 0x00000000
+#define MB_YESNO 0x00000004
+#define MB_ICONERROR 0x00000010
+#define MB_ICONWARNING 0x00000030
+#define MB_ICONINFORMATION 0x00000040
+#define IDYES 6
+#define IDNO 7
+
+HANDLE CreateFile(LPCSTR path, DWORD access, DWORD share, void* security, DWORD disposition, DWORD flags, HANDLE templateFile);
+BOOL CloseHandle(HANDLE handle);
+BOOL ReadFile(HANDLE file, void* buffer, DWORD size, DWORD* read, void* overlapped);
+BOOL WriteFile(HANDLE file, const void* data, DWORD size, DWORD* written, void* overlapped);
+BOOL FlushFileBuffers(HANDLE file);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER* size);
+BOOL SetFilePointerEx(HANDLE file, LARGE_INTEGER distance, LARGE_INTEGER* position, DWORD method);
+BOOL SetEndOfFile(HANDLE file);
+
+// The whole file is mapped read-only whatever offset and size are asked for
+HANDLE CreateFileMapping(HANDLE file, void* security, DWORD protect, DWORD sizeHigh, DWORD sizeLow, LPCSTR name);
+void* MapViewOfFile(HANDLE mapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, size_t size);
+BOOL UnmapViewOfFile(const void* view);
+
+DWORD GetFileAttributes(LPCSTR path);
+BOOL GetFileAttributesEx(LPCSTR path, GET_FILEEX_INFO_LEVELS level, void* information);
+BOOL MoveFileEx(LPCSTR from, LPCSTR to, DWORD flags);
+BOOL CopyFile(LPCSTR from, LPCSTR to, BOOL failIfExists);
+BOOL DeleteFile(LPCSTR path);
+BOOL CreateDirectory(LPCSTR path, void* security);
+
+int MultiByteToWideChar(UINT codePage, DWORD flags, LPCSTR text, int length, LPWSTR wide, int wideLength);
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR wide, int wideLength, LPSTR text, int length,
+    LPCSTR defaultChar, BOOL* usedDefaultChar);
+
+// Writes the caption and text to stderr
+int MessageBox(HWND hwnd, LPCSTR text, LPCSTR caption, UINT type);
+
+inline int sprintf_s(char* buffer, size_t size, const char* format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vsnprintf(buffer, size, format, arguments);
+    va_end(arguments);
+    return length;
+}